@@ -0,0 +1,71 @@
+#include "binary_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdexcept>
+
+#include "result_cache.hpp"
+
+using namespace std;
+
+MappedGraphFile::MappedGraphFile(const string &file_path, const string &kind,
+                                 uint32_t magic, uint32_t version,
+                                 size_t header_bytes, size_t value_bytes,
+                                 const eds_matrix &eds_segments,
+                                 uint64_t num_vertices)
+    : header_bytes_(header_bytes) {
+    int fd = open(file_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("cannot read file '" + file_path + "'");
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        throw runtime_error("cannot read file '" + file_path + "'");
+    }
+    mapping_bytes_ = file_stat.st_size;
+    if (mapping_bytes_ < header_bytes) {
+        close(fd);
+        throw invalid_argument("'" + file_path + "' is not a " + kind + ".");
+    }
+    mapping_ = mmap(nullptr, mapping_bytes_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping_ == MAP_FAILED) {
+        mapping_ = nullptr;
+        throw runtime_error("cannot map file '" + file_path + "'");
+    }
+
+    // The mapping is released by the destructor only once constructed.
+    try {
+        if (readValue<uint32_t>(data(), 0) != magic ||
+            readValue<uint32_t>(data(), 4) != version) {
+            throw invalid_argument("'" + file_path + "' is not a " + kind +
+                                   ".");
+        }
+        if (readValue<uint64_t>(data(), 8) != graphFingerprint(eds_segments)) {
+            throw invalid_argument("'" + file_path + "' is the " + kind +
+                                   " of another graph.");
+        }
+        if (readValue<uint64_t>(data(), 16) != num_vertices ||
+            (mapping_bytes_ - header_bytes) / value_bytes != num_vertices) {
+            throw invalid_argument("'" + file_path + "' has a " + kind +
+                                   " of another length.");
+        }
+    } catch (...) {
+        munmap(mapping_, mapping_bytes_);
+        throw;
+    }
+}
+
+MappedGraphFile::~MappedGraphFile() {
+    if (mapping_) {
+        munmap(mapping_, mapping_bytes_);
+    }
+}
+
+void MappedGraphFile::advise(int advice) const {
+    madvise(mapping_, mapping_bytes_, advice);
+}
@@ -0,0 +1,77 @@
+#ifndef MAXSCOREPATH_BINARY_FILE_HEADER
+#define MAXSCOREPATH_BINARY_FILE_HEADER
+
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <string>
+
+#include "utility_func.hpp"
+
+using namespace std;
+
+// This file contains the helpers shared by the binary files of the tool: the
+// result cache, weight tracks, marginal tables and shard files. All values are
+// in the byte order of the machine.
+
+// Writes the bytes of `value` to `output`.
+template <typename T>
+void writeValue(ostream &output, const T &value) {
+    output.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+// Reads `value` from `input`, returns false if the input ended before.
+template <typename T>
+bool readValue(istream &input, T &value) {
+    return bool(input.read(reinterpret_cast<char *>(&value), sizeof(value)));
+}
+
+// Returns the value at byte `offset` of `data`, which need not be aligned.
+template <typename T>
+T readValue(const char *data, size_t offset) {
+    T value;
+    memcpy(&value, data + offset, sizeof(value));
+    return value;
+}
+
+// The files of per-vertex values of one graph, weight tracks and marginal
+// tables, start with a header that holds, in this order:
+// - a magic number and a version, both 32 bits;
+// - the `graphFingerprint()` of the graph, 64 bits;
+// - the number of vertices, 64 bits.
+// A file may extend the header, its values start after it.
+const size_t GRAPH_FILE_HEADER_BYTES = 24;
+
+// A file of per-vertex values of one graph mapped into memory, read-only.
+class MappedGraphFile {
+   public:
+    // Maps `file_path` and checks its header against `magic`, `version`, the
+    // graph `eds_segments` and its `num_vertices`, and that `value_bytes` per
+    // vertex follow the `header_bytes`. `kind` names the file in messages,
+    // e.g. "weight track". Throws `runtime_error` if the file cannot be
+    // mapped, and `invalid_argument` if it is not such a file of this graph.
+    MappedGraphFile(const string &file_path, const string &kind,
+                    uint32_t magic, uint32_t version, size_t header_bytes,
+                    size_t value_bytes, const eds_matrix &eds_segments,
+                    uint64_t num_vertices);
+    ~MappedGraphFile();
+
+    MappedGraphFile(const MappedGraphFile &) = delete;
+    MappedGraphFile &operator=(const MappedGraphFile &) = delete;
+
+    // The bytes of the file, from the header on.
+    const char *data() const { return static_cast<const char *>(mapping_); }
+    // The values after the header.
+    const char *values() const { return data() + header_bytes_; }
+
+    // Tells the kernel how the values are read, see `madvise()`.
+    void advise(int advice) const;
+
+   private:
+    void *mapping_ = nullptr;
+    size_t mapping_bytes_ = 0;
+    size_t header_bytes_;
+};
+
+#endif
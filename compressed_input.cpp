@@ -0,0 +1,248 @@
+#include "compressed_input.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef MAXSCOREPATH_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+#include "pipeline.hpp"
+
+using namespace std;
+
+namespace {
+
+const unsigned char GZIP_MAGIC[] = {0x1f, 0x8b};
+const unsigned char ZSTD_MAGIC[] = {0x28, 0xb5, 0x2f, 0xfd};
+
+// Deflate expands at most 1032 times. A zstd block expands at most 32768
+// times, an RLE block of 4 bytes into the largest block of 128 KiB.
+const int64_t GZIP_MAX_RATIO = 1032;
+const int64_t ZSTD_MAX_RATIO = 32768;
+
+// Bytes read from the file and decompressed into a block at a time.
+const size_t DECOMPRESSION_BLOCK_BYTES = 1 << 20;
+// Decompressed blocks waiting for the reader.
+const size_t DECOMPRESSED_QUEUE_BLOCKS = 4;
+
+// The decompressed content of a file, filled by a decompression thread.
+class DecompressingBuffer : public streambuf {
+   public:
+    DecompressingBuffer(int fd, Compression compression,
+                        const string &file_path)
+        : fd_(fd),
+          file_path_(file_path),
+          blocks_(DECOMPRESSED_QUEUE_BLOCKS),
+          thread_([this, compression] { decompress(compression); }) {}
+
+    ~DecompressingBuffer() override {
+        blocks_.cancel();
+        thread_.join();
+        close(fd_);
+    }
+
+   protected:
+    int_type underflow() override {
+        do {
+            if (!blocks_.pop(block_)) {
+                // The error is set before the queue is closed.
+                if (error_) {
+                    rethrow_exception(error_);
+                }
+                return traits_type::eof();
+            }
+        } while (block_.empty());
+        setg(block_.data(), block_.data(), block_.data() + block_.size());
+        return traits_type::to_int_type(block_[0]);
+    }
+
+   private:
+    void decompress(Compression compression) {
+        try {
+            if (compression == Compression::GZIP) {
+                inflateGzip();
+            } else {
+                decompressZstd();
+            }
+        } catch (...) {
+            error_ = current_exception();
+        }
+        blocks_.close();
+    }
+
+    // Reads the next bytes of the file into `input`, returns their number.
+    size_t readInput(vector<char> &input) {
+        ssize_t read_bytes = read(fd_, input.data(), input.size());
+        if (read_bytes < 0) {
+            throw runtime_error("cannot read file '" + file_path_ + "'");
+        }
+        return read_bytes;
+    }
+
+    // Inflates the gzip members of the file one after the other, as `gzip -d`
+    // does.
+    void inflateGzip() {
+        z_stream stream = {};
+        // 32 detects the gzip header.
+        if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+            throw runtime_error("cannot decompress file '" + file_path_ + "'");
+        }
+        unique_ptr<z_stream, int (*)(z_stream *)> stream_end(&stream,
+                                                             inflateEnd);
+        vector<char> input(DECOMPRESSION_BLOCK_BYTES);
+        bool end_of_file = false;
+        bool member_ended = false;
+        while (true) {
+            if (stream.avail_in == 0 && !end_of_file) {
+                stream.avail_in = readInput(input);
+                stream.next_in = reinterpret_cast<Bytef *>(input.data());
+                end_of_file = stream.avail_in == 0;
+            }
+            string block(DECOMPRESSION_BLOCK_BYTES, '\0');
+            stream.next_out = reinterpret_cast<Bytef *>(block.data());
+            stream.avail_out = block.size();
+            uInt avail_in = stream.avail_in;
+            int status = inflate(&stream, Z_NO_FLUSH);
+            if (status == Z_STREAM_END) {
+                member_ended = true;
+                inflateReset(&stream);
+            } else if (status == Z_OK) {
+                member_ended &= stream.avail_in == avail_in;
+            } else if (status != Z_BUF_ERROR) {
+                throw runtime_error("file '" + file_path_ +
+                                    "' is not valid gzip");
+            }
+            block.resize(block.size() - stream.avail_out);
+            if (block.empty() && end_of_file && stream.avail_in == 0) {
+                break;
+            }
+            if (!block.empty() && !blocks_.push(move(block))) {
+                return;
+            }
+        }
+        if (!member_ended) {
+            throw runtime_error("file '" + file_path_ + "' is truncated");
+        }
+    }
+
+    void decompressZstd() {
+#ifdef MAXSCOREPATH_WITH_ZSTD
+        unique_ptr<ZSTD_DStream, size_t (*)(ZSTD_DStream *)> stream(
+            ZSTD_createDStream(), ZSTD_freeDStream);
+        if (!stream || ZSTD_isError(ZSTD_initDStream(stream.get()))) {
+            throw runtime_error("cannot decompress file '" + file_path_ + "'");
+        }
+        vector<char> input(DECOMPRESSION_BLOCK_BYTES);
+        ZSTD_inBuffer in = {input.data(), 0, 0};
+        bool end_of_file = false;
+        // 0 once a frame is complete.
+        size_t status = 0;
+        while (true) {
+            if (in.pos == in.size && !end_of_file) {
+                in = {input.data(), readInput(input), 0};
+                end_of_file = in.size == 0;
+            }
+            string block(DECOMPRESSION_BLOCK_BYTES, '\0');
+            ZSTD_outBuffer out = {block.data(), block.size(), 0};
+            status = ZSTD_decompressStream(stream.get(), &out, &in);
+            if (ZSTD_isError(status)) {
+                throw runtime_error("file '" + file_path_ +
+                                    "' is not valid zstd: " +
+                                    ZSTD_getErrorName(status));
+            }
+            block.resize(out.pos);
+            if (block.empty() && end_of_file && in.pos == in.size) {
+                break;
+            }
+            if (!block.empty() && !blocks_.push(move(block))) {
+                return;
+            }
+        }
+        if (status != 0) {
+            throw runtime_error("file '" + file_path_ + "' is truncated");
+        }
+#else
+        throw runtime_error("file '" + file_path_ +
+                            "' needs zstd, which this build does not support");
+#endif
+    }
+
+    int fd_;
+    string file_path_;
+    SPSCQueue<string> blocks_;
+    // The block that the get area points to.
+    string block_;
+    exception_ptr error_;
+    thread thread_;
+};
+
+class DecompressingStream : public istream {
+   public:
+    DecompressingStream(int fd, Compression compression,
+                        const string &file_path)
+        : istream(nullptr), buffer_(fd, compression, file_path) {
+        rdbuf(&buffer_);
+        // Rethrows the errors of the decompression from the reads.
+        exceptions(ios::badbit);
+    }
+
+   private:
+    DecompressingBuffer buffer_;
+};
+
+}  // namespace
+
+Compression detectCompression(const string &file_path) {
+    ifstream input(file_path, ios::binary);
+    if (!input) {
+        throw runtime_error("cannot read file '" + file_path + "'");
+    }
+    unsigned char magic[sizeof(ZSTD_MAGIC)] = {};
+    input.read(reinterpret_cast<char *>(magic), sizeof(magic));
+    if (input.gcount() >= (streamsize)sizeof(GZIP_MAGIC) &&
+        memcmp(magic, GZIP_MAGIC, sizeof(GZIP_MAGIC)) == 0) {
+        return Compression::GZIP;
+    }
+    if (input.gcount() == sizeof(ZSTD_MAGIC) &&
+        memcmp(magic, ZSTD_MAGIC, sizeof(ZSTD_MAGIC)) == 0) {
+        return Compression::ZSTD;
+    }
+    return Compression::NONE;
+}
+
+int64_t decompressedSizeBound(const string &file_path) {
+    Compression compression = detectCompression(file_path);
+    int64_t file_size = filesystem::file_size(file_path);
+    switch (compression) {
+        case Compression::GZIP:
+            return file_size * GZIP_MAX_RATIO;
+        case Compression::ZSTD:
+            return file_size * ZSTD_MAX_RATIO;
+        case Compression::NONE:
+            break;
+    }
+    return file_size;
+}
+
+unique_ptr<istream> openDecompressed(const string &file_path) {
+    Compression compression = detectCompression(file_path);
+    if (compression == Compression::NONE) {
+        return make_unique<ifstream>(file_path, ios::binary);
+    }
+    int fd = open(file_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("cannot read file '" + file_path + "'");
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return make_unique<DecompressingStream>(fd, compression, file_path);
+}
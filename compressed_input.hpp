@@ -0,0 +1,39 @@
+#ifndef MAXSCOREPATH_COMPRESSED_INPUT_HEADER
+#define MAXSCOREPATH_COMPRESSED_INPUT_HEADER
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+
+using namespace std;
+
+// This file contains the reading of compressed EDS files. gzip and zstd files
+// are recognized by their magic numbers and decompressed while they are read:
+// a decompression thread inflates the file block by block into a bounded
+// queue, and the reader takes the blocks from the queue through an `istream`.
+// The decompressed text is never written to disk, and the file is read at its
+// compressed size. zstd needs a build with `MAXSCOREPATH_WITH_ZSTD`, which
+// CMake defines when it finds the zstd library.
+
+enum class Compression { NONE, GZIP, ZSTD };
+
+// Returns the compression of `file_path` by its first bytes. Throws
+// `runtime_error` if the file cannot be read.
+Compression detectCompression(const string &file_path);
+
+// Returns an upper bound of the size of the decompressed content of
+// `file_path` in bytes, to select the coordinate and score types before the
+// file is read: its size if it is not compressed, its size times the maximal
+// compression ratio of the format otherwise. Throws `runtime_error` if the
+// file cannot be read.
+int64_t decompressedSizeBound(const string &file_path);
+
+// Opens `file_path` for reading its decompressed content, or its content if
+// it is not compressed. The decompression runs on its own thread while the
+// stream is read, a corrupt or truncated file makes a read throw
+// `runtime_error`. Throws `runtime_error` if the file cannot be opened or
+// needs zstd in a build without it.
+unique_ptr<istream> openDecompressed(const string &file_path);
+
+#endif
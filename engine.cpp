@@ -0,0 +1,145 @@
+#include "engine.hpp"
+
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+void *PeakCountingResource::do_allocate(size_t bytes, size_t alignment) {
+    void *p = pmr::new_delete_resource()->allocate(bytes, alignment);
+    allocated_ += bytes;
+    peak_ = max(peak_, allocated_);
+    return p;
+}
+
+void PeakCountingResource::do_deallocate(void *p, size_t bytes,
+                                         size_t alignment) {
+    pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    allocated_ -= bytes;
+}
+
+bool PeakCountingResource::do_is_equal(
+    const pmr::memory_resource &other) const noexcept {
+    return this == &other;
+}
+
+template <typename index_t>
+BasicMaxScorePathsEngine<index_t>::BasicMaxScorePathsEngine(
+    size_t initial_arena_size)
+    : eds_segments_(make_shared<eds_matrix>()), buffer_(initial_arena_size) {
+    createArena();
+}
+
+template <typename index_t>
+void BasicMaxScorePathsEngine<index_t>::loadGraph(const string &EDS) {
+    setGraph(EDSToMatrix(EDS));
+}
+
+template <typename index_t>
+void BasicMaxScorePathsEngine<index_t>::setGraph(eds_matrix eds_segments) {
+    setGraph(make_shared<const eds_matrix>(move(eds_segments)));
+}
+
+template <typename index_t>
+void BasicMaxScorePathsEngine<index_t>::setGraph(
+    shared_ptr<const eds_matrix> eds_segments) {
+    reset();
+    eds_segments_ = move(eds_segments);
+}
+
+template <typename index_t>
+void BasicMaxScorePathsEngine<index_t>::setGCContentScoring(int match,
+                                                            int non_match) {
+    match_ = match;
+    non_match_ = non_match;
+}
+
+template <typename index_t>
+void BasicMaxScorePathsEngine<index_t>::reset() {
+    paths_.reset();
+    tables_ = monostate();
+    weights_.reset();
+
+    if (upstream_.peak() == 0) {
+        // Everything fit into the buffer, start over from its beginning.
+        arena_->release();
+        return;
+    }
+    // The last run overflowed the buffer. Grow the buffer so that the next run
+    // of the same size fits into it.
+    size_t needed = buffer_.size() + upstream_.peak();
+    arena_.reset();
+    buffer_ = vector<byte>(needed);
+    upstream_.resetPeak();
+    createArena();
+}
+
+template <typename index_t>
+void BasicMaxScorePathsEngine<index_t>::createArena() {
+    if (buffer_.empty()) {
+        arena_.emplace(&upstream_);
+    } else {
+        arena_.emplace(buffer_.data(), buffer_.size(), &upstream_);
+    }
+}
+
+template <typename index_t>
+int64_t BasicMaxScorePathsEngine<index_t>::run(int penalty) {
+    reset();
+    weights_.emplace(
+        getGCContentWeights(*eds_segments_, match_, non_match_, &*arena_));
+
+    score_width_ = selectScoreWidth(*eds_segments_, *weights_, penalty);
+    switch (score_width_) {
+        case ScoreWidth::INT16:
+            return runWithScoreType<int16_t>(penalty);
+        case ScoreWidth::INT32:
+            return runWithScoreType<int32_t>(penalty);
+        case ScoreWidth::INT64:
+            break;
+    }
+    return runWithScoreType<int64_t>(penalty);
+}
+
+template <typename index_t>
+template <typename score_t>
+int64_t BasicMaxScorePathsEngine<index_t>::runWithScoreType(int penalty) {
+    int64_t result;
+    paths_.emplace(&*arena_);
+    if (layout_ == TableLayout::SCORE_ONLY) {
+        return findMaxScore<score_t, index_t>(*eds_segments_, *weights_,
+                                              penalty);
+    }
+    if (layout_ == TableLayout::CHECKPOINTED) {
+        return findMaxScoringPathsCheckpointed<score_t>(
+            *eds_segments_, *weights_, penalty, DEFAULT_BLOCK_VERTICES,
+            *paths_, &*arena_);
+    }
+    if (layout_ == TableLayout::PACKED) {
+        auto &tables = tables_.template emplace<PackedTables<score_t>>(
+            initPackedTables<score_t>(*eds_segments_, &*arena_));
+        result = findMaxScoringPaths<score_t, index_t>(
+            *eds_segments_, *weights_, tables, penalty);
+        getPathsInParallel(*eds_segments_, tables, *paths_,
+                           traceback_threads_);
+    } else if (layout_ == TableLayout::RUN_LENGTH && penalty >= 0) {
+        auto &tables = tables_.template emplace<RunLengthTables<score_t>>(
+            initRunLengthTables<score_t>(*weights_, &*arena_));
+        result = findMaxScoringPaths<score_t, index_t>(
+            *eds_segments_, *weights_, tables, penalty);
+        getPathsInParallel(*eds_segments_, *weights_, tables, *paths_,
+                           traceback_threads_);
+    } else {
+        auto &tables = tables_.template emplace<DPTables<score_t>>(
+            DPTables<score_t>{initScoreMatrix<score_t>(*weights_, &*arena_),
+                              initScoreMatrix<score_t>(*weights_, &*arena_)});
+        result = findMaxScoringPaths<score_t, index_t>(
+            *eds_segments_, *weights_, tables.scores, tables.choices, penalty);
+        getPathsInParallel(*eds_segments_, tables.scores, tables.choices,
+                           *paths_, traceback_threads_);
+    }
+    return result;
+}
+
+template class BasicMaxScorePathsEngine<int32_t>;
+template class BasicMaxScorePathsEngine<int64_t>;
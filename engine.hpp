@@ -0,0 +1,145 @@
+#ifndef MAXSCOREPATH_ENGINE_HEADER
+#define MAXSCOREPATH_ENGINE_HEADER
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "utility_func.hpp"
+
+using namespace std;
+
+// This file contains a reusable engine that runs the whole algorithm on a
+// graph: `getGCContentWeights()` -> `initScoreMatrix()` (x2) ->
+// `findMaxScoringPaths()` -> `getPaths()`.
+//
+// The weights, the DP tables and the paths are allocated from a monotonic
+// arena owned by the engine instead of millions of small heap allocations.
+// Every run starts by releasing the arena. If the previous run did not fit into
+// the arena's buffer, the buffer is first grown to the peak usage, so repeated
+// runs on the same graph (or graphs of similar size) do almost no malloc/free
+// and work on warm pages.
+
+// Memory resource forwarding to the heap and tracking the peak of the bytes
+// allocated through it. Used as the upstream of the arena to detect runs that
+// overflowed the arena's buffer.
+class PeakCountingResource : public pmr::memory_resource {
+   public:
+    size_t peak() const { return peak_; }
+    void resetPeak() { peak_ = allocated_; }
+
+   private:
+    void *do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const pmr::memory_resource &other) const noexcept override;
+
+    size_t allocated_ = 0;
+    size_t peak_ = 0;
+};
+
+// The DP tables for scores of type `score_t`.
+template <typename score_t>
+struct DPTables {
+    basic_score_matrix<score_t> scores;
+    basic_score_matrix<score_t> choices;
+};
+
+// Layout of the DP tables:
+// - FULL: a cell of scores and one of choices per vertex;
+// - RUN_LENGTH: one cell per run of equal weights, see `RunLengthTables`;
+// - PACKED: 4 bits of choices per vertex and no scores, see `PackedTables`;
+// - CHECKPOINTED: full tables of one block of the graph at a time, the DP runs
+//   twice, see `findMaxScoringPathsCheckpointed()`;
+// - SCORE_ONLY: no tables, only the score is computed, see `findMaxScore()`.
+enum class TableLayout { FULL, RUN_LENGTH, PACKED, CHECKPOINTED, SCORE_ONLY };
+
+// The engine is parameterized by the vertex coordinate type, see
+// `selectIndexWidth()`. The score type is selected for every run with
+// `selectScoreWidth()`.
+template <typename index_t = int>
+class BasicMaxScorePathsEngine {
+   public:
+    // The arena starts with a buffer of `initial_arena_size` bytes and grows on
+    // demand.
+    explicit BasicMaxScorePathsEngine(size_t initial_arena_size = 0);
+    BasicMaxScorePathsEngine(const BasicMaxScorePathsEngine &) = delete;
+    BasicMaxScorePathsEngine &operator=(const BasicMaxScorePathsEngine &) =
+        delete;
+
+    // Replaces the graph with the given EDS text, see `EDSToMatrix()`.
+    void loadGraph(const string &EDS);
+    // Replaces the graph.
+    void setGraph(eds_matrix eds_segments);
+    // Replaces the graph with a graph shared with other engines, e.g. between
+    // the worker threads of `QueryServer`. The graph is only read.
+    void setGraph(shared_ptr<const eds_matrix> eds_segments);
+
+    // Sets the scoring of `getGCContentWeights()` used by the next runs.
+    void setGCContentScoring(int match, int non_match);
+
+    // Sets the layout of the DP tables used by the next runs, run-length
+    // tables by default. Runs with a negative penalty use full tables instead
+    // of run-length tables.
+    void setTableLayout(TableLayout layout) { layout_ = layout; }
+    TableLayout tableLayout() const { return layout_; }
+
+    // Sets the number of threads of the traceback of the next runs, 1 by
+    // default, see `getPathsInParallel()`. The checkpointed tables are traced
+    // back block by block in one thread.
+    void setTracebackThreads(int threads) { traceback_threads_ = threads; }
+
+    // Runs the DP and the traceback with penalty `penalty` on the current
+    // graph, returns the maximal score. The weights, tables and paths of the
+    // run stay valid until the next `run()` or `reset()`.
+    int64_t run(int penalty);
+
+    const eds_matrix &graph() const { return *eds_segments_; }
+    // Returns the paths found by the last `run()`, empty with
+    // `TableLayout::SCORE_ONLY`.
+    const pmr_paths<index_t> &paths() const { return *paths_; }
+    // Returns the weights used by the last `run()`.
+    const weight_matrix &weights() const { return *weights_; }
+    // Returns the score type selected by the last `run()`.
+    ScoreWidth scoreWidth() const { return score_width_; }
+
+    // Frees the weights, tables and paths of the last run. The memory stays in
+    // the arena for the next run.
+    void reset();
+
+    // Returns the size of the arena's buffer in bytes.
+    size_t arenaSize() const { return buffer_.size(); }
+
+   private:
+    void createArena();
+
+    template <typename score_t>
+    int64_t runWithScoreType(int penalty);
+
+    shared_ptr<const eds_matrix> eds_segments_;
+    int match_ = 1;
+    int non_match_ = -1;
+    TableLayout layout_ = TableLayout::RUN_LENGTH;
+    int traceback_threads_ = 1;
+
+    vector<byte> buffer_;
+    PeakCountingResource upstream_;
+    optional<pmr::monotonic_buffer_resource> arena_;
+
+    // Allocated from `arena_`, have to be destroyed before it is released.
+    // Declared after `arena_` so that they are also destroyed before it.
+    optional<weight_matrix> weights_;
+    variant<monostate, DPTables<int16_t>, DPTables<int32_t>, DPTables<int64_t>,
+            RunLengthTables<int16_t>, RunLengthTables<int32_t>,
+            RunLengthTables<int64_t>, PackedTables<int16_t>,
+            PackedTables<int32_t>, PackedTables<int64_t>>
+        tables_;
+    optional<pmr_paths<index_t>> paths_;
+    ScoreWidth score_width_ = ScoreWidth::INT32;
+};
+typedef BasicMaxScorePathsEngine<int> MaxScorePathsEngine;
+
+#endif
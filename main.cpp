@@ -1,35 +1,585 @@
 // cd build
 // make
-// ./main
+// ./main [--cache <dir>] [--cache-size <bytes>] [--memory-budget <bytes>]
+//        [--paths <file>] [--paths-format bed|tsv|binary]
+//        [<file> | --reference <fasta> --vcf <vcf>]
+// ./main --weights <track> [--paths <file>] [--paths-format bed|tsv|binary]
+//        [<file> | --reference <fasta> --vcf <vcf>]
+// ./main --pipeline [--paths <file>] [--paths-format bed|tsv|binary] <file>
+// ./main series <file>...
+// ./main split <file> <shards> <directory>
+// ./main split --shard <k> <directory>
+// ./main merge <directory>
+// ./main merge --shard <k> <directory>
+// ./main merge --stitch [--paths <file>] [--paths-format bed|tsv|binary]
+//              <directory>
+// ./main marginals <file> <table>
+// ./main marginals --vertex <segment> <layer> <index> <file> <table>
+// ./main serve [--threads <n>] [--socket <path>] [--cache <dir>]
+//              [--cache-size <bytes>] [<graph>=<file>...]
 
+#include <fcntl.h>
+#include <cctype>
+#include <climits>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <iomanip>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
 
+#include "compressed_input.hpp"
+#include "engine.hpp"
+#include "marginal_table.hpp"
+#include "memory_plan.hpp"
+#include "path_writer.hpp"
+#include "pipeline.hpp"
+#include "result_cache.hpp"
+#include "server.hpp"
+#include "shards.hpp"
+#include "vcf_loader.hpp"
 #include "utility_func.hpp"
+#include "weight_track.hpp"
 
 using namespace std;
 
-int main(int argc, char* argv[]) {
-    string EDS = readEDSFile(argc > 1 ? argv[1] : "../unit_tests/test_inputs/input_01.txt");
+// Options shared by the normal and the server mode.
+struct Options {
+    string cache_directory;
+    uint64_t cache_size = ResultCache::DEFAULT_MAX_SIZE;
+};
 
-    eds_matrix eds_segments = EDSToMatrix(EDS);
-    //cout << "Loaded the graph" << endl;
-    weight_matrix weights = getGCContentWeights(eds_segments, 1, -2);
-    //cout << "Assigned weights" << endl;
+// Parses a size in bytes with an optional suffix K, M or G. Throws
+// `invalid_argument` if `arg` is not a non-negative size that fits into 64
+// bits.
+int64_t parseBytes(const string &arg) {
+    size_t parsed = 0;
+    int64_t bytes = -1;
+    if (!arg.empty() && isdigit((unsigned char)arg[0])) {
+        try {
+            bytes = stoll(arg, &parsed);
+        } catch (const out_of_range &) {
+            bytes = -1;
+        }
+    }
+    string suffix = arg.substr(parsed);
+    int shift = 0;
+    if (suffix == "K" || suffix == "k") {
+        shift = 10;
+    } else if (suffix == "M" || suffix == "m") {
+        shift = 20;
+    } else if (suffix == "G" || suffix == "g") {
+        shift = 30;
+    } else if (!suffix.empty()) {
+        bytes = -1;
+    }
+    if (bytes < 0 || bytes > (INT64_MAX >> shift)) {
+        throw invalid_argument("invalid size '" + arg + "'");
+    }
+    return bytes << shift;
+}
+
+// Parses the option `argv[i]` if it is a shared option, returns false if it is
+// not. Throws `invalid_argument` if its value is invalid.
+bool parseSharedOption(int argc, char* argv[], int &i, Options &options) {
+    string arg = argv[i];
+    if (arg == "--cache" && i + 1 < argc) {
+        options.cache_directory = argv[++i];
+    } else if (arg == "--cache-size" && i + 1 < argc) {
+        options.cache_size = parseBytes(argv[++i]);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+shared_ptr<ResultCache> createCache(const Options &options) {
+    if (options.cache_directory.empty()) {
+        return nullptr;
+    }
+    return make_shared<ResultCache>(options.cache_directory,
+                                    options.cache_size);
+}
 
-    score_matrix scores = initScoreMatrix(weights);
-    score_matrix choices = initScoreMatrix(weights);
+double toMiB(int64_t bytes) { return bytes / (1024.0 * 1024.0); }
 
-    int result = findMaxScoringPaths(eds_segments, weights, scores, choices, 10);
+// Chooses the table layout for `memory_budget` and prints the decision. Returns
+// false if no layout fits.
+bool planLayout(const eds_matrix &eds_segments, int penalty,
+                int64_t memory_budget, TableLayout &layout) {
+    GraphStatistics statistics = computeGraphStatistics(eds_segments, 1, -2);
+    ExecutionPlan plan = planExecution(statistics, penalty, memory_budget);
+    cout << setprecision(1) << fixed;
+    cout << "Estimated peak memory:";
+    for (TableLayout candidate :
+         {TableLayout::RUN_LENGTH, TableLayout::FULL, TableLayout::PACKED,
+          TableLayout::CHECKPOINTED, TableLayout::SCORE_ONLY}) {
+        cout << " " << tableLayoutName(candidate) << " "
+             << toMiB(estimateMemory(statistics, candidate, plan.score_width)
+                          .total())
+             << " MiB" << (candidate == TableLayout::SCORE_ONLY ? "\n" : ",");
+    }
+    if (!plan.fits) {
+        cout << "No strategy fits into the memory budget of "
+             << toMiB(memory_budget) << " MiB, " << tableLayoutName(plan.layout)
+             << " needs " << toMiB(plan.estimate.total()) << " MiB" << endl;
+        return false;
+    }
+    cout << "Using " << tableLayoutName(plan.layout) << ": "
+         << toMiB(plan.estimate.total()) << " MiB of the "
+         << toMiB(memory_budget) << " MiB budget" << endl;
+    layout = plan.layout;
+    return true;
+}
+
+// Where `--paths` writes the paths.
+struct PathsOutput {
+    string file_path;
+    PathFormat format = PathFormat::BED;
+    // The first column of BED.
+    string graph_name;
+};
+
+void writePaths(const eds_matrix &eds_segments, const compact_paths &paths,
+                const PathsOutput &output) {
+    int fd = open(output.file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw runtime_error("cannot open '" + output.file_path + "'");
+    }
+    try {
+        PathWriter writer(fd, output.format, eds_segments, output.graph_name);
+        writer.write(paths);
+        writer.flush();
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+    close(fd);
+}
+
+// Prints the statistics of the paths and writes them if `--paths` is given.
+void reportPaths(const eds_matrix &eds_segments, const PathsResult &result,
+                 const PathsOutput &output) {
+    cout << "Number of found paths: " << result.paths.size() << endl;
+    cout << setprecision(2) << fixed;
+    cout << "Paths cover the " << result.cover_percentage << "\% of the graph\n" ;
+    cout << "Average length of paths is: " << result.average_length << endl;
+    cout << result.score << "\t\t" << result.paths.size() << "\t\t" << result.cover_percentage << "%\t\t" << result.average_length << endl;
+    //printPaths(expandPaths(result.paths));
+    if (!output.file_path.empty()) {
+        writePaths(eds_segments, result.paths, output);
+    }
+}
+
+template <typename index_t>
+void findAndReportPaths(eds_matrix eds_segments, int penalty,
+                        ResultCache *cache, TableLayout layout,
+                        const PathsOutput &output) {
+    BasicMaxScorePathsEngine<index_t> engine;
+    uint64_t fingerprint = cache ? graphFingerprint(eds_segments) : 0;
+    engine.setGraph(move(eds_segments));
+    engine.setTableLayout(layout);
+    engine.setTracebackThreads(thread::hardware_concurrency());
+    //cout << "Loaded the graph" << endl;
+
+    PathsResult result = runCached(engine, cache, fingerprint, 1, -2, penalty);
     //cout << "Found paths and calculated max score" << endl;
-    cout << "Score: " << result << endl;
-    auto paths = getPaths(eds_segments, scores, choices);
+    cout << "Score: " << result.score << endl;
+    if (layout == TableLayout::SCORE_ONLY) {
+        return;
+    }
     //cout << "Finished getting the paths" << endl;
-    cout << "Number of found paths: " << paths.size() << endl;
-    cout << setprecision(2) << fixed;
-    cout << "Paths cover the " << pathCoverPercentage(eds_segments, paths) << "\% of the graph\n" ;
-    cout << "Average length of paths is: " << pathsAverageLength(paths) << endl;
-    cout << result << "\t\t" << paths.size() << "\t\t" << pathCoverPercentage(eds_segments, paths) << "%\t\t" << pathsAverageLength(paths) << endl;
-    //printPaths(paths);
+    reportPaths(engine.graph(), result, output);
+}
+
+// Reads, weights and fills the tables of the file in overlapping stages, see
+// `runPipeline()`.
+template <typename index_t>
+void findAndReportPathsPipelined(const string &file_path, int penalty,
+                                 const PathsOutput &output,
+                                 const PipelineOptions &options) {
+    unique_ptr<istream> input = openDecompressed(file_path);
+    if (!*input) {
+        throw runtime_error("cannot read file '" + file_path + "'");
+    }
+    // Every character is at most one vertex, plus the two `EMPTY_STR`.
+    int64_t max_vertices = decompressedSizeBound(file_path) + 2;
+    PipelineResult<index_t> pipeline =
+        runPipeline<index_t>(*input, max_vertices, 1, -2, penalty, options);
+    cout << "Score: " << pipeline.score << endl;
+    PathsResult result;
+    result.score = pipeline.score;
+    result.paths = compressPaths(pipeline.paths);
+    result.cover_percentage =
+        pathCoverPercentage(pipeline.eds_segments, pipeline.paths);
+    result.average_length = pathsAverageLength(pipeline.paths);
+    reportPaths(pipeline.eds_segments, result, output);
+}
+
+template <typename score_t, typename index_t>
+void findAndReportPathsWithTrack(const eds_matrix &eds_segments,
+                                 const WeightTrack &track, int penalty,
+                                 const PathsOutput &output) {
+    auto scores = initScoreMatrix<score_t>(track);
+    auto choices = initScoreMatrix<score_t>(track);
+    PathsResult result;
+    result.score = findMaxScoringPaths<score_t, index_t>(
+        eds_segments, track, scores, choices, penalty);
+    cout << "Score: " << result.score << endl;
+    auto paths = getPaths<score_t, index_t>(eds_segments, scores, choices);
+    result.paths = compressPaths(paths);
+    result.cover_percentage = pathCoverPercentage(eds_segments, paths);
+    result.average_length = pathsAverageLength(paths);
+    reportPaths(eds_segments, result, output);
+}
+
+// Runs the DP on the full tables with the weights of the track file
+// `track_path` of the graph instead of the GC content weights.
+template <typename index_t>
+void findAndReportPathsWithTrack(const eds_matrix &eds_segments,
+                                 const string &track_path, int penalty,
+                                 const PathsOutput &output) {
+    WeightTrack track(track_path, eds_segments);
+    switch (selectScoreWidth(eds_segments, track, penalty)) {
+        case ScoreWidth::INT16:
+            findAndReportPathsWithTrack<int16_t, index_t>(eds_segments, track,
+                                                          penalty, output);
+            return;
+        case ScoreWidth::INT32:
+            findAndReportPathsWithTrack<int32_t, index_t>(eds_segments, track,
+                                                          penalty, output);
+            return;
+        case ScoreWidth::INT64:
+            findAndReportPathsWithTrack<int64_t, index_t>(eds_segments, track,
+                                                          penalty, output);
+            return;
+    }
+}
+
+// Parses a positive count of `what`, e.g. of threads. Throws
+// `invalid_argument` if `arg` is not one.
+int parseCount(const string &arg, const string &what) {
+    size_t parsed = 0;
+    int count = 0;
+    try {
+        count = stoi(arg, &parsed);
+    } catch (const logic_error &) {
+        parsed = 0;
+    }
+    if (parsed == 0 || parsed != arg.size() || count <= 0) {
+        throw invalid_argument("invalid " + what + " '" + arg + "'");
+    }
+    return count;
+}
+
+// Runs the query server, see `QueryServer` for the protocol. Without
+// `--socket`, the requests are read from stdin.
+int serve(int argc, char* argv[]) {
+    int threads = thread::hardware_concurrency();
+    string socket_path;
+    Options options;
+    vector<pair<string, string>> graphs;
+    try {
+        for (int i = 2; i < argc; i++) {
+            string arg = argv[i];
+            size_t equals = arg.find('=');
+            if (parseSharedOption(argc, argv, i, options)) {
+                continue;
+            } else if (arg == "--threads" && i + 1 < argc) {
+                threads = parseCount(argv[++i], "thread count");
+            } else if (arg == "--socket" && i + 1 < argc) {
+                socket_path = argv[++i];
+            } else if (equals != string::npos && equals > 0) {
+                graphs.emplace_back(arg.substr(0, equals),
+                                    arg.substr(equals + 1));
+            } else {
+                cerr << "Unknown argument: " << arg << endl;
+                return 1;
+            }
+        }
+
+        QueryServer server(threads);
+        server.setResultCache(createCache(options));
+        for (const auto &graph : graphs) {
+            server.loadGraph(graph.first, graph.second);
+        }
+        if (socket_path.empty()) {
+            server.serveStream(STDIN_FILENO, STDOUT_FILENO);
+        } else {
+            server.serveUnixSocket(socket_path);
+        }
+    } catch (const exception &e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Prints the max scores of a series of related graphs, e.g. of nested sample
+// sets, reusing the units they share, see `ComparativeMaxScores`.
+int scoreSeries(int argc, char* argv[]) {
+    int penalty = 10;
+    ComparativeMaxScores comparative(1, -2, penalty);
+    try {
+        for (int i = 2; i < argc; i++) {
+            eds_matrix eds_segments = EDSToMatrix(
+                readEDSFile(argv[i]), thread::hardware_concurrency());
+            cout << argv[i] << " " << comparative.score(eds_segments) << endl;
+        }
+    } catch (const exception &e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+    cout << "Computed " << comparative.computedUnits() << " units, reused "
+         << comparative.reusedUnits() << endl;
+    return 0;
+}
+
+// Cuts a graph into shards, or computes the transfer of one shard, see
+// `cutShards()`.
+int split(int argc, char* argv[]) {
+    try {
+        if (argc == 5 && string(argv[2]) == "--shard") {
+            writeShardTransfer(argv[4], stoi(argv[3]));
+        } else if (argc == 5) {
+            eds_matrix eds_segments = EDSToMatrix(
+                readEDSFile(argv[2]), thread::hardware_concurrency());
+            ShardManifest manifest =
+                cutShards(eds_segments, stoi(argv[3]), 1, -2, 10, argv[4]);
+            cout << "Cut into " << manifest.first_segments.size()
+                 << " shards" << endl;
+        } else {
+            cerr << "Usage: ./main split <file> <shards> <directory> or "
+                    "./main split --shard <k> <directory>"
+                 << endl;
+            return 1;
+        }
+    } catch (const exception &e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Merges the transfers of the shards into their boundaries, traces back one
+// shard, or stitches the tracebacks into the paths of the graph.
+int merge(int argc, char* argv[]) {
+    int shard = -1;
+    bool stitch = false;
+    PathsOutput output;
+    string directory;
+    try {
+        for (int i = 2; i < argc; i++) {
+            string arg = argv[i];
+            if (arg == "--shard" && i + 1 < argc) {
+                shard = stoi(argv[++i]);
+            } else if (arg == "--stitch") {
+                stitch = true;
+            } else if (arg == "--paths" && i + 1 < argc) {
+                output.file_path = argv[++i];
+            } else if (arg == "--paths-format" && i + 1 < argc) {
+                output.format = parsePathFormat(argv[++i]);
+            } else {
+                directory = arg;
+            }
+        }
+        if (directory.empty()) {
+            cerr << "Missing the directory of the shards" << endl;
+            return 1;
+        }
+
+        if (shard >= 0) {
+            writeShardTraceback(directory, shard);
+        } else if (stitch) {
+            eds_matrix eds_segments = readShardedGraph(directory);
+            PathsResult result;
+            result.score = readShardedScore(directory);
+            result.paths = stitchShardPaths(directory);
+            auto paths = expandPaths<int64_t>(result.paths);
+            result.cover_percentage = pathCoverPercentage(eds_segments, paths);
+            result.average_length = pathsAverageLength(paths);
+            cout << "Score: " << result.score << endl;
+            output.graph_name = filesystem::path(directory).filename().string();
+            reportPaths(eds_segments, result, output);
+        } else {
+            cout << "Score: " << mergeShardTransfers(directory) << endl;
+        }
+    } catch (const exception &e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Writes the marginal table of a graph, or prints the forced scores of one
+// vertex from it, see `MarginalTable`.
+int marginals(int argc, char* argv[]) {
+    try {
+        if (argc == 8 && string(argv[2]) == "--vertex") {
+            eds_matrix eds_segments = EDSToMatrix(
+                readEDSFile(argv[6]), thread::hardware_concurrency());
+            MarginalTable table(argv[7], eds_segments);
+            forced_scores forced = table.forcedScores(
+                {stoll(argv[3]), stoll(argv[4]), stoll(argv[5])});
+            cout << "Score: " << table.score() << endl;
+            cout << "Selected: " << forced[SURELY_SELECTED] << endl;
+            cout << "Not selected: " << forced[!SURELY_SELECTED] << endl;
+        } else if (argc == 4) {
+            eds_matrix eds_segments = EDSToMatrix(
+                readEDSFile(argv[2]), thread::hardware_concurrency());
+            weight_matrix weights = getGCContentWeights(eds_segments, 1, -2);
+            cout << "Score: "
+                 << writeMarginalTable(argv[3], eds_segments, weights, 10)
+                 << endl;
+        } else {
+            cerr << "Usage: ./main marginals <file> <table> or ./main "
+                    "marginals --vertex <segment> <layer> <index> <file> "
+                    "<table>"
+                 << endl;
+            return 1;
+        }
+    } catch (const exception &e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "serve") {
+        return serve(argc, argv);
+    }
+    if (argc > 1 && string(argv[1]) == "series") {
+        return scoreSeries(argc, argv);
+    }
+    if (argc > 1 && string(argv[1]) == "split") {
+        return split(argc, argv);
+    }
+    if (argc > 1 && string(argv[1]) == "merge") {
+        return merge(argc, argv);
+    }
+    if (argc > 1 && string(argv[1]) == "marginals") {
+        return marginals(argc, argv);
+    }
+    Options options;
+    string file_path = "../unit_tests/test_inputs/input_01.txt";
+    int64_t memory_budget = -1;
+    PathsOutput output;
+    string reference_path;
+    string vcf_path;
+    string track_path;
+    bool pipelined = false;
+    PipelineOptions pipeline_options;
+    try {
+        for (int i = 1; i < argc; i++) {
+            string arg = argv[i];
+            if (parseSharedOption(argc, argv, i, options)) {
+                continue;
+            } else if (arg == "--memory-budget" && i + 1 < argc) {
+                memory_budget = parseBytes(argv[++i]);
+            } else if (arg == "--paths" && i + 1 < argc) {
+                output.file_path = argv[++i];
+            } else if (arg == "--paths-format" && i + 1 < argc) {
+                output.format = parsePathFormat(argv[++i]);
+            } else if (arg == "--reference" && i + 1 < argc) {
+                reference_path = argv[++i];
+            } else if (arg == "--vcf" && i + 1 < argc) {
+                vcf_path = argv[++i];
+            } else if (arg == "--weights" && i + 1 < argc) {
+                track_path = argv[++i];
+            } else if (arg == "--pipeline") {
+                pipelined = true;
+            } else if (arg == "--online-traceback") {
+                pipeline_options.online_traceback = true;
+            } else {
+                file_path = arg;
+            }
+        }
+    } catch (const exception &e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+    int penalty = 10;
+    if (pipelined) {
+        output.graph_name = filesystem::path(file_path).stem().string();
+        try {
+            if (decompressedSizeBound(file_path) + 2 <= INT32_MAX) {
+                findAndReportPathsPipelined<int32_t>(file_path, penalty,
+                                                     output, pipeline_options);
+            } else {
+                findAndReportPathsPipelined<int64_t>(file_path, penalty,
+                                                     output, pipeline_options);
+            }
+        } catch (const exception &e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    eds_matrix eds_segments;
+    if (!vcf_path.empty()) {
+        VCFLoadStatistics statistics;
+        try {
+            eds_segments =
+                readVCFFiles(reference_path, vcf_path, &statistics);
+        } catch (const exception &e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+        cout << "Loaded " << statistics.variants << " variants of "
+             << statistics.records << " VCF records, skipped "
+             << statistics.skipped_overlapping << " overlapping records"
+             << endl;
+        file_path = vcf_path;
+    } else {
+        try {
+            eds_segments = EDSToMatrix(readEDSFile(file_path),
+                                       thread::hardware_concurrency());
+        } catch (const exception &e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+    }
+    output.graph_name = filesystem::path(file_path).stem().string();
+
+    if (!track_path.empty()) {
+        try {
+            if (selectIndexWidth(eds_segments) == IndexWidth::INT32) {
+                findAndReportPathsWithTrack<int32_t>(eds_segments, track_path,
+                                                     penalty, output);
+            } else {
+                findAndReportPathsWithTrack<int64_t>(eds_segments, track_path,
+                                                     penalty, output);
+            }
+        } catch (const exception &e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    TableLayout layout = TableLayout::RUN_LENGTH;
+    if (memory_budget >= 0 &&
+        !planLayout(eds_segments, penalty, memory_budget, layout)) {
+        return 1;
+    }
+    shared_ptr<ResultCache> cache = createCache(options);
+    try {
+        if (selectIndexWidth(eds_segments) == IndexWidth::INT32) {
+            findAndReportPaths<int32_t>(move(eds_segments), penalty,
+                                        cache.get(), layout, output);
+        } else {
+            findAndReportPaths<int64_t>(move(eds_segments), penalty,
+                                        cache.get(), layout, output);
+        }
+    } catch (const exception &e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
     return 0;
 }
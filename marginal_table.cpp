@@ -0,0 +1,64 @@
+#include "marginal_table.hpp"
+
+#include <sys/mman.h>
+
+#include <fstream>
+#include <stdexcept>
+
+#include "result_cache.hpp"
+
+using namespace std;
+
+int64_t writeMarginalTable(const string &file_path,
+                           const eds_matrix &eds_segments,
+                           const weight_matrix &weights, int penalty) {
+    basic_score_matrix<int64_t> scores = initScoreMatrix<int64_t>(weights);
+    int64_t score;
+    {
+        // The choices are not needed by the backward DP.
+        basic_score_matrix<int64_t> choices =
+            initScoreMatrix<int64_t>(weights);
+        score = findMaxScoringPaths<int64_t, int64_t>(eds_segments, weights,
+                                                      scores, choices, penalty);
+    }
+    vector<forced_scores> forced;
+    {
+        basic_score_matrix<int64_t> backward =
+            findBackwardScores(eds_segments, weights, scores, penalty);
+        forced = getForcedScores(eds_segments, scores, backward);
+    }
+
+    ofstream output(file_path, ios::binary | ios::trunc);
+    if (!output) {
+        throw runtime_error("cannot write file '" + file_path + "'");
+    }
+    writeValue(output, MARGINAL_TABLE_MAGIC);
+    writeValue(output, MARGINAL_TABLE_VERSION);
+    writeValue(output, graphFingerprint(eds_segments));
+    writeValue(output, uint64_t(forced.size()));
+    writeValue(output, score);
+    output.write(reinterpret_cast<const char *>(forced.data()),
+                 forced.size() * sizeof(forced_scores));
+    if (!output.flush()) {
+        throw runtime_error("cannot write file '" + file_path + "'");
+    }
+    return score;
+}
+
+MarginalTable::MarginalTable(const string &file_path,
+                             const eds_matrix &eds_segments)
+    : order_(eds_segments),
+      file_(file_path, "marginal table", MARGINAL_TABLE_MAGIC,
+            MARGINAL_TABLE_VERSION, MARGINAL_TABLE_HEADER_BYTES,
+            sizeof(forced_scores), eds_segments, order_.numVertices()),
+      scores_(reinterpret_cast<const int64_t *>(file_.values())),
+      score_(readValue<int64_t>(file_.data(), GRAPH_FILE_HEADER_BYTES)) {
+    // Queries read single vertices.
+    file_.advise(MADV_RANDOM);
+}
+
+forced_scores MarginalTable::forcedScores(Vertex64 v) const {
+    const int64_t *scores =
+        scores_ + 2 * order_.position(v.segment, v.layer, v.index);
+    return {scores[!SURELY_SELECTED], scores[SURELY_SELECTED]};
+}
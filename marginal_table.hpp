@@ -0,0 +1,64 @@
+#ifndef MAXSCOREPATH_MARGINAL_TABLE_HEADER
+#define MAXSCOREPATH_MARGINAL_TABLE_HEADER
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "binary_file.hpp"
+#include "utility_func.hpp"
+#include "weight_track.hpp"
+
+using namespace std;
+
+// This file contains marginal tables: the forced scores of every vertex of a
+// graph, see `getForcedScores()`, in a binary file that is queried through a
+// memory mapping. A query answers whether a vertex, e.g. of a variant, can be
+// part of a path and what the score of the graph is with the vertex selected
+// or not selected, without running the DP again.
+//
+// A table file is a header followed by the forced scores as two 64-bit integers
+// per vertex, first the score with the vertex not selected, then selected, in
+// the vertex order of a weight track, see weight_track.hpp. The header is the
+// one of `MappedGraphFile`, with the magic number `MARGINAL_TABLE_MAGIC` and
+// the version `MARGINAL_TABLE_VERSION`, followed by the score of the graph, 64
+// bits. All values are in the byte order of the machine, the forced scores
+// start at byte `MARGINAL_TABLE_HEADER_BYTES`.
+
+const uint32_t MARGINAL_TABLE_MAGIC = 0x4d54534d;  // "MSTM"
+const uint32_t MARGINAL_TABLE_VERSION = 1;
+const size_t MARGINAL_TABLE_HEADER_BYTES = GRAPH_FILE_HEADER_BYTES + 8;
+
+// Computes the forced scores of `eds_segments` with `weights` and `penalty`
+// and writes them as a table to `file_path`. Returns the score of the graph.
+// Throws `overflow_error` if the scores do not fit into 64 bits, and
+// `runtime_error` if the file cannot be written.
+int64_t writeMarginalTable(const string &file_path,
+                           const eds_matrix &eds_segments,
+                           const weight_matrix &weights, int penalty);
+
+// A table file mapped into memory for one graph.
+class MarginalTable {
+   public:
+    // Maps the table of `eds_segments` from `file_path`. Throws
+    // `runtime_error` if the file cannot be mapped, and `invalid_argument` if
+    // it is not a table of this graph: a different header, fingerprint or
+    // length.
+    MarginalTable(const string &file_path, const eds_matrix &eds_segments);
+
+    // The score of the graph.
+    int64_t score() const { return score_; }
+    int64_t numVertices() const { return order_.numVertices(); }
+
+    // Returns the forced scores of `v`. Throws `out_of_range` if `v` is not a
+    // vertex of the graph.
+    forced_scores forcedScores(Vertex64 v) const;
+
+   private:
+    VertexOrder order_;
+    MappedGraphFile file_;
+    const int64_t *scores_;
+    int64_t score_;
+};
+
+#endif
@@ -0,0 +1,309 @@
+#include "maxscorepaths.h"
+
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "utility_func.hpp"
+
+using namespace std;
+
+struct msp_graph {
+    // The segments as added.
+    vector<vector<string>> segments;
+    // The weights of the segments added with weights, empty for the others.
+    vector<vector<vector<int>>> weights;
+    int match = 1;
+    int non_match = -1;
+};
+
+struct msp_result {
+    int64_t score = 0;
+    vector<vector<msp_vertex>> paths;
+};
+
+namespace {
+
+thread_local string last_error;
+
+msp_status fail(msp_status status, const string &message) {
+    last_error = message;
+    return status;
+}
+
+// Runs `body()` and turns its exceptions into a status.
+template <typename body_t>
+msp_status guard(const body_t &body) {
+    try {
+        body();
+        return MSP_OK;
+    } catch (const invalid_argument &e) {
+        return fail(MSP_INVALID_ARGUMENT, e.what());
+    } catch (const overflow_error &e) {
+        return fail(MSP_OVERFLOW, e.what());
+    } catch (const bad_alloc &) {
+        return fail(MSP_OUT_OF_MEMORY, "out of memory");
+    } catch (const exception &e) {
+        return fail(MSP_INTERNAL_ERROR, e.what());
+    } catch (...) {
+        return fail(MSP_INTERNAL_ERROR, "unknown error");
+    }
+}
+
+// The characters of a layer of the graph that come from the layer `origin` of
+// an added segment, from the character `origin.offset` on.
+struct LayerPiece {
+    int64_t layer;
+    int64_t start;
+    int64_t end;
+    msp_vertex origin;
+};
+
+// The graph of the DP: the added segments with consecutive deterministic
+// segments joined, enclosed in `EMPTY_STR` and separated as by `EDSToMatrix()`.
+struct DPGraph {
+    eds_matrix eds_segments;
+    weight_matrix weights;
+    // The pieces of every segment, ordered by layer and start.
+    vector<vector<LayerPiece>> pieces;
+};
+
+DPGraph buildDPGraph(const msp_graph &graph) {
+    DPGraph dp_graph;
+    string current(1, EMPTY_STR);
+    pmr::vector<int> current_weights(1, 0);
+    vector<LayerPiece> current_pieces;
+    auto flush = [&] {
+        dp_graph.eds_segments.push_back({move(current)});
+        dp_graph.weights.emplace_back().push_back(move(current_weights));
+        dp_graph.pieces.push_back(move(current_pieces));
+        current.clear();
+        current_weights.clear();
+        current_pieces.clear();
+    };
+    for (size_t i = 0; i < graph.segments.size(); i++) {
+        const auto &segment = graph.segments[i];
+        const auto &weights = graph.weights[i];
+        auto layerWeight = [&](size_t layer, size_t j) {
+            return weights.empty() ? gcContentWeight(segment[layer][j],
+                                                     graph.match,
+                                                     graph.non_match)
+                                   : weights[layer][j];
+        };
+        if (segment.size() == 1) {
+            if (!segment[0].empty()) {
+                current_pieces.push_back(
+                    {0, (int64_t)current.size(),
+                     (int64_t)(current.size() + segment[0].size()),
+                     {(int64_t)i, 0, 0}});
+            }
+            current += segment[0];
+            for (size_t j = 0; j < segment[0].size(); j++) {
+                current_weights.push_back(layerWeight(0, j));
+            }
+            continue;
+        }
+        // Adjacent bubbles are separated.
+        if (current.empty()) {
+            current += EMPTY_STR;
+            current_weights.push_back(0);
+        }
+        flush();
+        auto &layers = dp_graph.eds_segments.emplace_back();
+        auto &layer_weights = dp_graph.weights.emplace_back();
+        auto &pieces = dp_graph.pieces.emplace_back();
+        for (size_t layer = 0; layer < segment.size(); layer++) {
+            auto &weights_of_layer = layer_weights.emplace_back();
+            if (segment[layer].empty()) {
+                layers.emplace_back(1, EMPTY_STR);
+                weights_of_layer.push_back(0);
+                continue;
+            }
+            layers.push_back(segment[layer]);
+            for (size_t j = 0; j < segment[layer].size(); j++) {
+                weights_of_layer.push_back(layerWeight(layer, j));
+            }
+            pieces.push_back({(int64_t)layer, 0,
+                              (int64_t)segment[layer].size(),
+                              {(int64_t)i, (int64_t)layer, 0}});
+        }
+    }
+    current += EMPTY_STR;
+    current_weights.push_back(0);
+    flush();
+    return dp_graph;
+}
+
+// Returns the added vertex of `v`, or a vertex with segment -1 for the
+// separators.
+template <typename index_t>
+msp_vertex originOf(const DPGraph &dp_graph, BasicVertex<index_t> v) {
+    const auto &pieces = dp_graph.pieces[v.segment];
+    auto piece = upper_bound(pieces.begin(), pieces.end(),
+                             make_pair((int64_t)v.layer, (int64_t)v.index),
+                             [](const pair<int64_t, int64_t> &position,
+                                const LayerPiece &p) {
+                                 return position <
+                                        make_pair(p.layer, p.start);
+                             });
+    if (piece == pieces.begin() || (--piece)->layer != v.layer ||
+        v.index >= piece->end) {
+        return {-1, -1, -1};
+    }
+    return {piece->origin.segment, piece->origin.layer,
+            piece->origin.offset + v.index - piece->start};
+}
+
+template <typename score_t, typename index_t>
+void runDP(const DPGraph &dp_graph, int penalty, msp_result &result) {
+    auto scores = initScoreMatrix<score_t>(dp_graph.weights);
+    auto choices = initScoreMatrix<score_t>(dp_graph.weights);
+    result.score = findMaxScoringPaths<score_t, index_t>(
+        dp_graph.eds_segments, dp_graph.weights, scores, choices, penalty);
+    auto paths = getPaths<score_t, index_t>(dp_graph.eds_segments, scores,
+                                            choices);
+    // `getPaths()` returns the last path first.
+    for (auto path = paths.rbegin(); path != paths.rend(); path++) {
+        auto &vertices = result.paths.emplace_back();
+        vertices.reserve(path->size());
+        for (const auto &v : *path) {
+            msp_vertex origin = originOf(dp_graph, v);
+            if (origin.segment >= 0) {
+                vertices.push_back(origin);
+            }
+        }
+    }
+}
+
+template <typename index_t>
+void runDPWithIndexType(const DPGraph &dp_graph, int penalty,
+                        msp_result &result) {
+    switch (selectScoreWidth(dp_graph.eds_segments, dp_graph.weights,
+                             penalty)) {
+        case ScoreWidth::INT16:
+            runDP<int16_t, index_t>(dp_graph, penalty, result);
+            return;
+        case ScoreWidth::INT32:
+            runDP<int32_t, index_t>(dp_graph, penalty, result);
+            return;
+        case ScoreWidth::INT64:
+            runDP<int64_t, index_t>(dp_graph, penalty, result);
+            return;
+    }
+}
+
+msp_status addSegment(msp_graph *graph, size_t num_layers,
+                      const char *const *layers, const size_t *lengths,
+                      const int32_t *const *weights) {
+    if (!graph || num_layers == 0 || !layers || !lengths) {
+        return fail(MSP_INVALID_ARGUMENT,
+                    "a segment needs a graph and at least one layer");
+    }
+    for (size_t i = 0; i < num_layers; i++) {
+        if (lengths[i] > 0 && (!layers[i] || (weights && !weights[i]))) {
+            return fail(MSP_INVALID_ARGUMENT,
+                        "layer " + to_string(i) + " of the segment is null");
+        }
+    }
+    return guard([&] {
+        vector<string> segment;
+        vector<vector<int>> segment_weights;
+        segment.reserve(num_layers);
+        for (size_t i = 0; i < num_layers; i++) {
+            segment.emplace_back(layers[i], lengths[i]);
+            if (weights) {
+                segment_weights.emplace_back(weights[i],
+                                             weights[i] + lengths[i]);
+            }
+        }
+        graph->segments.push_back(move(segment));
+        graph->weights.push_back(move(segment_weights));
+    });
+}
+
+}  // namespace
+
+int msp_api_version(void) { return MSP_API_VERSION; }
+
+const char *msp_last_error(void) { return last_error.c_str(); }
+
+msp_graph *msp_graph_create(void) { return new (nothrow) msp_graph(); }
+
+void msp_graph_destroy(msp_graph *graph) { delete graph; }
+
+msp_status msp_graph_add_segment(msp_graph *graph, size_t num_layers,
+                                 const char *const *layers,
+                                 const size_t *lengths) {
+    return addSegment(graph, num_layers, layers, lengths, nullptr);
+}
+
+msp_status msp_graph_add_weighted_segment(msp_graph *graph, size_t num_layers,
+                                          const char *const *layers,
+                                          const size_t *lengths,
+                                          const int32_t *const *weights) {
+    if (!weights) {
+        return fail(MSP_INVALID_ARGUMENT, "the weights are null");
+    }
+    return addSegment(graph, num_layers, layers, lengths, weights);
+}
+
+msp_status msp_graph_set_gc_scoring(msp_graph *graph, int32_t match,
+                                    int32_t non_match) {
+    if (!graph) {
+        return fail(MSP_INVALID_ARGUMENT, "the graph is null");
+    }
+    graph->match = match;
+    graph->non_match = non_match;
+    return MSP_OK;
+}
+
+size_t msp_graph_num_segments(const msp_graph *graph) {
+    return graph ? graph->segments.size() : 0;
+}
+
+msp_status msp_run(const msp_graph *graph, int32_t penalty,
+                   msp_result **result) {
+    if (!graph || !result) {
+        return fail(MSP_INVALID_ARGUMENT, "the graph or the result is null");
+    }
+    *result = nullptr;
+    return guard([&] {
+        DPGraph dp_graph = buildDPGraph(*graph);
+        auto run_result = make_unique<msp_result>();
+        if (selectIndexWidth(dp_graph.eds_segments) == IndexWidth::INT32) {
+            runDPWithIndexType<int32_t>(dp_graph, penalty, *run_result);
+        } else {
+            runDPWithIndexType<int64_t>(dp_graph, penalty, *run_result);
+        }
+        *result = run_result.release();
+    });
+}
+
+void msp_result_destroy(msp_result *result) { delete result; }
+
+int64_t msp_result_score(const msp_result *result) {
+    return result ? result->score : 0;
+}
+
+size_t msp_result_num_paths(const msp_result *result) {
+    return result ? result->paths.size() : 0;
+}
+
+msp_status msp_result_path(const msp_result *result, size_t path,
+                           const msp_vertex **vertices, size_t *num_vertices) {
+    if (!result || !vertices || !num_vertices) {
+        return fail(MSP_INVALID_ARGUMENT, "an argument is null");
+    }
+    if (path >= result->paths.size()) {
+        return fail(MSP_INVALID_ARGUMENT,
+                    "path " + to_string(path) + " of " +
+                        to_string(result->paths.size()) + " does not exist");
+    }
+    *vertices = result->paths[path].data();
+    *num_vertices = result->paths[path].size();
+    return MSP_OK;
+}
@@ -0,0 +1,119 @@
+#ifndef MAXSCOREPATH_C_API_HEADER
+#define MAXSCOREPATH_C_API_HEADER
+
+#include <stddef.h>
+#include <stdint.h>
+
+// This file contains the C interface of the shared library `libmaxscorepaths`,
+// for programs that embed the DP instead of running `main` on a file. A caller
+// builds a graph segment by segment from memory, chooses the weights, runs the
+// DP and reads the paths from the result:
+//
+//     msp_graph *graph = msp_graph_create();
+//     const char *layers[] = {"AC", "G"};
+//     size_t lengths[] = {2, 1};
+//     msp_graph_add_segment(graph, 1, layers, lengths);
+//     msp_graph_add_segment(graph, 2, layers, lengths);
+//     msp_result *result;
+//     if (msp_run(graph, 10, &result) == MSP_OK) {
+//         ... msp_result_score(result), msp_result_path(result, 0, ...) ...
+//         msp_result_destroy(result);
+//     }
+//     msp_graph_destroy(graph);
+//
+// The vertices are addressed by the coordinates of the segments as added, the
+// separators that the DP needs between the segments are internal. Functions
+// that can fail return an `msp_status`, `msp_last_error()` describes the last
+// failure of the calling thread. A graph or a result is used by one thread at a
+// time, different objects are independent.
+
+// The library exports only the functions of this file.
+#define MSP_API __attribute__((visibility("default")))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Incremented when the interface changes incompatibly.
+#define MSP_API_VERSION 1
+
+typedef enum {
+    MSP_OK = 0,
+    // An argument is null or inconsistent with the graph.
+    MSP_INVALID_ARGUMENT = 1,
+    // The scores or coordinates of the graph do not fit into 64 bits.
+    MSP_OVERFLOW = 2,
+    MSP_OUT_OF_MEMORY = 3,
+    MSP_INTERNAL_ERROR = 4
+} msp_status;
+
+// A vertex of the graph: the character `offset` of layer `layer` of the
+// segment `segment`, counted from 0 in the order of addition.
+typedef struct {
+    int64_t segment;
+    int64_t layer;
+    int64_t offset;
+} msp_vertex;
+
+typedef struct msp_graph msp_graph;
+typedef struct msp_result msp_result;
+
+// Returns `MSP_API_VERSION` of the library.
+MSP_API int msp_api_version(void);
+
+// Returns the message of the last failure in the calling thread. Valid until
+// the next failing call of the thread.
+MSP_API const char *msp_last_error(void);
+
+// Returns an empty graph with the GC content scoring with match 1 and
+// non-match -1, or null if out of memory.
+MSP_API msp_graph *msp_graph_create(void);
+MSP_API void msp_graph_destroy(msp_graph *graph);
+
+// Appends a segment of `num_layers` layers, layer `i` is the `lengths[i]`
+// characters at `layers[i]`. A segment of one layer is deterministic, a
+// segment of more layers is a bubble. The characters are copied.
+MSP_API msp_status msp_graph_add_segment(msp_graph *graph, size_t num_layers,
+                                         const char *const *layers,
+                                         const size_t *lengths);
+
+// Same as above, with the weight `weights[i][j]` of the character `j` of layer
+// `i` instead of the scoring of the graph.
+MSP_API msp_status msp_graph_add_weighted_segment(
+    msp_graph *graph, size_t num_layers, const char *const *layers,
+    const size_t *lengths, const int32_t *const *weights);
+
+// Sets the GC content scoring of the segments added without weights: bases G
+// and C weigh `match`, the other characters `non_match`.
+MSP_API msp_status msp_graph_set_gc_scoring(msp_graph *graph, int32_t match,
+                                            int32_t non_match);
+
+// Returns the number of segments added to the graph.
+MSP_API size_t msp_graph_num_segments(const msp_graph *graph);
+
+// Runs the DP with the penalty `penalty` per path and stores the score and the
+// paths in a new `*result`, which the caller destroys. The graph stays usable.
+MSP_API msp_status msp_run(const msp_graph *graph, int32_t penalty,
+                           msp_result **result);
+
+MSP_API void msp_result_destroy(msp_result *result);
+
+// Returns the maximal score.
+MSP_API int64_t msp_result_score(const msp_result *result);
+
+// Returns the number of selected paths.
+MSP_API size_t msp_result_num_paths(const msp_result *result);
+
+// Returns the vertices of the path `path` in the order of the graph through
+// `*vertices` and their number through `*num_vertices`. The paths are in the
+// order of the graph too. A path on the internal separators only has no
+// vertices. The vertices stay valid until the result is destroyed.
+MSP_API msp_status msp_result_path(const msp_result *result, size_t path,
+                                   const msp_vertex **vertices,
+                                   size_t *num_vertices);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,218 @@
+#include "memory_plan.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// Bookkeeping bytes of `malloc()` per allocation of the graph. The weights
+// and the tables are allocated from the engine's arena without it.
+const int64_t MALLOC_OVERHEAD = 16;
+
+// Returns the heap bytes of `str`, 0 if it is stored inline.
+int64_t stringHeapBytes(const string &str) {
+    const char *data = str.data();
+    const char *object = reinterpret_cast<const char *>(&str);
+    if (data >= object && data < object + sizeof(string)) {
+        return 0;
+    }
+    return str.capacity() + 1 + MALLOC_OVERHEAD;
+}
+
+// The GC content weights of a layer for `countRunColumns()`.
+class LayerWeights {
+   public:
+    LayerWeights(const string &layer, int match, int non_match)
+        : layer_(layer), match_(match), non_match_(non_match) {}
+
+    size_t size() const { return layer_.size(); }
+    int operator[](size_t index) const {
+        return gcContentWeight(layer_[index], match_, non_match_);
+    }
+
+   private:
+    const string &layer_;
+    int match_;
+    int non_match_;
+};
+
+int64_t scoreBytes(ScoreWidth score_width) {
+    switch (score_width) {
+        case ScoreWidth::INT16:
+            return sizeof(int16_t);
+        case ScoreWidth::INT32:
+            return sizeof(int32_t);
+        case ScoreWidth::INT64:
+            break;
+    }
+    return sizeof(int64_t);
+}
+
+// The inner vectors of a `pmr::vector` per segment and per layer.
+int64_t nestedVectorBytes(const GraphStatistics &statistics) {
+    return sizeof(pmr::vector<int>) * (statistics.segments + statistics.layers);
+}
+
+}  // namespace
+
+GraphStatistics computeGraphStatistics(const eds_matrix &eds_segments,
+                                       int match, int non_match) {
+    GraphStatistics statistics;
+    statistics.segments = eds_segments.size();
+    statistics.graph_bytes =
+        sizeof(eds_matrix) + eds_segments.capacity() * sizeof(vector<string>);
+    bool has_gc = false;
+    bool has_other = false;
+    for (const auto &segment : eds_segments) {
+        statistics.layers += segment.size();
+        statistics.max_bubble_width =
+            max(statistics.max_bubble_width, (int64_t)segment.size());
+        statistics.graph_bytes +=
+            segment.capacity() * sizeof(string) + MALLOC_OVERHEAD;
+        for (const auto &layer : segment) {
+            statistics.vertices += layer.size();
+            statistics.run_columns +=
+                countRunColumns(LayerWeights(layer, match, non_match));
+            statistics.graph_bytes += stringHeapBytes(layer);
+            for (char c : layer) {
+                bool is_gc = c == 'G' || c == 'C';
+                has_gc = has_gc || is_gc;
+                has_other = has_other || (!is_gc && c != EMPTY_STR);
+            }
+        }
+    }
+    if (has_gc) {
+        statistics.max_abs_weight = abs((int64_t)match);
+    }
+    if (has_other) {
+        statistics.max_abs_weight =
+            max(statistics.max_abs_weight, abs((int64_t)non_match));
+    }
+    statistics.index_width = selectIndexWidth(eds_segments);
+
+    vector<int64_t> first_segments =
+        checkpointBlocks(eds_segments, DEFAULT_BLOCK_VERTICES);
+    statistics.checkpoint_blocks = first_segments.size();
+    first_segments.push_back(eds_segments.size());
+    for (size_t block = 0; block + 1 < first_segments.size(); block++) {
+        int64_t layers = 0;
+        int64_t vertices = 0;
+        for (int64_t segment = first_segments[block];
+             segment < first_segments[block + 1]; segment++) {
+            layers += eds_segments[segment].size();
+            for (const auto &layer : eds_segments[segment]) {
+                vertices += layer.size();
+            }
+        }
+        statistics.max_block_segments =
+            max(statistics.max_block_segments,
+                first_segments[block + 1] - first_segments[block]);
+        statistics.max_block_layers = max(statistics.max_block_layers, layers);
+        statistics.max_block_vertices =
+            max(statistics.max_block_vertices, vertices);
+    }
+    return statistics;
+}
+
+MemoryEstimate estimateMemory(const GraphStatistics &statistics,
+                              TableLayout layout, ScoreWidth score_width) {
+    const int64_t cell = 4 * scoreBytes(score_width);
+    const int64_t vertex =
+        3 * (statistics.index_width == IndexWidth::INT32 ? sizeof(int32_t)
+                                                         : sizeof(int64_t));
+    // The cells of the last vertices of two segments and the differences of
+    // the J vertex kernel, see `findMaxScore()`.
+    const int64_t window = statistics.max_bubble_width *
+                           (2 * cell + 3 * scoreBytes(score_width));
+
+    MemoryEstimate estimate;
+    estimate.graph = statistics.graph_bytes;
+    estimate.weights =
+        nestedVectorBytes(statistics) + statistics.vertices * sizeof(int);
+    if (layout != TableLayout::SCORE_ONLY) {
+        estimate.paths = statistics.vertices * vertex;
+    }
+    switch (layout) {
+        case TableLayout::FULL:
+            // Scores and choices.
+            estimate.tables = 2 * (nestedVectorBytes(statistics) +
+                                   statistics.vertices * cell);
+            break;
+        case TableLayout::RUN_LENGTH:
+            // Run ends, scores, first choices and bubble classes.
+            estimate.tables =
+                nestedVectorBytes(statistics) +
+                statistics.run_columns * sizeof(int64_t) +
+                nestedVectorBytes(statistics) + statistics.run_columns * cell +
+                sizeof(pmr::vector<int>) * statistics.segments +
+                statistics.layers * cell +
+                statistics.segments * sizeof(int32_t);
+            break;
+        case TableLayout::PACKED:
+            // Choice bits, layer starts and J vertex choices.
+            estimate.tables = window + (statistics.vertices + 1) / 2 +
+                              (statistics.layers + statistics.segments + 2) *
+                                  sizeof(int64_t) +
+                              statistics.segments * cell;
+            break;
+        case TableLayout::CHECKPOINTED:
+            // Checkpoints and the tables of the largest block.
+            estimate.tables =
+                window + statistics.checkpoint_blocks * (cell + 8) +
+                2 * statistics.max_block_vertices * cell +
+                (statistics.max_block_layers + statistics.max_block_segments) *
+                    sizeof(int64_t);
+            break;
+        case TableLayout::SCORE_ONLY:
+            estimate.tables = window;
+            break;
+    }
+    return estimate;
+}
+
+ExecutionPlan planExecution(const GraphStatistics &statistics, int penalty,
+                            int64_t memory_budget) {
+    ScoreWidth score_width = selectScoreWidth(
+        scoreBound(statistics.vertices, statistics.max_abs_weight, penalty),
+        statistics.max_bubble_width);
+    vector<TableLayout> layouts = {TableLayout::FULL, TableLayout::PACKED,
+                                   TableLayout::CHECKPOINTED,
+                                   TableLayout::SCORE_ONLY};
+    if (penalty >= 0) {
+        layouts.insert(layouts.begin(), TableLayout::RUN_LENGTH);
+    }
+    ExecutionPlan smallest = {layouts[0], score_width,
+                              estimateMemory(statistics, layouts[0],
+                                             score_width),
+                              false};
+    for (TableLayout layout : layouts) {
+        MemoryEstimate estimate =
+            estimateMemory(statistics, layout, score_width);
+        if (estimate.total() <= memory_budget) {
+            return {layout, score_width, estimate, true};
+        }
+        if (estimate.total() < smallest.estimate.total()) {
+            smallest = {layout, score_width, estimate, false};
+        }
+    }
+    return smallest;
+}
+
+string tableLayoutName(TableLayout layout) {
+    switch (layout) {
+        case TableLayout::FULL:
+            return "full tables";
+        case TableLayout::RUN_LENGTH:
+            return "run-length tables";
+        case TableLayout::PACKED:
+            return "packed tables";
+        case TableLayout::CHECKPOINTED:
+            return "checkpointed tables";
+        case TableLayout::SCORE_ONLY:
+            break;
+    }
+    return "score only";
+}
@@ -0,0 +1,78 @@
+#ifndef MAXSCOREPATH_MEMORY_PLAN_HEADER
+#define MAXSCOREPATH_MEMORY_PLAN_HEADER
+
+#include <cstdint>
+#include <string>
+
+#include "engine.hpp"
+#include "utility_func.hpp"
+
+using namespace std;
+
+// This file contains an estimator of the memory of a run of
+// `MaxScorePathsEngine` with the different table layouts. The estimates are
+// computed from statistics of the graph in one pass over the graph, without
+// computing the weights or the tables, so a layout that fits into a memory
+// budget can be chosen before the run.
+
+// Statistics of a graph for the GC content weights with `match` and
+// `non_match`.
+struct GraphStatistics {
+    int64_t segments = 0;
+    // Layers of all segments, deterministic segments have one layer.
+    int64_t layers = 0;
+    int64_t vertices = 0;
+    // Columns of `RunLengthTables`.
+    int64_t run_columns = 0;
+    int64_t max_bubble_width = 1;
+    int64_t max_abs_weight = 0;
+    IndexWidth index_width = IndexWidth::INT32;
+    // Bytes of the `eds_matrix` of the graph.
+    int64_t graph_bytes = 0;
+    // Blocks of `checkpointBlocks()` with `DEFAULT_BLOCK_VERTICES`.
+    int64_t checkpoint_blocks = 0;
+    int64_t max_block_segments = 0;
+    int64_t max_block_layers = 0;
+    int64_t max_block_vertices = 0;
+};
+
+GraphStatistics computeGraphStatistics(const eds_matrix &eds_segments,
+                                       int match, int non_match);
+
+// Estimated peak memory of a run in bytes, by what is allocated. The paths are
+// bounded by all vertices of the graph being on a path.
+struct MemoryEstimate {
+    int64_t graph = 0;
+    int64_t weights = 0;
+    int64_t tables = 0;
+    int64_t paths = 0;
+
+    int64_t total() const { return graph + weights + tables + paths; }
+};
+
+// Returns the estimate of a run with `layout` and scores of width
+// `score_width`.
+MemoryEstimate estimateMemory(const GraphStatistics &statistics,
+                              TableLayout layout, ScoreWidth score_width);
+
+// The layout chosen for a run and its estimate.
+struct ExecutionPlan {
+    TableLayout layout;
+    ScoreWidth score_width;
+    MemoryEstimate estimate;
+    // False if not even the smallest layout fits into the budget.
+    bool fits;
+};
+
+// Returns the fastest layout whose estimate fits into `memory_budget` bytes,
+// from the fastest: run-length tables (for a non-negative penalty), full
+// tables, packed tables, checkpointed tables, score only. If none fits,
+// returns the one with the smallest estimate. Throws `overflow_error` if the
+// scores do not fit into 64 bits.
+ExecutionPlan planExecution(const GraphStatistics &statistics, int penalty,
+                            int64_t memory_budget);
+
+// Returns a name of `layout` for messages.
+string tableLayoutName(TableLayout layout);
+
+#endif
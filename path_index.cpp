@@ -0,0 +1,127 @@
+#include "path_index.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+
+using namespace std;
+
+PathScoreIndex::PathScoreIndex(const eds_matrix &eds_segments,
+                               const weight_matrix &weights)
+    : order_(eds_segments) {
+    if (weights.size() != eds_segments.size()) {
+        throw invalid_argument("The weights do not match the graph.");
+    }
+    prefix_sums_.reserve(order_.numVertices() + 1);
+    prefix_sums_.push_back(0);
+    for (size_t segment = 0; segment < eds_segments.size(); segment++) {
+        if (weights[segment].size() != eds_segments[segment].size()) {
+            throw invalid_argument("The weights do not match the graph.");
+        }
+        for (size_t layer = 0; layer < eds_segments[segment].size(); layer++) {
+            const auto &layer_weights = weights[segment][layer];
+            if (layer_weights.size() != eds_segments[segment][layer].size()) {
+                throw invalid_argument("The weights do not match the graph.");
+            }
+            for (int weight : layer_weights) {
+                prefix_sums_.push_back(prefix_sums_.back() + weight);
+            }
+        }
+    }
+}
+
+int64_t PathScoreIndex::position(const PathInterval &interval) const {
+    if (interval.first_index > interval.last_index) {
+        throw out_of_range("The interval is not in the graph.");
+    }
+    // Both ends are vertices of the graph.
+    order_.position(interval.segment, interval.layer, interval.last_index);
+    return order_.position(interval.segment, interval.layer,
+                           interval.first_index);
+}
+
+int64_t PathScoreIndex::weight(const PathInterval &interval) const {
+    int64_t first = position(interval);
+    int64_t end = first + interval.last_index - interval.first_index + 1;
+    return prefix_sums_[end] - prefix_sums_[first];
+}
+
+int64_t PathScoreIndex::weight(const vector<PathInterval> &path) const {
+    int64_t path_weight = 0;
+    for (const auto &interval : path) {
+        path_weight += weight(interval);
+    }
+    return path_weight;
+}
+
+int64_t PathScoreIndex::score(const compact_paths &paths, int penalty) const {
+    int64_t paths_score = 0;
+    for (const auto &path : paths) {
+        if (!path.empty()) {
+            paths_score += weight(path) - penalty;
+        }
+    }
+    return paths_score;
+}
+
+void PathScoreIndex::validate(const compact_paths &paths) const {
+    // The first and the last position of every interval, with its path.
+    vector<tuple<int64_t, int64_t, size_t>> ranges;
+    for (size_t i = 0; i < paths.size(); i++) {
+        const auto &path = paths[i];
+        for (size_t j = 0; j < path.size(); j++) {
+            const PathInterval &interval = path[j];
+            int64_t first;
+            try {
+                first = position(interval);
+            } catch (const out_of_range &) {
+                throw invalid_argument("Path " + to_string(i) + ": interval " +
+                                       to_string(j) + " is not in the graph.");
+            }
+            if (j > 0) {
+                const PathInterval &previous = path[j - 1];
+                // The next vertex on the layer.
+                bool on_layer = previous.segment == interval.segment &&
+                                previous.layer == interval.layer &&
+                                previous.last_index + 1 == interval.first_index;
+                // The start vertex of a bubble to the first vertex of a layer,
+                // or the last vertex of a layer to the J vertex.
+                bool to_next_segment =
+                    previous.segment + 1 == interval.segment &&
+                    previous.last_index + 1 ==
+                        order_.layerSize(previous.segment, previous.layer) &&
+                    interval.first_index == 0 &&
+                    (order_.numLayers(previous.segment) == 1 ||
+                     order_.numLayers(interval.segment) == 1);
+                if (!on_layer && !to_next_segment) {
+                    throw invalid_argument(
+                        "Path " + to_string(i) + ": intervals " +
+                        to_string(j - 1) + " and " + to_string(j) +
+                        " are not joined by an edge.");
+                }
+            }
+            ranges.emplace_back(
+                first, first + interval.last_index - interval.first_index, i);
+        }
+    }
+    sort(ranges.begin(), ranges.end());
+    // The interval that reaches the furthest among the ones before.
+    size_t furthest = 0;
+    for (size_t k = 1; k < ranges.size(); k++) {
+        if (get<0>(ranges[k]) <= get<1>(ranges[furthest])) {
+            size_t path_1 = get<2>(ranges[furthest]);
+            size_t path_2 = get<2>(ranges[k]);
+            if (path_1 == path_2) {
+                throw invalid_argument("Path " + to_string(path_1) +
+                                       " visits a vertex twice.");
+            }
+            throw invalid_argument(
+                "Paths " + to_string(min(path_1, path_2)) + " and " +
+                to_string(max(path_1, path_2)) + " share a vertex.");
+        }
+        if (get<1>(ranges[k]) > get<1>(ranges[furthest])) {
+            furthest = k;
+        }
+    }
+}
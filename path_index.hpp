@@ -0,0 +1,59 @@
+#ifndef MAXSCOREPATH_PATH_INDEX_HEADER
+#define MAXSCOREPATH_PATH_INDEX_HEADER
+
+#include <cstdint>
+#include <vector>
+
+#include "result_cache.hpp"
+#include "utility_func.hpp"
+#include "weight_track.hpp"
+
+using namespace std;
+
+// This file contains an index of prefix sums over the weights of a graph. With
+// paths as intervals, see `compressPaths()`, the weight of a path and the score
+// of a set of paths take constant time per interval instead of a walk over
+// their vertices, e.g. to score the paths of other tools or to compare them
+// with the paths of `getPaths()`.
+//
+// A set of paths scores the weights of its vertices minus the penalty x for
+// every path, the objective of the DP. The set is valid if every path follows
+// the edges of the graph and no vertex is on two paths.
+
+class PathScoreIndex {
+   public:
+    // Builds the index of `weights` of `eds_segments`, one pass over the
+    // weights. Throws `invalid_argument` if their shapes differ.
+    PathScoreIndex(const eds_matrix &eds_segments,
+                   const weight_matrix &weights);
+
+    int64_t numVertices() const { return order_.numVertices(); }
+
+    // Returns the sum of the weights of the vertices of `interval`. Throws
+    // `out_of_range` if the interval is empty or not in the graph.
+    int64_t weight(const PathInterval &interval) const;
+    // Returns the sum of the weights of the vertices of `path`.
+    int64_t weight(const vector<PathInterval> &path) const;
+
+    // Returns the score of `paths` with `penalty`, paths without intervals do
+    // not count. The paths are not validated, see `validate()`.
+    int64_t score(const compact_paths &paths, int penalty) const;
+
+    // Throws `invalid_argument` naming the first violation if `paths` are not
+    // a valid set of paths: an interval is empty or not in the graph, two
+    // consecutive intervals of a path are not joined by an edge, or two
+    // intervals share a vertex. Takes O(k log k) time for k intervals.
+    void validate(const compact_paths &paths) const;
+
+   private:
+    // Returns the position of the first vertex of `interval` in the vertex
+    // order of the graph, see `weight_track.hpp`.
+    int64_t position(const PathInterval &interval) const;
+
+    VertexOrder order_;
+    // The sums of the weights of the vertices before every vertex in the
+    // vertex order of the graph, and of all vertices at the end.
+    vector<int64_t> prefix_sums_;
+};
+
+#endif
@@ -0,0 +1,208 @@
+#include "path_writer.hpp"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+const uint32_t BINARY_PATHS_MAGIC = 0x4250534d;  // "MSPB"
+const uint32_t BINARY_PATHS_VERSION = 1;
+const char TSV_HEADER[] = "#path\tsegment\tlayer\tfirst_index\tlast_index\n";
+
+// Longest formatted 64-bit integer.
+const size_t MAX_INTEGER_CHARS = 20;
+
+char *appendInteger(char *out, int64_t value) {
+    return to_chars(out, out + MAX_INTEGER_CHARS, value).ptr;
+}
+
+char *appendString(char *out, const string &value) {
+    return copy(value.begin(), value.end(), out);
+}
+
+template <typename T>
+char *appendLittleEndian(char *out, T value) {
+    uint64_t bits = value;
+    for (size_t i = 0; i < sizeof(T); i++) {
+        *out++ = char(bits >> (8 * i));
+    }
+    return out;
+}
+
+// Calls `on_interval(interval)` for the intervals of consecutive vertices of
+// `path`, see `compressPaths()`.
+template <typename path_t, typename on_interval_t>
+void forEachInterval(const path_t &path, const on_interval_t &on_interval) {
+    auto v = path.begin();
+    while (v != path.end()) {
+        PathInterval interval = {v->segment, v->layer, v->index, v->index};
+        for (v++; v != path.end() && v->segment == interval.segment &&
+                  v->layer == interval.layer &&
+                  v->index == interval.last_index + 1;
+             v++) {
+            interval.last_index++;
+        }
+        on_interval(interval);
+    }
+}
+
+}  // namespace
+
+PathFormat parsePathFormat(const string &name) {
+    if (name == "bed") {
+        return PathFormat::BED;
+    }
+    if (name == "tsv") {
+        return PathFormat::TSV;
+    }
+    if (name == "binary") {
+        return PathFormat::BINARY;
+    }
+    throw invalid_argument("unknown path format '" + name + "'");
+}
+
+PathWriter::PathWriter(int fd, PathFormat format,
+                       const eds_matrix &eds_segments, string graph_name,
+                       size_t buffer_size)
+    : fd_(fd), format_(format), graph_name_(move(graph_name)) {
+    if (format_ == PathFormat::BED) {
+        int64_t position = 0;
+        segment_starts_.reserve(eds_segments.size());
+        for (const auto &segment : eds_segments) {
+            segment_starts_.push_back(layer_starts_.size());
+            for (const auto &layer : segment) {
+                layer_starts_.push_back(position);
+                position += layer.size();
+            }
+        }
+    }
+    // The buffer holds at least a few records.
+    buffer_.resize(max(buffer_size, 4 * (graph_name_.size() + 8 * 24)));
+
+    char *out = buffer_.data();
+    if (format_ == PathFormat::TSV) {
+        out = copy(begin(TSV_HEADER), end(TSV_HEADER) - 1, out);
+    } else if (format_ == PathFormat::BINARY) {
+        out = appendLittleEndian(out, BINARY_PATHS_MAGIC);
+        out = appendLittleEndian(out, BINARY_PATHS_VERSION);
+    }
+    used_ = out - buffer_.data();
+}
+
+PathWriter::~PathWriter() {
+    try {
+        flush();
+    } catch (const runtime_error &) {
+    }
+}
+
+void PathWriter::flush() {
+    size_t written = 0;
+    while (written < used_) {
+        ssize_t bytes = ::write(fd_, buffer_.data() + written, used_ - written);
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            used_ = 0;
+            throw runtime_error(string("cannot write paths: ") +
+                                strerror(errno));
+        }
+        written += bytes;
+    }
+    used_ = 0;
+}
+
+void PathWriter::reserveRecord() {
+    // A record has at most 5 integers and the graph name.
+    if (buffer_.size() - used_ < graph_name_.size() + 8 * 24) {
+        flush();
+    }
+}
+
+void PathWriter::beginPath(int64_t num_intervals) {
+    if (format_ == PathFormat::BINARY) {
+        reserveRecord();
+        used_ = appendLittleEndian(buffer_.data() + used_, num_intervals) -
+                buffer_.data();
+    }
+    path_count_++;
+}
+
+void PathWriter::writeInterval(const PathInterval &interval) {
+    reserveRecord();
+    char *out = buffer_.data() + used_;
+    int64_t path = path_count_ - 1;
+    switch (format_) {
+        case PathFormat::BED: {
+            int64_t start =
+                layer_starts_[segment_starts_[interval.segment] +
+                              interval.layer];
+            out = appendString(out, graph_name_);
+            *out++ = '\t';
+            out = appendInteger(out, start + interval.first_index);
+            *out++ = '\t';
+            out = appendInteger(out, start + interval.last_index + 1);
+            out = copy_n("\tpath", 5, out);
+            out = appendInteger(out, path);
+            *out++ = '\n';
+            break;
+        }
+        case PathFormat::TSV:
+            out = appendInteger(out, path);
+            *out++ = '\t';
+            out = appendInteger(out, interval.segment);
+            *out++ = '\t';
+            out = appendInteger(out, interval.layer);
+            *out++ = '\t';
+            out = appendInteger(out, interval.first_index);
+            *out++ = '\t';
+            out = appendInteger(out, interval.last_index);
+            *out++ = '\n';
+            break;
+        case PathFormat::BINARY:
+            out = appendLittleEndian(out, interval.segment);
+            out = appendLittleEndian(out, interval.layer);
+            out = appendLittleEndian(out, interval.first_index);
+            out = appendLittleEndian(out, interval.last_index);
+            break;
+    }
+    used_ = out - buffer_.data();
+}
+
+template <typename paths_t>
+void PathWriter::write(const paths_t &paths) {
+    for (const auto &path : paths) {
+        int64_t num_intervals = 0;
+        if (format_ == PathFormat::BINARY) {
+            forEachInterval(path, [&](const PathInterval &) {
+                num_intervals++;
+            });
+        }
+        beginPath(num_intervals);
+        forEachInterval(path, [this](const PathInterval &interval) {
+            writeInterval(interval);
+        });
+    }
+}
+
+void PathWriter::write(const compact_paths &paths) {
+    for (const auto &intervals : paths) {
+        beginPath(intervals.size());
+        for (const auto &interval : intervals) {
+            writeInterval(interval);
+        }
+    }
+}
+
+template void PathWriter::write(const vector<vector<BasicVertex<int32_t>>> &);
+template void PathWriter::write(const vector<vector<BasicVertex<int64_t>>> &);
+template void PathWriter::write(const pmr_paths<int32_t> &);
+template void PathWriter::write(const pmr_paths<int64_t> &);
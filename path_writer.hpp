@@ -0,0 +1,80 @@
+#ifndef MAXSCOREPATH_PATH_WRITER_HEADER
+#define MAXSCOREPATH_PATH_WRITER_HEADER
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "result_cache.hpp"
+#include "utility_func.hpp"
+
+using namespace std;
+
+// This file contains a buffered writer of the paths found by `getPaths()`.
+// Every path is written as intervals of consecutive vertices on a layer, see
+// `PathInterval`. The records are formatted into a large buffer that is reused
+// and written with one `write()` call when it is full.
+//
+// Formats:
+// - BED: `<graph name> <start> <end> path<i>` separated by tabs, one line per
+//   interval, where start and end are the 0-based half-open positions of the
+//   interval in the linearized graph, see `linearizedGraphLength()`.
+// - TSV: a header line, then `<path> <segment> <layer> <first index>
+//   <last index>` separated by tabs, one line per interval.
+// - BINARY: the 32-bit magic "MSPB" and the 32-bit version 1, then for every
+//   path the 64-bit number of its intervals followed by the segment, layer,
+//   first index and last index of each interval as 64-bit integers. All values
+//   are little-endian. The paths are numbered from 0 in the order of the file.
+
+enum class PathFormat { BED, TSV, BINARY };
+
+// Parses "bed", "tsv" or "binary", throws `invalid_argument` otherwise.
+PathFormat parsePathFormat(const string &name);
+
+class PathWriter {
+   public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 1 << 20;
+
+    // Writes to the open file descriptor `fd`, which is not closed. `graph_name`
+    // is the first column of BED.
+    PathWriter(int fd, PathFormat format, const eds_matrix &eds_segments,
+               string graph_name = "graph",
+               size_t buffer_size = DEFAULT_BUFFER_SIZE);
+    PathWriter(const PathWriter &) = delete;
+    PathWriter &operator=(const PathWriter &) = delete;
+    // Flushes the buffer, ignoring errors.
+    ~PathWriter();
+
+    // Appends paths of vertices, a `vector` or `pmr_paths`, numbered after the
+    // paths written before.
+    template <typename paths_t>
+    void write(const paths_t &paths);
+    // Appends paths of intervals.
+    void write(const compact_paths &paths);
+
+    // Writes the buffer out. Throws `runtime_error` if writing fails.
+    void flush();
+
+    // Returns the number of paths written so far.
+    int64_t pathCount() const { return path_count_; }
+
+   private:
+    void beginPath(int64_t num_intervals);
+    void writeInterval(const PathInterval &interval);
+    // Makes room for one record in the buffer.
+    void reserveRecord();
+
+    int fd_;
+    PathFormat format_;
+    string graph_name_;
+    // `layer_starts_[segment_starts_[segment] + layer]` is the linearized
+    // position of the first vertex of the layer, for BED.
+    vector<int64_t> segment_starts_;
+    vector<int64_t> layer_starts_;
+
+    vector<char> buffer_;
+    size_t used_ = 0;
+    int64_t path_count_ = 0;
+};
+
+#endif
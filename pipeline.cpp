@@ -0,0 +1,216 @@
+#include "pipeline.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+
+using namespace std;
+
+namespace {
+
+struct SegmentBatch {
+    eds_matrix segments;
+    weight_matrix weights;
+};
+
+template <typename score_t>
+ScoreWidth scoreWidthOf() {
+    switch (sizeof(score_t)) {
+        case sizeof(int16_t):
+            return ScoreWidth::INT16;
+        case sizeof(int32_t):
+            return ScoreWidth::INT32;
+    }
+    return ScoreWidth::INT64;
+}
+
+// Reads the EDS text from `input` and passes the segments to `emit(segments)`
+// batch by batch, until `emit()` returns false. The text is enclosed in
+// `EMPTY_STR` as by `readEDSFile()`.
+template <typename emit_t>
+void readBatches(istream &input, size_t read_bytes, const emit_t &emit) {
+    string text(1, EMPTY_STR);
+    bool after_bubble = false;
+    auto emitText = [&](const string &batch_text) {
+        eds_matrix segments = EDSToMatrix(batch_text);
+        // The batch starts after a `}`, separate adjacent bubbles as
+        // `EDSToMatrix()` does.
+        if (after_bubble && batch_text[0] == '{') {
+            segments.insert(segments.begin(),
+                            vector<string>{string(1, EMPTY_STR)});
+        }
+        after_bubble = batch_text.back() == '}';
+        return emit(move(segments));
+    };
+
+    vector<char> buffer(read_bytes);
+    while (input.read(buffer.data(), buffer.size()) || input.gcount() > 0) {
+        size_t read_start = text.size();
+        text.append(buffer.data(), input.gcount());
+        // Batches end after a `}`, outside of a bubble.
+        size_t cut = string_view(text).substr(read_start).rfind('}');
+        if (cut == string_view::npos) {
+            continue;
+        }
+        cut += read_start + 1;
+        if (!emitText(text.substr(0, cut))) {
+            return;
+        }
+        text.erase(0, cut);
+    }
+    if (input.bad()) {
+        throw runtime_error("cannot read the EDS text");
+    }
+    text += EMPTY_STR;
+    emitText(text);
+}
+
+template <typename score_t, typename index_t>
+PipelineResult<index_t> runPipelineWithScoreType(
+    istream &input, int64_t max_vertices, int match, int non_match,
+    int penalty, const PipelineOptions &options) {
+    SPSCQueue<SegmentBatch> parsed(options.queue_batches);
+    SPSCQueue<SegmentBatch> weighted(options.queue_batches);
+    exception_ptr reader_error;
+    exception_ptr weighting_error;
+    auto cancel = [&] {
+        parsed.cancel();
+        weighted.cancel();
+    };
+
+    thread reader([&] {
+        try {
+            readBatches(input, options.read_bytes, [&](eds_matrix segments) {
+                return parsed.push(SegmentBatch{move(segments), {}});
+            });
+        } catch (...) {
+            reader_error = current_exception();
+            cancel();
+        }
+        parsed.close();
+    });
+    thread weighting([&] {
+        try {
+            SegmentBatch batch;
+            while (parsed.pop(batch)) {
+                batch.weights =
+                    getGCContentWeights(batch.segments, match, non_match);
+                if (!weighted.push(move(batch))) {
+                    break;
+                }
+            }
+        } catch (...) {
+            weighting_error = current_exception();
+            cancel();
+        }
+        weighted.close();
+    });
+    auto join = [&] {
+        reader.join();
+        weighting.join();
+    };
+
+    PipelineResult<index_t> result;
+    result.score_width = scoreWidthOf<score_t>();
+    eds_matrix &eds_segments = result.eds_segments;
+    weight_matrix weights;
+    basic_score_matrix<score_t> scores;
+    basic_score_matrix<score_t> choices;
+    OnlineMaxScorePaths<score_t, index_t> online(penalty);
+    // The paths of the online traceback, in the order of the graph.
+    vector<vector<BasicVertex<index_t>>> online_paths;
+    int64_t max_abs_weight = max(abs((int64_t)match), abs((int64_t)non_match));
+    int64_t num_vertices = 0;
+    int64_t max_bubble_width = 1;
+    try {
+        SegmentBatch batch;
+        while (weighted.pop(batch)) {
+            index_t first_segment = eds_segments.size();
+            for (size_t i = 0; i < batch.segments.size(); i++) {
+                auto &segment = batch.segments[i];
+                max_bubble_width =
+                    max(max_bubble_width, (int64_t)segment.size());
+                for (const auto &layer : segment) {
+                    num_vertices += layer.size();
+                }
+                if (!options.online_traceback) {
+                    auto &segment_scores = scores.emplace_back();
+                    auto &segment_choices = choices.emplace_back();
+                    for (const auto &layer : segment) {
+                        segment_scores.emplace_back(layer.size());
+                        segment_choices.emplace_back(layer.size());
+                    }
+                }
+                eds_segments.push_back(move(segment));
+                weights.push_back(move(batch.weights[i]));
+            }
+            int64_t score_bound = scoreBound(max(num_vertices, max_vertices),
+                                             max_abs_weight, penalty);
+            if (selectScoreWidth(score_bound, max_bubble_width) >
+                result.score_width) {
+                throw overflow_error(
+                    "Score type is too narrow for the bubbles of the graph.");
+            }
+            if (options.online_traceback) {
+                online.extend(eds_segments, weights, online_paths);
+            } else {
+                fillTables(eds_segments, weights, scores, choices, penalty,
+                           BasicVertex<index_t>(first_segment, 0, 0));
+            }
+        }
+    } catch (...) {
+        cancel();
+        join();
+        throw;
+    }
+    join();
+    if (reader_error) {
+        rethrow_exception(reader_error);
+    }
+    if (weighting_error) {
+        rethrow_exception(weighting_error);
+    }
+
+    if (options.online_traceback) {
+        result.score = online.finish(eds_segments, online_paths);
+        result.paths.assign(make_move_iterator(online_paths.rbegin()),
+                            make_move_iterator(online_paths.rend()));
+        return result;
+    }
+    const auto &last_cell = scores.back()[0].back();
+    result.score =
+        max(last_cell[!SURELY_SELECTED][I], last_cell[!SURELY_SELECTED][E]);
+    getPaths(eds_segments, scores, choices, result.paths);
+    return result;
+}
+
+}  // namespace
+
+template <typename index_t>
+PipelineResult<index_t> runPipeline(istream &input, int64_t max_vertices,
+                                    int match, int non_match, int penalty,
+                                    const PipelineOptions &options) {
+    int64_t score_bound = scoreBound(
+        max_vertices, max(abs((int64_t)match), abs((int64_t)non_match)),
+        penalty);
+    switch (selectScoreWidth(score_bound, 1)) {
+        case ScoreWidth::INT16:
+            return runPipelineWithScoreType<int16_t, index_t>(
+                input, max_vertices, match, non_match, penalty, options);
+        case ScoreWidth::INT32:
+            return runPipelineWithScoreType<int32_t, index_t>(
+                input, max_vertices, match, non_match, penalty, options);
+        case ScoreWidth::INT64:
+            break;
+    }
+    return runPipelineWithScoreType<int64_t, index_t>(
+        input, max_vertices, match, non_match, penalty, options);
+}
+
+template PipelineResult<int32_t> runPipeline(istream &, int64_t, int, int, int,
+                                             const PipelineOptions &);
+template PipelineResult<int64_t> runPipeline(istream &, int64_t, int, int, int,
+                                             const PipelineOptions &);
@@ -0,0 +1,110 @@
+#ifndef MAXSCOREPATH_PIPELINE_HEADER
+#define MAXSCOREPATH_PIPELINE_HEADER
+
+#include <atomic>
+#include <cstdint>
+#include <istream>
+#include <thread>
+#include <vector>
+
+#include "utility_func.hpp"
+
+using namespace std;
+
+// This file contains a pipelined run of the DP on full tables. A reader thread
+// reads EDS text from a stream and parses it into batches of segments, a
+// weighting thread computes their weights and the calling thread fills the
+// tables of every batch as soon as it arrives, so the three stages overlap and
+// the wall time approaches that of the slowest stage. The stages are connected
+// by bounded queues, a full queue makes its producer wait. The traceback runs
+// once the whole graph is filled, or while it is filled with
+// `PipelineOptions::online_traceback`.
+
+// Bounded lock-free queue between one producer and one consumer thread. A
+// waiting end yields its time slice.
+template <typename T>
+class SPSCQueue {
+   public:
+    explicit SPSCQueue(size_t capacity) : slots_(capacity + 1) {}
+
+    // Waits while the queue is full. Returns false if the queue is cancelled.
+    bool push(T value) {
+        size_t tail = tail_.load(memory_order_relaxed);
+        size_t next = (tail + 1) % slots_.size();
+        while (!cancelled_.load(memory_order_acquire)) {
+            if (next != head_.load(memory_order_acquire)) {
+                slots_[tail] = move(value);
+                tail_.store(next, memory_order_release);
+                return true;
+            }
+            this_thread::yield();
+        }
+        return false;
+    }
+
+    // Waits while the queue is empty. Returns false once the queue is closed
+    // and empty, or cancelled.
+    bool pop(T &value) {
+        size_t head = head_.load(memory_order_relaxed);
+        while (!cancelled_.load(memory_order_acquire)) {
+            // Read before the tail, the last push happened before the close.
+            bool closed = closed_.load(memory_order_acquire);
+            if (head != tail_.load(memory_order_acquire)) {
+                value = move(slots_[head]);
+                head_.store((head + 1) % slots_.size(), memory_order_release);
+                return true;
+            }
+            if (closed) {
+                return false;
+            }
+            this_thread::yield();
+        }
+        return false;
+    }
+
+    // Called by the producer after its last push.
+    void close() { closed_.store(true, memory_order_release); }
+    // Makes both ends return false from now on, when a stage fails.
+    void cancel() { cancelled_.store(true, memory_order_release); }
+
+   private:
+    vector<T> slots_;
+    // The producer and the consumer write to different cache lines.
+    alignas(64) atomic<size_t> head_{0};
+    alignas(64) atomic<size_t> tail_{0};
+    atomic<bool> closed_{false};
+    atomic<bool> cancelled_{false};
+};
+
+struct PipelineOptions {
+    // Bytes read from the stream at a time. After every read, the text up to
+    // the last `}` becomes a batch.
+    size_t read_bytes = 1 << 20;
+    // Batches in each queue.
+    size_t queue_batches = 4;
+    // Keeps only the choices of the vertices whose paths are not final yet,
+    // see `OnlineMaxScorePaths`, instead of the full tables.
+    bool online_traceback = false;
+};
+
+template <typename index_t>
+struct PipelineResult {
+    eds_matrix eds_segments;
+    int64_t score = 0;
+    ScoreWidth score_width = ScoreWidth::INT64;
+    // As found by `getPaths()`.
+    vector<vector<BasicVertex<index_t>>> paths;
+};
+
+// Returns the graph, the score and the paths of the EDS text read from `input`,
+// the same as `readEDSFile()`, `EDSToMatrix()`, `findMaxScoringPaths()` and
+// `getPaths()` with the GC content weights with `match` and `non_match`. The
+// score type is selected for `max_vertices` vertices, e.g. the size of the
+// input plus 2. Throws `overflow_error` if the graph turns out to have more
+// vertices or too wide bubbles for it, and `runtime_error` if reading fails.
+template <typename index_t>
+PipelineResult<index_t> runPipeline(
+    istream &input, int64_t max_vertices, int match, int non_match,
+    int penalty, const PipelineOptions &options = PipelineOptions());
+
+#endif
@@ -0,0 +1,311 @@
+#include "result_cache.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <tuple>
+#include <utility>
+
+#include "binary_file.hpp"
+
+using namespace std;
+
+namespace {
+
+// Identifies the files of the cache and their format version.
+const uint32_t RESULT_FILE_MAGIC = 0x4350534d;  // "MSPC"
+const uint32_t RESULT_FILE_VERSION = 1;
+const char RESULT_FILE_EXTENSION[] = ".paths";
+
+// Mixes `value` into `hash`, using the finalizer of MurmurHash3.
+uint64_t hashCombine(uint64_t hash, uint64_t value) {
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    hash ^= value;
+    return ((hash << 27) | (hash >> 37)) * 5 + 0x52dce729;
+}
+
+}  // namespace
+
+uint64_t graphFingerprint(const eds_matrix &eds_segments) {
+    uint64_t hash = hashCombine(0, eds_segments.size());
+    for (const auto &segment : eds_segments) {
+        hash = hashCombine(hash, segment.size());
+        for (const auto &layer : segment) {
+            // The length also separates the layers.
+            hash = hashCombine(hash, layer.size());
+            const size_t word_size = sizeof(uint64_t);
+            size_t i = 0;
+            for (; i + word_size <= layer.size(); i += word_size) {
+                uint64_t word;
+                memcpy(&word, layer.data() + i, word_size);
+                hash = hashCombine(hash, word);
+            }
+            if (i < layer.size()) {
+                uint64_t word = 0;
+                memcpy(&word, layer.data() + i, layer.size() - i);
+                hash = hashCombine(hash, word);
+            }
+        }
+    }
+    return hash;
+}
+
+bool operator==(const PathInterval &a, const PathInterval &b) {
+    return tie(a.segment, a.layer, a.first_index, a.last_index) ==
+           tie(b.segment, b.layer, b.first_index, b.last_index);
+}
+
+template <typename paths_t>
+compact_paths compressPaths(const paths_t &paths) {
+    compact_paths compressed;
+    compressed.reserve(paths.size());
+    for (const auto &path : paths) {
+        vector<PathInterval> intervals;
+        for (const auto &v : path) {
+            if (!intervals.empty() && intervals.back().segment == v.segment &&
+                intervals.back().layer == v.layer &&
+                intervals.back().last_index + 1 == v.index) {
+                intervals.back().last_index++;
+            } else {
+                intervals.push_back({v.segment, v.layer, v.index, v.index});
+            }
+        }
+        compressed.push_back(move(intervals));
+    }
+    return compressed;
+}
+
+template <typename index_t>
+vector<vector<BasicVertex<index_t>>> expandPaths(const compact_paths &paths) {
+    vector<vector<BasicVertex<index_t>>> expanded;
+    expanded.reserve(paths.size());
+    for (const auto &intervals : paths) {
+        vector<BasicVertex<index_t>> path;
+        for (const auto &interval : intervals) {
+            for (int64_t i = interval.first_index; i <= interval.last_index;
+                 i++) {
+                path.emplace_back(interval.segment, interval.layer, i);
+            }
+        }
+        expanded.push_back(move(path));
+    }
+    return expanded;
+}
+
+ResultCache::ResultCache(string directory, uint64_t max_size)
+    : directory_(move(directory)), max_size_(max_size) {
+    filesystem::create_directories(directory_);
+}
+
+string ResultCache::resultPath(const ResultKey &key) const {
+    ostringstream path;
+    path << directory_ << "/" << hex << setw(16) << setfill('0')
+         << key.graph_fingerprint << dec << "_" << key.match << "_"
+         << key.non_match << "_" << key.penalty << RESULT_FILE_EXTENSION;
+    return path.str();
+}
+
+optional<PathsResult> ResultCache::lookup(const ResultKey &key) {
+    string path = resultPath(key);
+    ifstream input(path, ios::binary);
+    if (!input) {
+        return nullopt;
+    }
+
+    uint32_t magic, version;
+    ResultKey stored_key;
+    if (!readValue(input, magic) || magic != RESULT_FILE_MAGIC ||
+        !readValue(input, version) || version != RESULT_FILE_VERSION ||
+        !readValue(input, stored_key.graph_fingerprint) ||
+        !readValue(input, stored_key.match) ||
+        !readValue(input, stored_key.non_match) ||
+        !readValue(input, stored_key.penalty) ||
+        stored_key.graph_fingerprint != key.graph_fingerprint ||
+        stored_key.match != key.match ||
+        stored_key.non_match != key.non_match ||
+        stored_key.penalty != key.penalty) {
+        return nullopt;
+    }
+
+    PathsResult result;
+    uint64_t num_paths;
+    if (!readValue(input, result.score) ||
+        !readValue(input, result.cover_percentage) ||
+        !readValue(input, result.average_length) ||
+        !readValue(input, num_paths)) {
+        return nullopt;
+    }
+    // The counts are not trusted for preallocation, a damaged file ends with
+    // a failed read.
+    for (uint64_t p = 0; p < num_paths; p++) {
+        uint64_t num_intervals;
+        if (!readValue(input, num_intervals)) {
+            return nullopt;
+        }
+        vector<PathInterval> intervals;
+        for (uint64_t i = 0; i < num_intervals; i++) {
+            PathInterval interval;
+            if (!readValue(input, interval)) {
+                return nullopt;
+            }
+            intervals.push_back(interval);
+        }
+        result.paths.push_back(move(intervals));
+    }
+
+    // The modification time orders the results for the eviction.
+    error_code error;
+    filesystem::last_write_time(path, filesystem::file_time_type::clock::now(),
+                                error);
+    return result;
+}
+
+void ResultCache::store(const ResultKey &key, const PathsResult &result) {
+    static atomic<uint64_t> temp_counter(0);
+    string path = resultPath(key);
+    // Readers never see a partially written file.
+    string temp_path = path + ".tmp" + to_string(getpid()) + "_" +
+                       to_string(temp_counter++);
+    {
+        ofstream output(temp_path, ios::binary | ios::trunc);
+        writeValue(output, RESULT_FILE_MAGIC);
+        writeValue(output, RESULT_FILE_VERSION);
+        writeValue(output, key.graph_fingerprint);
+        writeValue(output, key.match);
+        writeValue(output, key.non_match);
+        writeValue(output, key.penalty);
+        writeValue(output, result.score);
+        writeValue(output, result.cover_percentage);
+        writeValue(output, result.average_length);
+        writeValue(output, uint64_t(result.paths.size()));
+        for (const auto &intervals : result.paths) {
+            writeValue(output, uint64_t(intervals.size()));
+            output.write(reinterpret_cast<const char *>(intervals.data()),
+                         intervals.size() * sizeof(PathInterval));
+        }
+        if (!output.flush()) {
+            output.close();
+            error_code error;
+            filesystem::remove(temp_path, error);
+            return;
+        }
+    }
+    error_code error;
+    filesystem::rename(temp_path, path, error);
+    if (error) {
+        filesystem::remove(temp_path, error);
+        return;
+    }
+
+    lock_guard<mutex> lock(store_mutex_);
+    evict();
+}
+
+uint64_t ResultCache::size() const {
+    uint64_t total_size = 0;
+    error_code error;
+    for (const auto &entry :
+         filesystem::directory_iterator(directory_, error)) {
+        if (entry.path().extension() == RESULT_FILE_EXTENSION) {
+            total_size += entry.file_size(error);
+        }
+    }
+    return total_size;
+}
+
+void ResultCache::evict() {
+    struct CachedFile {
+        filesystem::file_time_type last_use;
+        uint64_t size;
+        filesystem::path path;
+    };
+    vector<CachedFile> files;
+    uint64_t total_size = 0;
+    error_code error;
+    for (const auto &entry :
+         filesystem::directory_iterator(directory_, error)) {
+        if (entry.path().extension() != RESULT_FILE_EXTENSION) {
+            continue;
+        }
+        CachedFile file;
+        file.last_use = entry.last_write_time(error);
+        if (error) {
+            continue;
+        }
+        file.size = entry.file_size(error);
+        if (error) {
+            continue;
+        }
+        file.path = entry.path();
+        total_size += file.size;
+        files.push_back(move(file));
+    }
+    if (total_size <= max_size_) {
+        return;
+    }
+
+    sort(files.begin(), files.end(),
+         [](const CachedFile &a, const CachedFile &b) {
+             return a.last_use < b.last_use;
+         });
+    for (const auto &file : files) {
+        if (total_size <= max_size_) {
+            break;
+        }
+        if (filesystem::remove(file.path, error)) {
+            total_size -= file.size;
+        }
+    }
+}
+
+template <typename index_t>
+PathsResult runCached(BasicMaxScorePathsEngine<index_t> &engine,
+                      ResultCache *cache, uint64_t graph_fingerprint,
+                      int match, int non_match, int penalty) {
+    ResultKey key = {graph_fingerprint, match, non_match, penalty};
+    if (cache != nullptr) {
+        optional<PathsResult> cached = cache->lookup(key);
+        if (cached) {
+            return move(*cached);
+        }
+    }
+
+    engine.setGCContentScoring(match, non_match);
+    PathsResult result;
+    result.score = engine.run(penalty);
+    if (engine.tableLayout() == TableLayout::SCORE_ONLY) {
+        // Without paths, the result is not worth caching.
+        result.cover_percentage = 0;
+        result.average_length = 0;
+        return result;
+    }
+    result.paths = compressPaths(engine.paths());
+    result.cover_percentage =
+        pathCoverPercentage(engine.graph(), engine.paths());
+    result.average_length = pathsAverageLength(engine.paths());
+    if (cache != nullptr) {
+        cache->store(key, result);
+    }
+    return result;
+}
+
+#define INSTANTIATE_RESULT_FUNCTIONS(index_t)                                  \
+    template compact_paths compressPaths(                                      \
+        const vector<vector<BasicVertex<index_t>>> &);                         \
+    template compact_paths compressPaths(const pmr_paths<index_t> &);          \
+    template vector<vector<BasicVertex<index_t>>> expandPaths(                 \
+        const compact_paths &);                                                \
+    template PathsResult runCached(BasicMaxScorePathsEngine<index_t> &,        \
+                                   ResultCache *, uint64_t, int, int, int);
+
+INSTANTIATE_RESULT_FUNCTIONS(int32_t)
+INSTANTIATE_RESULT_FUNCTIONS(int64_t)
@@ -0,0 +1,100 @@
+#ifndef MAXSCOREPATH_RESULT_CACHE_HEADER
+#define MAXSCOREPATH_RESULT_CACHE_HEADER
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "engine.hpp"
+#include "utility_func.hpp"
+
+using namespace std;
+
+// This file contains an on-disk cache of the results of the algorithm. A result
+// is identified by a fingerprint of the graph and the scoring parameters, so
+// reruns on unchanged inputs skip the DP and the traceback.
+
+// Returns a 64-bit hash of the content and the structure of the graph.
+uint64_t graphFingerprint(const eds_matrix &eds_segments);
+
+// Identifies a result.
+struct ResultKey {
+    uint64_t graph_fingerprint;
+    int match;
+    int non_match;
+    int penalty;
+};
+
+// Consecutive vertices `first_index`..`last_index` of a path on one layer of a
+// segment.
+struct PathInterval {
+    int64_t segment;
+    int64_t layer;
+    int64_t first_index;
+    int64_t last_index;
+};
+bool operator==(const PathInterval &a, const PathInterval &b);
+
+typedef vector<vector<PathInterval>> compact_paths;
+
+// Returns the paths found by `getPaths()` as intervals.
+template <typename paths_t>
+compact_paths compressPaths(const paths_t &paths);
+
+// Inverse of `compressPaths()`.
+template <typename index_t = int>
+vector<vector<BasicVertex<index_t>>> expandPaths(const compact_paths &paths);
+
+// The score, the paths and their statistics.
+struct PathsResult {
+    int64_t score;
+    compact_paths paths;
+    double cover_percentage;
+    double average_length;
+};
+
+// Cache in the directory `directory`, one file per result. When the size of the
+// files exceeds `max_size` bytes, the least recently used results are removed.
+// The cache is safe to use from multiple threads and processes; reading and
+// writing errors turn into cache misses.
+class ResultCache {
+   public:
+    static constexpr uint64_t DEFAULT_MAX_SIZE = uint64_t(1) << 30;
+
+    // Creates the directory if needed, throws `filesystem_error` if it
+    // cannot be created.
+    explicit ResultCache(string directory,
+                         uint64_t max_size = DEFAULT_MAX_SIZE);
+
+    // Returns the result stored for `key`, if any, and marks it as recently
+    // used.
+    optional<PathsResult> lookup(const ResultKey &key);
+
+    // Stores `result` for `key`, then evicts results above the size limit.
+    void store(const ResultKey &key, const PathsResult &result);
+
+    // Returns the total size of the cached results in bytes.
+    uint64_t size() const;
+
+   private:
+    string resultPath(const ResultKey &key) const;
+    void evict();
+
+    string directory_;
+    uint64_t max_size_;
+    mutex store_mutex_;
+};
+
+// Runs `engine` on its current graph with the given scoring and returns the
+// result. If `cache` is not null, the result is taken from it if present and
+// stored into it otherwise. `graph_fingerprint` is the fingerprint of the
+// engine's graph, see `graphFingerprint()`. Results of engines with
+// `TableLayout::SCORE_ONLY` have no paths and are not stored.
+template <typename index_t>
+PathsResult runCached(BasicMaxScorePathsEngine<index_t> &engine,
+                      ResultCache *cache, uint64_t graph_fingerprint,
+                      int match, int non_match, int penalty);
+
+#endif
@@ -0,0 +1,413 @@
+#include "server.hpp"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+// Graph of the engines of a worker between queries, so that unloaded graphs
+// are not kept alive by idle workers.
+const shared_ptr<const eds_matrix> NO_GRAPH = make_shared<const eds_matrix>();
+
+// Splits lines from a file descriptor.
+class LineReader {
+   public:
+    explicit LineReader(int fd) : fd_(fd) {}
+
+    // Returns false at the end of the input or on an error.
+    bool getLine(string &line) {
+        while (true) {
+            size_t end = buffer_.find('\n', start_);
+            if (end != string::npos) {
+                line.assign(buffer_, start_, end - start_);
+                start_ = end + 1;
+                break;
+            }
+            buffer_.erase(0, start_);
+            start_ = 0;
+            char chunk[1 << 16];
+            ssize_t read_bytes = read(fd_, chunk, sizeof(chunk));
+            if (read_bytes < 0 && errno == EINTR) {
+                continue;
+            }
+            if (read_bytes <= 0) {
+                // The last line does not need to end with a new line.
+                if (buffer_.empty()) {
+                    return false;
+                }
+                line = move(buffer_);
+                buffer_.clear();
+                break;
+            }
+            buffer_.append(chunk, read_bytes);
+        }
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        return true;
+    }
+
+   private:
+    int fd_;
+    string buffer_;
+    size_t start_ = 0;
+};
+
+// Sockets are written with `MSG_NOSIGNAL`, a client closing its connection
+// early must not raise SIGPIPE in a host process of the library.
+bool writeAll(int fd, const string &data) {
+    bool is_socket = true;
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t bytes;
+        if (is_socket) {
+            bytes = send(fd, data.data() + written, data.size() - written,
+                         MSG_NOSIGNAL);
+            if (bytes < 0 && errno == ENOTSOCK) {
+                is_socket = false;
+                continue;
+            }
+        } else {
+            bytes = write(fd, data.data() + written, data.size() - written);
+        }
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            return false;
+        }
+        written += bytes;
+    }
+    return true;
+}
+
+int parseInt(const string &token, const string &what) {
+    size_t parsed = 0;
+    int value = 0;
+    try {
+        value = stoi(token, &parsed);
+    } catch (const logic_error &) {
+        parsed = 0;
+    }
+    if (parsed == 0 || parsed != token.size()) {
+        throw invalid_argument("invalid " + what + " '" + token + "'");
+    }
+    return value;
+}
+
+template <typename index_t>
+string runQuery(BasicMaxScorePathsEngine<index_t> &engine, ResultCache *cache,
+                shared_ptr<const eds_matrix> eds_segments, uint64_t fingerprint,
+                const string &command, int penalty, int match,
+                int non_match) {
+    engine.setGraph(move(eds_segments));
+    PathsResult result =
+        runCached(engine, cache, fingerprint, match, non_match, penalty);
+    engine.setGraph(NO_GRAPH);
+
+    ostringstream response;
+    response << "ok " << result.score;
+    if (command == "stats") {
+        response << " " << result.paths.size() << " " << setprecision(2)
+                 << fixed << result.cover_percentage << " "
+                 << result.average_length;
+    } else if (command == "paths") {
+        response << " " << result.paths.size();
+        for (const auto &intervals : result.paths) {
+            response << "\n";
+            for (const auto &interval : intervals) {
+                for (int64_t i = interval.first_index;
+                     i <= interval.last_index; i++) {
+                    response << "(" << interval.segment << ","
+                             << interval.layer << "," << i << ")";
+                }
+            }
+        }
+    }
+    return response.str();
+}
+
+}  // namespace
+
+QueryServer::QueryServer(int num_workers) {
+    num_workers = max(num_workers, 1);
+    for (int i = 0; i < num_workers; i++) {
+        workers_.emplace_back(&QueryServer::workerLoop, this);
+    }
+}
+
+QueryServer::~QueryServer() {
+    {
+        lock_guard<mutex> lock(tasks_mutex_);
+        stopping_ = true;
+    }
+    tasks_cv_.notify_all();
+    for (auto &worker : workers_) {
+        worker.join();
+    }
+}
+
+void QueryServer::setResultCache(shared_ptr<ResultCache> cache) {
+    cache_ = move(cache);
+}
+
+void QueryServer::loadGraph(const string &name, const string &file_path) {
+    // `readEDSFile()` reports errors on stdout, which may be our output.
+    if (!ifstream(file_path).good()) {
+        throw runtime_error("cannot read file '" + file_path + "'");
+    }
+    auto eds_segments =
+        make_shared<const eds_matrix>(EDSToMatrix(readEDSFile(file_path)));
+    LoadedGraph graph = {eds_segments, selectIndexWidth(*eds_segments),
+                         graphFingerprint(*eds_segments)};
+
+    unique_lock<shared_mutex> lock(graphs_mutex_);
+    graphs_[name] = move(graph);
+}
+
+QueryServer::LoadedGraph QueryServer::findGraph(const string &name) {
+    shared_lock<shared_mutex> lock(graphs_mutex_);
+    auto graph = graphs_.find(name);
+    if (graph == graphs_.end()) {
+        throw invalid_argument("unknown graph '" + name + "'");
+    }
+    return graph->second;
+}
+
+string QueryServer::handleRequest(const string &request) {
+    return submit(request).get();
+}
+
+future<string> QueryServer::submit(string request) {
+    Task task;
+    task.request = move(request);
+    future<string> response = task.response.get_future();
+    {
+        lock_guard<mutex> lock(tasks_mutex_);
+        tasks_.push_back(move(task));
+    }
+    tasks_cv_.notify_one();
+    return response;
+}
+
+void QueryServer::workerLoop() {
+    Worker worker;
+    while (true) {
+        Task task;
+        {
+            unique_lock<mutex> lock(tasks_mutex_);
+            tasks_cv_.wait(lock,
+                           [this] { return stopping_ || !tasks_.empty(); });
+            if (tasks_.empty()) {
+                return;
+            }
+            task = move(tasks_.front());
+            tasks_.pop_front();
+        }
+        try {
+            task.response.set_value(execute(task.request, worker));
+        } catch (const exception &e) {
+            task.response.set_value(string("error ") + e.what());
+        }
+    }
+}
+
+string QueryServer::execute(const string &request, Worker &worker) {
+    istringstream input(request);
+    vector<string> tokens;
+    for (string token; input >> token;) {
+        tokens.push_back(token);
+    }
+    if (tokens.empty()) {
+        throw invalid_argument("empty request");
+    }
+    const string &command = tokens[0];
+
+    if (command == "load" && tokens.size() == 3) {
+        loadGraph(tokens[1], tokens[2]);
+        return "ok";
+    }
+    if (command == "unload" && tokens.size() == 2) {
+        unique_lock<shared_mutex> lock(graphs_mutex_);
+        if (graphs_.erase(tokens[1]) == 0) {
+            throw invalid_argument("unknown graph '" + tokens[1] + "'");
+        }
+        return "ok";
+    }
+    if (command == "graphs" && tokens.size() == 1) {
+        shared_lock<shared_mutex> lock(graphs_mutex_);
+        string response = "ok " + to_string(graphs_.size());
+        for (const auto &graph : graphs_) {
+            response += " " + graph.first;
+        }
+        return response;
+    }
+    if ((command == "score" || command == "stats" || command == "paths") &&
+        (tokens.size() == 3 || tokens.size() == 5)) {
+        LoadedGraph graph = findGraph(tokens[1]);
+        int penalty = parseInt(tokens[2], "penalty");
+        int match = 1;
+        int non_match = -2;
+        if (tokens.size() == 5) {
+            match = parseInt(tokens[3], "match");
+            non_match = parseInt(tokens[4], "non_match");
+        }
+        if (graph.index_width == IndexWidth::INT32) {
+            return runQuery(worker.engine, cache_.get(),
+                            move(graph.eds_segments), graph.fingerprint,
+                            command, penalty, match, non_match);
+        }
+        return runQuery(worker.engine_64, cache_.get(),
+                        move(graph.eds_segments), graph.fingerprint, command,
+                        penalty, match, non_match);
+    }
+    throw invalid_argument("invalid request '" + request + "'");
+}
+
+void QueryServer::requestShutdown() {
+    shutdown_requested_ = true;
+    int listen_fd = listen_fd_;
+    if (listen_fd >= 0) {
+        // Wakes up the `accept()` in `serveUnixSocket()`.
+        shutdown(listen_fd, SHUT_RDWR);
+    }
+}
+
+void QueryServer::serveStream(int in_fd, int out_fd) {
+    // The responses are written by a separate thread in the order of the
+    // requests, while the next requests are already being executed.
+    mutex responses_mutex;
+    condition_variable responses_cv;
+    deque<future<string>> responses;
+    bool input_done = false;
+
+    thread writer([&] {
+        bool output_ok = true;
+        while (true) {
+            future<string> response;
+            {
+                unique_lock<mutex> lock(responses_mutex);
+                responses_cv.wait(
+                    lock, [&] { return input_done || !responses.empty(); });
+                if (responses.empty()) {
+                    return;
+                }
+                response = move(responses.front());
+                responses.pop_front();
+            }
+            // Keep waiting for the responses after an error, the requests
+            // still reference `responses`.
+            string line = response.get() + "\n";
+            output_ok = output_ok && writeAll(out_fd, line);
+        }
+    });
+    auto push = [&](future<string> response) {
+        {
+            lock_guard<mutex> lock(responses_mutex);
+            responses.push_back(move(response));
+        }
+        responses_cv.notify_one();
+    };
+
+    LineReader reader(in_fd);
+    for (string line; reader.getLine(line);) {
+        string command;
+        istringstream(line) >> command;
+        if (command.empty()) {
+            continue;
+        }
+        if (command == "quit" || command == "shutdown") {
+            if (command == "shutdown") {
+                requestShutdown();
+            }
+            promise<string> ok;
+            ok.set_value("ok");
+            push(ok.get_future());
+            break;
+        }
+        push(submit(line));
+    }
+    {
+        lock_guard<mutex> lock(responses_mutex);
+        input_done = true;
+    }
+    responses_cv.notify_one();
+    writer.join();
+}
+
+void QueryServer::serveUnixSocket(const string &socket_path) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        throw runtime_error("socket path '" + socket_path + "' is too long");
+    }
+    strncpy(address.sun_path, socket_path.c_str(),
+            sizeof(address.sun_path) - 1);
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        throw runtime_error(string("cannot create socket: ") +
+                            strerror(errno));
+    }
+    unlink(socket_path.c_str());
+    if (bind(listen_fd, reinterpret_cast<sockaddr *>(&address),
+             sizeof(address)) < 0 ||
+        listen(listen_fd, SOMAXCONN) < 0) {
+        string error = strerror(errno);
+        close(listen_fd);
+        throw runtime_error("cannot listen on '" + socket_path + "': " + error);
+    }
+    listen_fd_ = listen_fd;
+
+    // The connection threads are detached so that finished ones do not pile
+    // up, the server waits for the open connections before it returns.
+    mutex connections_mutex;
+    condition_variable connections_cv;
+    set<int> open_connections;
+    while (!shutdown_requested_) {
+        int connection = accept(listen_fd, nullptr, nullptr);
+        if (connection < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            break;
+        }
+        {
+            lock_guard<mutex> lock(connections_mutex);
+            open_connections.insert(connection);
+        }
+        thread([&, connection] {
+            serveStream(connection, connection);
+            lock_guard<mutex> lock(connections_mutex);
+            open_connections.erase(connection);
+            close(connection);
+            // Notified under the lock, the waiting server cannot destroy the
+            // condition variable before.
+            connections_cv.notify_all();
+        }).detach();
+    }
+    {
+        // Let the remaining connections finish their requests.
+        unique_lock<mutex> lock(connections_mutex);
+        for (int connection : open_connections) {
+            shutdown(connection, SHUT_RD);
+        }
+        connections_cv.wait(lock, [&] { return open_connections.empty(); });
+    }
+    listen_fd_ = -1;
+    close(listen_fd);
+    unlink(socket_path.c_str());
+}
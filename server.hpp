@@ -0,0 +1,114 @@
+#ifndef MAXSCOREPATH_SERVER_HEADER
+#define MAXSCOREPATH_SERVER_HEADER
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "engine.hpp"
+#include "result_cache.hpp"
+#include "utility_func.hpp"
+
+using namespace std;
+
+// This file contains a long-running query server. The graphs are loaded and
+// parsed once and stay in memory, so a query on a loaded graph costs only the
+// DP and the traceback. The loaded graphs are read-only and shared between the
+// worker threads, every worker has its own `MaxScorePathsEngine` whose arena
+// stays warm between the queries.
+//
+// The server speaks a line protocol, on stdin/stdout or on the connections of
+// a Unix domain socket. Every request is one line, and is answered by a line
+// starting with `ok` or `error <message>`. The requests of one connection are
+// executed concurrently, the responses are written in the order of the
+// requests.
+//
+// Requests:
+// - `load <graph> <file>`: loads EDS text from `file` under the name `graph`.
+// - `unload <graph>`: frees the graph `graph`.
+// - `graphs`: responds `ok <count> <graph>...` with the loaded graphs.
+// - `score <graph> <penalty> [<match> <non_match>]`: responds `ok <score>`.
+// - `stats <graph> <penalty> [<match> <non_match>]`: responds
+//   `ok <score> <number of paths> <cover percentage> <average path length>`.
+// - `paths <graph> <penalty> [<match> <non_match>]`: responds
+//   `ok <score> <number of paths>` followed by one line per path, in the format
+//   of `printPaths()`.
+// - `quit`: closes the connection.
+// - `shutdown`: stops the Unix domain socket server.
+// The GC content scoring defaults to `match` 1 and `non_match` -2.
+
+class QueryServer {
+   public:
+    // Starts `num_workers` worker threads, at least one.
+    explicit QueryServer(int num_workers = thread::hardware_concurrency());
+    QueryServer(const QueryServer &) = delete;
+    QueryServer &operator=(const QueryServer &) = delete;
+    ~QueryServer();
+
+    // Answers the queries from `cache` when possible and stores the new
+    // results into it. Must be set before serving.
+    void setResultCache(shared_ptr<ResultCache> cache);
+
+    // Loads and parses the EDS text from `file_path` under the name `name`.
+    // Throws `runtime_error` if the file cannot be read.
+    void loadGraph(const string &name, const string &file_path);
+
+    // Executes one request on a worker thread and returns the response,
+    // without the trailing new line. Thread-safe.
+    string handleRequest(const string &request);
+
+    // Answers the requests read from `in_fd` on `out_fd` until the end of the
+    // input or a `quit` request.
+    void serveStream(int in_fd, int out_fd);
+
+    // Listens on a Unix domain socket on `socket_path` and serves every
+    // connection as in `serveStream()` until a `shutdown` request.
+    // Throws `runtime_error` if the socket cannot be created.
+    void serveUnixSocket(const string &socket_path);
+
+   private:
+    // Engines of a worker thread, one per coordinate type.
+    struct Worker {
+        MaxScorePathsEngine engine;
+        BasicMaxScorePathsEngine<int64_t> engine_64;
+    };
+    struct LoadedGraph {
+        shared_ptr<const eds_matrix> eds_segments;
+        IndexWidth index_width;
+        uint64_t fingerprint;
+    };
+    struct Task {
+        string request;
+        promise<string> response;
+    };
+
+    future<string> submit(string request);
+    void workerLoop();
+    string execute(const string &request, Worker &worker);
+    LoadedGraph findGraph(const string &name);
+    void requestShutdown();
+
+    shared_ptr<ResultCache> cache_;
+
+    shared_mutex graphs_mutex_;
+    map<string, LoadedGraph> graphs_;
+
+    mutex tasks_mutex_;
+    condition_variable tasks_cv_;
+    deque<Task> tasks_;
+    bool stopping_ = false;
+    vector<thread> workers_;
+
+    atomic<bool> shutdown_requested_{false};
+    atomic<int> listen_fd_{-1};
+};
+
+#endif
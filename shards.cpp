@@ -0,0 +1,381 @@
+#include "shards.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include "binary_file.hpp"
+
+using namespace std;
+
+namespace {
+
+// Identify the files of a split graph and their format version.
+const uint32_t MANIFEST_MAGIC = 0x4d53534d;    // "MSSM"
+const uint32_t TRANSFER_MAGIC = 0x5453534d;    // "MSST"
+const uint32_t BOUNDARIES_MAGIC = 0x4253534d;  // "MSSB"
+const uint32_t TRACEBACK_MAGIC = 0x4b53534d;   // "MSSK"
+const uint32_t SHARD_FILE_VERSION = 1;
+
+string shardPath(const string &directory, int shard, const string &extension) {
+    return directory + "/shard_" + to_string(shard) + extension;
+}
+
+// Writes the file `path` with `write(output)`, through a temporary file.
+void writeFile(const string &path, const function<void(ostream &)> &write) {
+    string temp_path = path + ".tmp" + to_string(getpid());
+    {
+        ofstream output(temp_path, ios::binary | ios::trunc);
+        write(output);
+        if (!output.flush()) {
+            output.close();
+            error_code error;
+            filesystem::remove(temp_path, error);
+            throw runtime_error("cannot write '" + path + "'");
+        }
+    }
+    filesystem::rename(temp_path, path);
+}
+
+// Reads the values of one file, throws `runtime_error` if it is damaged.
+class FileReader {
+   public:
+    FileReader(const string &path, uint32_t magic)
+        : path_(path), input_(path, ios::binary) {
+        if (!input_) {
+            throw runtime_error("cannot read '" + path + "'");
+        }
+        if (read<uint32_t>() != magic ||
+            read<uint32_t>() != SHARD_FILE_VERSION) {
+            throw runtime_error("file '" + path + "' is not a shard file");
+        }
+    }
+
+    template <typename T>
+    T read() {
+        T value;
+        if (!readValue(input_, value)) {
+            throw runtime_error("file '" + path_ + "' is truncated");
+        }
+        return value;
+    }
+
+    // Checks that `value` is `expected`, a value of an earlier step.
+    template <typename T>
+    void expect(const T &value, const T &expected) {
+        if (value != expected) {
+            throw runtime_error("file '" + path_ +
+                                "' belongs to another split or merge");
+        }
+    }
+
+   private:
+    string path_;
+    ifstream input_;
+};
+
+void writeIntervals(ostream &output, const vector<PathInterval> &intervals) {
+    writeValue(output, uint64_t(intervals.size()));
+    output.write(reinterpret_cast<const char *>(intervals.data()),
+                 intervals.size() * sizeof(PathInterval));
+}
+
+vector<PathInterval> readIntervals(FileReader &reader) {
+    // The counts are not trusted for preallocation, a damaged file ends with
+    // a failed read.
+    uint64_t num_intervals = reader.read<uint64_t>();
+    vector<PathInterval> intervals;
+    for (uint64_t i = 0; i < num_intervals; i++) {
+        intervals.push_back(reader.read<PathInterval>());
+    }
+    return intervals;
+}
+
+// Returns the paths of the shard in the coordinates of the graph, the first
+// segment of the shard is `segment_offset` in the graph.
+compact_paths toGraphPaths(const vector<vector<Vertex64>> &paths,
+                           int64_t segment_offset) {
+    compact_paths compressed = compressPaths(paths);
+    for (auto &intervals : compressed) {
+        for (auto &interval : intervals) {
+            interval.segment += segment_offset;
+        }
+    }
+    return compressed;
+}
+
+// The EDS text of `segments`, the inverse of `EDSToMatrix()`.
+string segmentsToEDS(const eds_matrix &segments) {
+    string EDS;
+    for (const auto &segment : segments) {
+        if (segment.size() == 1) {
+            EDS += segment[0];
+            continue;
+        }
+        EDS += '{';
+        for (size_t layer = 0; layer < segment.size(); layer++) {
+            EDS += segment[layer];
+            EDS += layer + 1 < segment.size() ? ',' : '}';
+        }
+    }
+    return EDS;
+}
+
+int numShards(const ShardManifest &manifest) {
+    return manifest.first_segments.size();
+}
+
+void checkShard(const ShardManifest &manifest, int shard) {
+    if (shard < 0 || shard >= numShards(manifest)) {
+        throw invalid_argument("no shard " + to_string(shard) + " in " +
+                               to_string(numShards(manifest)) + " shards");
+    }
+}
+
+// The cells of p of every shard and the score, see `mergeShardTransfers()`.
+struct ShardBoundaries {
+    vector<boundary_cells> cells;
+    int64_t score;
+};
+
+ShardBoundaries readShardBoundaries(const string &directory,
+                                    const ShardManifest &manifest) {
+    FileReader reader(directory + "/boundaries", BOUNDARIES_MAGIC);
+    reader.expect(reader.read<int64_t>(), (int64_t)numShards(manifest));
+    ShardBoundaries boundaries;
+    for (int shard = 0; shard < numShards(manifest); shard++) {
+        boundaries.cells.push_back(reader.read<boundary_cells>());
+    }
+    boundaries.score = reader.read<int64_t>();
+    return boundaries;
+}
+
+}  // namespace
+
+ShardManifest cutShards(const eds_matrix &eds_segments, int num_shards,
+                        int match, int non_match, int penalty,
+                        const string &directory) {
+    if (num_shards < 1) {
+        throw invalid_argument("Needs at least one shard.");
+    }
+    ShardManifest manifest;
+    manifest.match = match;
+    manifest.non_match = non_match;
+    manifest.penalty = penalty;
+    manifest.num_segments = eds_segments.size();
+    int64_t num_vertices = linearizedGraphLength(eds_segments);
+    manifest.first_segments = checkpointBlocks(
+        eds_segments, max<int64_t>(1, (num_vertices + num_shards - 1) /
+                                          num_shards));
+
+    filesystem::create_directories(directory);
+    for (int shard = 0; shard < numShards(manifest); shard++) {
+        int64_t end_segment = shard + 1 < numShards(manifest)
+                                  ? manifest.first_segments[shard + 1]
+                                  : manifest.num_segments;
+        string EDS = segmentsToEDS(shardSegments(
+            eds_segments, manifest.first_segments[shard], end_segment));
+        writeFile(shardPath(directory, shard, ".eds"),
+                  [&](ostream &output) { output << EDS; });
+    }
+    // Written last, the shards are complete when it exists.
+    writeFile(directory + "/manifest", [&](ostream &output) {
+        writeValue(output, MANIFEST_MAGIC);
+        writeValue(output, SHARD_FILE_VERSION);
+        writeValue(output, manifest.match);
+        writeValue(output, manifest.non_match);
+        writeValue(output, manifest.penalty);
+        writeValue(output, manifest.num_segments);
+        writeValue(output, int64_t(numShards(manifest)));
+        for (int64_t first_segment : manifest.first_segments) {
+            writeValue(output, first_segment);
+        }
+    });
+    return manifest;
+}
+
+ShardManifest readShardManifest(const string &directory) {
+    FileReader reader(directory + "/manifest", MANIFEST_MAGIC);
+    ShardManifest manifest;
+    manifest.match = reader.read<int>();
+    manifest.non_match = reader.read<int>();
+    manifest.penalty = reader.read<int>();
+    manifest.num_segments = reader.read<int64_t>();
+    int64_t num_shards = reader.read<int64_t>();
+    for (int64_t shard = 0; shard < num_shards; shard++) {
+        manifest.first_segments.push_back(reader.read<int64_t>());
+    }
+    return manifest;
+}
+
+eds_matrix readShard(const string &directory, int shard) {
+    string path = shardPath(directory, shard, ".eds");
+    ifstream input(path, ios::binary);
+    if (!input) {
+        throw runtime_error("cannot read '" + path + "'");
+    }
+    stringstream EDS;
+    EDS << input.rdbuf();
+    return EDSToMatrix(EDS.str());
+}
+
+eds_matrix readShardedGraph(const string &directory) {
+    ShardManifest manifest = readShardManifest(directory);
+    eds_matrix eds_segments;
+    eds_segments.reserve(manifest.num_segments);
+    for (int shard = 0; shard < numShards(manifest); shard++) {
+        eds_matrix segments = readShard(directory, shard);
+        // Without the segment of p.
+        eds_segments.insert(eds_segments.end(),
+                            make_move_iterator(segments.begin() + (shard > 0)),
+                            make_move_iterator(segments.end()));
+    }
+    return eds_segments;
+}
+
+void writeShardTransfer(const string &directory, int shard) {
+    ShardManifest manifest = readShardManifest(directory);
+    checkShard(manifest, shard);
+    shard_transfer transfer = computeShardTransfer(
+        readShard(directory, shard), shard == 0, manifest.match,
+        manifest.non_match, manifest.penalty);
+    writeFile(shardPath(directory, shard, ".transfer"), [&](ostream &output) {
+        writeValue(output, TRANSFER_MAGIC);
+        writeValue(output, SHARD_FILE_VERSION);
+        writeValue(output, int64_t(shard));
+        writeValue(output, transfer);
+    });
+}
+
+int64_t mergeShardTransfers(const string &directory) {
+    ShardManifest manifest = readShardManifest(directory);
+    ShardBoundaries boundaries;
+    // The first shard does not depend on its p.
+    boundary_cells p = {0, NO_SCORE};
+    for (int shard = 0; shard < numShards(manifest); shard++) {
+        FileReader reader(shardPath(directory, shard, ".transfer"),
+                          TRANSFER_MAGIC);
+        reader.expect(reader.read<int64_t>(), (int64_t)shard);
+        boundaries.cells.push_back(p);
+        p = applyShardTransfer(reader.read<shard_transfer>(), p);
+    }
+    // The last vertex is an `EMPTY_STR` with the E continuation at 0, as in
+    // `SegmentWindow::score()`.
+    boundaries.score = max<int64_t>(p[0], 0);
+    writeFile(directory + "/boundaries", [&](ostream &output) {
+        writeValue(output, BOUNDARIES_MAGIC);
+        writeValue(output, SHARD_FILE_VERSION);
+        writeValue(output, int64_t(numShards(manifest)));
+        for (const auto &cells : boundaries.cells) {
+            writeValue(output, cells);
+        }
+        writeValue(output, boundaries.score);
+    });
+    return boundaries.score;
+}
+
+int64_t readShardedScore(const string &directory) {
+    return readShardBoundaries(directory, readShardManifest(directory)).score;
+}
+
+void writeShardTraceback(const string &directory, int shard) {
+    ShardManifest manifest = readShardManifest(directory);
+    checkShard(manifest, shard);
+    boundary_cells p = readShardBoundaries(directory, manifest).cells[shard];
+    auto tracebacks =
+        traceBackShard(readShard(directory, shard), shard == 0, p,
+                       manifest.match, manifest.non_match, manifest.penalty);
+    // The shards after the first one start with the segment of p.
+    int64_t segment_offset = manifest.first_segments[shard] - (shard > 0);
+    writeFile(shardPath(directory, shard, ".traceback"), [&](ostream &output) {
+        writeValue(output, TRACEBACK_MAGIC);
+        writeValue(output, SHARD_FILE_VERSION);
+        writeValue(output, int64_t(shard));
+        writeValue(output, p);
+        for (const auto &traceback : tracebacks) {
+            writeValue(output, int32_t(traceback.p_exit));
+            writeValue(output, uint64_t(traceback.continued_paths.size()));
+            for (int64_t path : traceback.continued_paths) {
+                writeValue(output, path);
+            }
+            writeValue(output, traceback.open_path_continues);
+            compact_paths paths =
+                toGraphPaths(traceback.paths, segment_offset);
+            writeValue(output, uint64_t(paths.size()));
+            for (const auto &intervals : paths) {
+                writeIntervals(output, intervals);
+            }
+            writeIntervals(output,
+                           toGraphPaths({traceback.open_path}, segment_offset)
+                               .front());
+        }
+    });
+}
+
+compact_paths stitchShardPaths(const string &directory) {
+    ShardManifest manifest = readShardManifest(directory);
+    ShardBoundaries boundaries = readShardBoundaries(directory, manifest);
+    compact_paths paths;
+    // The state of the traceback at q of the current shard, and the path open
+    // there, as at the end of the graph for the last shard.
+    ShardExit exit = EXIT_CLOSED;
+    vector<PathInterval> open_path;
+    for (int shard = numShards(manifest) - 1; shard >= 0; shard--) {
+        FileReader reader(shardPath(directory, shard, ".traceback"),
+                          TRACEBACK_MAGIC);
+        reader.expect(reader.read<int64_t>(), (int64_t)shard);
+        reader.expect(reader.read<boundary_cells>(),
+                      boundaries.cells[shard]);
+        ShardExit next_exit = EXIT_CLOSED;
+        vector<PathInterval> next_open_path;
+        for (int traceback = EXIT_CLOSED; traceback < NUM_SHARD_EXITS;
+             traceback++) {
+            bool is_taken = traceback == exit;
+            ShardExit p_exit = (ShardExit)reader.read<int32_t>();
+            uint64_t num_continued_paths = reader.read<uint64_t>();
+            vector<int64_t> continued_paths;
+            for (uint64_t i = 0; i < num_continued_paths; i++) {
+                continued_paths.push_back(reader.read<int64_t>());
+            }
+            bool open_path_continues = reader.read<bool>();
+            uint64_t num_paths = reader.read<uint64_t>();
+            auto continued_path = continued_paths.begin();
+            for (uint64_t path = 0; path < num_paths; path++) {
+                vector<PathInterval> intervals = readIntervals(reader);
+                if (!is_taken) {
+                    continue;
+                }
+                // The path open at q continues after the vertices of the
+                // shard, in the next shard.
+                if (continued_path != continued_paths.end() &&
+                    *continued_path == (int64_t)path) {
+                    intervals.insert(intervals.end(), open_path.begin(),
+                                     open_path.end());
+                    continued_path++;
+                }
+                paths.push_back(move(intervals));
+            }
+            vector<PathInterval> intervals = readIntervals(reader);
+            if (is_taken) {
+                next_exit = p_exit;
+                next_open_path = move(intervals);
+                if (open_path_continues) {
+                    next_open_path.insert(next_open_path.end(),
+                                          open_path.begin(), open_path.end());
+                }
+            }
+        }
+        exit = next_exit;
+        open_path = move(next_open_path);
+    }
+    if (!open_path.empty()) {
+        paths.push_back(move(open_path));
+    }
+    return paths;
+}
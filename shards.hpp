@@ -0,0 +1,69 @@
+#ifndef MAXSCOREPATH_SHARDS_HEADER
+#define MAXSCOREPATH_SHARDS_HEADER
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "result_cache.hpp"
+#include "utility_func.hpp"
+
+using namespace std;
+
+// This file contains the split of a graph into shards that are filled on
+// different machines, and the merge of their results, see
+// `computeShardTransfer()`. The jobs coordinate only through the files of one
+// directory, so that a job scheduler can run them:
+// - `cutShards()` writes every shard as EDS text into `shard_<k>.eds` and the
+//   parameters into `manifest`, on one machine.
+// - `writeShardTransfer()` writes the transfer of shard k into
+//   `shard_<k>.transfer`, one job per shard.
+// - `mergeShardTransfers()` composes the transfers into the cells of p of
+//   every shard, `boundaries`, and returns the score, on one machine.
+// - `writeShardTraceback()` fills shard k again from its p and writes its
+//   tracebacks into `shard_<k>.traceback`, one job per shard.
+// - `stitchShardPaths()` joins the tracebacks into the paths of the graph, the
+//   same as `getPaths()`, on one machine.
+// Every file is written into a temporary file and renamed, so a failed job
+// leaves no partial file behind and can be run again. The functions throw
+// `runtime_error` if a file of an earlier step is missing or damaged.
+
+// The parameters of a split graph.
+struct ShardManifest {
+    int match;
+    int non_match;
+    int penalty;
+    // The first segment of every shard in the graph.
+    vector<int64_t> first_segments;
+    // The segments of the graph.
+    int64_t num_segments;
+};
+
+// Cuts `eds_segments` into `num_shards` shards of about the same number of
+// vertices, fewer if the graph has not enough bubbles, and writes them and the
+// manifest into `directory`, which is created if needed. Returns the manifest.
+ShardManifest cutShards(const eds_matrix &eds_segments, int num_shards,
+                        int match, int non_match, int penalty,
+                        const string &directory);
+
+ShardManifest readShardManifest(const string &directory);
+
+// Reads shard `shard` of `directory`, see `shardSegments()`.
+eds_matrix readShard(const string &directory, int shard);
+
+// Reads the graph of all shards of `directory`.
+eds_matrix readShardedGraph(const string &directory);
+
+void writeShardTransfer(const string &directory, int shard);
+
+// Returns the score of the graph.
+int64_t mergeShardTransfers(const string &directory);
+
+// Returns the score of the graph that `mergeShardTransfers()` wrote.
+int64_t readShardedScore(const string &directory);
+
+void writeShardTraceback(const string &directory, int shard);
+
+compact_paths stitchShardPaths(const string &directory);
+
+#endif
@@ -1,9 +1,38 @@
 #include <gtest/gtest.h>
 
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <random>
 #include <set>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef MAXSCOREPATH_WITH_ZSTD
+#include <zstd.h>
+#endif
 
+#include "../compressed_input.hpp"
+#include "../engine.hpp"
+#include "../marginal_table.hpp"
+#include "../maxscorepaths.h"
+#include "../memory_plan.hpp"
+#include "../path_index.hpp"
+#include "../path_writer.hpp"
+#include "../pipeline.hpp"
+#include "../result_cache.hpp"
+#include "../server.hpp"
+#include "../shards.hpp"
+#include "../vcf_loader.hpp"
 #include "../utility_func.hpp"
+#include "../weight_track.hpp"
 
 using namespace std;
 
@@ -37,6 +66,66 @@ TEST(InputProcessing, EDSToMatrixTest) {
     EXPECT_EQ(eds_segments, expected);
 }
 
+TEST(InputProcessing, EDSToMatrixBlocksTest) {
+    // Structural characters at the ends of the 64-byte blocks of the parser.
+    string first = "_" + string(62, 'A');
+    eds_matrix expected = {
+        {first}, {"C", "_"}, {string(62, 'A')}, {"G", "T"}, {"_"}};
+    EXPECT_EQ(EDSToMatrix(first + "{C,}" + string(62, 'A') + "{G,T}_"),
+              expected);
+    expected = {{"_"}, {"_", "_"}, {"_"}, {string(64, 'C'), "G"}, {"_"}};
+    EXPECT_EQ(EDSToMatrix("_{,}{" + string(64, 'C') + ",G}_"), expected);
+}
+
+TEST(InputProcessing, EDSToMatrixThreadsTest) {
+    // Large enough for three chunks of the parallel parser.
+    const int repeats = 3000;
+    string EDS = "_";
+    for (int i = 0; i < repeats; i++) {
+        EDS += string(4200 + i % 7, "ACGT"[i % 4]) + "{GG,A,}{T,C}";
+    }
+    EDS += "_";
+    eds_matrix eds_segments = EDSToMatrix(EDS);
+    // A deterministic segment, two bubbles and their separator per repeat.
+    EXPECT_EQ(eds_segments.size(), 4 * repeats + 1);
+    EXPECT_EQ(eds_segments[4 * 1000 + 1], vector<string>({"GG", "A", "_"}));
+    for (int num_threads : {2, 3, 8}) {
+        EXPECT_EQ(EDSToMatrix(EDS, num_threads), eds_segments);
+    }
+}
+
+TEST(InputProcessing, EDSToMatrixMalformedTest) {
+    for (string EDS : {"A}B", "A,B", "{A{B}", "{A,B", "A{B}}", "{A,B}{C",
+                       "_{A,}C,"}) {
+        EXPECT_THROW(EDSToMatrix(EDS), invalid_argument) << EDS;
+    }
+    try {
+        EDSToMatrix("AC{G,T}A}");
+        FAIL();
+    } catch (const invalid_argument &e) {
+        EXPECT_NE(string(e.what()).find("offset 8"), string::npos);
+    }
+    // Found by the parallel parser in any chunk.
+    string EDS = "_";
+    for (int i = 0; i < 3000; i++) {
+        EDS += string(4200, 'A') + "{GG,A,}";
+    }
+    for (string error : {"{", "}", ","}) {
+        // In the deterministic segments at the start and in the middle, and
+        // at the end.
+        for (size_t position :
+             {size_t(2), size_t(1 + 1500 * 4207 + 100), EDS.size()}) {
+            string malformed = EDS;
+            malformed.insert(position, error);
+            for (int num_threads : {1, 3}) {
+                EXPECT_THROW(EDSToMatrix(malformed, num_threads),
+                             invalid_argument)
+                    << error << " " << position << " " << num_threads;
+            }
+        }
+    }
+}
+
 TEST(InputProcessing, LinearizedGraphLengthTest) {
     string EDS =
         "_GG{AGAA,GGGA,,ACCCCC}{AG,G}AGG{A,G}{C,}{A,AG}G{A,GA,CCC}{,A}_";
@@ -83,6 +172,26 @@ class PathFindingTest : public testing::Test {
         score = findMaxScoringPaths(eds_segments, weights, scores, choices,
                                     penalty);
         paths = getPaths(eds_segments, scores, choices);
+
+        // The run-length DP finds the same paths.
+        auto tables = initRunLengthTables(weights);
+        EXPECT_EQ(findMaxScoringPaths(eds_segments, weights, tables, penalty),
+                  score);
+        vector<vector<Vertex>> run_length_paths;
+        getPaths(eds_segments, weights, tables, run_length_paths);
+        EXPECT_EQ(run_length_paths, paths);
+
+        // So do the score-only DP and the checkpointed DP with blocks of any
+        // size.
+        EXPECT_EQ(findMaxScore<int>(eds_segments, weights, penalty), score);
+        for (int64_t block_vertices : {1, 4, 1000}) {
+            vector<vector<Vertex>> checkpointed_paths;
+            EXPECT_EQ(findMaxScoringPathsCheckpointed<int>(
+                          eds_segments, weights, penalty, block_vertices,
+                          checkpointed_paths),
+                      score);
+            EXPECT_EQ(checkpointed_paths, paths);
+        }
     }
 
     int score;
@@ -408,4 +517,1903 @@ TEST_F(PathFindingTest, Mix07) {
                      Vertex(4, 0, 4)});
     EXPECT_EQ(set<vector<Vertex>>(this->paths.begin(), this->paths.end()),
               expected);
-}
\ No newline at end of file
+}
+
+TEST_F(PathFindingTest, WideBubble01) {
+    GetPaths("_GG{T,T,T,T,T,T,T,T,T,T,T,T,T,T,T,T,GGGA,T}_");
+    EXPECT_EQ(this->score, 3);
+    set<vector<Vertex>> expected;
+    expected.insert({Vertex(0, 0, 1), Vertex(0, 0, 2), Vertex(1, 16, 0),
+                     Vertex(1, 16, 1), Vertex(1, 16, 2)});
+    EXPECT_EQ(set<vector<Vertex>>(this->paths.begin(), this->paths.end()),
+              expected);
+}
+
+TEST_F(PathFindingTest, WideBubble02) {
+    GetPaths(
+        "_GCA{AT,GC,CCG,A,TT,GG,CA,TA,AA,C,T,GGT,GA,CT,TG,AG,GCGC,TCC,GG}"
+        "CC_");
+    EXPECT_EQ(this->score, 6);
+    set<vector<Vertex>> expected;
+    expected.insert({Vertex(0, 0, 1), Vertex(0, 0, 2), Vertex(0, 0, 3),
+                     Vertex(1, 1, 0), Vertex(1, 1, 1), Vertex(2, 0, 0),
+                     Vertex(2, 0, 1), Vertex(2, 0, 2)});
+    expected.insert({Vertex(1, 2, 0), Vertex(1, 2, 1), Vertex(1, 2, 2)});
+    expected.insert({Vertex(1, 5, 0), Vertex(1, 5, 1)});
+    expected.insert({Vertex(1, 11, 0), Vertex(1, 11, 1)});
+    expected.insert({Vertex(1, 16, 0), Vertex(1, 16, 1), Vertex(1, 16, 2),
+                     Vertex(1, 16, 3)});
+    expected.insert({Vertex(1, 17, 1), Vertex(1, 17, 2)});
+    expected.insert({Vertex(1, 18, 0), Vertex(1, 18, 1)});
+    EXPECT_EQ(set<vector<Vertex>>(this->paths.begin(), this->paths.end()),
+              expected);
+}
+
+TEST(ScoreWidth, SelectScoreWidthTest) {
+    eds_matrix eds_segments = EDSToMatrix("_GG{AAGG,GGA}_");
+    weight_matrix weights = getGCContentWeights(eds_segments, 1, -1);
+    EXPECT_EQ(selectScoreWidth(eds_segments, weights, 2), ScoreWidth::INT16);
+    weights = getGCContentWeights(eds_segments, 100000, -1);
+    EXPECT_EQ(selectScoreWidth(eds_segments, weights, 2), ScoreWidth::INT32);
+    weights = getGCContentWeights(eds_segments, INT_MAX, INT_MIN + 1);
+    EXPECT_EQ(selectScoreWidth(eds_segments, weights, 2), ScoreWidth::INT64);
+    EXPECT_EQ(selectIndexWidth(eds_segments), IndexWidth::INT32);
+}
+
+TEST(ScoreWidth, NarrowScoresTest) {
+    eds_matrix eds_segments =
+        EDSToMatrix("_AG{GGG,,CCC}{AG,GCGG,AA}A{A,G}{G,CC}{AAAA,}_");
+    weight_matrix weights = getGCContentWeights(eds_segments, 1, -1);
+
+    score_matrix scores = initScoreMatrix(weights);
+    score_matrix choices = initScoreMatrix(weights);
+    int score = findMaxScoringPaths(eds_segments, weights, scores, choices, 2);
+    auto paths = getPaths(eds_segments, scores, choices);
+
+    auto scores_16 = initScoreMatrix<int16_t>(weights);
+    auto choices_16 = initScoreMatrix<int16_t>(weights);
+    EXPECT_EQ(findMaxScoringPaths(eds_segments, weights, scores_16, choices_16,
+                                  2),
+              score);
+    EXPECT_EQ(getPaths(eds_segments, scores_16, choices_16), paths);
+
+    auto scores_64 = initScoreMatrix<int64_t>(weights);
+    auto choices_64 = initScoreMatrix<int64_t>(weights);
+    EXPECT_EQ((findMaxScoringPaths<int64_t, int64_t>(
+                  eds_segments, weights, scores_64, choices_64, 2)),
+              score);
+    auto paths_64 = getPaths<int64_t, int64_t>(eds_segments, scores_64,
+                                               choices_64);
+    ASSERT_EQ(paths_64.size(), paths.size());
+    for (int i = 0; i < paths.size(); i++) {
+        ASSERT_EQ(paths_64[i].size(), paths[i].size());
+        for (int j = 0; j < paths[i].size(); j++) {
+            EXPECT_EQ(paths_64[i][j], Vertex64(paths[i][j].segment,
+                                               paths[i][j].layer,
+                                               paths[i][j].index));
+        }
+    }
+}
+
+TEST(ScoreWidth, OverflowTest) {
+    eds_matrix eds_segments = EDSToMatrix("_GGGGGGGGGGGGGGGGGGG_");
+    weight_matrix weights = getGCContentWeights(eds_segments, 1000, -1);
+    auto scores = initScoreMatrix<int16_t>(weights);
+    auto choices = initScoreMatrix<int16_t>(weights);
+    EXPECT_THROW(
+        findMaxScoringPaths(eds_segments, weights, scores, choices, 2),
+        overflow_error);
+}
+
+vector<vector<Vertex>> toPaths(const pmr_paths<int> &pmr_paths) {
+    vector<vector<Vertex>> paths;
+    for (const auto &path : pmr_paths) {
+        paths.emplace_back(path.begin(), path.end());
+    }
+    return paths;
+}
+
+TEST(Engine, RepeatedRunsTest) {
+    eds_matrix eds_segments =
+        EDSToMatrix("_AG{GGG,,CCC}{AG,GCGG,AA}A{A,G}{G,CC}{AAAA,}_");
+    MaxScorePathsEngine engine;
+    engine.setGraph(eds_segments);
+
+    const TableLayout layouts[] = {TableLayout::RUN_LENGTH, TableLayout::FULL,
+                                   TableLayout::PACKED,
+                                   TableLayout::CHECKPOINTED,
+                                   TableLayout::SCORE_ONLY};
+    for (int run = 0; run < 10; run++) {
+        // Alternate the layouts of the tables.
+        TableLayout layout = layouts[run % 5];
+        engine.setTableLayout(layout);
+        for (int penalty : {0, 2, 10}) {
+            for (int non_match : {-1, -2}) {
+                weight_matrix weights =
+                    getGCContentWeights(eds_segments, 1, non_match);
+                score_matrix scores = initScoreMatrix(weights);
+                score_matrix choices = initScoreMatrix(weights);
+                int score = findMaxScoringPaths(eds_segments, weights, scores,
+                                                choices, penalty);
+                auto paths = getPaths(eds_segments, scores, choices);
+
+                engine.setGCContentScoring(1, non_match);
+                EXPECT_EQ(engine.run(penalty), score);
+                EXPECT_EQ(engine.scoreWidth(), ScoreWidth::INT16);
+                if (layout == TableLayout::SCORE_ONLY) {
+                    EXPECT_TRUE(engine.paths().empty());
+                } else {
+                    EXPECT_EQ(toPaths(engine.paths()), paths);
+                }
+            }
+        }
+    }
+    // The arena has grown to the size of one run and is reused since.
+    size_t arena_size = engine.arenaSize();
+    EXPECT_GT(arena_size, 0);
+    engine.run(2);
+    EXPECT_EQ(engine.arenaSize(), arena_size);
+}
+
+TEST(Engine, LoadGraphTest) {
+    string EDS = "_CG{A,CCC,GA,}ATA{A,}{GG,CC}A_";
+    eds_matrix eds_segments = EDSToMatrix(EDS);
+    weight_matrix weights = getGCContentWeights(eds_segments);
+    score_matrix scores = initScoreMatrix(weights);
+    score_matrix choices = initScoreMatrix(weights);
+    int score = findMaxScoringPaths(eds_segments, weights, scores, choices, 1);
+    auto paths = getPaths(eds_segments, scores, choices);
+
+    MaxScorePathsEngine engine(1 << 16);
+    engine.loadGraph(EDS);
+    EXPECT_EQ(engine.graph(), eds_segments);
+    EXPECT_EQ(engine.run(1), score);
+    EXPECT_EQ(toPaths(engine.paths()), paths);
+    EXPECT_EQ(pathCoverPercentage(engine.graph(), engine.paths()),
+              pathCoverPercentage(eds_segments, paths));
+    // The initial buffer is big enough for this graph.
+    EXPECT_EQ(engine.arenaSize(), 1 << 16);
+}
+
+TEST(Server, RequestsTest) {
+    string file_path = "../unit_tests/test_inputs/input_01.txt";
+    eds_matrix eds_segments = EDSToMatrix(readEDSFile(file_path));
+    weight_matrix weights = getGCContentWeights(eds_segments, 1, -1);
+    score_matrix scores = initScoreMatrix(weights);
+    score_matrix choices = initScoreMatrix(weights);
+    int score = findMaxScoringPaths(eds_segments, weights, scores, choices, 2);
+    auto paths = getPaths(eds_segments, scores, choices);
+
+    QueryServer server(2);
+    EXPECT_EQ(server.handleRequest("load g " + file_path), "ok");
+    EXPECT_EQ(server.handleRequest("graphs"), "ok 1 g");
+    EXPECT_EQ(server.handleRequest("score g 2 1 -1"),
+              "ok " + to_string(score));
+    string response = server.handleRequest("paths g 2 1 -1");
+    EXPECT_EQ(response.substr(0, response.find('\n')),
+              "ok " + to_string(score) + " " + to_string(paths.size()));
+    EXPECT_EQ(count(response.begin(), response.end(), '\n'), paths.size());
+
+    EXPECT_EQ(server.handleRequest("score h 2").rfind("error", 0), 0);
+    EXPECT_EQ(server.handleRequest("score g x").rfind("error", 0), 0);
+    EXPECT_EQ(server.handleRequest("load h missing.txt").rfind("error", 0), 0);
+    EXPECT_EQ(server.handleRequest("unload g"), "ok");
+    EXPECT_EQ(server.handleRequest("graphs"), "ok 0");
+}
+
+TEST(Server, ConcurrentRequestsTest) {
+    QueryServer server(4);
+    server.loadGraph("g", "../unit_tests/test_inputs/input_01.txt");
+    vector<string> expected;
+    for (int penalty = 0; penalty < 8; penalty++) {
+        expected.push_back(
+            server.handleRequest("stats g " + to_string(penalty)));
+    }
+
+    vector<thread> clients;
+    vector<vector<string>> responses(4);
+    for (int client = 0; client < 4; client++) {
+        clients.emplace_back([&, client] {
+            for (int penalty = 0; penalty < 8; penalty++) {
+                responses[client].push_back(
+                    server.handleRequest("stats g " + to_string(penalty)));
+            }
+        });
+    }
+    for (auto &client : clients) {
+        client.join();
+    }
+    for (const auto &client_responses : responses) {
+        EXPECT_EQ(client_responses, expected);
+    }
+}
+
+TEST(Server, StreamTest) {
+    QueryServer server(3);
+    server.loadGraph("g", "../unit_tests/test_inputs/input_01.txt");
+    string expected;
+    for (int penalty = 0; penalty < 5; penalty++) {
+        expected += server.handleRequest("score g " + to_string(penalty)) +
+                    "\n";
+    }
+
+    int requests[2];
+    int responses[2];
+    ASSERT_EQ(pipe(requests), 0);
+    ASSERT_EQ(pipe(responses), 0);
+    string input = "score g 0\nscore g 1\n\nscore g 2\r\nscore g 3\n"
+                   "score g 4\nquit\nscore g 5\n";
+    ASSERT_EQ(write(requests[1], input.data(), input.size()), input.size());
+    close(requests[1]);
+    server.serveStream(requests[0], responses[1]);
+    close(requests[0]);
+    close(responses[1]);
+
+    string output;
+    char buffer[256];
+    for (ssize_t bytes; (bytes = read(responses[0], buffer, 256)) > 0;) {
+        output.append(buffer, bytes);
+    }
+    close(responses[0]);
+    EXPECT_EQ(output, expected + "ok\n");
+}
+
+TEST(Server, UnixSocketTest) {
+    QueryServer server(2);
+    server.loadGraph("g", "../unit_tests/test_inputs/input_01.txt");
+    string expected = server.handleRequest("score g 1") + "\n";
+    string socket_path =
+        (filesystem::temp_directory_path() / "server_test.sock").string();
+    thread serving([&] { server.serveUnixSocket(socket_path); });
+
+    // Many short connections, the last one shuts the server down.
+    auto request = [&](const string &input, bool read_output = true) {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, socket_path.c_str(),
+                sizeof(address.sun_path) - 1);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        while (connect(fd, reinterpret_cast<sockaddr *>(&address),
+                       sizeof(address)) < 0) {
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+        EXPECT_EQ(write(fd, input.data(), input.size()), input.size());
+        string output;
+        char buffer[256];
+        for (ssize_t bytes;
+             read_output && (bytes = read(fd, buffer, 256)) > 0;) {
+            output.append(buffer, bytes);
+        }
+        close(fd);
+        return output;
+    };
+    for (int i = 0; i < 50; i++) {
+        EXPECT_EQ(request("score g 1\nquit\n"), expected + "ok\n");
+    }
+    // Clients that leave before their responses raise no SIGPIPE.
+    for (int i = 0; i < 10; i++) {
+        request("score g 1\nscore g 2\nscore g 3\n", false);
+    }
+    EXPECT_EQ(request("score g 1\nquit\n"), expected + "ok\n");
+    EXPECT_EQ(request("shutdown\n"), "ok\n");
+    serving.join();
+    EXPECT_FALSE(filesystem::exists(socket_path));
+}
+
+TEST(ResultCache, FingerprintTest) {
+    EXPECT_EQ(graphFingerprint(EDSToMatrix("_GG{AGAA,GGGA,,ACCCCC}_")),
+              graphFingerprint(EDSToMatrix("_GG{AGAA,GGGA,,ACCCCC}_")));
+    EXPECT_NE(graphFingerprint(EDSToMatrix("_GG{AGAA,GGGA,,ACCCCC}_")),
+              graphFingerprint(EDSToMatrix("_GG{AGAA,GGGA,,ACCCCA}_")));
+    EXPECT_NE(graphFingerprint(EDSToMatrix("_GG{AGAA,GGGA,,ACCCCC}_")),
+              graphFingerprint(EDSToMatrix("_GG{AGAAG,GGA,,ACCCCC}_")));
+}
+
+TEST(ResultCache, CompressPathsTest) {
+    vector<vector<Vertex>> paths = {
+        {{0, 0, 1}, {0, 0, 2}, {1, 1, 0}, {1, 1, 1}, {2, 0, 0}},
+        {{3, 0, 4}}};
+    compact_paths compressed = compressPaths(paths);
+    compact_paths expected = {{{0, 0, 1, 2}, {1, 1, 0, 1}, {2, 0, 0, 0}},
+                              {{3, 0, 4, 4}}};
+    EXPECT_EQ(compressed, expected);
+    EXPECT_EQ(expandPaths(compressed), paths);
+}
+
+TEST(ResultCache, StoreAndLookupTest) {
+    string directory = (filesystem::temp_directory_path() /
+                        ("maxscorepaths_cache_" + to_string(getpid())))
+                           .string();
+    filesystem::remove_all(directory);
+    eds_matrix eds_segments =
+        EDSToMatrix(readEDSFile("../unit_tests/test_inputs/input_01.txt"));
+    uint64_t fingerprint = graphFingerprint(eds_segments);
+    {
+        ResultCache cache(directory);
+        MaxScorePathsEngine engine;
+        engine.setGraph(eds_segments);
+        EXPECT_FALSE(cache.lookup({fingerprint, 1, -1, 2}));
+
+        PathsResult computed =
+            runCached(engine, &cache, fingerprint, 1, -1, 2);
+        optional<PathsResult> cached = cache.lookup({fingerprint, 1, -1, 2});
+        ASSERT_TRUE(cached);
+        EXPECT_EQ(cached->score, computed.score);
+        EXPECT_EQ(cached->paths, computed.paths);
+        EXPECT_EQ(cached->cover_percentage, computed.cover_percentage);
+        EXPECT_EQ(cached->average_length, computed.average_length);
+        EXPECT_EQ(computed.score, engine.run(2));
+        EXPECT_EQ(expandPaths(computed.paths), toPaths(engine.paths()));
+        EXPECT_FALSE(cache.lookup({fingerprint, 1, -1, 3}));
+        EXPECT_FALSE(cache.lookup({fingerprint + 1, 1, -1, 2}));
+
+        // A damaged file is a miss.
+        for (const auto &entry : filesystem::directory_iterator(directory)) {
+            filesystem::resize_file(entry.path(), 30);
+        }
+        EXPECT_FALSE(cache.lookup({fingerprint, 1, -1, 2}));
+    }
+    filesystem::remove_all(directory);
+    {
+        MaxScorePathsEngine engine;
+        engine.setGraph(eds_segments);
+        uint64_t result_size;
+        {
+            ResultCache cache(directory);
+            runCached(engine, &cache, fingerprint, 1, -1, 0);
+            result_size = cache.size();
+            EXPECT_GT(result_size, 0);
+        }
+        // Room for about two results, the least recently used goes first. The
+        // modification times order the results, the sleeps make them distinct.
+        ResultCache cache(directory, 2 * result_size + result_size / 2);
+        for (int penalty = 1; penalty < 4; penalty++) {
+            this_thread::sleep_for(chrono::milliseconds(20));
+            runCached(engine, &cache, fingerprint, 1, -1, penalty);
+            this_thread::sleep_for(chrono::milliseconds(20));
+            EXPECT_TRUE(cache.lookup({fingerprint, 1, -1, 0}));
+        }
+        EXPECT_LE(cache.size(), 2 * result_size + result_size / 2);
+        EXPECT_TRUE(cache.lookup({fingerprint, 1, -1, 3}));
+        EXPECT_FALSE(cache.lookup({fingerprint, 1, -1, 1}));
+    }
+    filesystem::remove_all(directory);
+}
+
+TEST(RunLength, RunLayoutTest) {
+    eds_matrix eds_segments = EDSToMatrix("_GGCAT{AGAAT,,CCTTTA}A_");
+    weight_matrix weights = getGCContentWeights(eds_segments);
+    auto tables = initRunLengthTables(weights);
+    ASSERT_EQ(tables.run_ends.size(), 3);
+    // _GGCAT: runs GGC and AT after the first vertex.
+    EXPECT_EQ(tables.run_ends[0][0], pmr::vector<int64_t>({0, 3, 5}));
+    EXPECT_EQ(tables.run_ends[1][0], pmr::vector<int64_t>({0, 1, 4}));
+    EXPECT_EQ(tables.run_ends[1][1], pmr::vector<int64_t>({0}));
+    EXPECT_EQ(tables.run_ends[1][2], pmr::vector<int64_t>({0, 1, 5}));
+    EXPECT_EQ(tables.run_ends[2][0], pmr::vector<int64_t>({0, 1}));
+    EXPECT_EQ(tables.scores[0][0].size(), 3);
+}
+
+TEST(RunLength, LongRunsTest) {
+    // Long runs of both weights, also directly after J vertices and on the
+    // layers of bubbles.
+    string at = string(40, 'A') + "TTATTA" + string(25, 'T');
+    string gc = string(30, 'G') + "CGCC" + string(50, 'C');
+    vector<string> graphs = {
+        "_" + gc + at + gc + "_",
+        "_" + at + "{" + gc + "," + at + "," + at + gc + "}" + at + "_",
+        "_GC{" + gc + ",G,}" + gc + at + "{A," + at + "}" + gc + "_",
+        "_{" + at + "G" + gc + "," + gc + "," + at + "}{,C}" + at + "G_"};
+    for (const auto &EDS : graphs) {
+        eds_matrix eds_segments = EDSToMatrix(EDS);
+        for (auto scoring : {make_pair(1, -1), make_pair(1, -2),
+                             make_pair(3, 1), make_pair(0, -3)}) {
+            weight_matrix weights = getGCContentWeights(
+                eds_segments, scoring.first, scoring.second);
+            for (int penalty : {0, 1, 2, 5, 10, 40}) {
+                score_matrix scores = initScoreMatrix(weights);
+                score_matrix choices = initScoreMatrix(weights);
+                int score = findMaxScoringPaths(eds_segments, weights, scores,
+                                                choices, penalty);
+                auto paths = getPaths(eds_segments, scores, choices);
+
+                auto tables = initRunLengthTables(weights);
+                EXPECT_EQ(
+                    findMaxScoringPaths(eds_segments, weights, tables, penalty),
+                    score);
+                vector<vector<Vertex>> run_length_paths;
+                getPaths(eds_segments, weights, tables, run_length_paths);
+                EXPECT_EQ(run_length_paths, paths);
+            }
+        }
+    }
+}
+
+TEST(RunLength, NegativePenaltyTest) {
+    eds_matrix eds_segments = EDSToMatrix("_GGCAT{AGAAT,,CCTTTA}A_");
+    weight_matrix weights = getGCContentWeights(eds_segments);
+    auto tables = initRunLengthTables(weights);
+    EXPECT_THROW(findMaxScoringPaths(eds_segments, weights, tables, -1),
+                 invalid_argument);
+}
+
+TEST(RunLength, BubbleClassesTest) {
+    // {A,T} and {T,A} have the same weights, {G,C} and {GGC,} occur once.
+    eds_matrix eds_segments =
+        EDSToMatrix("_GA{A,T}C{T,A}AG{G,C}T{GGC,}{A,T}_");
+    weight_matrix weights = getGCContentWeights(eds_segments);
+    auto tables = initRunLengthTables(weights);
+    EXPECT_EQ(tables.bubble_classes,
+              pmr::vector<int32_t>({-1, 0, -1, 0, -1, -1, -1, -1, -1, 0, -1}));
+}
+
+TEST(RunLength, RepeatedBubblesTest) {
+    // The same bubbles entered from start vertices with different scores.
+    string snps = "{A,G}T{A,G}GGGG{A,G}AAAAAAAA{A,G}";
+    string indels = "{GCGC,}AT{GCGC,}ATTTAT{GCGC,}GCCG{GCGC,}{,AT,GC}";
+    vector<string> graphs = {"_" + snps + snps + "_",
+                             "_C" + indels + "G" + snps + indels + "_",
+                             "_" + indels + indels + indels + "A_"};
+    for (const auto &EDS : graphs) {
+        eds_matrix eds_segments = EDSToMatrix(EDS);
+        for (auto scoring : {make_pair(1, -1), make_pair(1, -2),
+                             make_pair(2, 1), make_pair(0, -3)}) {
+            weight_matrix weights = getGCContentWeights(
+                eds_segments, scoring.first, scoring.second);
+            auto tables = initRunLengthTables(weights);
+            for (int penalty : {0, 1, 2, 3, 5, 10}) {
+                score_matrix scores = initScoreMatrix(weights);
+                score_matrix choices = initScoreMatrix(weights);
+                int score = findMaxScoringPaths(eds_segments, weights, scores,
+                                                choices, penalty);
+                auto paths = getPaths(eds_segments, scores, choices);
+
+                // The tables are reused with every penalty.
+                EXPECT_EQ(
+                    findMaxScoringPaths(eds_segments, weights, tables, penalty),
+                    score);
+                vector<vector<Vertex>> run_length_paths;
+                getPaths(eds_segments, weights, tables, run_length_paths);
+                EXPECT_EQ(run_length_paths, paths);
+            }
+        }
+    }
+}
+
+TEST(Checkpointed, BlocksTest) {
+    eds_matrix eds_segments =
+        EDSToMatrix("_GA{A,T}C{T,A}AG{G,C}T{GGC,}{A,T}_");
+    EXPECT_EQ(checkpointBlocks(eds_segments, 1000), vector<int64_t>({0}));
+    // Blocks start at the first bubble after at least 4 vertices.
+    EXPECT_EQ(checkpointBlocks(eds_segments, 4), vector<int64_t>({0, 3, 5, 9}));
+    EXPECT_EQ(checkpointBlocks(eds_segments, 1),
+              vector<int64_t>({0, 1, 3, 5, 7, 9}));
+}
+
+TEST(MemoryPlan, StatisticsTest) {
+    eds_matrix eds_segments = EDSToMatrix("_GGCAT{AGAAT,,CCTTTA}A_");
+    GraphStatistics statistics = computeGraphStatistics(eds_segments, 1, -2);
+    EXPECT_EQ(statistics.segments, 3);
+    EXPECT_EQ(statistics.layers, 5);
+    EXPECT_EQ(statistics.vertices, 20);
+    EXPECT_EQ(statistics.max_bubble_width, 3);
+    EXPECT_EQ(statistics.max_abs_weight, 2);
+    EXPECT_EQ(statistics.checkpoint_blocks, 1);
+    EXPECT_EQ(statistics.max_block_vertices, 20);
+
+    weight_matrix weights = getGCContentWeights(eds_segments, 1, -2);
+    auto tables = initRunLengthTables(weights);
+    int64_t run_columns = 0;
+    for (const auto &segment : tables.run_ends) {
+        for (const auto &run_ends : segment) {
+            run_columns += run_ends.size();
+        }
+    }
+    EXPECT_EQ(statistics.run_columns, run_columns);
+}
+
+TEST(MemoryPlan, EstimateTest) {
+    eds_matrix eds_segments =
+        EDSToMatrix("_AG{GGG,,CCC}{AG,GCGG,AA}AAAATTTTTGGCGC{A,G}{G,CC}_");
+    GraphStatistics statistics = computeGraphStatistics(eds_segments, 1, -2);
+
+    // The weights and the tables allocate exactly the estimated bytes.
+    PeakCountingResource resource;
+    weight_matrix weights =
+        getGCContentWeights(eds_segments, 1, -2, &resource);
+    MemoryEstimate full =
+        estimateMemory(statistics, TableLayout::FULL, ScoreWidth::INT32);
+    EXPECT_EQ(resource.peak(), full.weights);
+    {
+        PeakCountingResource tables_resource;
+        auto scores = initScoreMatrix<int32_t>(weights, &tables_resource);
+        auto choices = initScoreMatrix<int32_t>(weights, &tables_resource);
+        EXPECT_EQ(tables_resource.peak(), full.tables);
+    }
+    {
+        PeakCountingResource tables_resource;
+        auto tables = initRunLengthTables<int32_t>(weights, &tables_resource);
+        EXPECT_EQ(tables_resource.peak(),
+                  estimateMemory(statistics, TableLayout::RUN_LENGTH,
+                                 ScoreWidth::INT32)
+                      .tables);
+    }
+    MemoryEstimate packed =
+        estimateMemory(statistics, TableLayout::PACKED, ScoreWidth::INT32);
+    {
+        // The estimate adds the window of the DP.
+        PeakCountingResource tables_resource;
+        auto tables = initPackedTables<int32_t>(eds_segments, &tables_resource);
+        EXPECT_LT(tables_resource.peak(), packed.tables);
+        EXPECT_GT(tables_resource.peak() + 200, packed.tables);
+    }
+
+    // The layouts that keep less cells need less memory.
+    EXPECT_LT(packed.total(), full.total());
+    int64_t checkpointed =
+        estimateMemory(statistics, TableLayout::CHECKPOINTED, ScoreWidth::INT32)
+            .total();
+    int64_t score_only =
+        estimateMemory(statistics, TableLayout::SCORE_ONLY, ScoreWidth::INT32)
+            .total();
+    EXPECT_LT(checkpointed, full.total());
+    EXPECT_LT(score_only, checkpointed);
+}
+
+TEST(MemoryPlan, PlanExecutionTest) {
+    eds_matrix eds_segments = EDSToMatrix(
+        "_" + string(100, 'A') + "{" + string(50, 'C') + ",G}" +
+        string(100000, 'T') + "{A,C}" + string(100, 'G') + "_");
+    GraphStatistics statistics = computeGraphStatistics(eds_segments, 1, -2);
+    auto total = [&](TableLayout layout) {
+        return estimateMemory(statistics, layout, ScoreWidth::INT32).total();
+    };
+
+    ExecutionPlan plan = planExecution(statistics, 10, INT64_MAX);
+    EXPECT_EQ(plan.layout, TableLayout::RUN_LENGTH);
+    EXPECT_EQ(plan.score_width, ScoreWidth::INT32);
+    EXPECT_TRUE(plan.fits);
+    // Run-length tables need a non-negative penalty.
+    EXPECT_EQ(planExecution(statistics, -1, INT64_MAX).layout,
+              TableLayout::FULL);
+    // The long run makes run-length tables smaller than full tables, the large
+    // block makes checkpointed tables larger than run-length tables.
+    EXPECT_EQ(planExecution(statistics, 10, total(TableLayout::RUN_LENGTH))
+                  .layout,
+              TableLayout::RUN_LENGTH);
+    EXPECT_EQ(planExecution(statistics, -1, total(TableLayout::PACKED))
+                  .layout,
+              TableLayout::PACKED);
+    plan = planExecution(statistics, 10, total(TableLayout::SCORE_ONLY));
+    EXPECT_EQ(plan.layout, TableLayout::SCORE_ONLY);
+    EXPECT_TRUE(plan.fits);
+
+    plan = planExecution(statistics, 10, 0);
+    EXPECT_EQ(plan.layout, TableLayout::SCORE_ONLY);
+    EXPECT_FALSE(plan.fits);
+
+    // Packed tables grow with the graph, checkpointed tables with the largest
+    // block.
+    string text(1, EMPTY_STR);
+    for (int i = 0; i < 8000; i++) {
+        text += string(1000, 'A') + "{A,C}";
+    }
+    GraphStatistics long_statistics =
+        computeGraphStatistics(EDSToMatrix(text + EMPTY_STR), 1, -2);
+    int64_t checkpointed = estimateMemory(long_statistics,
+                                          TableLayout::CHECKPOINTED,
+                                          ScoreWidth::INT32)
+                               .total();
+    EXPECT_EQ(planExecution(long_statistics, -1, checkpointed).layout,
+              TableLayout::CHECKPOINTED);
+}
+
+// Returns what `write` writes with a `PathWriter` with a small buffer.
+template <typename write_t>
+string writePathsToString(PathFormat format, const eds_matrix &eds_segments,
+                          const write_t &write) {
+    FILE *file = tmpfile();
+    {
+        PathWriter writer(fileno(file), format, eds_segments, "g", 64);
+        write(writer);
+    }
+    string written(ftell(file), '\0');
+    rewind(file);
+    EXPECT_EQ(fread(written.data(), 1, written.size(), file), written.size());
+    fclose(file);
+    return written;
+}
+
+class PathWriterTest : public ::testing::Test {
+   protected:
+    // Segments "_GG", {AGAA,GGGA}, "_", {AG,G} and "AGG_".
+    eds_matrix eds_segments = EDSToMatrix("_GG{AGAA,GGGA}{AG,G}AGG_");
+    vector<vector<Vertex>> paths = {
+        {{0, 0, 1}, {1, 0, 0}, {1, 0, 1}, {3, 1, 0}, {4, 0, 0}, {4, 0, 1}},
+        {{1, 1, 2}, {1, 1, 3}}};
+
+    string write(PathFormat format) {
+        string written = writePathsToString(
+            format, eds_segments, [&](PathWriter &writer) {
+                writer.write(paths);
+                EXPECT_EQ(writer.pathCount(), 2);
+            });
+        // The intervals are written the same way.
+        EXPECT_EQ(writePathsToString(format, eds_segments,
+                                     [&](PathWriter &writer) {
+                                         writer.write(compressPaths(paths));
+                                     }),
+                  written);
+        return written;
+    }
+};
+
+TEST_F(PathWriterTest, BEDTest) {
+    EXPECT_EQ(write(PathFormat::BED),
+              "g\t1\t2\tpath0\n"
+              "g\t3\t5\tpath0\n"
+              "g\t14\t15\tpath0\n"
+              "g\t15\t17\tpath0\n"
+              "g\t9\t11\tpath1\n");
+}
+
+TEST_F(PathWriterTest, TSVTest) {
+    EXPECT_EQ(write(PathFormat::TSV),
+              "#path\tsegment\tlayer\tfirst_index\tlast_index\n"
+              "0\t0\t0\t1\t1\n"
+              "0\t1\t0\t0\t1\n"
+              "0\t3\t1\t0\t0\n"
+              "0\t4\t0\t0\t1\n"
+              "1\t1\t1\t2\t3\n");
+}
+
+TEST_F(PathWriterTest, BinaryTest) {
+    string written = write(PathFormat::BINARY);
+    ASSERT_EQ(written.size(), 8 + (8 + 4 * 32) + (8 + 32));
+    EXPECT_EQ(written.substr(0, 4), "MSPB");
+    auto value = [&](size_t offset, size_t size) {
+        uint64_t result = 0;
+        for (size_t i = 0; i < size; i++) {
+            result |= uint64_t((unsigned char)written[offset + i]) << (8 * i);
+        }
+        return result;
+    };
+    EXPECT_EQ(value(4, 4), 1);
+    vector<vector<int64_t>> records;
+    for (size_t offset = 8; offset < written.size();) {
+        int64_t num_intervals = value(offset, 8);
+        offset += 8;
+        records.emplace_back();
+        for (int64_t i = 0; i < 4 * num_intervals; i++, offset += 8) {
+            records.back().push_back(value(offset, 8));
+        }
+    }
+    vector<vector<int64_t>> expected = {
+        {0, 0, 1, 1, 1, 0, 0, 1, 3, 1, 0, 0, 4, 0, 0, 1}, {1, 1, 2, 3}};
+    EXPECT_EQ(records, expected);
+}
+
+TEST(PathWriter, ParsePathFormatTest) {
+    EXPECT_EQ(parsePathFormat("bed"), PathFormat::BED);
+    EXPECT_EQ(parsePathFormat("tsv"), PathFormat::TSV);
+    EXPECT_EQ(parsePathFormat("binary"), PathFormat::BINARY);
+    EXPECT_THROW(parsePathFormat("BED"), invalid_argument);
+}
+
+TEST(VCFLoader, VCFToMatrixTest) {
+    istringstream fasta(
+        ">chr1 description\nacgtAC\nGTACGT\n>chr2\nGGCC\nAA\n>chr3\nTT\n");
+    istringstream vcf(
+        "##fileformat=VCFv4.2\n"
+        "#CHROM\tPOS\tID\tREF\tALT\tQUAL\n"
+        "chr1\t1\t.\tA\tG,<DEL>\t50\n"
+        "chr1\t2\t.\tC\tT,*,T\t50\n"
+        "chr1\t2\t.\tC\tA\t50\n"
+        "chr1\t5\t.\tACG\tA\t50\n"
+        "chr1\t9\t.\tA\t.\t50\n"
+        "chr1\t12\t.\tT\tTT\t50\n"
+        "chr2\t3\t.\tC\tg\t50\n");
+    VCFLoadStatistics statistics;
+    EXPECT_EQ(VCFToMatrix(fasta, vcf, &statistics),
+              EDSToMatrix("_{A,G}{C,T}GT{ACG,A}TACG{T,TT}GG{C,G}CAATT_"));
+    EXPECT_EQ(statistics.records, 7);
+    EXPECT_EQ(statistics.variants, 5);
+    EXPECT_EQ(statistics.skipped_overlapping, 1);
+
+    // Without variants the graph is the reference.
+    fasta = istringstream(">chr1\nACGT\n");
+    vcf = istringstream("#CHROM\tPOS\tID\tREF\tALT\n");
+    EXPECT_EQ(VCFToMatrix(fasta, vcf), EDSToMatrix("_ACGT_"));
+}
+
+TEST(VCFLoader, InvalidRecordsTest) {
+    const string reference = ">chr1\nACGT\n>chr2\nGG\n";
+    auto load = [&](const string &record) {
+        istringstream fasta(reference);
+        istringstream vcf(record);
+        return VCFToMatrix(fasta, vcf);
+    };
+    EXPECT_NO_THROW(load("chr2\t2\t.\tG\tA\n"));
+    // REF differs from the reference.
+    EXPECT_THROW(load("chr1\t2\t.\tG\tA\n"), runtime_error);
+    // Past the end of the sequence.
+    EXPECT_THROW(load("chr2\t2\t.\tGG\tA\n"), runtime_error);
+    // Chromosomes out of the order of the FASTA.
+    EXPECT_THROW(load("chr2\t1\t.\tG\tA\nchr1\t1\t.\tA\tG\n"),
+                 runtime_error);
+    EXPECT_THROW(load("chr3\t1\t.\tG\tA\n"), runtime_error);
+    // Malformed.
+    EXPECT_THROW(load("chr1\tx\t.\tA\tG\n"), runtime_error);
+    EXPECT_THROW(load("chr1\t1\t.\tA\n"), runtime_error);
+}
+
+// Splits EDS text into characters and non-deterministic segments.
+vector<string> splitEDSText(const string &EDS) {
+    vector<string> tokens;
+    for (size_t i = 0; i < EDS.size(); i++) {
+        size_t end = EDS[i] == '{' ? EDS.find('}', i) : i;
+        tokens.push_back(EDS.substr(i, end - i + 1));
+        i = end;
+    }
+    return tokens;
+}
+
+// Checks the graph, the score and the paths of `appendable` against the DP on
+// the whole text `EDS`.
+void expectSameAsFullDP(const AppendableMaxScorePaths<int> &appendable,
+                        const string &EDS, int non_match, int penalty) {
+    eds_matrix eds_segments = EDSToMatrix(EMPTY_STR + EDS + EMPTY_STR);
+    weight_matrix weights = getGCContentWeights(eds_segments, 1, non_match);
+    score_matrix scores = initScoreMatrix(weights);
+    score_matrix choices = initScoreMatrix(weights);
+    int score =
+        findMaxScoringPaths(eds_segments, weights, scores, choices, penalty);
+    auto paths = getPaths(eds_segments, scores, choices);
+    reverse(paths.begin(), paths.end());
+
+    EXPECT_EQ(appendable.graph(), eds_segments) << EDS;
+    EXPECT_EQ(appendable.score(), score) << EDS;
+    EXPECT_EQ(appendable.paths(), paths) << EDS;
+}
+
+TEST(Appendable, AppendTest) {
+    const string texts[] = {
+        "GG{AGAA,GGGA,,ACCCCC}{AG,G}AGG{A,G}{C,}{A,AG}G{A,GA,CCC}{,A}",
+        "AG{GGG,,CCC}{AG,GCGG,AA}A{A,G}{G,CC}{AAAA,}",
+        "{CG,A}GCGCAATTGCGC{G,C}CCGAT{GGC,CA,A}CGCGCG"};
+    for (const string &text : texts) {
+        vector<string> tokens = splitEDSText(text);
+        for (int penalty : {0, 1, 3}) {
+            for (int non_match : {-1, -2}) {
+                // Every split into two parts.
+                for (size_t split = 0; split <= tokens.size(); split++) {
+                    string prefix, suffix;
+                    for (size_t i = 0; i < tokens.size(); i++) {
+                        (i < split ? prefix : suffix) += tokens[i];
+                    }
+                    AppendableMaxScorePaths<int> appendable(1, non_match,
+                                                            penalty);
+                    appendable.append(prefix);
+                    expectSameAsFullDP(appendable, prefix, non_match,
+                                       penalty);
+                    appendable.append(suffix);
+                    expectSameAsFullDP(appendable, text, non_match, penalty);
+                }
+                // One token at a time.
+                AppendableMaxScorePaths<int> appendable(1, non_match, penalty);
+                expectSameAsFullDP(appendable, "", non_match, penalty);
+                string prefix;
+                for (const string &token : tokens) {
+                    prefix += token;
+                    appendable.append(token);
+                    expectSameAsFullDP(appendable, prefix, non_match,
+                                       penalty);
+                }
+            }
+        }
+    }
+}
+
+TEST(Appendable, ResumeTest) {
+    // Many paths separated by AT-rich stretches.
+    string text;
+    for (int i = 0; i < 100; i++) {
+        text += "GCGC{A,T}AAAAAAAAAA";
+    }
+    AppendableMaxScorePaths<int> appendable(1, -1, 2);
+    appendable.append(text);
+    size_t num_paths = appendable.paths().size();
+    EXPECT_EQ(num_paths, 100);
+
+    // Only the appended vertices are filled, only the trailing paths change.
+    appendable.append("GGGG{C,A}");
+    EXPECT_EQ(appendable.filledVertices(), 4 + 2 + 1);
+    EXPECT_EQ(appendable.paths().size(), num_paths + 1);
+    EXPECT_EQ(appendable.changedPaths(), 1);
+    appendable.append("CC");
+    EXPECT_EQ(appendable.filledVertices(), 3);
+    EXPECT_EQ(appendable.changedPaths(), 1);
+    expectSameAsFullDP(appendable, text + "GGGG{C,A}CC", -1, 2);
+}
+
+TEST(Appendable, OverflowTest) {
+    AppendableMaxScorePaths<int16_t> appendable(100, -1, 0);
+    appendable.append("GC{A,T}");
+    eds_matrix eds_segments = appendable.graph();
+    EXPECT_THROW(appendable.append(string(100, 'G')), overflow_error);
+    EXPECT_EQ(appendable.graph(), eds_segments);
+}
+
+TEST(Pipeline, SPSCQueueTest) {
+    SPSCQueue<int> queue(3);
+    thread producer([&] {
+        for (int i = 0; i < 10000; i++) {
+            EXPECT_TRUE(queue.push(i));
+        }
+        queue.close();
+    });
+    int value;
+    int expected = 0;
+    while (queue.pop(value)) {
+        EXPECT_EQ(value, expected++);
+    }
+    producer.join();
+    EXPECT_EQ(expected, 10000);
+}
+
+TEST(Pipeline, SPSCQueueCancelTest) {
+    SPSCQueue<int> queue(1);
+    EXPECT_TRUE(queue.push(1));
+    thread producer([&] { EXPECT_FALSE(queue.push(2)); });
+    queue.cancel();
+    producer.join();
+    int value;
+    EXPECT_FALSE(queue.pop(value));
+}
+
+TEST(Pipeline, RunPipelineTest) {
+    const string texts[] = {
+        "GG{AGAA,GGGA,,ACCCCC}{AG,G}AGG{A,G}{C,}{A,AG}G{A,GA,CCC}{,A}",
+        "{CG,A}GCGCAATTGCGC{G,C}CCGAT{GGC,CA,A}CGCGCG\n",
+        "AG{GGG,,CCC}{AG,GCGG,AA}A{A,G}{G,CC}{AAAA,}",
+        "ACGTTGCA",
+        ""};
+    for (const string &text : texts) {
+        eds_matrix eds_segments = EDSToMatrix(EMPTY_STR + text + EMPTY_STR);
+        weight_matrix weights = getGCContentWeights(eds_segments, 1, -2);
+        score_matrix scores = initScoreMatrix(weights);
+        score_matrix choices = initScoreMatrix(weights);
+        int score =
+            findMaxScoringPaths(eds_segments, weights, scores, choices, 2);
+        auto paths = getPaths(eds_segments, scores, choices);
+        for (size_t read_bytes : {1, 3, 7, 1000}) {
+            PipelineOptions options;
+            options.read_bytes = read_bytes;
+            options.queue_batches = 1;
+            istringstream input(text);
+            PipelineResult<int> result =
+                runPipeline<int>(input, text.size() + 2, 1, -2, 2, options);
+            EXPECT_EQ(result.eds_segments, eds_segments) << text;
+            EXPECT_EQ(result.score, score) << text;
+            EXPECT_EQ(result.paths, paths) << text;
+            EXPECT_EQ(result.score_width, ScoreWidth::INT16);
+        }
+    }
+}
+
+TEST(Pipeline, OverflowTest) {
+    istringstream input("GC{A,T}" + string(100, 'G'));
+    EXPECT_THROW(runPipeline<int>(input, 10, 100, -1, 0), overflow_error);
+}
+
+// Adds the segments of the EDS text `EDS` to `graph`, a character of a
+// deterministic segment at a time.
+void addEDSSegments(msp_graph *graph, const string &EDS) {
+    for (const string &token : splitEDSText(EDS)) {
+        vector<string> layers;
+        if (token[0] == '{') {
+            stringstream stream(token.substr(1, token.size() - 2));
+            string layer;
+            while (getline(stream, layer, ',')) {
+                layers.push_back(layer);
+            }
+            if (token[token.size() - 2] == ',') {
+                layers.emplace_back();
+            }
+        } else {
+            layers.push_back(token);
+        }
+        vector<const char *> data;
+        vector<size_t> lengths;
+        for (const string &layer : layers) {
+            data.push_back(layer.data());
+            lengths.push_back(layer.size());
+        }
+        ASSERT_EQ(msp_graph_add_segment(graph, layers.size(), data.data(),
+                                        lengths.data()),
+                  MSP_OK);
+    }
+}
+
+TEST(CApi, GCScoringTest) {
+    const string texts[] = {
+        "GG{AGAA,GGGA,,ACCCCC}{AG,G}AGG{A,G}{C,}{A,AG}G{A,GA,CCC}{,A}",
+        "{CG,A}GCGCAATTGCGC{G,C}CCGAT{GGC,CA,A}CGCGCG", "", "{GC,}"};
+    for (const string &text : texts) {
+        vector<string> tokens = splitEDSText(text);
+        msp_graph *graph = msp_graph_create();
+        addEDSSegments(graph, text);
+        ASSERT_EQ(msp_graph_set_gc_scoring(graph, 1, -2), MSP_OK);
+        EXPECT_EQ(msp_graph_num_segments(graph), tokens.size());
+        for (int penalty : {0, 1, 3}) {
+            eds_matrix eds_segments = EDSToMatrix(EMPTY_STR + text + EMPTY_STR);
+            weight_matrix weights = getGCContentWeights(eds_segments, 1, -2);
+            score_matrix scores = initScoreMatrix(weights);
+            score_matrix choices = initScoreMatrix(weights);
+            int score = findMaxScoringPaths(eds_segments, weights, scores,
+                                            choices, penalty);
+            auto paths = getPaths(eds_segments, scores, choices);
+            reverse(paths.begin(), paths.end());
+
+            msp_result *result = nullptr;
+            ASSERT_EQ(msp_run(graph, penalty, &result), MSP_OK);
+            EXPECT_EQ(msp_result_score(result), score) << text;
+            ASSERT_EQ(msp_result_num_paths(result), paths.size()) << text;
+            for (size_t i = 0; i < paths.size(); i++) {
+                string expected;
+                for (const Vertex &v : paths[i]) {
+                    char c = eds_segments[v.segment][v.layer][v.index];
+                    if (c != EMPTY_STR) {
+                        expected += c;
+                    }
+                }
+                const msp_vertex *vertices;
+                size_t num_vertices;
+                ASSERT_EQ(msp_result_path(result, i, &vertices, &num_vertices),
+                          MSP_OK);
+                string found;
+                for (size_t j = 0; j < num_vertices; j++) {
+                    string layer = tokens[vertices[j].segment];
+                    if (layer[0] == '{') {
+                        layer = layer.substr(1, layer.size() - 2) + ",";
+                        for (int k = 0; k < vertices[j].layer; k++) {
+                            layer.erase(0, layer.find(',') + 1);
+                        }
+                        layer.erase(layer.find(','));
+                    }
+                    found += layer[vertices[j].offset];
+                }
+                EXPECT_EQ(found, expected) << text;
+            }
+            msp_result_destroy(result);
+        }
+        msp_graph_destroy(graph);
+    }
+}
+
+TEST(CApi, WeightedSegmentTest) {
+    msp_graph *graph = msp_graph_create();
+    const char *layers[] = {"AC", "GT"};
+    size_t lengths[] = {2, 2};
+    int32_t first_weights[] = {5, -1};
+    int32_t second_weights[] = {-1, 5};
+    const int32_t *weights[] = {first_weights, second_weights};
+    ASSERT_EQ(msp_graph_add_weighted_segment(graph, 1, layers, lengths,
+                                             weights),
+              MSP_OK);
+    ASSERT_EQ(msp_graph_add_weighted_segment(graph, 1, layers + 1,
+                                             lengths + 1, weights + 1),
+              MSP_OK);
+    msp_result *result = nullptr;
+    ASSERT_EQ(msp_run(graph, 1, &result), MSP_OK);
+    EXPECT_EQ(msp_result_score(result), 8);
+    ASSERT_EQ(msp_result_num_paths(result), 2);
+    const msp_vertex *vertices;
+    size_t num_vertices;
+    ASSERT_EQ(msp_result_path(result, 0, &vertices, &num_vertices), MSP_OK);
+    ASSERT_EQ(num_vertices, 1);
+    EXPECT_EQ(vertices[0].segment, 0);
+    EXPECT_EQ(vertices[0].offset, 0);
+    ASSERT_EQ(msp_result_path(result, 1, &vertices, &num_vertices), MSP_OK);
+    ASSERT_EQ(num_vertices, 1);
+    EXPECT_EQ(vertices[0].segment, 1);
+    EXPECT_EQ(vertices[0].offset, 1);
+    msp_result_destroy(result);
+    msp_graph_destroy(graph);
+}
+
+TEST(CApi, InvalidArgumentsTest) {
+    EXPECT_EQ(msp_api_version(), MSP_API_VERSION);
+    const char *layers[] = {"A", nullptr};
+    size_t lengths[] = {1, 1};
+    msp_graph *graph = msp_graph_create();
+    EXPECT_EQ(msp_graph_add_segment(nullptr, 1, layers, lengths),
+              MSP_INVALID_ARGUMENT);
+    EXPECT_EQ(msp_graph_add_segment(graph, 0, layers, lengths),
+              MSP_INVALID_ARGUMENT);
+    EXPECT_EQ(msp_graph_add_segment(graph, 2, layers, lengths),
+              MSP_INVALID_ARGUMENT);
+    EXPECT_STRNE(msp_last_error(), "");
+    EXPECT_EQ(msp_graph_add_weighted_segment(graph, 1, layers, lengths,
+                                             nullptr),
+              MSP_INVALID_ARGUMENT);
+    EXPECT_EQ(msp_graph_num_segments(graph), 0);
+
+    // Scores beyond 32 bits.
+    const int32_t huge_weights[] = {INT32_MAX};
+    const int32_t *weights[] = {huge_weights};
+    for (int i = 0; i < 5; i++) {
+        ASSERT_EQ(msp_graph_add_weighted_segment(graph, 1, layers, lengths,
+                                                 weights),
+                  MSP_OK);
+    }
+    msp_result *result = nullptr;
+    EXPECT_EQ(msp_run(graph, 0, &result), MSP_OK);
+    const msp_vertex *vertices;
+    size_t num_vertices;
+    EXPECT_EQ(msp_result_path(result, 1, &vertices, &num_vertices),
+              MSP_INVALID_ARGUMENT);
+    msp_result_destroy(result);
+    msp_graph_destroy(graph);
+}
+
+// Returns a random EDS text with up to `max_bubbles` bubbles of up to
+// `max_width` layers.
+string randomEDSText(mt19937 &random, int max_bubbles, int max_width) {
+    const char bases[] = "ACGT";
+    auto sequence = [&](int max_length) {
+        string bases_of_sequence;
+        for (int i = random() % (max_length + 1); i > 0; i--) {
+            bases_of_sequence += bases[random() % 4];
+        }
+        return bases_of_sequence;
+    };
+    string EDS = sequence(6);
+    for (int bubble = random() % (max_bubbles + 1); bubble > 0; bubble--) {
+        EDS += "{" + sequence(5);
+        for (int layer = random() % max_width + 1; layer > 0; layer--) {
+            EDS += "," + sequence(5);
+        }
+        EDS += "}" + sequence(random() % 2 ? 6 : 0);
+    }
+    return EDS;
+}
+
+TEST(LaneBatch, GCScoringTest) {
+    mt19937 random(7);
+    vector<eds_matrix> graphs;
+    for (int i = 0; i < 300; i++) {
+        graphs.push_back(EDSToMatrix(EMPTY_STR +
+                                     randomEDSText(random, 6, i % 3 ? 3 : 20) +
+                                     EMPTY_STR));
+    }
+    for (int penalty : {-1, 0, 3}) {
+        for (int non_match : {-1, -2}) {
+            auto results =
+                findMaxScoringPathsBatch(graphs, 1, non_match, penalty);
+            ASSERT_EQ(results.size(), graphs.size());
+            for (size_t i = 0; i < graphs.size(); i++) {
+                weight_matrix weights =
+                    getGCContentWeights(graphs[i], 1, non_match);
+                score_matrix scores = initScoreMatrix(weights);
+                score_matrix choices = initScoreMatrix(weights);
+                int score = findMaxScoringPaths(graphs[i], weights, scores,
+                                                choices, penalty);
+                EXPECT_EQ(results[i].score, score) << i;
+                EXPECT_EQ(results[i].paths,
+                          getPaths(graphs[i], scores, choices))
+                    << i;
+            }
+        }
+    }
+}
+
+TEST(LaneBatch, WeightsTest) {
+    mt19937 random(11);
+    vector<eds_matrix> graphs;
+    vector<weight_matrix> weights;
+    for (int i = 0; i < 100; i++) {
+        graphs.push_back(
+            EDSToMatrix(EMPTY_STR + randomEDSText(random, 4, 4) + EMPTY_STR));
+        // Many ties.
+        weights.push_back(getGCContentWeights(graphs.back(), 0, 1));
+        for (auto &segment : weights.back()) {
+            for (auto &layer : segment) {
+                for (int &weight : layer) {
+                    weight -= random() % 2;
+                }
+            }
+        }
+    }
+    auto results = findMaxScoringPathsInLanes<int16_t>(graphs, weights, 1);
+    for (size_t i = 0; i < graphs.size(); i++) {
+        auto scores = initScoreMatrix<int16_t>(weights[i]);
+        auto choices = initScoreMatrix<int16_t>(weights[i]);
+        int score =
+            findMaxScoringPaths(graphs[i], weights[i], scores, choices, 1);
+        EXPECT_EQ(results[i].score, score) << i;
+        EXPECT_EQ(results[i].paths, getPaths(graphs[i], scores, choices))
+            << i;
+    }
+
+    weights[3][0][0][0] = 10000;
+    EXPECT_THROW(findMaxScoringPathsInLanes<int16_t>(graphs, weights, 1),
+                 overflow_error);
+    weights.pop_back();
+    EXPECT_THROW(findMaxScoringPathsInLanes<int32_t>(graphs, weights, 1),
+                 invalid_argument);
+}
+
+// Returns a path for a temporary track file of the test.
+string weightTrackPath(const string &name) {
+    return (filesystem::temp_directory_path() /
+            ("maxscorepaths_" + name + "_" + to_string(getpid()) + ".track"))
+        .string();
+}
+
+TEST(WeightTrack, DPTest) {
+    mt19937 random(5);
+    eds_matrix eds_segments =
+        EDSToMatrix(readEDSFile("../unit_tests/test_inputs/input_01.txt"));
+    weight_matrix weights = getGCContentWeights(eds_segments);
+    for (size_t segment = 0; segment < weights.size(); segment++) {
+        for (size_t layer = 0; layer < weights[segment].size(); layer++) {
+            for (size_t index = 0; index < weights[segment][layer].size();
+                 index++) {
+                if (eds_segments[segment][layer][index] != EMPTY_STR) {
+                    weights[segment][layer][index] = (int)(random() % 7) - 3;
+                }
+            }
+        }
+    }
+    string path = weightTrackPath("dp");
+    writeWeightTrack(path, eds_segments, weights);
+    {
+        WeightTrack track(path, eds_segments);
+        EXPECT_EQ(track.numVertices(), linearizedGraphLength(eds_segments));
+        EXPECT_EQ(track.maxAbsWeight(), 3);
+        ASSERT_EQ(track.size(), weights.size());
+        for (size_t segment = 0; segment < weights.size(); segment++) {
+            ASSERT_EQ(track[segment].size(), weights[segment].size());
+            for (size_t layer = 0; layer < weights[segment].size(); layer++) {
+                ASSERT_EQ(track[segment][layer].size(),
+                          weights[segment][layer].size());
+                for (size_t index = 0; index < weights[segment][layer].size();
+                     index++) {
+                    EXPECT_EQ(track[segment][layer][index],
+                              weights[segment][layer][index]);
+                }
+            }
+        }
+        EXPECT_EQ(selectScoreWidth(eds_segments, track, 2),
+                  selectScoreWidth(eds_segments, weights, 2));
+
+        for (int penalty : {0, 2, 5}) {
+            auto scores = initScoreMatrix(weights);
+            auto choices = initScoreMatrix(weights);
+            int score = findMaxScoringPaths(eds_segments, weights, scores,
+                                            choices, penalty);
+            auto track_scores = initScoreMatrix(track);
+            auto track_choices = initScoreMatrix(track);
+            EXPECT_EQ(findMaxScoringPaths(eds_segments, track, track_scores,
+                                          track_choices, penalty),
+                      score);
+            EXPECT_EQ(track_scores, scores);
+            EXPECT_EQ(getPaths(eds_segments, track_scores, track_choices),
+                      getPaths(eds_segments, scores, choices));
+            EXPECT_EQ(findMaxScore<int>(eds_segments, track, penalty), score);
+        }
+    }
+    filesystem::remove(path);
+}
+
+TEST(WeightTrack, InvalidTracksTest) {
+    eds_matrix eds_segments =
+        EDSToMatrix(readEDSFile("../unit_tests/test_inputs/input_01.txt"));
+    weight_matrix weights = getGCContentWeights(eds_segments);
+    string path = weightTrackPath("invalid");
+    EXPECT_THROW(WeightTrack(path, eds_segments), runtime_error);
+
+    writeWeightTrack(path, eds_segments, weights);
+    eds_matrix other = eds_segments;
+    other[1][0][0] = 'T';
+    EXPECT_THROW(WeightTrack(path, other), invalid_argument);
+
+    // A weight for the `EMPTY_STR` at the start of the graph.
+    weights[0][0][0] = 1;
+    writeWeightTrack(path, eds_segments, weights);
+    EXPECT_THROW(WeightTrack(path, eds_segments), invalid_argument);
+
+    weights[0][0][0] = 0;
+    writeWeightTrack(path, eds_segments, weights);
+    filesystem::resize_file(path, filesystem::file_size(path) - 4);
+    EXPECT_THROW(WeightTrack(path, eds_segments), invalid_argument);
+    filesystem::resize_file(path, 10);
+    EXPECT_THROW(WeightTrack(path, eds_segments), invalid_argument);
+
+    weights[1].pop_back();
+    EXPECT_THROW(writeWeightTrack(path, eds_segments, weights),
+                 invalid_argument);
+    filesystem::remove(path);
+}
+
+TEST(Packed, TablesTest) {
+    mt19937 random(3);
+    for (int i = 0; i < 200; i++) {
+        eds_matrix eds_segments =
+            EDSToMatrix(EMPTY_STR + randomEDSText(random, 6, 5) + EMPTY_STR);
+        weight_matrix weights =
+            getGCContentWeights(eds_segments, 1, i % 2 ? -1 : -2);
+        // The tables are reused for every penalty.
+        auto packed = initPackedTables<int32_t>(eds_segments);
+        for (int penalty : {-1, 0, 1, 3}) {
+            auto scores = initScoreMatrix<int32_t>(weights);
+            auto choices = initScoreMatrix<int32_t>(weights);
+            int score = findMaxScoringPaths(eds_segments, weights, scores,
+                                            choices, penalty);
+            EXPECT_EQ(findMaxScoringPaths(eds_segments, weights, packed,
+                                          penalty),
+                      score);
+            vector<vector<Vertex>> paths;
+            getPaths(eds_segments, packed, paths);
+            EXPECT_EQ(paths, getPaths(eds_segments, scores, choices)) << i;
+        }
+    }
+}
+
+TEST(Comparative, NestedSeriesTest) {
+    mt19937 random(13);
+    // Graphs of nested sample sets: variant i is in the graphs from
+    // `first_graph[i]` on, the other graphs have its reference allele.
+    const int num_graphs = 8;
+    vector<string> references, variants;
+    vector<int> first_graph;
+    for (int i = 0; i < 2000; i++) {
+        string bubble = randomEDSText(random, 1, 3);
+        size_t open = bubble.find('{');
+        if (open == string::npos) {
+            references.push_back(bubble);
+            variants.push_back(bubble);
+        } else {
+            size_t comma = bubble.find(',', open);
+            size_t close = bubble.find('}', open);
+            references.push_back(bubble.substr(0, open) +
+                                 bubble.substr(open + 1, comma - open - 1) +
+                                 bubble.substr(close + 1));
+            variants.push_back(bubble);
+        }
+        first_graph.push_back(random() % 5 ? 0 : random() % num_graphs);
+    }
+    ComparativeMaxScores comparative(1, -2, 3);
+    for (int graph = 0; graph < num_graphs; graph++) {
+        string EDS(1, EMPTY_STR);
+        for (size_t i = 0; i < variants.size(); i++) {
+            EDS += graph >= first_graph[i] ? variants[i] : references[i];
+        }
+        eds_matrix eds_segments = EDSToMatrix(EDS + EMPTY_STR);
+        weight_matrix weights = getGCContentWeights(eds_segments, 1, -2);
+        int64_t computed = comparative.computedUnits();
+        int64_t reused = comparative.reusedUnits();
+        EXPECT_EQ(comparative.score(eds_segments),
+                  findMaxScore<int64_t>(eds_segments, weights, 3))
+            << graph;
+        computed = comparative.computedUnits() - computed;
+        reused = comparative.reusedUnits() - reused;
+        // The later graphs add few variants to the previous ones.
+        if (graph > 0) {
+            EXPECT_GT(reused, 2 * computed) << graph;
+        }
+    }
+
+    // Every graph alone.
+    mt19937 graph_random(17);
+    for (int i = 0; i < 200; i++) {
+        eds_matrix eds_segments = EDSToMatrix(
+            EMPTY_STR + randomEDSText(graph_random, 6, 4) + EMPTY_STR);
+        for (int penalty : {-1, 0, 2}) {
+            ComparativeMaxScores single(1, i % 2 ? -1 : -2, penalty);
+            EXPECT_EQ(single.score(eds_segments),
+                      findMaxScore<int64_t>(
+                          eds_segments,
+                          getGCContentWeights(eds_segments, 1,
+                                              i % 2 ? -1 : -2),
+                          penalty))
+                << i;
+        }
+    }
+}
+
+string compressedInputPath(const string &name) {
+    return (filesystem::temp_directory_path() /
+            ("maxscorepaths_" + name + "_" + to_string(getpid())))
+        .string();
+}
+
+// Writes `parts` to `file_path` as one gzip member each.
+void writeGzip(const string &file_path, const vector<string> &parts) {
+    ofstream output(file_path, ios::binary | ios::trunc);
+    for (const string &part : parts) {
+        z_stream stream = {};
+        ASSERT_EQ(deflateInit2(&stream, 9, Z_DEFLATED, 15 + 16, 8,
+                               Z_DEFAULT_STRATEGY),
+                  Z_OK);
+        string compressed(deflateBound(&stream, part.size()), '\0');
+        stream.next_in = (Bytef *)part.data();
+        stream.avail_in = part.size();
+        stream.next_out = (Bytef *)compressed.data();
+        stream.avail_out = compressed.size();
+        ASSERT_EQ(deflate(&stream, Z_FINISH), Z_STREAM_END);
+        output.write(compressed.data(), stream.total_out);
+        deflateEnd(&stream);
+    }
+}
+
+TEST(CompressedInput, GzipTest) {
+    mt19937 random(23);
+    // Repetitive, as the EDS files, and longer than a decompressed block.
+    string text, chunk;
+    while (chunk.size() < 100000) {
+        chunk += randomEDSText(random, 20, 4);
+    }
+    while (text.size() < 1500000) {
+        text += chunk;
+    }
+    string plain_path = compressedInputPath("plain");
+    string gzip_path = compressedInputPath("gzip");
+    ofstream(plain_path, ios::binary) << text;
+    EXPECT_EQ(detectCompression(plain_path), Compression::NONE);
+    EXPECT_EQ(decompressedSizeBound(plain_path), text.size());
+
+    // One member, and several members as written by `cat a.gz b.gz`.
+    size_t third = text.size() / 3;
+    for (const vector<string> &parts :
+         {vector<string>{text},
+          vector<string>{text.substr(0, third), "",
+                         text.substr(third, third),
+                         text.substr(2 * third)}}) {
+        writeGzip(gzip_path, parts);
+        EXPECT_EQ(detectCompression(gzip_path), Compression::GZIP);
+        EXPECT_GE(decompressedSizeBound(gzip_path), text.size());
+        EXPECT_EQ(readEDSFile(gzip_path), readEDSFile(plain_path));
+
+        // A stream closed before the end of its content.
+        unique_ptr<istream> input = openDecompressed(gzip_path);
+        char c;
+        EXPECT_TRUE(input->get(c));
+    }
+
+    // The pipeline reads the decompressed stream.
+    {
+        writeGzip(gzip_path, {chunk});
+        unique_ptr<istream> input = openDecompressed(gzip_path);
+        PipelineResult<int> result =
+            runPipeline<int>(*input, chunk.size() + 2, 1, -2, 10);
+        eds_matrix eds_segments = EDSToMatrix(EMPTY_STR + chunk + EMPTY_STR);
+        EXPECT_EQ(result.eds_segments, eds_segments);
+        EXPECT_EQ(result.score,
+                  findMaxScore<int64_t>(eds_segments,
+                                        getGCContentWeights(eds_segments, 1,
+                                                            -2),
+                                        10));
+    }
+
+    // Truncated and corrupt files.
+    string compressed;
+    {
+        ifstream input(gzip_path, ios::binary);
+        compressed.assign(istreambuf_iterator<char>(input), {});
+    }
+    ofstream(gzip_path, ios::binary | ios::trunc)
+        << compressed.substr(0, compressed.size() / 2);
+    EXPECT_THROW(readEDSFile(gzip_path), runtime_error);
+    compressed[compressed.size() / 2] ^= 0xff;
+    compressed[compressed.size() / 2 + 1] ^= 0xff;
+    ofstream(gzip_path, ios::binary | ios::trunc) << compressed;
+    EXPECT_THROW(readEDSFile(gzip_path), runtime_error);
+    ofstream(gzip_path, ios::binary | ios::trunc) << "\x1f\x8b";
+    EXPECT_THROW(readEDSFile(gzip_path), runtime_error);
+
+    remove(plain_path.c_str());
+    remove(gzip_path.c_str());
+}
+
+TEST(CompressedInput, ZstdTest) {
+    string text = "ACGT{A,C}GGC{,T,TT}A";
+    string zstd_path = compressedInputPath("zstd");
+#ifdef MAXSCOREPATH_WITH_ZSTD
+    string compressed(ZSTD_compressBound(text.size()), '\0');
+    compressed.resize(ZSTD_compress(compressed.data(), compressed.size(),
+                                    text.data(), text.size(), 3));
+    ofstream(zstd_path, ios::binary | ios::trunc) << compressed << compressed;
+    EXPECT_EQ(detectCompression(zstd_path), Compression::ZSTD);
+    EXPECT_EQ(readEDSFile(zstd_path), EMPTY_STR + text + text + EMPTY_STR);
+    ofstream(zstd_path, ios::binary | ios::trunc)
+        << compressed.substr(0, compressed.size() - 1);
+    EXPECT_THROW(readEDSFile(zstd_path), runtime_error);
+#else
+    ofstream(zstd_path, ios::binary | ios::trunc)
+        << "\x28\xb5\x2f\xfd" << text;
+    EXPECT_EQ(detectCompression(zstd_path), Compression::ZSTD);
+    EXPECT_THROW(readEDSFile(zstd_path), runtime_error);
+#endif
+    remove(zstd_path.c_str());
+}
+
+TEST(ParallelTraceback, PathsTest) {
+    mt19937 random(29);
+    string EDS;
+    while (EDS.size() < 160000) {
+        EDS += randomEDSText(random, 20, 4) + "A";
+    }
+    eds_matrix eds_segments = EDSToMatrix(EMPTY_STR + EDS + EMPTY_STR);
+    // Short paths close often, long paths span the chunks.
+    for (int non_match : {-2, -1}) {
+        weight_matrix weights = getGCContentWeights(eds_segments, 1, non_match);
+        for (int penalty : {0, 3, 10}) {
+            score_matrix scores = initScoreMatrix(weights);
+            score_matrix choices = initScoreMatrix(weights);
+            findMaxScoringPaths(eds_segments, weights, scores, choices,
+                                penalty);
+            auto expected = getPaths(eds_segments, scores, choices);
+            RunLengthTables<int> run_length = initRunLengthTables<int>(weights);
+            findMaxScoringPaths(eds_segments, weights, run_length, penalty);
+            PackedTables<int> packed = initPackedTables<int>(eds_segments);
+            findMaxScoringPaths(eds_segments, weights, packed, penalty);
+            for (int threads : {1, 2, 3, 8}) {
+                vector<vector<Vertex>> paths;
+                getPathsInParallel(eds_segments, scores, choices, paths,
+                                   threads);
+                EXPECT_EQ(paths, expected) << penalty << " " << threads;
+                pmr_paths<int> resource_paths;
+                getPathsInParallel(eds_segments, weights, run_length,
+                                   resource_paths, threads);
+                EXPECT_TRUE(equal(resource_paths.begin(), resource_paths.end(),
+                                  expected.begin(), expected.end(),
+                                  [](const auto &a, const auto &b) {
+                                      return equal(a.begin(), a.end(),
+                                                   b.begin(), b.end());
+                                  }))
+                    << penalty << " " << threads;
+                paths.clear();
+                getPathsInParallel(eds_segments, packed, paths, threads);
+                EXPECT_EQ(paths, expected) << penalty << " " << threads;
+            }
+        }
+    }
+}
+
+TEST(Shards, SplitMergeTest) {
+    string directory = (filesystem::temp_directory_path() /
+                        ("maxscorepaths_shards_" + to_string(getpid())))
+                           .string();
+    mt19937 random(31);
+    for (int graph = 0; graph < 40; graph++) {
+        string EDS;
+        for (int piece = random() % 30; piece >= 0; piece--) {
+            EDS += randomEDSText(random, 6, graph % 4 ? 3 : 12) + "A";
+        }
+        eds_matrix eds_segments = EDSToMatrix(EMPTY_STR + EDS + EMPTY_STR);
+        int non_match = graph % 2 ? -1 : -2;
+        for (int penalty : {0, 3, 10}) {
+            weight_matrix weights =
+                getGCContentWeights(eds_segments, 1, non_match);
+            score_matrix scores = initScoreMatrix(weights);
+            score_matrix choices = initScoreMatrix(weights);
+            int64_t score = findMaxScoringPaths(eds_segments, weights, scores,
+                                                choices, penalty);
+            compact_paths paths =
+                compressPaths(getPaths(eds_segments, scores, choices));
+            for (int num_shards : {1, 2, 5, 40}) {
+                filesystem::remove_all(directory);
+                ShardManifest manifest = cutShards(
+                    eds_segments, num_shards, 1, non_match, penalty, directory);
+                EXPECT_LE(manifest.first_segments.size(), num_shards);
+                EXPECT_EQ(readShardedGraph(directory), eds_segments);
+                int shards = manifest.first_segments.size();
+                // Every shard on its own, as on another machine.
+                for (int shard = shards - 1; shard >= 0; shard--) {
+                    writeShardTransfer(directory, shard);
+                }
+                EXPECT_EQ(mergeShardTransfers(directory), score)
+                    << graph << " " << penalty << " " << num_shards;
+                EXPECT_EQ(readShardedScore(directory), score);
+                for (int shard = 0; shard < shards; shard++) {
+                    writeShardTraceback(directory, shard);
+                }
+                EXPECT_EQ(stitchShardPaths(directory), paths)
+                    << graph << " " << penalty << " " << num_shards;
+            }
+        }
+    }
+
+    // The steps need the files of the earlier steps.
+    filesystem::remove_all(directory);
+    eds_matrix eds_segments = EDSToMatrix("_A{C,G}T{A,}GC_");
+    cutShards(eds_segments, 2, 1, -2, 0, directory);
+    EXPECT_THROW(mergeShardTransfers(directory), runtime_error);
+    EXPECT_THROW(writeShardTransfer(directory, 2), invalid_argument);
+    writeShardTransfer(directory, 0);
+    writeShardTransfer(directory, 1);
+    EXPECT_THROW(writeShardTraceback(directory, 1), runtime_error);
+    mergeShardTransfers(directory);
+    writeShardTraceback(directory, 1);
+    EXPECT_THROW(stitchShardPaths(directory), runtime_error);
+    writeShardTraceback(directory, 0);
+    EXPECT_FALSE(stitchShardPaths(directory).empty());
+    // The tracebacks of another merge are detected.
+    cutShards(eds_segments, 2, 1, -1, 0, directory);
+    writeShardTransfer(directory, 0);
+    writeShardTransfer(directory, 1);
+    mergeShardTransfers(directory);
+    EXPECT_THROW(stitchShardPaths(directory), runtime_error);
+    // A damaged count of continued paths is a truncated file.
+    writeShardTraceback(directory, 0);
+    writeShardTraceback(directory, 1);
+    EXPECT_FALSE(stitchShardPaths(directory).empty());
+    {
+        fstream traceback(directory + "/shard_0.traceback",
+                          ios::in | ios::out | ios::binary);
+        // After the header, the shard, p and the exit of the first traceback.
+        traceback.seekp(2 * sizeof(uint32_t) + sizeof(int64_t) +
+                        sizeof(boundary_cells) + sizeof(int32_t));
+        uint64_t num_continued_paths = UINT64_MAX / 2;
+        traceback.write(reinterpret_cast<char *>(&num_continued_paths),
+                        sizeof(num_continued_paths));
+    }
+    EXPECT_THROW(stitchShardPaths(directory), runtime_error);
+    filesystem::remove_all(directory);
+}
+
+// Returns the score of the graph with the weight of `v` set to `weight`.
+int scoreWithWeight(const eds_matrix &eds_segments, weight_matrix weights,
+                    Vertex v, int weight, int penalty) {
+    weights[v.segment][v.layer][v.index] = weight;
+    auto scores = initScoreMatrix(weights);
+    auto choices = initScoreMatrix(weights);
+    return findMaxScoringPaths(eds_segments, weights, scores, choices, penalty);
+}
+
+TEST(ForcedScores, RerunTest) {
+    // Far above the scores of the graphs, a vertex of this weight is always
+    // selected, and never of its negation.
+    const int forcing_weight = 100000;
+    mt19937 random(11);
+    for (int i = 0; i < 150; i++) {
+        eds_matrix eds_segments =
+            EDSToMatrix(EMPTY_STR + randomEDSText(random, 5, 4) + EMPTY_STR);
+        weight_matrix weights = getGCContentWeights(eds_segments);
+        if (i % 2) {
+            for (size_t segment = 0; segment < weights.size(); segment++) {
+                for (size_t layer = 0; layer < weights[segment].size();
+                     layer++) {
+                    for (size_t index = 0;
+                         index < weights[segment][layer].size(); index++) {
+                        if (eds_segments[segment][layer][index] != EMPTY_STR) {
+                            weights[segment][layer][index] =
+                                (int)(random() % 7) - 3;
+                        }
+                    }
+                }
+            }
+        }
+        for (int penalty : {0, 2, 5}) {
+            auto scores = initScoreMatrix(weights);
+            auto choices = initScoreMatrix(weights);
+            int score = findMaxScoringPaths(eds_segments, weights, scores,
+                                            choices, penalty);
+            vector<forced_scores> forced = getForcedScores(
+                eds_segments, scores,
+                findBackwardScores(eds_segments, weights, scores, penalty));
+            ASSERT_EQ(forced.size(), linearizedGraphLength(eds_segments));
+
+            size_t position = 0;
+            for (int segment = 0; segment < eds_segments.size(); segment++) {
+                for (int layer = 0; layer < eds_segments[segment].size();
+                     layer++) {
+                    for (int index = 0;
+                         index < eds_segments[segment][layer].size();
+                         index++) {
+                        Vertex v(segment, layer, index);
+                        int weight = weights[segment][layer][index];
+                        const forced_scores &v_forced = forced[position++];
+                        EXPECT_EQ(max(v_forced[SURELY_SELECTED],
+                                      v_forced[!SURELY_SELECTED]),
+                                  score);
+                        int selected_score =
+                            scoreWithWeight(eds_segments, weights, v,
+                                            weight + forcing_weight, penalty) -
+                            forcing_weight;
+                        // No solution selects the vertex.
+                        if (selected_score < -forcing_weight / 2) {
+                            EXPECT_EQ(v_forced[SURELY_SELECTED], NO_SCORE);
+                        } else {
+                            EXPECT_EQ(v_forced[SURELY_SELECTED],
+                                      selected_score);
+                        }
+                        EXPECT_EQ(v_forced[!SURELY_SELECTED],
+                                  scoreWithWeight(eds_segments, weights, v,
+                                                  -forcing_weight, penalty));
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST(ForcedScores, MarginalTableTest) {
+    eds_matrix eds_segments =
+        EDSToMatrix(readEDSFile("../unit_tests/test_inputs/input_01.txt"));
+    weight_matrix weights = getGCContentWeights(eds_segments, 1, -2);
+    auto scores = initScoreMatrix<int64_t>(weights);
+    auto choices = initScoreMatrix<int64_t>(weights);
+    int64_t score = findMaxScoringPaths(eds_segments, weights, scores, choices,
+                                        3);
+    vector<forced_scores> forced = getForcedScores(
+        eds_segments, scores,
+        findBackwardScores(eds_segments, weights, scores, 3));
+
+    string path = weightTrackPath("marginals");
+    EXPECT_THROW(MarginalTable(path, eds_segments), runtime_error);
+    EXPECT_EQ(writeMarginalTable(path, eds_segments, weights, 3), score);
+    {
+        MarginalTable table(path, eds_segments);
+        EXPECT_EQ(table.score(), score);
+        EXPECT_EQ(table.numVertices(), forced.size());
+        size_t position = 0;
+        for (int64_t segment = 0; segment < eds_segments.size(); segment++) {
+            for (int64_t layer = 0; layer < eds_segments[segment].size();
+                 layer++) {
+                for (int64_t index = 0;
+                     index < eds_segments[segment][layer].size(); index++) {
+                    EXPECT_EQ(table.forcedScores({segment, layer, index}),
+                              forced[position++]);
+                }
+            }
+        }
+        EXPECT_THROW(table.forcedScores({1, 5, 0}), out_of_range);
+        EXPECT_THROW(table.forcedScores({0, 0, 1000}), out_of_range);
+        EXPECT_THROW(table.forcedScores({-1, 0, 0}), out_of_range);
+    }
+
+    eds_matrix other = eds_segments;
+    other[1][0][0] = 'T';
+    EXPECT_THROW(MarginalTable(path, other), invalid_argument);
+    filesystem::resize_file(path, filesystem::file_size(path) - 8);
+    EXPECT_THROW(MarginalTable(path, eds_segments), invalid_argument);
+    filesystem::resize_file(path, 10);
+    EXPECT_THROW(MarginalTable(path, eds_segments), invalid_argument);
+    filesystem::remove(path);
+}
+
+TEST(UnprofitableRegions, SkipTest) {
+    mt19937 random(13);
+    // Mostly A and T, the GC content scoring makes long negative stretches.
+    const char at_rich_bases[] = "AATTAATTAGTC";
+    int num_graphs_with_regions = 0;
+    for (int i = 0; i < 200; i++) {
+        string EDS = randomEDSText(random, 4, 3);
+        if (i % 2) {
+            for (char &c : EDS) {
+                if (c == 'A' || c == 'C' || c == 'G' || c == 'T') {
+                    c = at_rich_bases[random() % 12];
+                }
+            }
+            EDS = string(random() % 40, 'A') + EDS + "GCGC";
+        }
+        eds_matrix eds_segments = EDSToMatrix(EMPTY_STR + EDS + EMPTY_STR);
+        weight_matrix weights = getGCContentWeights(eds_segments);
+        for (int penalty : {0, 2, 5, 10}) {
+            auto scores = initScoreMatrix(weights);
+            auto choices = initScoreMatrix(weights);
+            int score = findMaxScoringPaths(eds_segments, weights, scores,
+                                            choices, penalty);
+            auto paths = getPaths(eds_segments, scores, choices);
+
+            UnprofitableRegions regions =
+                findUnprofitableRegions(eds_segments, weights, penalty);
+            num_graphs_with_regions += !regions.regions.empty();
+            auto skipping_scores = initScoreMatrix(weights);
+            auto skipping_choices = initScoreMatrix(weights);
+            EXPECT_EQ(findMaxScoringPaths(eds_segments, weights,
+                                          skipping_scores, skipping_choices,
+                                          penalty, regions),
+                      score);
+            vector<vector<Vertex>> skipping_paths;
+            getPaths(eds_segments, weights, skipping_scores, skipping_choices,
+                     regions, skipping_paths);
+            EXPECT_EQ(skipping_paths, paths);
+            for (const auto &region : regions.regions) {
+                ASSERT_EQ(eds_segments[region.segment].size(), 1);
+                EXPECT_GT(region.first_index, 0);
+                EXPECT_LT(region.last_index,
+                          eds_segments[region.segment][0].size() - 1);
+                EXPECT_LT(region.sum, -penalty);
+                EXPECT_EQ(skipping_scores[region.segment][0][region.last_index],
+                          scores[region.segment][0][region.last_index]);
+            }
+        }
+    }
+    EXPECT_GT(num_graphs_with_regions, 50);
+
+    eds_matrix eds_segments = EDSToMatrix("_AAAAGC_");
+    weight_matrix weights = getGCContentWeights(eds_segments);
+    EXPECT_THROW(findUnprofitableRegions(eds_segments, weights, -1),
+                 invalid_argument);
+    UnprofitableRegions regions =
+        findUnprofitableRegions(eds_segments, weights, 1);
+    ASSERT_EQ(regions.regions.size(), 1);
+    EXPECT_EQ(regions.regions[0].first_index, 1);
+    EXPECT_EQ(regions.regions[0].last_index, 4);
+    EXPECT_EQ(regions.regions[0].sum, -4);
+    EXPECT_EQ(regions.regions[0].max_suffix_sum, -1);
+    auto scores = initScoreMatrix(weights);
+    auto choices = initScoreMatrix(weights);
+    EXPECT_THROW(findMaxScoringPaths(eds_segments, weights, scores, choices, 2,
+                                     regions),
+                 invalid_argument);
+}
+
+// Returns random disjoint paths of the graph, walks from random vertices that
+// stop at a used vertex.
+vector<vector<Vertex>> randomPaths(mt19937 &random,
+                                   const eds_matrix &eds_segments) {
+    set<tuple<int, int, int>> used;
+    vector<vector<Vertex>> paths;
+    for (int i = random() % 8; i > 0; i--) {
+        int segment = random() % eds_segments.size();
+        int layer = random() % eds_segments[segment].size();
+        int index = random() % eds_segments[segment][layer].size();
+        vector<Vertex> path;
+        while (used.insert({segment, layer, index}).second &&
+               random() % 8 != 0) {
+            path.emplace_back(segment, layer, index);
+            if (index + 1 < eds_segments[segment][layer].size()) {
+                index++;
+            } else if (segment + 1 < eds_segments.size()) {
+                segment++;
+                layer = random() % eds_segments[segment].size();
+                index = 0;
+            } else {
+                break;
+            }
+        }
+        paths.push_back(path);
+    }
+    return paths;
+}
+
+TEST(PathScoreIndex, ScoreTest) {
+    mt19937 random(17);
+    for (int i = 0; i < 200; i++) {
+        eds_matrix eds_segments =
+            EDSToMatrix(EMPTY_STR + randomEDSText(random, 5, 4) + EMPTY_STR);
+        weight_matrix weights = getGCContentWeights(eds_segments, 3, -2);
+        PathScoreIndex index(eds_segments, weights);
+        EXPECT_EQ(index.numVertices(), linearizedGraphLength(eds_segments));
+
+        auto scores = initScoreMatrix(weights);
+        auto choices = initScoreMatrix(weights);
+        findMaxScoringPaths(eds_segments, weights, scores, choices, 2);
+        for (const auto &paths :
+             {getPaths(eds_segments, scores, choices),
+              randomPaths(random, eds_segments)}) {
+            compact_paths compressed = compressPaths(paths);
+            int64_t paths_score = 0;
+            for (size_t j = 0; j < paths.size(); j++) {
+                int64_t path_weight = 0;
+                for (const Vertex &v : paths[j]) {
+                    path_weight += weights[v.segment][v.layer][v.index];
+                }
+                EXPECT_EQ(index.weight(compressed[j]), path_weight);
+                paths_score += paths[j].empty() ? 0 : path_weight - 2;
+            }
+            EXPECT_EQ(index.score(compressed, 2), paths_score);
+        }
+        EXPECT_NO_THROW(
+            index.validate(compressPaths(randomPaths(random, eds_segments))));
+    }
+}
+
+TEST(PathScoreIndex, ValidateTest) {
+    eds_matrix eds_segments = EDSToMatrix("_AC{GT,A}TT_");
+    weight_matrix weights = getGCContentWeights(eds_segments);
+    PathScoreIndex index(eds_segments, weights);
+    compact_paths paths = {{{0, 0, 1, 2}, {1, 0, 0, 1}, {2, 0, 0, 1}},
+                           {{1, 1, 0, 0}}};
+    EXPECT_NO_THROW(index.validate(paths));
+    // AC GT TT and A.
+    EXPECT_EQ(index.score(paths, 1), (0 + 0 - 2) - 1 + (-1) - 1);
+
+    // No edge between the layers, or from the middle of a segment.
+    EXPECT_THROW(index.validate({{{1, 0, 0, 1}, {1, 1, 0, 0}}}),
+                 invalid_argument);
+    EXPECT_THROW(index.validate({{{0, 0, 1, 1}, {1, 0, 0, 1}}}),
+                 invalid_argument);
+    EXPECT_THROW(index.validate({{{1, 0, 1, 1}, {2, 0, 1, 1}}}),
+                 invalid_argument);
+    // Shared vertices.
+    EXPECT_THROW(index.validate({{{0, 0, 0, 2}}, {{0, 0, 2, 2}}}),
+                 invalid_argument);
+    EXPECT_THROW(index.validate({{{2, 0, 0, 2}}, {{0, 0, 0, 2}, {1, 0, 0, 0}},
+                                 {{2, 0, 1, 1}}}),
+                 invalid_argument);
+    EXPECT_THROW(index.validate({{{2, 0, 0, 0}, {2, 0, 0, 1}}}),
+                 invalid_argument);
+    // Not in the graph.
+    EXPECT_THROW(index.validate({{{1, 2, 0, 0}}}), invalid_argument);
+    EXPECT_THROW(index.validate({{{0, 0, 2, 1}}}), invalid_argument);
+    EXPECT_THROW(index.weight(PathInterval{3, 0, 0, 0}), out_of_range);
+
+    weights.pop_back();
+    EXPECT_THROW(PathScoreIndex(eds_segments, weights), invalid_argument);
+}
+
+TEST(OnlineTraceback, PathsTest) {
+    mt19937 random(19);
+    for (int i = 0; i < 200; i++) {
+        eds_matrix eds_segments =
+            EDSToMatrix(EMPTY_STR + randomEDSText(random, 30, 4) + EMPTY_STR);
+        weight_matrix weights = getGCContentWeights(eds_segments, 1, -2);
+        for (int penalty : {0, 3}) {
+            score_matrix scores = initScoreMatrix(weights);
+            score_matrix choices = initScoreMatrix(weights);
+            int score = findMaxScoringPaths(eds_segments, weights, scores,
+                                            choices, penalty);
+            auto paths = getPaths(eds_segments, scores, choices);
+            reverse(paths.begin(), paths.end());
+            for (int64_t interval : {1, 16, 1 << 16}) {
+                OnlineMaxScorePaths<int> online(penalty, interval);
+                vector<vector<Vertex>> online_paths;
+                // The graph grows by a few segments at a time.
+                eds_matrix graph;
+                weight_matrix graph_weights;
+                for (size_t segment = 0; segment < eds_segments.size();
+                     segment++) {
+                    graph.push_back(eds_segments[segment]);
+                    graph_weights.push_back(weights[segment]);
+                    if (random() % 3 == 0) {
+                        online.extend(graph, graph_weights, online_paths);
+                    }
+                }
+                online.extend(graph, graph_weights, online_paths);
+                EXPECT_EQ(online.finish(graph, online_paths), score);
+                EXPECT_EQ(online_paths, paths);
+                EXPECT_EQ(online.keptVertices(), 0);
+            }
+        }
+    }
+}
+
+TEST(OnlineTraceback, BoundedMemoryTest) {
+    string EDS(1, EMPTY_STR);
+    for (int i = 0; i < 2000; i++) {
+        EDS += "GCGCAAAAAAAA{GC,A,TT}";
+    }
+    EDS += EMPTY_STR;
+    eds_matrix eds_segments = EDSToMatrix(EDS);
+    weight_matrix weights = getGCContentWeights(eds_segments, 1, -2);
+    score_matrix scores = initScoreMatrix(weights);
+    score_matrix choices = initScoreMatrix(weights);
+    int score = findMaxScoringPaths(eds_segments, weights, scores, choices, 3);
+    auto paths = getPaths(eds_segments, scores, choices);
+    reverse(paths.begin(), paths.end());
+
+    OnlineMaxScorePaths<int> online(3, 64);
+    vector<vector<Vertex>> online_paths;
+    online.extend(eds_segments, weights, online_paths);
+    // Most paths are final before the end of the graph.
+    EXPECT_GT(online_paths.size(), paths.size() * 9 / 10);
+    EXPECT_LT(online.maxKeptVertices(), 1000);
+    EXPECT_EQ(online.finish(eds_segments, online_paths), score);
+    EXPECT_EQ(online_paths, paths);
+
+    PipelineOptions options;
+    options.read_bytes = 100;
+    options.online_traceback = true;
+    istringstream input(EDS.substr(1, EDS.size() - 2));
+    PipelineResult<int> result =
+        runPipeline<int>(input, EDS.size(), 1, -2, 3, options);
+    EXPECT_EQ(result.score, score);
+    reverse(paths.begin(), paths.end());
+    EXPECT_EQ(result.paths, paths);
+}
@@ -1,14 +1,25 @@
 #include "utility_func.hpp"
 
+#include "compressed_input.hpp"
+#include "weight_track.hpp"
+
 #include <math.h>
 
+#include <algorithm>
 #include <cassert>
 #include <climits>
+#include <cstring>
+#include <exception>
 #include <fstream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <tuple>
+#include <unordered_map>
 #include <vector>
 
 using namespace std;
@@ -21,6 +32,16 @@ string readEDSFile(const string &file_path) {
         return "";
     }
     assert(input_stream.good());
+    if (detectCompression(file_path) != Compression::NONE) {
+        unique_ptr<istream> input = openDecompressed(file_path);
+        string text(1, EMPTY_STR);
+        vector<char> buffer(1 << 20);
+        while (input->read(buffer.data(), buffer.size()) ||
+               input->gcount() > 0) {
+            text.append(buffer.data(), input->gcount());
+        }
+        return text + EMPTY_STR;
+    }
     return EMPTY_STR +
            static_cast<stringstream const &>(stringstream()
                                              << input_stream.rdbuf())
@@ -28,691 +49,2003 @@ string readEDSFile(const string &file_path) {
            EMPTY_STR;
 }
 
-eds_matrix EDSToMatrix(const string &EDS) {
-    eds_matrix eds_segments;
-    vector<string> current_segment;
-    string current_string;
-    bool in_nondet_segment = false;
+// Parsing of EDS text through a structural index, as simdjson parses JSON:
+// the first stage classifies blocks of 64 bytes at once into a bit mask of the
+// structural characters `{`, `}` and `,` and collects their positions, the
+// second stage cuts the segments and layers between consecutive structural
+// characters without looking at the other characters. Both stages run on
+// chunks of the text in parallel.
+
+const int EDS_BLOCK_BYTES = 64;
+// The smallest part of the text worth a thread.
+const int64_t EDS_PARSE_CHUNK_BYTES = 1 << 22;
+
+// Returns 0x80 in the bytes of `word` equal to `byte` and 0 in the others.
+inline uint64_t equalBytes(uint64_t word, uint8_t byte) {
+    const uint64_t low_bits = 0x7f7f7f7f7f7f7f7fULL;
+    uint64_t diff = word ^ (0x0101010101010101ULL * byte);
+    return ~(((diff & low_bits) + low_bits) | diff | low_bits);
+}
 
-    for (int i = 0; i < EDS.length(); i++) {
-        char c = EDS[i];
-        // Inside a string or segment.
-        if (c != '{' && c != '}') {
-            // Commas can be only inside segments.
-            assert(in_nondet_segment || c != ',');
+// Returns the bit mask of the structural characters of the `EDS_BLOCK_BYTES`
+// bytes at `block`, bit i for byte i. Classifies 8 bytes at a time in a
+// 64-bit word, without branches.
+inline uint64_t structuralMask(const char *block) {
+    uint64_t mask = 0;
+    for (int word_index = 0; word_index < EDS_BLOCK_BYTES / 8; word_index++) {
+        uint64_t word;
+        memcpy(&word, block + 8 * word_index, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        word = __builtin_bswap64(word);
+#endif
+        uint64_t high_bits = equalBytes(word, '{') | equalBytes(word, '}') |
+                             equalBytes(word, ',');
+        // Gathers the high bit of byte i into bit 56 + i.
+        uint64_t bits = ((high_bits >> 7) * 0x0102040810204080ULL) >> 56;
+        mask |= bits << (8 * word_index);
+    }
+    return mask;
+}
 
-            if (c == ',') {
-                // Empty layers are are denoted by a vertex with value
-                // `EMPTY_STR`.
-                if (current_string.empty()) {
-                    current_string += EMPTY_STR;
-                }
-                current_segment.emplace_back(current_string);
-                current_string.clear();
-            } else {
-                current_string += c;
-            }
+// Appends the positions of the structural characters of `EDS[begin..end)` to
+// `structurals`. `begin` is a multiple of `EDS_BLOCK_BYTES`.
+void indexStructurals(const string &EDS, int64_t begin, int64_t end,
+                      vector<int64_t> &structurals) {
+    char padded[EDS_BLOCK_BYTES];
+    for (int64_t block = begin; block < end; block += EDS_BLOCK_BYTES) {
+        const char *data = EDS.data() + block;
+        if (end - block < EDS_BLOCK_BYTES) {
+            memset(padded, 0, EDS_BLOCK_BYTES);
+            memcpy(padded, data, end - block);
+            data = padded;
+        }
+        for (uint64_t mask = structuralMask(data); mask != 0;
+             mask &= mask - 1) {
+            structurals.push_back(block + __builtin_ctzll(mask));
         }
+    }
+}
+
+// Throws `invalid_argument` for malformed EDS text at `position`.
+[[noreturn]] void throwMalformedEDS(const string &problem, int64_t position) {
+    throw invalid_argument("Malformed EDS text: " + problem + " at offset " +
+                           to_string(position) + ".");
+}
+
+// Appends the segments between `structurals[first..last)` to `eds_segments`.
+// The text of the first segment starts at `text_start`, outside of a
+// non-deterministic segment. If `to_end`, the text after the last structural
+// character is the last segment. Throws `invalid_argument` for a `,` or `}`
+// outside of a non-deterministic segment, a `{` inside of one, or one that is
+// not closed.
+void buildSegments(const string &EDS, const vector<int64_t> &structurals,
+                   size_t first, size_t last, int64_t text_start, bool to_end,
+                   eds_matrix &eds_segments) {
+    // A bubble and the deterministic segment before it per `{`.
+    size_t num_bubbles = 0;
+    for (size_t i = first; i < last; i++) {
+        num_bubbles += EDS[structurals[i]] == '{';
+    }
+    eds_segments.reserve(eds_segments.size() + 2 * num_bubbles + 1);
+
+    // Start of the text of the current deterministic segment or layer.
+    int64_t start = text_start;
+    vector<string> layers;
+    // The `{` of the current non-deterministic segment, or -1 outside.
+    int64_t open = -1;
+    for (size_t i = first; i < last; i++) {
+        int64_t position = structurals[i];
+        char c = EDS[position];
         // Start of a non-deterministic segment.
-        else if (c == '{') {
-            assert(!in_nondet_segment && current_segment.empty());
-            in_nondet_segment = true;
-            // Starts after another non-deterministic segment: separate them
-            // with with an empty deterministic segment.
-            if (i > 0 && EDS[i - 1] == '}') {
-                eds_segments.emplace_back(vector<string>{string(1, EMPTY_STR)});
+        if (c == '{') {
+            if (open >= 0) {
+                throwMalformedEDS("nested '{'", position);
             }
+            open = position;
             // Starts after a deterministic segment.
-            if (!current_string.empty()) {
-                eds_segments.emplace_back(vector<string>{move(current_string)});
-                current_string.clear();
+            if (position > start) {
+                eds_segments.emplace_back(
+                    1, EDS.substr(start, position - start));
+            }
+            // Starts after another non-deterministic segment: separate them
+            // with an empty deterministic segment.
+            else if (position > 0 && EDS[position - 1] == '}') {
+                eds_segments.emplace_back(1, string(1, EMPTY_STR));
             }
         }
-        // End of a segment.
+        // End of a layer. Empty layers are denoted by a vertex with value
+        // `EMPTY_STR`.
         else {
-            assert(c == '}' && in_nondet_segment && !current_segment.empty());
-            // Empty layers are are denoted by a vertex with value `EMPTY_STR`.
-            if (current_string.empty()) {
-                current_string += EMPTY_STR;
+            if (open < 0) {
+                throwMalformedEDS(string("'") + c + "' outside of '{...}'",
+                                  position);
             }
-            current_segment.emplace_back(current_string);
-            current_string.clear();
-
-            eds_segments.emplace_back(current_segment);
-            current_segment.clear();
+            layers.push_back(position > start
+                                 ? EDS.substr(start, position - start)
+                                 : string(1, EMPTY_STR));
+            if (c == '}') {
+                eds_segments.push_back(move(layers));
+                layers.clear();
+                open = -1;
+            }
+        }
+        start = position + 1;
+    }
+    // The chunks end after a `}` unless they reach the end of the text.
+    if (open >= 0) {
+        throwMalformedEDS("'{' without '}'", open);
+    }
+    // EDS ended with a deterministic string.
+    if (to_end && start < (int64_t)EDS.size()) {
+        eds_segments.emplace_back(1, EDS.substr(start));
+    }
+}
 
-            in_nondet_segment = false;
+eds_matrix EDSToMatrix(const string &EDS, int num_threads) {
+    const int64_t size = EDS.size();
+    int64_t num_chunks = max<int64_t>(
+        1, min<int64_t>(num_threads, size / EDS_PARSE_CHUNK_BYTES));
+    // Runs `work(chunk)` for every chunk, in parallel if there are more.
+    // Rethrows the exception of the first chunk that failed.
+    auto forEachChunk = [num_chunks](const auto &work) {
+        vector<exception_ptr> errors(num_chunks);
+        auto run = [&](int64_t chunk) {
+            try {
+                work(chunk);
+            } catch (...) {
+                errors[chunk] = current_exception();
+            }
+        };
+        vector<thread> threads;
+        for (int64_t chunk = 1; chunk < num_chunks; chunk++) {
+            threads.emplace_back(run, chunk);
         }
+        run(0);
+        for (auto &t : threads) {
+            t.join();
+        }
+        for (const auto &error : errors) {
+            if (error) {
+                rethrow_exception(error);
+            }
+        }
+    };
+
+    // Stage 1: the structural index of every chunk of whole blocks.
+    int64_t blocks = (size + EDS_BLOCK_BYTES - 1) / EDS_BLOCK_BYTES;
+    int64_t chunk_bytes =
+        (blocks + num_chunks - 1) / num_chunks * EDS_BLOCK_BYTES;
+    vector<vector<int64_t>> chunk_structurals(num_chunks);
+    forEachChunk([&](int64_t chunk) {
+        indexStructurals(EDS, min(size, chunk * chunk_bytes),
+                         min(size, (chunk + 1) * chunk_bytes),
+                         chunk_structurals[chunk]);
+    });
+    vector<int64_t> structurals = move(chunk_structurals[0]);
+    for (int64_t chunk = 1; chunk < num_chunks; chunk++) {
+        structurals.insert(structurals.end(), chunk_structurals[chunk].begin(),
+                           chunk_structurals[chunk].end());
     }
 
-    // EDS ended with a deterministic string.
-    if (!current_string.empty()) {
-        assert(!in_nondet_segment && current_segment.empty());
-        eds_segments.emplace_back(vector<string>{move(current_string)});
+    // Stage 2: the segments of every chunk of structural characters. The
+    // chunks end after a `}`, so every chunk starts outside of a
+    // non-deterministic segment.
+    vector<size_t> chunk_ends(num_chunks, structurals.size());
+    for (int64_t chunk = 0; chunk + 1 < num_chunks; chunk++) {
+        size_t end = max(structurals.size() * (chunk + 1) / num_chunks,
+                         chunk > 0 ? chunk_ends[chunk - 1] : 0);
+        while (end < structurals.size() && EDS[structurals[end]] != '}') {
+            end++;
+        }
+        chunk_ends[chunk] = min(end + 1, structurals.size());
+    }
+    vector<eds_matrix> chunk_segments(num_chunks);
+    forEachChunk([&](int64_t chunk) {
+        size_t first = chunk > 0 ? chunk_ends[chunk - 1] : 0;
+        int64_t text_start = first > 0 ? structurals[first - 1] + 1 : 0;
+        buildSegments(EDS, structurals, first, chunk_ends[chunk], text_start,
+                      chunk + 1 == num_chunks, chunk_segments[chunk]);
+    });
+    eds_matrix eds_segments = move(chunk_segments[0]);
+    for (int64_t chunk = 1; chunk < num_chunks; chunk++) {
+        eds_segments.insert(eds_segments.end(),
+                            make_move_iterator(chunk_segments[chunk].begin()),
+                            make_move_iterator(chunk_segments[chunk].end()));
     }
     return eds_segments;
 }
 
-vector<vector<vector<int>>> getGCContentWeights(const eds_matrix &eds_segments,
-                                                int match, int non_match) {
-    vector<vector<vector<int>>> weights;
+weight_matrix getGCContentWeights(const eds_matrix &eds_segments, int match,
+                                  int non_match,
+                                  pmr::memory_resource *resource) {
+    weight_matrix weights(resource);
     weights.reserve(eds_segments.size());
     for (const auto &segment : eds_segments) {
-        vector<vector<int>> w_segment;
+        // The inner vectors get the resource of `weights`.
+        auto &w_segment = weights.emplace_back();
         w_segment.reserve(segment.size());
         for (const auto &str : segment) {
-            vector<int> w_str(str.size(), 0);
+            auto &w_str = w_segment.emplace_back(str.size(), 0);
             for (int i = 0; i < str.size(); i++) {
-                // The `EMPTY_STR` has no biological significance.
-                if (str[i] == EMPTY_STR) {
-                    w_str[i] = 0;
-                } else {
-                    w_str[i] =
-                        (str[i] == 'G' || str[i] == 'C') ? match : non_match;
-                }
+                w_str[i] = gcContentWeight(str[i], match, non_match);
             }
-            w_segment.emplace_back(w_str);
         }
-        weights.emplace_back(w_segment);
     }
     return weights;
 }
 
-bool operator==(const Vertex &a, const Vertex &b) {
+template <typename index_t>
+bool operator==(const BasicVertex<index_t> &a, const BasicVertex<index_t> &b) {
     return tie(a.segment, a.layer, a.index) == tie(b.segment, b.layer, b.index);
 }
 
-bool operator!=(const Vertex &a, const Vertex &b) { return !(a == b); }
+template <typename index_t>
+bool operator!=(const BasicVertex<index_t> &a, const BasicVertex<index_t> &b) {
+    return !(a == b);
+}
 
-bool operator<(const Vertex &a, const Vertex &b) {
+template <typename index_t>
+bool operator<(const BasicVertex<index_t> &a, const BasicVertex<index_t> &b) {
     return tie(a.segment, a.layer, a.index) < tie(b.segment, b.layer, b.index);
 }
 
-std::ostream &operator<<(std::ostream &os, Vertex const &v) {
+template <typename index_t>
+std::ostream &operator<<(std::ostream &os, BasicVertex<index_t> const &v) {
     return os << "(" << v.segment << "," << v.layer << "," << v.index << ")";
 }
 
-Vertex getLastVertex(const eds_matrix &eds_segments) {
-    int last_segment = eds_segments.size() - 1;
-    int last_index = eds_segments[last_segment][0].size() - 1;
-    return Vertex(last_segment, 0, last_index);
+int64_t scoreBound(const eds_matrix &eds_segments, const weight_matrix &weights,
+                   int penalty) {
+    int64_t max_abs_weight = 0;
+    for (const auto &segment : weights) {
+        for (const auto &layer : segment) {
+            for (int weight : layer) {
+                max_abs_weight = max(max_abs_weight, abs((int64_t)weight));
+            }
+        }
+    }
+    return scoreBound(linearizedGraphLength(eds_segments), max_abs_weight,
+                      penalty);
+}
+
+int64_t scoreBound(const eds_matrix &eds_segments, const WeightTrack &track,
+                   int penalty) {
+    // The track was checked to have the vertices of the graph when mapped.
+    return scoreBound(linearizedGraphLength(eds_segments),
+                      track.maxAbsWeight(), penalty);
+}
+
+int64_t scoreBound(int64_t num_vertices, int64_t max_abs_weight, int penalty) {
+    int64_t per_vertex = max_abs_weight + abs((int64_t)penalty);
+    if (per_vertex != 0 && num_vertices > INT64_MAX / per_vertex) {
+        return INT64_MAX;
+    }
+    return num_vertices * per_vertex;
+}
+
+// The J vertex kernel adds up to four scores of the bound (the base score and
+// two differences), keep a margin for that.
+const int64_t SCORE_BOUND_MARGIN = 8;
+
+// Returns the largest choice code stored by the DP for a bubble with
+// `num_preds` layers, see `combineJVertexGroups()`.
+int64_t maxChoiceCode(int64_t num_preds) {
+    return num_preds * num_preds + 3 * num_preds;
+}
+
+template <typename score_t>
+bool fitsScoreType(int64_t bound, int64_t max_bubble_width) {
+    const int64_t type_max = numeric_limits<score_t>::max();
+    return bound <= type_max / SCORE_BOUND_MARGIN &&
+           maxChoiceCode(max_bubble_width) <= type_max;
+}
+
+int64_t maxBubbleWidth(const eds_matrix &eds_segments) {
+    int64_t width = 1;
+    for (const auto &segment : eds_segments) {
+        width = max(width, (int64_t)segment.size());
+    }
+    return width;
+}
+
+ScoreWidth selectScoreWidth(const eds_matrix &eds_segments,
+                            const weight_matrix &weights, int penalty) {
+    return selectScoreWidth(scoreBound(eds_segments, weights, penalty),
+                            maxBubbleWidth(eds_segments));
+}
+
+ScoreWidth selectScoreWidth(const eds_matrix &eds_segments,
+                            const WeightTrack &track, int penalty) {
+    return selectScoreWidth(scoreBound(eds_segments, track, penalty),
+                            maxBubbleWidth(eds_segments));
+}
+
+ScoreWidth selectScoreWidth(int64_t bound, int64_t width) {
+    if (fitsScoreType<int16_t>(bound, width)) {
+        return ScoreWidth::INT16;
+    }
+    if (fitsScoreType<int32_t>(bound, width)) {
+        return ScoreWidth::INT32;
+    }
+    if (fitsScoreType<int64_t>(bound, width)) {
+        return ScoreWidth::INT64;
+    }
+    throw overflow_error("Scores of the graph do not fit into 64 bits.");
+}
+
+IndexWidth selectIndexWidth(const eds_matrix &eds_segments) {
+    int64_t max_coordinate = eds_segments.size();
+    for (const auto &segment : eds_segments) {
+        max_coordinate = max(max_coordinate, (int64_t)segment.size());
+        for (const auto &layer : segment) {
+            max_coordinate = max(max_coordinate, (int64_t)layer.size());
+        }
+    }
+    return max_coordinate <= numeric_limits<int32_t>::max()
+               ? IndexWidth::INT32
+               : IndexWidth::INT64;
+}
+
+// Fails loudly instead of silently overflowing, if the types are too narrow.
+// `weights` is a `weight_matrix` or a `WeightTrack`.
+template <typename score_t, typename index_t, typename weights_t>
+void checkTypeWidths(const eds_matrix &eds_segments, const weights_t &weights,
+                     int penalty) {
+    if (!fitsScoreType<score_t>(scoreBound(eds_segments, weights, penalty),
+                                maxBubbleWidth(eds_segments))) {
+        throw overflow_error("Score type is too narrow for the graph, use " +
+                             string("selectScoreWidth()."));
+    }
+    if (sizeof(index_t) < sizeof(int64_t) &&
+        selectIndexWidth(eds_segments) == IndexWidth::INT64) {
+        throw overflow_error("Index type is too narrow for the graph, use " +
+                             string("selectIndexWidth()."));
+    }
+}
+
+template <typename index_t>
+BasicVertex<index_t> getLastVertex(const eds_matrix &eds_segments) {
+    index_t last_segment = eds_segments.size() - 1;
+    index_t last_index = eds_segments[last_segment][0].size() - 1;
+    return BasicVertex<index_t>(last_segment, 0, last_index);
 }
 
-bool isLayerVertex(Vertex v, const eds_matrix &eds_segments) {
+template <typename index_t>
+bool isLayerVertex(BasicVertex<index_t> v, const eds_matrix &eds_segments) {
     return eds_segments[v.segment].size() > 1;
 }
 
-bool isFirstLayerVertex(Vertex v, const eds_matrix &eds_segments) {
+template <typename index_t>
+bool isFirstLayerVertex(BasicVertex<index_t> v,
+                        const eds_matrix &eds_segments) {
     return isLayerVertex(v, eds_segments) && v.layer == 0;
 }
 
-bool isVertexFirstOnLayer(Vertex v, const eds_matrix &eds_segments) {
+template <typename index_t>
+bool isVertexFirstOnLayer(BasicVertex<index_t> v,
+                          const eds_matrix &eds_segments) {
     return isLayerVertex(v, eds_segments) && v.index == 0;
 }
 
-bool isJVertex(Vertex v, const eds_matrix &eds_segments) {
+template <typename index_t>
+bool isJVertex(BasicVertex<index_t> v, const eds_matrix &eds_segments) {
     return !isLayerVertex(v, eds_segments) &&
            (v.index == 0 && v.segment > 0 &&
             eds_segments[v.segment - 1].size() > 1);
 }
 
-bool isNVertex(Vertex v, const eds_matrix &eds_segments) {
+template <typename index_t>
+bool isNVertex(BasicVertex<index_t> v, const eds_matrix &eds_segments) {
     return !isLayerVertex(v, eds_segments) && !isJVertex(v, eds_segments);
 }
 
-bool hasPredecessorVertex(Vertex v) {
+template <typename index_t>
+bool hasPredecessorVertex(BasicVertex<index_t> v) {
     return !(v.segment == 0 && v.index == 0);
 }
 
-Vertex getPredecessorVertex(const eds_matrix &eds_segments, Vertex v,
-                            int predecessor_layer) {
+template <typename index_t>
+BasicVertex<index_t> getPredecessorVertex(const eds_matrix &eds_segments,
+                                          BasicVertex<index_t> v,
+                                          int64_t predecessor_layer) {
     assert(hasPredecessorVertex(v));
     if (v.index != 0) {
         return {v.segment, v.layer, v.index - 1};
     }
-    return {v.segment - 1, predecessor_layer,
-            static_cast<int>(
+    return {v.segment - 1, static_cast<index_t>(predecessor_layer),
+            static_cast<index_t>(
                 eds_segments[v.segment - 1][predecessor_layer].size() - 1)};
 }
 
-int getScore(score_matrix &scores, Vertex v, bool surely_selected,
-             path_continuation path_goes) {
+template <typename score_t, typename index_t>
+score_t getScore(basic_score_matrix<score_t> &scores, BasicVertex<index_t> v,
+                 bool surely_selected, path_continuation path_goes) {
     return scores[v.segment][v.layer][v.index][surely_selected][path_goes];
 }
 
-int getChoice(score_matrix &choices, Vertex v, bool surely_selected,
-              path_continuation path_goes) {
+template <typename score_t, typename index_t>
+int getChoice(basic_score_matrix<score_t> &choices, BasicVertex<index_t> v,
+              bool surely_selected, path_continuation path_goes) {
     return choices[v.segment][v.layer][v.index][surely_selected][path_goes];
 }
 
-int getWeight(const weight_matrix &weights, Vertex v) {
+template <typename index_t>
+int getWeight(const weight_matrix &weights, BasicVertex<index_t> v) {
+    return weights[v.segment][v.layer][v.index];
+}
+
+template <typename index_t>
+int getWeight(const WeightTrack &track, BasicVertex<index_t> v) {
+    return track[v.segment][v.layer][v.index];
+}
+
+// The GC content weights of a graph, computed when read instead of stored as
+// by `getGCContentWeights()`. Indexed as a `weight_matrix`.
+class GCContentWeights {
+   public:
+    class Layer {
+       public:
+        Layer(const string &layer, int match, int non_match)
+            : layer_(layer), match_(match), non_match_(non_match) {}
+
+        size_t size() const { return layer_.size(); }
+        int operator[](size_t index) const {
+            return gcContentWeight(layer_[index], match_, non_match_);
+        }
+
+       private:
+        const string &layer_;
+        int match_;
+        int non_match_;
+    };
+
+    class Segment {
+       public:
+        Segment(const vector<string> &segment, int match, int non_match)
+            : segment_(segment), match_(match), non_match_(non_match) {}
+
+        size_t size() const { return segment_.size(); }
+        Layer operator[](size_t layer) const {
+            return Layer(segment_[layer], match_, non_match_);
+        }
+
+       private:
+        const vector<string> &segment_;
+        int match_;
+        int non_match_;
+    };
+
+    GCContentWeights(const eds_matrix &eds_segments, int match, int non_match)
+        : eds_segments_(eds_segments), match_(match), non_match_(non_match) {}
+
+    size_t size() const { return eds_segments_.size(); }
+    Segment operator[](size_t segment) const {
+        return Segment(eds_segments_[segment], match_, non_match_);
+    }
+
+   private:
+    const eds_matrix &eds_segments_;
+    int match_;
+    int non_match_;
+};
+
+template <typename index_t>
+int getWeight(const GCContentWeights &weights, BasicVertex<index_t> v) {
     return weights[v.segment][v.layer][v.index];
 }
 
-pair<int, int> max_score(int first_score, int second_score) {
+pair<int64_t, int> max_score(int64_t first_score, int64_t second_score) {
     return first_score > second_score ? make_pair(first_score, FIRST)
                                       : make_pair(second_score, SECOND);
 }
 
-void setScoreAndChoice(score_matrix &scores, score_matrix &choices,
-                       pair<int, int> score_choice, Vertex v, bool selected,
-                       path_continuation layer = I) {
+template <typename score_t, typename index_t>
+void setScoreAndChoice(basic_score_matrix<score_t> &scores,
+                       basic_score_matrix<score_t> &choices,
+                       pair<int64_t, int> score_choice, BasicVertex<index_t> v,
+                       bool selected, path_continuation layer) {
     scores[v.segment][v.layer][v.index][selected][layer] = score_choice.first;
     choices[v.segment][v.layer][v.index][selected][layer] = score_choice.second;
 }
 
-// vector<vector<vector<vector<vector<int>>>>>
+// pmr::vector<pmr::vector<pmr::vector<array<array<score_t, 2>, 2>>>>
 // [segment][layer][index][{SURELY_SELECTED, !SURELY_SELECTED}][I, E]
-score_matrix initScoreMatrix(const weight_matrix &weights) {
-    score_matrix scores;
+template <typename score_t, typename weights_t>
+basic_score_matrix<score_t> initScoreMatrixFor(const weights_t &weights,
+                                               pmr::memory_resource *resource) {
+    basic_score_matrix<score_t> scores(resource);
+    // The inner vectors get the resource of `scores`.
     scores.resize(weights.size());
-    for (int segment = 0; segment < weights.size(); segment++) {
+    for (size_t segment = 0; segment < weights.size(); segment++) {
         scores[segment].resize(weights[segment].size());
-        for (int layer = 0; layer < weights[segment].size(); layer++) {
+        for (size_t layer = 0; layer < weights[segment].size(); layer++) {
+            // One cell of 2x2 scores for (!)SURELY_SELECTED and path
+            // continuation I or E.
             scores[segment][layer].resize(weights[segment][layer].size());
-            for (int index = 0; index < weights[segment][layer].size();
-                 index++) {
-                // Dimension of size 2 for (!)SURELY_SELECTED.
-                scores[segment][layer][index].resize(2);
-                // Dimension of size 2 for path continuation I or E.
-                scores[segment][layer][index][0].resize(2);
-                scores[segment][layer][index][1].resize(2);
-            }
         }
     }
     return scores;
 }
 
-int findMaxScoringPaths(const eds_matrix &eds_segments,
-                        const weight_matrix &weights, score_matrix &scores,
-                        score_matrix &choices, int penalty = -1) {
-    for (int segment = 0; segment < eds_segments.size(); segment++) {
-        for (int layer = 0; layer < eds_segments[segment].size(); layer++) {
-            for (int index = 0; index < eds_segments[segment][layer].size();
-                 index++) {
-                Vertex a{segment, layer, index};
+template <typename score_t>
+basic_score_matrix<score_t> initScoreMatrix(const weight_matrix &weights,
+                                            pmr::memory_resource *resource) {
+    return initScoreMatrixFor<score_t>(weights, resource);
+}
+
+template <typename score_t>
+basic_score_matrix<score_t> initScoreMatrix(const WeightTrack &track,
+                                            pmr::memory_resource *resource) {
+    return initScoreMatrixFor<score_t>(track, resource);
+}
+
+// J vertex kernel.
+//
+// All rules of a J vertex `a` with predecessors p1, ..., pb are expressed
+// relative to the base score W(p1, 0, E) + W(p2, 0, E) + ... + W(pb, 0, E).
+// Exchanging the term of a predecessor p_i changes the base score by one of
+// the following differences:
+// - W(p_i, 0, I) - W(p_i, 0, E): the path continues on layer L_i;
+// - W(p_i, 1, I) - W(p_i, 0, E): p_i is selected and the path continues on L_i;
+// - W(p_i, 1, E) - W(p_i, 0, E): p_i is selected and the path continues on a
+//   different layer.
+// The differences are gathered once per J vertex into a scratch buffer that is
+// reused for the whole graph. Then all groups of the rules are evaluated in a
+// single pass that tracks the best (and second best) differences.
+
+// Scratch buffer holding the predecessor scores of the current J vertex.
+template <typename score_t>
+struct JPredecessorScores {
+    score_t base_score;
+    vector<score_t> diff_0_I;
+    vector<score_t> diff_1_I;
+    vector<score_t> diff_1_E;
+};
+
+// Bubbles at least this wide are reduced in lanes that fill
+// `J_KERNEL_LANE_BYTES` bytes, i.e. narrower scores get more lanes.
+const int J_KERNEL_SIMD_MIN_WIDTH = 16;
+const int J_KERNEL_LANE_BYTES = 32;
+
+// `pred_cell(i)` returns the cell of scores of the predecessor on layer i.
+template <typename pred_cell_t, typename score_t>
+void gatherJPredecessorScores(const pred_cell_t &pred_cell, int num_preds,
+                              JPredecessorScores<score_t> &preds) {
+    // Only grows, the buffer keeps the capacity of the widest bubble so far.
+    if (preds.diff_0_I.size() < num_preds) {
+        preds.diff_0_I.resize(num_preds);
+        preds.diff_1_I.resize(num_preds);
+        preds.diff_1_E.resize(num_preds);
+    }
+    score_t base_score = 0;
+    for (int i = 0; i < num_preds; i++) {
+        const score_cell<score_t> &p_scores = pred_cell(i);
+        score_t score_p_0_E = p_scores[!SURELY_SELECTED][E];
+        base_score += score_p_0_E;
+        preds.diff_0_I[i] = p_scores[!SURELY_SELECTED][I] - score_p_0_E;
+        preds.diff_1_I[i] = p_scores[SURELY_SELECTED][I] - score_p_0_E;
+        preds.diff_1_E[i] = p_scores[SURELY_SELECTED][E] - score_p_0_E;
+    }
+    preds.base_score = base_score;
+}
+
+// The largest and second largest value of a sequence with their positions. On
+// equal values the smaller position is preferred, which corresponds to a
+// sequential scan that only replaces on a strictly larger value.
+template <typename score_t>
+struct TopTwo {
+    void push(score_t value, int pos) {
+        if (value > max_value) {
+            second_value = max_value;
+            second_pos = max_pos;
+            max_value = value;
+            max_pos = pos;
+        } else if (value > second_value) {
+            second_value = value;
+            second_pos = pos;
+        }
+    }
+
+    // Adds a candidate that may come from any position of the sequence.
+    void merge(score_t value, int pos) {
+        if (pos == -1) {
+            return;
+        }
+        if (value > max_value || (value == max_value && pos < max_pos)) {
+            second_value = max_value;
+            second_pos = max_pos;
+            max_value = value;
+            max_pos = pos;
+        } else if (value > second_value ||
+                   (value == second_value && pos < second_pos)) {
+            second_value = value;
+            second_pos = pos;
+        }
+    }
+
+    score_t max_value = numeric_limits<score_t>::min();
+    int max_pos = -1;
+    score_t second_value = numeric_limits<score_t>::min();
+    int second_pos = -1;
+};
+
+// Scores and choices of a J vertex, `score_1` does not contain w(a).
+template <typename score_t>
+struct JVertexScores {
+    score_t score_1;
+    int choice_1;
+    score_t score_0;
+    int choice_0;
+};
+
+// Evaluates the rules of the J vertex from the best differences.
+template <typename score_t>
+JVertexScores<score_t> combineJVertexGroups(score_t base_score,
+                                            const TopTwo<score_t> &top_0_I,
+                                            const TopTwo<score_t> &top_1_I,
+                                            const TopTwo<score_t> &top_1_E,
+                                            int num_preds, int penalty) {
+    // Group 1: no predecessor vertex is selected:
+    // group_1 = max{
+    //      W(p1, 0, I) + W(p2, 0, E) +...+ W(pb, 0, E) - x,
+    //      W(p1, 0, E) + W(p2, 0, I) +...+ W(pb, 0, E) - x,
+    //                         ...
+    //      W(p1, 0, E) + W(p2, 0, E) +...+ W(pb, 0, I) - x }
+    // Code the choice: i.
+    score_t score_1 = base_score + top_0_I.max_value - penalty;
+    int choice_1 = top_0_I.max_pos;
+
+    // Group 2: predecessor p_i is selected and the path continues on
+    // layer L_i: group_2 = max{
+    //      W(p1, 1, I) + W(p2, 0, E) +...+ W(pb, 0, E),
+    //      W(p1, 0, E) + W(p2, 1, I) +...+ W(pb, 0, E),
+    //                         ...
+    //      W(p1, 0, E) + W(p2, 0, E) +...+ W(pb, 1, I) }
+    // Code the choice: b + i.
+    score_t group_2 = base_score + top_1_I.max_value;
+    if (score_1 < group_2) {
+        score_1 = group_2;
+        choice_1 = num_preds + top_1_I.max_pos;
+    }
+
+    // Group 3: predecessor p_k is selected and the path continues on layer
+    // L_i, i ≠ k. Take the predecessors with the largest differences, if they
+    // are the same, try the second best ones instead.
+    // Code the choice as: 2b + b*k + i.
+    if (top_0_I.max_pos != top_1_E.max_pos) {
+        score_t group_3 = base_score + top_0_I.max_value + top_1_E.max_value;
+        if (score_1 < group_3) {
+            score_1 = group_3;
+            choice_1 = 2 * num_preds + num_preds * top_1_E.max_pos +
+                       top_0_I.max_pos;
+        }
+    } else {
+        score_t group_3 =
+            base_score + top_0_I.max_value + top_1_E.second_value;
+        if (score_1 < group_3) {
+            score_1 = group_3;
+            choice_1 = 2 * num_preds + num_preds * top_1_E.second_pos +
+                       top_0_I.max_pos;
+        }
+        group_3 = base_score + top_0_I.second_value + top_1_E.max_value;
+        if (score_1 < group_3) {
+            score_1 = group_3;
+            choice_1 = 2 * num_preds + num_preds * top_1_E.max_pos +
+                       top_0_I.second_pos;
+        }
+    }
+
+    // W(a, 0) = max{
+    //      W(p1, 0, I) + W(p2, 0, E) +...+ W(pb, 0, E),
+    //                         ...
+    //      W(p1, 0, E) + W(p2, 0, E) +...+ W(pb, 0, I),
+    //      W(a, 1)
+    // where b is the number of layers in the current bubble.
+    score_t score_0 = base_score + top_0_I.max_value;
+    int choice_0 = top_0_I.max_pos;
+    if (score_0 < score_1) {
+        score_0 = score_1;
+        // For non-ambiguous decoding to get the paths, store choice
+        // `choice_1` here "moved" by `num_preds`: i.e. if choice_0 >=
+        // num_preds, then decode choice_0 - num_preds based on W(a, 1) rules.
+        choice_0 = num_preds + choice_1;
+    }
+    return {score_1, choice_1, score_0, choice_0};
+}
+
+// Scalar kernel, `WIDTH` > 0 fixes the number of predecessors at compile time
+// so the loop is fully unrolled.
+template <int WIDTH, typename score_t>
+JVertexScores<score_t> computeJVertexScoresScalar(
+    const JPredecessorScores<score_t> &preds, int num_preds, int penalty) {
+    const int width = WIDTH > 0 ? WIDTH : num_preds;
+    TopTwo<score_t> top_0_I, top_1_I, top_1_E;
+    for (int i = 0; i < width; i++) {
+        top_0_I.push(preds.diff_0_I[i], i);
+        top_1_I.push(preds.diff_1_I[i], i);
+        top_1_E.push(preds.diff_1_E[i], i);
+    }
+    return combineJVertexGroups(preds.base_score, top_0_I, top_1_I, top_1_E,
+                                width, penalty);
+}
+
+// Top two reduction of `values[0..size)` in independent lanes. The lane
+// updates are branch-free and the positions are kept in the score type, so the
+// compiler vectorizes the loop. `selectScoreWidth()` guarantees that the
+// positions fit into `score_t`.
+template <typename score_t>
+TopTwo<score_t> topTwoInLanes(const score_t *values, int size) {
+    const int lanes = J_KERNEL_LANE_BYTES / sizeof(score_t);
+    score_t max_value[lanes], max_pos[lanes];
+    score_t second_value[lanes], second_pos[lanes];
+    for (int lane = 0; lane < lanes; lane++) {
+        max_value[lane] = second_value[lane] = numeric_limits<score_t>::min();
+        max_pos[lane] = second_pos[lane] = -1;
+    }
+    int block_end = size - size % lanes;
+    for (int block = 0; block < block_end; block += lanes) {
+        for (int lane = 0; lane < lanes; lane++) {
+            score_t value = values[block + lane];
+            score_t pos = block + lane;
+            bool is_max = value > max_value[lane];
+            bool is_second = value > second_value[lane];
+            second_value[lane] = is_max      ? max_value[lane]
+                                 : is_second ? value
+                                             : second_value[lane];
+            second_pos[lane] = is_max      ? max_pos[lane]
+                               : is_second ? pos
+                                           : second_pos[lane];
+            max_value[lane] = is_max ? value : max_value[lane];
+            max_pos[lane] = is_max ? pos : max_pos[lane];
+        }
+    }
+    TopTwo<score_t> top;
+    for (int lane = 0; lane < lanes; lane++) {
+        top.merge(max_value[lane], max_pos[lane]);
+        top.merge(second_value[lane], second_pos[lane]);
+    }
+    for (int pos = block_end; pos < size; pos++) {
+        top.merge(values[pos], pos);
+    }
+    return top;
+}
+
+template <typename score_t>
+JVertexScores<score_t> computeJVertexScoresWide(
+    const JPredecessorScores<score_t> &preds, int num_preds, int penalty) {
+    return combineJVertexGroups(
+        preds.base_score, topTwoInLanes(preds.diff_0_I.data(), num_preds),
+        topTwoInLanes(preds.diff_1_I.data(), num_preds),
+        topTwoInLanes(preds.diff_1_E.data(), num_preds), num_preds, penalty);
+}
+
+template <typename score_t>
+JVertexScores<score_t> computeJVertexScores(
+    const JPredecessorScores<score_t> &preds, int num_preds, int penalty) {
+    switch (num_preds) {
+        case 2:
+            return computeJVertexScoresScalar<2>(preds, num_preds, penalty);
+        case 3:
+            return computeJVertexScoresScalar<3>(preds, num_preds, penalty);
+        case 4:
+            return computeJVertexScoresScalar<4>(preds, num_preds, penalty);
+        default:
+            if (num_preds >= J_KERNEL_SIMD_MIN_WIDTH) {
+                return computeJVertexScoresWide(preds, num_preds, penalty);
+            }
+            return computeJVertexScoresScalar<0>(preds, num_preds, penalty);
+    }
+}
+
+// The rules of the DP for the kinds of vertices on the cells of scores and
+// choices, shared by the DP on full and on run-length tables. `a` and
+// `a_choices` are the cells of the vertex and `p` is the cell of its
+// predecessor.
+
+template <typename score_t>
+void setCell(score_cell<score_t> &a, score_cell<score_t> &a_choices,
+             pair<int64_t, int> score_choice, bool selected,
+             path_continuation layer = I) {
+    a[selected][layer] = score_choice.first;
+    a_choices[selected][layer] = score_choice.second;
+}
+
+// First vertex of the graph.
+template <typename score_t>
+void firstVertexRule(int weight_a, int penalty, score_cell<score_t> &a,
+                     score_cell<score_t> &a_choices) {
+    // W(a, 1) = w(a) - x
+    score_t score_a_1 = weight_a - penalty;
+    setCell(a, a_choices, make_pair(score_a_1, FIRST), SURELY_SELECTED);
+
+    // W(a, 0) = max{0, W(a, 1)}
+    setCell(a, a_choices, max_score(0, score_a_1), !SURELY_SELECTED);
+}
+
+// N vertex, or 1_later and L_later vertex for path continuation `layer`.
+template <typename score_t>
+void laterVertexRule(const score_cell<score_t> &p, int weight_a, int penalty,
+                     path_continuation layer, score_cell<score_t> &a,
+                     score_cell<score_t> &a_choices) {
+    score_t score_p_0 = p[!SURELY_SELECTED][layer];
+    score_t score_p_1 = p[SURELY_SELECTED][layer];
+    // W(a, 1, _) = w(a) + max{W(p, 0, _) - x, W(p, 1, _)}
+    setCell(a, a_choices,
+            max_score(weight_a + score_p_0 - penalty, weight_a + score_p_1),
+            SURELY_SELECTED, layer);
+
+    // W(a, 0, _) = max{W(p, 0, _), W(a, 1, _)}
+    setCell(a, a_choices, max_score(score_p_0, a[SURELY_SELECTED][layer]),
+            !SURELY_SELECTED, layer);
+}
+
+// 1_first vertex, `p` is the start vertex of the bubble.
+template <typename score_t>
+void firstLayerFirstVertexRule(const score_cell<score_t> &p, int weight_a,
+                               int penalty, score_cell<score_t> &a,
+                               score_cell<score_t> &a_choices) {
+    score_t score_p_0 = p[!SURELY_SELECTED][I];
+    score_t score_p_1 = p[SURELY_SELECTED][I];
+    // W(a, 1, I) = w(a) + max{W(p, 0) - x, W(p, 1)}
+    setCell(a, a_choices,
+            max_score(weight_a + score_p_0 - penalty, weight_a + score_p_1),
+            SURELY_SELECTED, I);
+
+    // W(a, 0, I) = max{W(p, 0), W(a, 1, I)}
+    setCell(a, a_choices, max_score(score_p_0, a[SURELY_SELECTED][I]),
+            !SURELY_SELECTED, I);
+
+    // W(a, 1, E) = w(a) + W(p, 1) - x
+    score_t score_a_1_E = weight_a + score_p_1 - penalty;
+    setCell(a, a_choices, make_pair(score_a_1_E, FIRST), SURELY_SELECTED, E);
+
+    // W(a, 0, E) = max{W(p, 1), W(a, 1, E)}
+    setCell(a, a_choices, max_score(score_p_1, score_a_1_E), !SURELY_SELECTED,
+            E);
+}
+
+// L_first vertex, where L is not 1.
+template <typename score_t>
+void layerFirstVertexRule(int weight_a, int penalty, score_cell<score_t> &a,
+                          score_cell<score_t> &a_choices) {
+    // W(a, 1, I) = w(a)
+    score_t score_a_1_I = weight_a;
+    setCell(a, a_choices, make_pair(score_a_1_I, FIRST), SURELY_SELECTED, I);
+
+    // W(a, 0, I) = W(a, 1, I)
+    setCell(a, a_choices, make_pair(score_a_1_I, FIRST), !SURELY_SELECTED, I);
+
+    // W(a, 1, E) = w(a) - x
+    score_t score_a_1_E = weight_a - penalty;
+    setCell(a, a_choices, make_pair(score_a_1_E, FIRST), SURELY_SELECTED, E);
+
+    // W(a, 0, E) = max{0, W(a, 1, E)}
+    setCell(a, a_choices, max_score(0, score_a_1_E), !SURELY_SELECTED, E);
+}
+
+// J vertex with the scores `j_scores` computed from its predecessors.
+template <typename score_t>
+void setJVertexCell(const JVertexScores<score_t> &j_scores, int weight_a,
+                    score_cell<score_t> &a, score_cell<score_t> &a_choices) {
+    // W(a, 1) = w(a) + max{group_1, group_2, group_3}.
+    setCell(a, a_choices,
+            make_pair(weight_a + j_scores.score_1, j_scores.choice_1),
+            SURELY_SELECTED);
+    // W(a, 0) = max{group_0, W(a, 1)}.
+    setCell(a, a_choices, make_pair(j_scores.score_0, j_scores.choice_0),
+            !SURELY_SELECTED);
+}
+
+// J vertex, `pred_cell(i)` returns the cell of the predecessor on layer i.
+template <typename score_t, typename pred_cell_t>
+void jVertexRule(const pred_cell_t &pred_cell, int num_preds, int weight_a,
+                 int penalty, JPredecessorScores<score_t> &j_preds,
+                 score_cell<score_t> &a, score_cell<score_t> &a_choices) {
+    gatherJPredecessorScores(pred_cell, num_preds, j_preds);
+    setJVertexCell(computeJVertexScores(j_preds, num_preds, penalty),
+                   weight_a, a, a_choices);
+}
+
+// Fills the cells of the last vertex q of the unprofitable region `region`
+// from the cell `p` of the vertex before it, see `findUnprofitableRegions()`.
+// W(q, 1) is never chosen, so is its choice.
+template <typename score_t>
+void unprofitableRegionRule(const score_cell<score_t> &p,
+                            const UnprofitableRegions::Region &region,
+                            int penalty, score_cell<score_t> &q,
+                            score_cell<score_t> &q_choices) {
+    // W(q, 0) = W(p, 0)
+    setCell(q, q_choices, make_pair(p[!SURELY_SELECTED][I], FIRST),
+            !SURELY_SELECTED);
+    // W(q, 1) = max{W(p, 1) + S, W(p, 0) - x + M}
+    setCell(q, q_choices,
+            max_score(p[SURELY_SELECTED][I] + region.sum,
+                      p[!SURELY_SELECTED][I] - penalty +
+                          region.max_suffix_sum),
+            SURELY_SELECTED);
+}
+
+// Fills the cells of `region` with the rule of N vertices, as if
+// `unprofitableRegionRule()` had not skipped them.
+template <typename score_t>
+void fillUnprofitableRegion(const weight_matrix &weights,
+                            const UnprofitableRegions::Region &region,
+                            int penalty, basic_score_matrix<score_t> &scores,
+                            basic_score_matrix<score_t> &choices) {
+    auto &layer_scores = scores[region.segment][0];
+    for (int64_t index = region.first_index; index <= region.last_index;
+         index++) {
+        laterVertexRule(layer_scores[index - 1],
+                        weights[region.segment][0][index], penalty, I,
+                        layer_scores[index], choices[region.segment][0][index]);
+    }
+}
+
+// `fillTables()` for weights in a `weight_matrix` or a `WeightTrack`. The
+// cells of `regions`, if given, are filled by `unprofitableRegionRule()`,
+// `first` must be the first vertex of the graph then.
+template <typename score_t, typename index_t, typename weights_t>
+void fillTablesFor(const eds_matrix &eds_segments, const weights_t &weights,
+                   basic_score_matrix<score_t> &scores,
+                   basic_score_matrix<score_t> &choices, int penalty,
+                   BasicVertex<index_t> first,
+                   const UnprofitableRegions *regions = nullptr) {
+    typedef BasicVertex<index_t> vertex_t;
+    auto cell = [&scores](vertex_t v) -> const score_cell<score_t> & {
+        return scores[v.segment][v.layer][v.index];
+    };
+    // Reused by every J vertex, so the kernel does not allocate.
+    JPredecessorScores<score_t> j_preds;
+    size_t next_region = 0;
+    size_t num_regions = regions == nullptr ? 0 : regions->regions.size();
+    for (index_t segment = first.segment; segment < eds_segments.size();
+         segment++) {
+        for (index_t layer = segment == first.segment ? first.layer : 0;
+             layer < eds_segments[segment].size(); layer++) {
+            for (index_t index = segment == first.segment &&
+                                         layer == first.layer
+                                     ? first.index
+                                     : 0;
+                 index < eds_segments[segment][layer].size(); index++) {
+                vertex_t a{segment, layer, index};
+                // First vertex of an unprofitable region, continue after it.
+                if (next_region < num_regions &&
+                    regions->regions[next_region].segment == segment &&
+                    regions->regions[next_region].first_index == index) {
+                    const auto &region = regions->regions[next_region++];
+                    const score_cell<score_t> &p =
+                        cell(getPredecessorVertex(eds_segments, a));
+                    index = region.last_index;
+                    unprofitableRegionRule(p, region, penalty,
+                                           scores[segment][0][index],
+                                           choices[segment][0][index]);
+                    continue;
+                }
                 int weight_a = getWeight(weights, a);
+                auto &a_scores = scores[segment][layer][index];
+                auto &a_choices = choices[segment][layer][index];
 
                 // First vertex of the graph.
                 if (!hasPredecessorVertex(a)) {
-                    // W(a, 1) = w(a) - x
-                    int score_a_1 = weight_a - penalty;
-                    setScoreAndChoice(scores, choices,
-                                      make_pair(score_a_1, FIRST), a,
-                                      SURELY_SELECTED);
-
-                    // W(a, 0) = max{0, W(a, 1)}
-                    setScoreAndChoice(scores, choices, max_score(0, score_a_1),
-                                      a, !SURELY_SELECTED);
+                    firstVertexRule(weight_a, penalty, a_scores, a_choices);
                 }
                 // N vertex.
                 else if (isNVertex(a, eds_segments)) {
                     assert(layer == 0);
-                    // W(a, 1) = w(a) + max{W(p, 0) - x, W(p, 1)}
-                    Vertex p = getPredecessorVertex(eds_segments, a);
-                    int score_p_0 = getScore(scores, p, !SURELY_SELECTED);
-                    int score_p_1 = getScore(scores, p, SURELY_SELECTED);
-                    setScoreAndChoice(scores, choices,
-                                      max_score(weight_a + score_p_0 - penalty,
-                                                weight_a + score_p_1),
-                                      a, SURELY_SELECTED);
-
-                    // W(a, 0) = max{W(p, 0), W(a, 1)}
-                    setScoreAndChoice(
-                        scores, choices,
-                        max_score(score_p_0,
-                                  getScore(scores, a, SURELY_SELECTED)),
-                        a, !SURELY_SELECTED);
+                    vertex_t p = getPredecessorVertex(eds_segments, a);
+                    laterVertexRule(cell(p), weight_a, penalty, I, a_scores,
+                                    a_choices);
                 }
                 // L = 1 layer vertex.
                 else if (isFirstLayerVertex(a, eds_segments)) {
+                    vertex_t p = getPredecessorVertex(eds_segments, a);
                     // 1_first vertex.
                     if (isVertexFirstOnLayer(a, eds_segments)) {
-                        Vertex p = getPredecessorVertex(eds_segments, a);
-                        int score_p_0 = getScore(scores, p, !SURELY_SELECTED);
-                        int score_p_1 = getScore(scores, p, SURELY_SELECTED);
-                        // W(a, 1, I) = w(a) + max{W(p, 0) - x, W(p, 1)}
-                        setScoreAndChoice(
-                            scores, choices,
-                            max_score(weight_a + score_p_0 - penalty,
-                                      weight_a + score_p_1),
-                            a, SURELY_SELECTED, I);
-
-                        // W(a, 0, I) = max{W(p, 0), W(a, 1, I)}
-                        setScoreAndChoice(
-                            scores, choices,
-                            max_score(score_p_0,
-                                      getScore(scores, a, SURELY_SELECTED, I)),
-                            a, !SURELY_SELECTED, I);
-
-                        // W(a, 1, E) = w(a) + W(p, 1) - x
-                        int score_a_1_E = weight_a + score_p_1 - penalty;
-                        setScoreAndChoice(scores, choices,
-                                          make_pair(score_a_1_E, FIRST), a,
-                                          SURELY_SELECTED, E);
-
-                        // W(a, 0, E) = max{W(p, 1), W(a, 1, E)}
-                        setScoreAndChoice(scores, choices,
-                                          max_score(score_p_1, score_a_1_E), a,
-                                          !SURELY_SELECTED, E);
+                        firstLayerFirstVertexRule(cell(p), weight_a, penalty,
+                                                  a_scores, a_choices);
                     }
                     // 1_later vertex.
                     else {
-                        Vertex p = getPredecessorVertex(eds_segments, a);
-                        int score_p_0_I =
-                            getScore(scores, p, !SURELY_SELECTED, I);
-                        int score_p_1_I =
-                            getScore(scores, p, SURELY_SELECTED, I);
-                        // W(a, 1, I) = w(a) + max{W(p, 0, I) - x, W(p, 1, I)}
-                        setScoreAndChoice(
-                            scores, choices,
-                            max_score(weight_a + score_p_0_I - penalty,
-                                      weight_a + score_p_1_I),
-                            a, SURELY_SELECTED, I);
-
-                        // W(a, 0, I) = max{W(p, 0, I), W(a, 1, I)}
-                        setScoreAndChoice(
-                            scores, choices,
-                            max_score(score_p_0_I,
-                                      getScore(scores, a, SURELY_SELECTED, I)),
-                            a, !SURELY_SELECTED, I);
-
-                        // W(a, 1, E) = w(a) + max{W(p, 0, E) - x, W(p, 1, E)}
-                        int score_p_0_E =
-                            getScore(scores, p, !SURELY_SELECTED, E);
-                        int score_p_1_E =
-                            getScore(scores, p, SURELY_SELECTED, E);
-                        setScoreAndChoice(
-                            scores, choices,
-                            max_score(weight_a + score_p_0_E - penalty,
-                                      weight_a + score_p_1_E),
-                            a, SURELY_SELECTED, E);
-
-                        // W(a, 0, E) = max{W(p, 0, E), W(a, 1, E)}
-                        setScoreAndChoice(
-                            scores, choices,
-                            max_score(score_p_0_E,
-                                      getScore(scores, a, SURELY_SELECTED, E)),
-                            a, !SURELY_SELECTED, E);
+                        laterVertexRule(cell(p), weight_a, penalty, I,
+                                        a_scores, a_choices);
+                        laterVertexRule(cell(p), weight_a, penalty, E,
+                                        a_scores, a_choices);
                     }
                 }
                 // L in {2, ..., n} layer vertex.
                 else if (isLayerVertex(a, eds_segments)) {
                     // L_first vertex.
                     if (isVertexFirstOnLayer(a, eds_segments)) {
-                        // W(a, 1, I) = w(a)
-                        int score_a_1_I = weight_a;
-                        setScoreAndChoice(scores, choices,
-                                          make_pair(score_a_1_I, FIRST), a,
-                                          SURELY_SELECTED, I);
-
-                        // W(a, 0, I) = W(a, 1, I)
-                        setScoreAndChoice(scores, choices,
-                                          make_pair(score_a_1_I, FIRST), a,
-                                          !SURELY_SELECTED, I);
-
-                        // W(a, 1, E) = w(a) - x
-                        int score_a_1_E = weight_a - penalty;
-                        setScoreAndChoice(scores, choices,
-                                          make_pair(score_a_1_E, FIRST), a,
-                                          SURELY_SELECTED, E);
-
-                        // W(a, 0, E) = max{0, W(a, 1, E)}
-                        setScoreAndChoice(scores, choices,
-                                          max_score(0, score_a_1_E), a,
-                                          !SURELY_SELECTED, E);
+                        layerFirstVertexRule(weight_a, penalty, a_scores,
+                                             a_choices);
                     }
                     // L_later vertex.
                     else {
-                        Vertex p = getPredecessorVertex(eds_segments, a);
-                        int score_p_0_I =
-                            getScore(scores, p, !SURELY_SELECTED, I);
-                        int score_p_1_I =
-                            getScore(scores, p, SURELY_SELECTED, I);
-                        // W(a, 1, I) = w(a) + max{W(p, 0, I) - x, W(p, 1, I)}
-                        setScoreAndChoice(
-                            scores, choices,
-                            max_score(weight_a + score_p_0_I - penalty,
-                                      weight_a + score_p_1_I),
-                            a, SURELY_SELECTED, I);
-
-                        // W(a, 0, I) = max{W(p, 0, I), W(a, 1, I)}
-                        setScoreAndChoice(
-                            scores, choices,
-                            max_score(score_p_0_I,
-                                      getScore(scores, a, SURELY_SELECTED, I)),
-                            a, !SURELY_SELECTED, I);
-
-                        // W(a, 1, E) = w(a) + max{W(p, 0, E) - x, W(p, 1, E)}
-                        int score_p_0_E =
-                            getScore(scores, p, !SURELY_SELECTED, E);
-                        int score_p_1_E =
-                            getScore(scores, p, SURELY_SELECTED, E);
-                        setScoreAndChoice(
-                            scores, choices,
-                            max_score(weight_a + score_p_0_E - penalty,
-                                      weight_a + score_p_1_E),
-                            a, SURELY_SELECTED, E);
-
-                        // W(a, 0, E) = max{W(p, 0, E), W(a, 1, E)}
-                        setScoreAndChoice(
-                            scores, choices,
-                            max_score(score_p_0_E,
-                                      getScore(scores, a, SURELY_SELECTED, E)),
-                            a, !SURELY_SELECTED, E);
+                        vertex_t p = getPredecessorVertex(eds_segments, a);
+                        laterVertexRule(cell(p), weight_a, penalty, I,
+                                        a_scores, a_choices);
+                        laterVertexRule(cell(p), weight_a, penalty, E,
+                                        a_scores, a_choices);
                     }
                 }
                 // J vertex.
                 else if (isJVertex(a, eds_segments)) {
-                    // W(a, 1) = w(a) + max{group_1, group_2, group_3}.
-                    //
-                    // Get all predecessors.
                     int num_preds = eds_segments[segment - 1].size();
-                    vector<Vertex> a_preds(num_preds);
-                    for (int i = 0; i < num_preds; i++) {
-                        a_preds[i] = getPredecessorVertex(eds_segments, a, i);
-                    }
-
-                    // Calculate the base score that is going to be modified:
-                    // w(a) + W(p1, 0, E) +  W(p2, 0, E) + ... + W(pb, 0, E)
-                    int base_score = 0;
-                    for (const Vertex &p : a_preds) {
-                        base_score += getScore(scores, p, !SURELY_SELECTED, E);
-                    }
-
-                    int choice_a_1 = -1;
-                    int score_a_1 = INT_MIN;
-                    // Calculate the groups first:
-                    //
-                    // Group 1: no predecessor vertex is selected:
-                    // group_1 = max{
-                    //      W(p1, 0, I) + W(p2, 0, E) +...+ W(pb, 0, E) - x,
-                    //      W(p1, 0, E) + W(p2, 0, I) +...+ W(pb, 0, E) - x,
-                    //                         ...
-                    //      W(p1, 0, E) + W(p2, 0, E) +...+ W(pb, 0, I) - x }
-                    // Code the choice: i.
-                    for (int p_i = 0; p_i < num_preds; p_i++) {
-                        int current_score = base_score -
-                                            getScore(scores, a_preds[p_i],
-                                                     !SURELY_SELECTED, E) +
-                                            getScore(scores, a_preds[p_i],
-                                                     !SURELY_SELECTED, I) -
-                                            penalty;
-                        if (score_a_1 < current_score) {
-                            score_a_1 = current_score;
-                            choice_a_1 = p_i;
-                        }
-                    }
-
-                    // Group 2: predecessor p_i is selected and pah continues on
-                    // layer L_i: group_2 = max{
-                    //      W(p1, 1, I) + W(p2, 0, E) +...+ W(pb, 0, E),
-                    //      W(p1, 0, E) + W(p2, 1, I) +...+ W(pb, 0, E),
-                    //                         ...
-                    //      W(p1, 0, E) + W(p2, 0, E) +...+ W(pb, 1, I) }
-                    // Code the choice: b + i.
-                    for (int p_i = 0; p_i < num_preds; p_i++) {
-                        int current_score =
-                            base_score -
-                            getScore(scores, a_preds[p_i], !SURELY_SELECTED,
-                                     E) +
-                            getScore(scores, a_preds[p_i], SURELY_SELECTED, I);
-                        if (score_a_1 < current_score) {
-                            score_a_1 = current_score;
-                            choice_a_1 = p_i + num_preds;
-                        }
-                    }
-
-                    // Group 3: predecessor p_i is selected and the path
-                    // continues on layer L_j, i ≠ j.
-                    //
-                    // Find best predecessors, i.e. the predecessor to be chosen
-                    // and the predecessor which is on the layer where the path
-                    // continued to from the bubble's start vertex.
-                    // Search for also the second best ones in case of i = j.
-                    // Find p_i, p_j where W(p_x, 0, I) - W(p_x, 0, E) is the
-                    // largest.
-                    int p_I_max = -1;
-                    int p_I_max_score_diff = INT_MIN;
-                    int p_I_second = -1;
-                    int p_I_second_score_diff = INT_MIN;
-                    // Find p_k, p_l where W(p_x, 1, E) - W(p_x, 0, E) is the
-                    // largest.
-                    int p_SELECTED_max = -1;
-                    int p_SELECTED_max_score_diff = INT_MIN;
-                    int p_SELECTED_second = -1;
-                    int p_SELECTED_second_score_diff = INT_MIN;
-                    for (int p_i = 0; p_i < num_preds; p_i++) {
-                        int I_diff =
-                            getScore(scores, a_preds[p_i], !SURELY_SELECTED,
-                                     I) -
-                            getScore(scores, a_preds[p_i], !SURELY_SELECTED, E);
-                        if (I_diff > p_I_max_score_diff) {
-                            p_I_second_score_diff = p_I_max_score_diff;
-                            p_I_second = p_I_max;
-                            p_I_max_score_diff = I_diff;
-                            p_I_max = p_i;
-                        } else if (I_diff > p_I_second_score_diff) {
-                            p_I_second_score_diff = I_diff;
-                            p_I_second = p_i;
-                        }
-
-                        int SELECTED_diff =
-                            getScore(scores, a_preds[p_i], SURELY_SELECTED, E) -
-                            getScore(scores, a_preds[p_i], !SURELY_SELECTED, E);
-                        if (SELECTED_diff > p_SELECTED_max_score_diff) {
-                            p_SELECTED_second_score_diff =
-                                p_SELECTED_max_score_diff;
-                            p_SELECTED_second = p_SELECTED_max;
-                            p_SELECTED_max_score_diff = SELECTED_diff;
-                            p_SELECTED_max = p_i;
-                        } else if (SELECTED_diff >
-                                   p_SELECTED_second_score_diff) {
-                            p_SELECTED_second_score_diff = SELECTED_diff;
-                            p_SELECTED_second = p_i;
-                        }
-                    }
-                    // Select the two predecessors that maximise the sum.
-                    // Let p_x be the surely selected vertex and let L_y be the
-                    // layer of path continuation.
-                    // Code the choice as: 2b + b*x + y.
-                    // Take the two maximalising predecessors p_i and p_k if
-                    // they are not the same.
-                    if (p_I_max != p_SELECTED_max) {
-                        int current_score =
-                            base_score -
-                            getScore(scores, a_preds[p_I_max], !SURELY_SELECTED,
-                                     E) +
-                            getScore(scores, a_preds[p_I_max], !SURELY_SELECTED,
-                                     I) -
-                            getScore(scores, a_preds[p_SELECTED_max],
-                                     !SURELY_SELECTED, E) +
-                            getScore(scores, a_preds[p_SELECTED_max],
-                                     SURELY_SELECTED, E);
-                        if (score_a_1 < current_score) {
-                            score_a_1 = current_score;
-                            choice_a_1 = 2 * num_preds +
-                                         num_preds * p_SELECTED_max + p_I_max;
-                        }
-                    } else {
-                        // Try p_i and p_l if p_i and p_k were the same.
-                        int current_score =
-                            base_score -
-                            getScore(scores, a_preds[p_I_max], !SURELY_SELECTED,
-                                     E) +
-                            getScore(scores, a_preds[p_I_max], !SURELY_SELECTED,
-                                     I) -
-                            getScore(scores, a_preds[p_SELECTED_second],
-                                     !SURELY_SELECTED, E) +
-                            getScore(scores, a_preds[p_SELECTED_second],
-                                     SURELY_SELECTED, E);
-                        if (score_a_1 < current_score) {
-                            score_a_1 = current_score;
-                            choice_a_1 = 2 * num_preds +
-                                         num_preds * p_SELECTED_second +
-                                         p_I_max;
-                        }
-                        // Try p_j and p_k if p_i and p_k were the same.
-                        current_score =
-                            base_score -
-                            getScore(scores, a_preds[p_I_second],
-                                     !SURELY_SELECTED, E) +
-                            getScore(scores, a_preds[p_I_second],
-                                     !SURELY_SELECTED, I) -
-                            getScore(scores, a_preds[p_SELECTED_max],
-                                     !SURELY_SELECTED, E) +
-                            getScore(scores, a_preds[p_SELECTED_max],
-                                     SURELY_SELECTED, E);
-                        if (score_a_1 < current_score) {
-                            score_a_1 = current_score;
-                            choice_a_1 = 2 * num_preds +
-                                         num_preds * p_SELECTED_max +
-                                         p_I_second;
-                        }
-                    }
-
-                    setScoreAndChoice(
-                        scores, choices,
-                        make_pair(weight_a + score_a_1, choice_a_1), a,
-                        SURELY_SELECTED);
-
-                    // W(a, 0) = max{
-                    //      W(p1, 0, I) + W(p2, 0, E) +...+ W(pb, 0, E),
-                    //                         ...
-                    //______W(p1, 0, E) + W(p2, 0, E) +...+ W(pb, 0, I),
-                    //      W(a, 1)
-                    // where b is the number of layers in the current bubble.
-                    int score_a_0 = INT_MIN;
-                    int choice_a_0 = 0;
-                    for (int path_I = 0; path_I < num_preds; path_I++) {
-                        int current_score = base_score -
-                                            getScore(scores, a_preds[path_I],
-                                                     !SURELY_SELECTED, E) +
-                                            getScore(scores, a_preds[path_I],
-                                                     !SURELY_SELECTED, I);
-                        if (score_a_0 < current_score) {
-                            score_a_0 = current_score;
-                            choice_a_0 = path_I;
-                        }
-                    }
-                    if (score_a_0 < score_a_1) {
-                        score_a_0 = score_a_1;
-                        // For non-ambiguous decoding to get the paths, store
-                        // choice `choice_a_1` here "moved" by `num_preds`: i.e.
-                        // if choice_a_0 >= num_preds, then decode choice_a_0 -
-                        // num_preds based on W(a, 1) rules.
-                        choice_a_0 = num_preds + choice_a_1;
-                    }
-                    setScoreAndChoice(scores, choices,
-                                      make_pair(score_a_0, choice_a_0), a,
-                                      !SURELY_SELECTED);
+                    jVertexRule(
+                        [&](int i) -> const score_cell<score_t> & {
+                            return cell(getPredecessorVertex(eds_segments, a,
+                                                             i));
+                        },
+                        num_preds, weight_a, penalty, j_preds, a_scores,
+                        a_choices);
                 } else {
                     assert(false);
                 }
             }
         }
     }
+}
+
+template <typename score_t, typename index_t>
+void fillTables(const eds_matrix &eds_segments, const weight_matrix &weights,
+                basic_score_matrix<score_t> &scores,
+                basic_score_matrix<score_t> &choices, int penalty,
+                BasicVertex<index_t> first) {
+    fillTablesFor(eds_segments, weights, scores, choices, penalty, first);
+}
+
+template <typename score_t, typename index_t, typename weights_t>
+score_t findMaxScoringPathsFor(const eds_matrix &eds_segments,
+                               const weights_t &weights,
+                               basic_score_matrix<score_t> &scores,
+                               basic_score_matrix<score_t> &choices,
+                               int penalty,
+                               const UnprofitableRegions *regions = nullptr) {
+    checkTypeWidths<score_t, index_t>(eds_segments, weights, penalty);
+    typedef BasicVertex<index_t> vertex_t;
+    fillTablesFor(eds_segments, weights, scores, choices, penalty,
+                  vertex_t{0, 0, 0}, regions);
 
     // Get the max score from the last vertex of the graph. The last vertex is
     // an `EMPTY_STR`, i.e. it has weight 0, therefore, it is unnecessary to
     // select it.
-    Vertex last = getLastVertex(eds_segments);
+    vertex_t last = getLastVertex<index_t>(eds_segments);
     assert(isNVertex(last, eds_segments) || isJVertex(last, eds_segments));
     const auto &last_data = scores[last.segment][last.layer][last.index];
     return max(last_data[!SURELY_SELECTED][I], last_data[!SURELY_SELECTED][E]);
 }
 
-// Helper function for `getPaths`. Merges and clears the `layer_path` into
-// `current_path` if possible.
-bool mergeLayerPathIntoCurrentPath(vector<Vertex> &current_path,
-                                   vector<Vertex> &layer_path, const Vertex &j,
-                                   const Vertex &j_pred,
-                                   int surely_selected_j_p_layer) {
-    if ((surely_selected_j_p_layer != -1 &&
-         surely_selected_j_p_layer != j_pred.layer) ||
-        current_path.empty() || layer_path.empty() ||
-        current_path.back() != j || layer_path[0] != j_pred) {
-        return false;
-    }
-    current_path.insert(current_path.end(), layer_path.begin(),
-                        layer_path.end());
-    layer_path.clear();
-    return true;
+template <typename score_t, typename index_t>
+score_t findMaxScoringPaths(const eds_matrix &eds_segments,
+                            const weight_matrix &weights,
+                            basic_score_matrix<score_t> &scores,
+                            basic_score_matrix<score_t> &choices,
+                            int penalty) {
+    return findMaxScoringPathsFor<score_t, index_t>(eds_segments, weights,
+                                                    scores, choices, penalty);
 }
 
-vector<vector<Vertex>> getPaths(const eds_matrix &eds_segments,
-                                score_matrix &scores, score_matrix &choices) {
-    vector<vector<Vertex>> paths;
-    // The last vertex was synthetically added to the pangenome-graph and has
-    // weight 0. Therefore, it is not necessary to select it
-    Vertex a = getLastVertex(eds_segments);
-    bool is_a_surely_selected = false;
-    vector<Vertex> current_path;
-    while (hasPredecessorVertex(a)) {
-        // N vertex.
-        if (isNVertex(a, eds_segments)) {
-            // W(a, 1) = w(a) + max{W(p, 0) - x, W(p, 1)}
-            // W(a, 0) = max{W(p, 0), W(a, 1)}
-            int choice = getChoice(
-                choices, a,
-                is_a_surely_selected ? SURELY_SELECTED : !SURELY_SELECTED);
-            // Vertex `a` is selected if W(a, 1) or W(a, 0) = W(a, 1).
-            if (is_a_surely_selected || choice == SECOND) {
-                current_path.emplace_back(a);
-                if (is_a_surely_selected) {
-                    is_a_surely_selected = choice == SECOND ? true : false;
-                } else {
-                    if (choice == FIRST) {
-                        is_a_surely_selected = false;
-                    } else {
-                        int choice_a_1 =
-                            getChoice(choices, a, !SURELY_SELECTED);
-                        is_a_surely_selected = choice == SECOND ? true : false;
-                    }
+template <typename score_t, typename index_t>
+score_t findMaxScoringPaths(const eds_matrix &eds_segments,
+                            const WeightTrack &track,
+                            basic_score_matrix<score_t> &scores,
+                            basic_score_matrix<score_t> &choices,
+                            int penalty) {
+    return findMaxScoringPathsFor<score_t, index_t>(eds_segments, track, scores,
+                                                    choices, penalty);
+}
+
+UnprofitableRegions findUnprofitableRegions(const eds_matrix &eds_segments,
+                                            const weight_matrix &weights,
+                                            int penalty) {
+    if (penalty < 0) {
+        throw invalid_argument(
+            "Unprofitable regions need a non-negative penalty.");
+    }
+    UnprofitableRegions unprofitable;
+    unprofitable.penalty = penalty;
+    for (int64_t segment = 0; segment < eds_segments.size(); segment++) {
+        if (eds_segments[segment].size() > 1) {
+            continue;
+        }
+        // The first vertex of the segment is a J vertex or the first vertex
+        // of the graph, the last one the start vertex of a bubble or the last
+        // vertex of the graph, they keep their rules. W(J, 0) leaves out w(J)
+        // in some of its terms, W(J, 1) may exceed it and a path through J
+        // may select the vertex after J on a tie: the regions after a bubble
+        // start one vertex later, where W(p, 0) >= W(p, 1) again.
+        const auto &layer_weights = weights[segment][0];
+        int64_t end = (int64_t)layer_weights.size() - 1;
+        int64_t first = segment == 0 ? 1 : 2;
+        while (first < end) {
+            // The sums of first..index: S, the largest suffix sum and the
+            // largest window sum. The region grows as long as all prefix sums
+            // are negative and all windows below x, and ends at the last
+            // index where the other bounds hold.
+            int64_t sum = 0;
+            int64_t max_suffix_sum = 0;
+            int64_t max_window_sum = INT64_MIN;
+            int64_t last_index = -1;
+            int64_t region_sum = 0;
+            int64_t region_max_suffix_sum = 0;
+            int64_t index = first;
+            for (; index < end; index++) {
+                int64_t weight = layer_weights[index];
+                sum += weight;
+                max_suffix_sum = index == first
+                                     ? weight
+                                     : max(weight, max_suffix_sum + weight);
+                max_window_sum = max(max_window_sum, max_suffix_sum);
+                if (sum >= 0 || max_window_sum >= penalty) {
+                    break;
                 }
-            }
-            // Vertex `a` is not selected if W(a, 0) = W(p, 0).
-            else {
-                is_a_surely_selected = false;
-                if (!current_path.empty()) {
-                    paths.emplace_back(current_path);
-                    current_path.clear();
+                if (max_suffix_sum < 0 && sum < -penalty) {
+                    last_index = index;
+                    region_sum = sum;
+                    region_max_suffix_sum = max_suffix_sum;
                 }
             }
-            a = getPredecessorVertex(eds_segments, a);
-        }
-        // J vertex.
-        // Handle the full bubble, `a` is the start vertex of the bubble after
-        // this code part.
-        else if (isJVertex(a, eds_segments)) {
-            Vertex j = a;
-            // Get all predecessors.
-            int num_preds = eds_segments[a.segment - 1].size();
-            vector<Vertex> j_preds(num_preds);
-            for (int layer = 0; layer < num_preds; layer++) {
-                j_preds[layer] = getPredecessorVertex(eds_segments, a, layer);
+            if (last_index != -1) {
+                unprofitable.regions.push_back({segment, first, last_index,
+                                                region_sum,
+                                                region_max_suffix_sum});
             }
-            // W(a, 1) = w(a) + max{group_1, group_2, group_3}.
-            // W(a, 0) = max{
-            //      W(p1, 0, I) + W(p2, 0, E) +...+ W(pb, 0, E),
-            //                         ...
-            //      W(p1, 0, E) + W(p2, 0, E) +...+ W(pb, 0, I),
-            //      W(a, 1)
-            // where b is the number of layers in the current bubble.
+            // Every vertex is visited once, a region that failed at `index`
+            // is not tried again from a later start before it.
+            first = index + 1;
+        }
+    }
+    return unprofitable;
+}
 
-            int choice = getChoice(
-                choices, j,
-                is_a_surely_selected ? SURELY_SELECTED : !SURELY_SELECTED);
+template <typename score_t, typename index_t>
+score_t findMaxScoringPaths(const eds_matrix &eds_segments,
+                            const weight_matrix &weights,
+                            basic_score_matrix<score_t> &scores,
+                            basic_score_matrix<score_t> &choices, int penalty,
+                            const UnprofitableRegions &regions) {
+    if (regions.penalty != penalty) {
+        throw invalid_argument(
+            "Unprofitable regions of another penalty, see "
+            "findUnprofitableRegions().");
+    }
+    return findMaxScoringPathsFor<score_t, index_t>(
+        eds_segments, weights, scores, choices, penalty, &regions);
+}
 
-            // Select J vertex if W(a, 1) or W(a, 0) = W(a, 1).
-            if (is_a_surely_selected || choice == num_preds) {
-                current_path.emplace_back(a);
-            } else {
-                if (!current_path.empty()) {
-                    paths.emplace_back(current_path);
-                    current_path.clear();
-                }
-            }
+// Segment by segment DP, keeping the cells of a window of segments only, see
+// `findMaxScore()` and `findMaxScoringPathsCheckpointed()`.
+
+// Fills the cells of the vertices of `segment`. `pred_last_cell(layer)` returns
+// the cell of the last vertex of layer `layer` of the previous segment,
+// `cell_of(layer, index)` and `choice_cell_of(layer, index)` return the cells
+// to fill. The cells of a layer may share storage, e.g. to keep only the last
+// one: the cell of the predecessor is copied before the vertex is filled.
+template <typename score_t, typename index_t, typename weights_t,
+          typename pred_cell_t, typename cell_of_t, typename choice_cell_of_t>
+void fillSegment(const eds_matrix &eds_segments, const weights_t &weights,
+                 int penalty, index_t segment,
+                 const pred_cell_t &pred_last_cell, const cell_of_t &cell_of,
+                 const choice_cell_of_t &choice_cell_of,
+                 JPredecessorScores<score_t> &j_preds) {
+    typedef BasicVertex<index_t> vertex_t;
+    for (index_t layer = 0; layer < eds_segments[segment].size(); layer++) {
+        vertex_t a{segment, layer, 0};
+        int weight_a = getWeight(weights, a);
+        score_cell<score_t> &a_scores = cell_of(layer, 0);
+        score_cell<score_t> &a_choices = choice_cell_of(layer, 0);
+        // N and J vertices keep the E continuation at 0, as in the tables of
+        // `initScoreMatrix()`.
+        a_scores = {};
+        a_choices = {};
+
+        // The first vertex of the layer, see `findMaxScoringPaths()`.
+        if (!hasPredecessorVertex(a)) {
+            firstVertexRule(weight_a, penalty, a_scores, a_choices);
+        } else if (isNVertex(a, eds_segments)) {
+            laterVertexRule(pred_last_cell(0), weight_a, penalty, I, a_scores,
+                            a_choices);
+        } else if (isFirstLayerVertex(a, eds_segments)) {
+            firstLayerFirstVertexRule(pred_last_cell(0), weight_a, penalty,
+                                      a_scores, a_choices);
+        } else if (isLayerVertex(a, eds_segments)) {
+            layerFirstVertexRule(weight_a, penalty, a_scores, a_choices);
+        } else {
+            assert(isJVertex(a, eds_segments));
+            jVertexRule(pred_last_cell, eds_segments[segment - 1].size(),
+                        weight_a, penalty, j_preds, a_scores, a_choices);
+        }
+
+        // The later vertices. N vertices only have the I continuation.
+        int num_continuations = isLayerVertex(a, eds_segments) ? 2 : 1;
+        const auto &layer_weights = weights[segment][layer];
+        for (index_t index = 1; index < layer_weights.size(); index++) {
+            score_cell<score_t> p = cell_of(layer, index - 1);
+            score_cell<score_t> &scores = cell_of(layer, index);
+            score_cell<score_t> &choices = choice_cell_of(layer, index);
+            for (int layer_goes = I; layer_goes < num_continuations;
+                 layer_goes++) {
+                laterVertexRule(p, layer_weights[index], penalty,
+                                (path_continuation)layer_goes, scores,
+                                choices);
+            }
+        }
+    }
+}
+
+// The cells of the last vertices of the layers of the current and of the
+// previous segment.
+template <typename score_t>
+struct SegmentWindow {
+    explicit SegmentWindow(const eds_matrix &eds_segments)
+        : last_cells(maxBubbleWidth(eds_segments)),
+          cells(maxBubbleWidth(eds_segments)) {}
+
+    // Fills `segment` from the cells of the previous segment.
+    template <typename index_t, typename weights_t>
+    void fill(const eds_matrix &eds_segments, const weights_t &weights,
+              int penalty, index_t segment) {
+        fill(eds_segments, weights, penalty, segment,
+             [this](index_t, index_t) -> score_cell<score_t> & {
+                 return ignored_choices;
+             });
+    }
+
+    // Same as above, `choice_cell_of(layer, index)` returns the cell for the
+    // choices of the vertex, see `fillSegment()`.
+    template <typename index_t, typename weights_t, typename choice_cell_of_t>
+    void fill(const eds_matrix &eds_segments, const weights_t &weights,
+              int penalty, index_t segment,
+              const choice_cell_of_t &choice_cell_of) {
+        fillSegment<score_t>(
+            eds_segments, weights, penalty, segment,
+            [this](int layer) -> const score_cell<score_t> & {
+                return last_cells[layer];
+            },
+            [this](index_t layer, index_t) -> score_cell<score_t> & {
+                return cells[layer];
+            },
+            choice_cell_of, j_preds);
+        swap(last_cells, cells);
+    }
+
+    // The score of the graph once its last segment is filled.
+    score_t score() const {
+        // The last vertex of the graph is an N or a J vertex.
+        const auto &last_data = last_cells[0];
+        return max(last_data[!SURELY_SELECTED][I],
+                   last_data[!SURELY_SELECTED][E]);
+    }
+
+    vector<score_cell<score_t>> last_cells;
+    vector<score_cell<score_t>> cells;
+    score_cell<score_t> ignored_choices;
+    JPredecessorScores<score_t> j_preds;
+};
+
+template <typename score_t, typename index_t, typename weights_t>
+score_t findMaxScoreFor(const eds_matrix &eds_segments,
+                        const weights_t &weights, int penalty) {
+    checkTypeWidths<score_t, index_t>(eds_segments, weights, penalty);
+    SegmentWindow<score_t> window(eds_segments);
+    for (index_t segment = 0; segment < eds_segments.size(); segment++) {
+        window.fill(eds_segments, weights, penalty, segment);
+    }
+    return window.score();
+}
+
+template <typename score_t, typename index_t>
+score_t findMaxScore(const eds_matrix &eds_segments,
+                     const weight_matrix &weights, int penalty) {
+    return findMaxScoreFor<score_t, index_t>(eds_segments, weights, penalty);
+}
+
+template <typename score_t, typename index_t>
+score_t findMaxScore(const eds_matrix &eds_segments, const WeightTrack &track,
+                     int penalty) {
+    return findMaxScoreFor<score_t, index_t>(eds_segments, track, penalty);
+}
+
+vector<int64_t> checkpointBlocks(const eds_matrix &eds_segments,
+                                 int64_t block_vertices) {
+    vector<int64_t> first_segments = {0};
+    int64_t vertices = 0;
+    for (size_t segment = 0; segment < eds_segments.size(); segment++) {
+        if (segment > 0 && vertices >= block_vertices &&
+            eds_segments[segment].size() > 1) {
+            first_segments.push_back(segment);
+            vertices = 0;
+        }
+        for (const auto &layer : eds_segments[segment]) {
+            vertices += layer.size();
+        }
+    }
+    return first_segments;
+}
+
+// Run-length DP.
+//
+// Later vertices, i.e. N vertices and 1_later and L_later vertices, have a
+// single predecessor on the same layer. For a run of later vertices with equal
+// weight w and penalty x >= 0 the rules have a closed form. After the first
+// vertex of the run W(a, 0) >= W(a, 1) holds (it may not hold before, for J
+// vertices), and then:
+// - if w >= 0, W(p, 0) - x <= W(p, 1), so W(a, 1) grows by w per vertex and
+//   W(a, 0) = max{W(a', 0), W(a, 1)} where a' is the first vertex of the run;
+// - if w < 0, W(a, 1) < W(p, 0), so W(a, 0) stays constant. W(a, 1) decreases
+//   by w per vertex while W(p, 1) >= c = W(a, 0) - x, then it is c + w.
+
+// Scores W(a, 1, _) and W(a, 0, _) of a later vertex.
+struct ChainState {
+    int64_t score_1;
+    int64_t score_0;
+};
+
+// Closed form of a run of later vertices of weight `weight` that follow a
+// vertex with state `entry`.
+class RunTransfer {
+   public:
+    RunTransfer(ChainState entry, int64_t weight, int64_t penalty)
+        : entry_(entry), weight_(weight) {
+        assert(penalty >= 0);
+        first_.score_1 = weight + max(entry.score_0 - penalty, entry.score_1);
+        first_.score_0 = max(entry.score_0, first_.score_1);
+        floor_ = first_.score_0 - penalty;
+        linear_steps_ = weight < 0 && first_.score_1 >= floor_
+                            ? (first_.score_1 - floor_) / -weight + 1
+                            : 0;
+    }
+
+    // Returns the state after `steps` vertices of the run.
+    ChainState stateAfter(int64_t steps) const {
+        if (steps == 0) {
+            return entry_;
+        }
+        int64_t later_steps = steps - 1;
+        if (weight_ >= 0) {
+            int64_t score_1 = first_.score_1 + later_steps * weight_;
+            return {score_1, max(first_.score_0, score_1)};
+        }
+        int64_t score_1 = later_steps <= linear_steps_
+                              ? first_.score_1 + later_steps * weight_
+                              : floor_ + weight_;
+        return {score_1, first_.score_0};
+    }
+
+   private:
+    ChainState entry_;
+    int64_t weight_;
+    // The state after the first vertex of the run.
+    ChainState first_;
+    // For negative weights, W(a, 1) decreases for `linear_steps_` vertices
+    // after the first one, then it is `floor_` + w.
+    int64_t floor_;
+    int64_t linear_steps_;
+};
+
+template <typename score_t>
+ChainState chainState(const score_cell<score_t> &cell,
+                      path_continuation layer) {
+    return {cell[SURELY_SELECTED][layer], cell[!SURELY_SELECTED][layer]};
+}
+
+// Returns a hash of the weights of the layers of `segment`.
+uint64_t segmentWeightsHash(const weight_matrix &weights, size_t segment) {
+    auto mix = [](uint64_t hash, uint64_t value) {
+        hash = (hash ^ value) * 0x9e3779b97f4a7c15ULL;
+        return hash ^ (hash >> 29);
+    };
+    uint64_t hash = weights[segment].size();
+    for (const auto &layer_weights : weights[segment]) {
+        hash = mix(hash, layer_weights.size());
+        for (int weight : layer_weights) {
+            hash = mix(hash, (uint32_t)weight);
+        }
+    }
+    return hash;
+}
+
+// Fills `bubble_classes`, see `RunLengthTables`. The bubble of segment 0 has no
+// start vertex and is never in a class.
+void assignBubbleClasses(const weight_matrix &weights,
+                         pmr::vector<int32_t> &bubble_classes) {
+    bubble_classes.assign(weights.size(), -1);
+    // The first bubble of every class, by the hash of its weights.
+    unordered_multimap<uint64_t, size_t> first_bubbles;
+    vector<int64_t> class_sizes;
+    for (size_t segment = 1; segment < weights.size(); segment++) {
+        if (weights[segment].size() < 2) {
+            continue;
+        }
+        uint64_t hash = segmentWeightsHash(weights, segment);
+        auto candidates = first_bubbles.equal_range(hash);
+        for (auto it = candidates.first; it != candidates.second; it++) {
+            if (weights[it->second] == weights[segment]) {
+                bubble_classes[segment] = bubble_classes[it->second];
+                break;
+            }
+        }
+        if (bubble_classes[segment] < 0) {
+            bubble_classes[segment] = class_sizes.size();
+            class_sizes.push_back(0);
+            first_bubbles.emplace(hash, segment);
+        }
+        class_sizes[bubble_classes[segment]]++;
+    }
+    for (int32_t &bubble_class : bubble_classes) {
+        if (bubble_class >= 0 && class_sizes[bubble_class] == 1) {
+            bubble_class = -1;
+        }
+    }
+}
+
+template <typename score_t>
+RunLengthTables<score_t> initRunLengthTables(const weight_matrix &weights,
+                                             pmr::memory_resource *resource) {
+    RunLengthTables<score_t> tables(resource);
+    tables.run_ends.resize(weights.size());
+    tables.scores.resize(weights.size());
+    tables.first_choices.resize(weights.size());
+    for (size_t segment = 0; segment < weights.size(); segment++) {
+        tables.run_ends[segment].resize(weights[segment].size());
+        tables.scores[segment].resize(weights[segment].size());
+        tables.first_choices[segment].resize(weights[segment].size());
+        for (size_t layer = 0; layer < weights[segment].size(); layer++) {
+            const auto &layer_weights = weights[segment][layer];
+            auto &run_ends = tables.run_ends[segment][layer];
+            run_ends.reserve(countRunColumns(layer_weights));
+            // The first vertex of the layer is a column on its own.
+            run_ends.push_back(0);
+            for (size_t index = 1; index < layer_weights.size(); index++) {
+                if (index + 1 == layer_weights.size() ||
+                    layer_weights[index + 1] != layer_weights[index]) {
+                    run_ends.push_back(index);
+                }
+            }
+            tables.scores[segment][layer].resize(run_ends.size());
+        }
+    }
+    assignBubbleClasses(weights, tables.bubble_classes);
+    return tables;
+}
+
+// Transfers of the bubbles of one run of the run-length DP.
+//
+// Let p be the start vertex of a bubble and d = W(p, 1) - W(p, 0). The cells of
+// layer 1 of the bubble and of the J vertex after it are W(p, 0) plus a value
+// that depends only on d and the weights of the bubble, the cells of the other
+// layers do not depend on p at all, and none of the choices depend on W(p, 0).
+// So the cells of a bubble and the scores of its J vertex are stored once per
+// bubble class and d, the cells of layer 1 and of the J vertex relative to
+// W(p, 0).
+template <typename score_t>
+class BubbleMemo {
+   public:
+    // Returns the index of the transfer of class `bubble_class` for `d`, or
+    // -1 if it is not known.
+    int64_t find(int32_t bubble_class, int64_t d) const {
+        if (bubble_class >= by_class_.size()) {
+            return -1;
+        }
+        for (const auto &d_transfer : by_class_[bubble_class]) {
+            if (d_transfer.first == d) {
+                return d_transfer.second;
+            }
+        }
+        return -1;
+    }
+
+    // Stores the cells of the bubble `segment` of `tables` for class
+    // `bubble_class` and `d`, `offset` is W(p, 0). Returns the index of the
+    // transfer, or -1 if the class already has enough transfers.
+    int64_t record(int32_t bubble_class, int64_t d,
+                   const RunLengthTables<score_t> &tables, size_t segment,
+                   score_t offset) {
+        if (bubble_class >= by_class_.size()) {
+            by_class_.resize(bubble_class + 1);
+        }
+        auto &class_transfers = by_class_[bubble_class];
+        if (class_transfers.size() == MAX_TRANSFERS_PER_CLASS) {
+            return -1;
+        }
+        class_transfers.emplace_back(d, transfers_.size());
+        transfers_.push_back({cells_.size(), {}});
+        for (size_t layer = 0; layer < tables.scores[segment].size();
+             layer++) {
+            for (auto cell : tables.scores[segment][layer]) {
+                cells_.push_back(layer == 0 ? shift(cell, -offset) : cell);
+            }
+            cells_.push_back(tables.first_choices[segment][layer]);
+        }
+        return transfers_.size() - 1;
+    }
+
+    // Copies the cells of transfer `transfer` into the bubble `segment` of
+    // `tables`.
+    void restore(int64_t transfer, RunLengthTables<score_t> &tables,
+                 size_t segment, score_t offset) const {
+        const score_cell<score_t> *cell =
+            &cells_[transfers_[transfer].first_cell];
+        for (size_t layer = 0; layer < tables.scores[segment].size();
+             layer++) {
+            for (auto &column : tables.scores[segment][layer]) {
+                column = layer == 0 ? shift(*cell, offset) : *cell;
+                cell++;
+            }
+            tables.first_choices[segment][layer] = *cell++;
+        }
+    }
+
+    // The scores of the J vertex after the bubble, relative to W(p, 0).
+    void setJVertexScores(int64_t transfer, JVertexScores<score_t> j_scores,
+                          score_t offset) {
+        j_scores.score_1 -= offset;
+        j_scores.score_0 -= offset;
+        transfers_[transfer].j_scores = j_scores;
+    }
+    JVertexScores<score_t> jVertexScores(int64_t transfer,
+                                         score_t offset) const {
+        JVertexScores<score_t> j_scores = transfers_[transfer].j_scores;
+        j_scores.score_1 += offset;
+        j_scores.score_0 += offset;
+        return j_scores;
+    }
+
+   private:
+    // Bounds the search in `find()` for bubbles entered with many different d.
+    static constexpr size_t MAX_TRANSFERS_PER_CLASS = 16;
+
+    struct Transfer {
+        // The cells of the columns and the first choices of every layer start
+        // at `cells_[first_cell]`.
+        size_t first_cell;
+        JVertexScores<score_t> j_scores;
+    };
+
+    static score_cell<score_t> shift(score_cell<score_t> cell,
+                                     score_t offset) {
+        for (auto &selected : cell) {
+            for (auto &score : selected) {
+                score += offset;
+            }
+        }
+        return cell;
+    }
+
+    // `by_class_[bubble_class]` holds pairs of d and the index of a transfer.
+    vector<vector<pair<int64_t, int64_t>>> by_class_;
+    vector<Transfer> transfers_;
+    vector<score_cell<score_t>> cells_;
+};
+
+template <typename score_t, typename index_t>
+score_t findMaxScoringPaths(const eds_matrix &eds_segments,
+                            const weight_matrix &weights,
+                            RunLengthTables<score_t> &tables, int penalty) {
+    checkTypeWidths<score_t, index_t>(eds_segments, weights, penalty);
+    if (penalty < 0) {
+        throw invalid_argument("Run-length DP needs a non-negative penalty.");
+    }
+    typedef BasicVertex<index_t> vertex_t;
+    tables.penalty = penalty;
+    // The last vertex of a layer is the end of its last column.
+    auto last_cell = [&tables](index_t segment,
+                               index_t layer) -> const score_cell<score_t> & {
+        return tables.scores[segment][layer].back();
+    };
+    JPredecessorScores<score_t> j_preds;
+    BubbleMemo<score_t> memo;
+    // The transfer of the last bubble, that was either restored or is being
+    // recorded, and W(p, 0) and d of its start vertex p.
+    int64_t transfer = -1;
+    bool restored = false;
+    score_t offset = 0;
+    int64_t d = 0;
+    for (index_t segment = 0; segment < eds_segments.size(); segment++) {
+        int32_t bubble_class = tables.bubble_classes[segment];
+        if (bubble_class >= 0) {
+            const auto &p = last_cell(segment - 1, 0);
+            offset = p[!SURELY_SELECTED][I];
+            d = (int64_t)p[SURELY_SELECTED][I] - offset;
+            transfer = memo.find(bubble_class, d);
+            restored = transfer >= 0;
+            if (restored) {
+                memo.restore(transfer, tables, segment, offset);
+                continue;
+            }
+        }
+        for (index_t layer = 0; layer < eds_segments[segment].size();
+             layer++) {
+            auto &layer_scores = tables.scores[segment][layer];
+            auto &a_choices = tables.first_choices[segment][layer];
+            vertex_t a{segment, layer, 0};
+            int weight_a = getWeight(weights, a);
+
+            // The first vertex of the layer, see `findMaxScoringPaths()`.
+            if (!hasPredecessorVertex(a)) {
+                firstVertexRule(weight_a, penalty, layer_scores[0], a_choices);
+            } else if (isNVertex(a, eds_segments)) {
+                laterVertexRule(last_cell(segment - 1, 0), weight_a, penalty, I,
+                                layer_scores[0], a_choices);
+            } else if (isFirstLayerVertex(a, eds_segments)) {
+                firstLayerFirstVertexRule(last_cell(segment - 1, 0), weight_a,
+                                          penalty, layer_scores[0], a_choices);
+            } else if (isLayerVertex(a, eds_segments)) {
+                layerFirstVertexRule(weight_a, penalty, layer_scores[0],
+                                     a_choices);
+            } else {
+                assert(isJVertex(a, eds_segments));
+                JVertexScores<score_t> j_scores;
+                if (restored) {
+                    j_scores = memo.jVertexScores(transfer, offset);
+                } else {
+                    int num_preds = eds_segments[segment - 1].size();
+                    gatherJPredecessorScores(
+                        [&](int i) -> const score_cell<score_t> & {
+                            return last_cell(segment - 1, i);
+                        },
+                        num_preds, j_preds);
+                    j_scores =
+                        computeJVertexScores(j_preds, num_preds, penalty);
+                    if (transfer >= 0) {
+                        memo.setJVertexScores(transfer, j_scores, offset);
+                    }
+                }
+                setJVertexCell(j_scores, weight_a, layer_scores[0],
+                               a_choices);
+                transfer = -1;
+                restored = false;
+            }
+
+            // The runs of later vertices. N vertices only have the I
+            // continuation.
+            const auto &run_ends = tables.run_ends[segment][layer];
+            int num_continuations = isLayerVertex(a, eds_segments) ? 2 : 1;
+            for (size_t column = 1; column < run_ends.size(); column++) {
+                int64_t weight = weights[segment][layer][run_ends[column]];
+                int64_t steps = run_ends[column] - run_ends[column - 1];
+                for (int layer_goes = I; layer_goes < num_continuations;
+                     layer_goes++) {
+                    ChainState end =
+                        RunTransfer(
+                            chainState(layer_scores[column - 1], layer_goes),
+                            weight, penalty)
+                            .stateAfter(steps);
+                    layer_scores[column][SURELY_SELECTED][layer_goes] =
+                        end.score_1;
+                    layer_scores[column][!SURELY_SELECTED][layer_goes] =
+                        end.score_0;
+                }
+            }
+        }
+        if (bubble_class >= 0) {
+            transfer = memo.record(bubble_class, d, tables, segment, offset);
+        }
+    }
+
+    vertex_t last = getLastVertex<index_t>(eds_segments);
+    assert(isNVertex(last, eds_segments) || isJVertex(last, eds_segments));
+    const auto &last_data = last_cell(last.segment, last.layer);
+    return max(last_data[!SURELY_SELECTED][I], last_data[!SURELY_SELECTED][E]);
+}
+
+// Choices of the run-length tables for the traceback. The choices of the first
+// vertices of the layers are stored, the choices inside the runs are
+// recomputed from the closed form of the run.
+template <typename score_t>
+class RunLengthChoices {
+   public:
+    RunLengthChoices(const weight_matrix &weights,
+                     const RunLengthTables<score_t> &tables)
+        : weights_(weights), tables_(tables) {}
+
+    template <typename vertex_t>
+    int operator()(vertex_t v, bool selected, path_continuation layer) {
+        if (v.index == 0) {
+            return tables_.first_choices[v.segment][v.layer][selected][layer];
+        }
+        if (v.segment != segment_ || v.layer != layer_) {
+            segment_ = v.segment;
+            layer_ = v.layer;
+            run_ends_ = &tables_.run_ends[v.segment][v.layer];
+            column_ = 0;
+        }
+        // The traceback walks the layers backwards, so the vertex is usually
+        // in the same or in the previous run.
+        const auto &run_ends = *run_ends_;
+        if (column_ == 0 || v.index > run_ends[column_] ||
+            v.index <= run_ends[column_ - 1]) {
+            if (column_ > 1 && v.index <= run_ends[column_ - 1] &&
+                v.index > run_ends[column_ - 2]) {
+                column_--;
+            } else {
+                column_ = lower_bound(run_ends.begin(), run_ends.end(),
+                                      (int64_t)v.index) -
+                          run_ends.begin();
+            }
+            weight_ = weights_[v.segment][v.layer][v.index];
+            transfers_valid_[I] = transfers_valid_[E] = false;
+        }
+        if (!transfers_valid_[layer]) {
+            transfers_[layer] = RunTransfer(
+                chainState(tables_.scores[v.segment][v.layer][column_ - 1],
+                           layer),
+                weight_, tables_.penalty);
+            transfers_valid_[layer] = true;
+        }
+        ChainState p =
+            transfers_[layer].stateAfter(v.index - run_ends[column_ - 1] - 1);
+        // The rules of `laterVertexRule()`.
+        if (selected) {
+            return p.score_1 >= p.score_0 - tables_.penalty ? SECOND : FIRST;
+        }
+        int64_t score_1 =
+            weight_ + max(p.score_0 - tables_.penalty, p.score_1);
+        return score_1 >= p.score_0 ? SECOND : FIRST;
+    }
+
+   private:
+    const weight_matrix &weights_;
+    const RunLengthTables<score_t> &tables_;
+    // The run of the last vertex, its weight and closed forms for the
+    // continuations.
+    int64_t segment_ = -1;
+    int64_t layer_ = -1;
+    const pmr::vector<int64_t> *run_ends_ = nullptr;
+    size_t column_ = 0;
+    int64_t weight_ = 0;
+    array<RunTransfer, 2> transfers_ = {RunTransfer({0, 0}, 0, 0),
+                                        RunTransfer({0, 0}, 0, 0)};
+    array<bool, 2> transfers_valid_ = {false, false};
+};
+
+// Helper function for `getPaths`. Merges and clears the `layer_path` into
+// `current_path` if possible.
+template <typename path_t, typename vertex_t>
+bool mergeLayerPathIntoCurrentPath(path_t &current_path, path_t &layer_path,
+                                   const vertex_t &j, const vertex_t &j_pred,
+                                   int surely_selected_j_p_layer) {
+    if ((surely_selected_j_p_layer != -1 &&
+         surely_selected_j_p_layer != j_pred.layer) ||
+        current_path.empty() || layer_path.empty() ||
+        current_path.back() != j || layer_path[0] != j_pred) {
+        return false;
+    }
+    current_path.insert(current_path.end(), layer_path.begin(),
+                        layer_path.end());
+    layer_path.clear();
+    return true;
+}
+
+template <typename score_t, typename index_t>
+vector<vector<BasicVertex<index_t>>> getPaths(
+    const eds_matrix &eds_segments, basic_score_matrix<score_t> &scores,
+    basic_score_matrix<score_t> &choices) {
+    vector<vector<BasicVertex<index_t>>> paths;
+    getPaths(eds_segments, scores, choices, paths);
+    return paths;
+}
+
+template <typename choice_lookup_t, typename paths_t>
+void tracePaths(const eds_matrix &eds_segments, choice_lookup_t choice_of,
+                paths_t &paths,
+                const UnprofitableRegions *skipped_regions = nullptr);
+
+template <typename score_t, typename paths_t>
+void getPaths(const eds_matrix &eds_segments,
+              basic_score_matrix<score_t> &scores,
+              basic_score_matrix<score_t> &choices, paths_t &paths) {
+    tracePaths(
+        eds_segments,
+        [&choices](auto v, bool surely_selected, path_continuation path_goes) {
+            return getChoice(choices, v, surely_selected, path_goes);
+        },
+        paths);
+}
+
+template <typename score_t, typename paths_t>
+void getPaths(const eds_matrix &eds_segments, const weight_matrix &weights,
+              const RunLengthTables<score_t> &tables, paths_t &paths) {
+    tracePaths(eds_segments, RunLengthChoices<score_t>(weights, tables), paths);
+}
+
+template <typename score_t, typename paths_t>
+void getPaths(const eds_matrix &eds_segments, const weight_matrix &weights,
+              basic_score_matrix<score_t> &scores,
+              basic_score_matrix<score_t> &choices,
+              const UnprofitableRegions &regions, paths_t &paths) {
+    // The traceback looks up the vertices in the reverse order of the graph.
+    // The last region that does not start after the vertex looked up.
+    int64_t next_region = (int64_t)regions.regions.size() - 1;
+    tracePaths(
+        eds_segments,
+        [&](auto v, bool surely_selected, path_continuation path_goes) {
+            while (next_region >= 0 &&
+                   regionStartsAfter(regions.regions[next_region], v)) {
+                next_region--;
+            }
+            if (next_region >= 0) {
+                const auto &region = regions.regions[next_region];
+                // The choice of W(q, 1) is left out by
+                // `unprofitableRegionRule()`.
+                if (region.segment == v.segment &&
+                    (v.index < region.last_index || surely_selected)) {
+                    fillUnprofitableRegion(weights, region, regions.penalty,
+                                           scores, choices);
+                    next_region--;
+                }
+            }
+            return getChoice(choices, v, surely_selected, path_goes);
+        },
+        paths, &regions);
+}
+
+// State of the traceback between the calls of `traceBack()`, so that the
+// traceback can run in chunks of segments.
+template <typename paths_t>
+struct TracebackState {
+    typedef typename paths_t::value_type path_t;
+    typedef typename path_t::value_type vertex_t;
+    typedef decltype(vertex_t::segment) index_t;
+
+    TracebackState(const eds_matrix &eds_segments, const paths_t &paths)
+        : first_path(paths.size()),
+          // The last vertex was synthetically added to the pangenome-graph
+          // and has weight 0. Therefore, it is not necessary to select it
+          a(getLastVertex<index_t>(eds_segments)),
+          current_path(paths.get_allocator()),
+          layer_path(paths.get_allocator()),
+          after_bubble_current_path(paths.get_allocator()) {}
+
+    // Newly found paths start after the given ones.
+    size_t first_path;
+    // The next vertex to trace back.
+    vertex_t a;
+    bool is_a_surely_selected = false;
+    path_t current_path;
+    // Buffers of the bubbles, kept between the bubbles to reuse their
+    // capacity.
+    path_t layer_path;
+    path_t after_bubble_current_path;
+    // The regions without selected vertices that the traceback jumps over,
+    // see `findUnprofitableRegions()`, if any, and the last of them that does
+    // not start after `a`.
+    const UnprofitableRegions *skipped_regions = nullptr;
+    int64_t next_skipped_region = -1;
+};
+
+template <typename index_t>
+bool regionStartsAfter(const UnprofitableRegions::Region &region,
+                       BasicVertex<index_t> v) {
+    return region.segment > v.segment ||
+           (region.segment == v.segment && region.first_index > v.index);
+}
+
+// Moves `state.a` from the last vertex of an unprofitable region, which is not
+// selected, to the first vertex of the region.
+template <typename paths_t>
+void skipUnprofitableRegion(TracebackState<paths_t> &state) {
+    const auto &regions = state.skipped_regions->regions;
+    int64_t &next = state.next_skipped_region;
+    auto &a = state.a;
+    while (next >= 0 && regionStartsAfter(regions[next], a)) {
+        next--;
+    }
+    if (next >= 0 && regions[next].segment == a.segment &&
+        regions[next].last_index == a.index) {
+        a.index = regions[next].first_index;
+    }
+}
+
+// Traces back the vertices of segments `first_segment` and later, starting
+// from `state.a`. The choices of the DP are needed for these segments only: a
+// bubble is traced back from its J vertex, so `first_segment` must not be the
+// J vertex segment of a bubble.
+template <typename choice_lookup_t, typename paths_t>
+void traceBack(const eds_matrix &eds_segments, choice_lookup_t &choice_of,
+               TracebackState<paths_t> &state, paths_t &paths,
+               int64_t first_segment);
+
+// Completes the paths after the traceback reached the first vertex.
+template <typename paths_t>
+void finishTraceback(TracebackState<paths_t> &state, paths_t &paths) {
+    if (!state.current_path.empty()) {
+        paths.emplace_back(state.current_path);
+    }
+
+    // Reverse the paths.
+    for (size_t i = state.first_path; i < paths.size(); i++) {
+        reverse(paths[i].begin(), paths[i].end());
+    }
+}
+
+// Traceback of `getPaths()`. `choice_of(v, surely_selected, path_goes)` returns
+// the choice of the DP for vertex `v`.
+template <typename choice_lookup_t, typename paths_t>
+void tracePaths(const eds_matrix &eds_segments, choice_lookup_t choice_of,
+                paths_t &paths, const UnprofitableRegions *skipped_regions) {
+    TracebackState<paths_t> state(eds_segments, paths);
+    if (skipped_regions != nullptr) {
+        state.skipped_regions = skipped_regions;
+        state.next_skipped_region =
+            (int64_t)skipped_regions->regions.size() - 1;
+    }
+    traceBack(eds_segments, choice_of, state, paths, 0);
+    finishTraceback(state, paths);
+}
+
+template <typename choice_lookup_t, typename paths_t>
+void traceBack(const eds_matrix &eds_segments, choice_lookup_t &choice_of,
+               TracebackState<paths_t> &state, paths_t &paths,
+               int64_t first_segment) {
+    typedef typename TracebackState<paths_t>::vertex_t vertex_t;
+    vertex_t &a = state.a;
+    bool &is_a_surely_selected = state.is_a_surely_selected;
+    auto &current_path = state.current_path;
+    auto &layer_path = state.layer_path;
+    auto &after_bubble_current_path = state.after_bubble_current_path;
+    while (hasPredecessorVertex(a) && a.segment >= first_segment) {
+        // N vertex.
+        if (isNVertex(a, eds_segments)) {
+            // W(a, 1) = w(a) + max{W(p, 0) - x, W(p, 1)}
+            // W(a, 0) = max{W(p, 0), W(a, 1)}
+            int choice = choice_of(
+                a, is_a_surely_selected ? SURELY_SELECTED : !SURELY_SELECTED,
+                I);
+            // Vertex `a` is selected if W(a, 1) or W(a, 0) = W(a, 1).
+            if (is_a_surely_selected || choice == SECOND) {
+                current_path.emplace_back(a);
+                if (is_a_surely_selected) {
+                    is_a_surely_selected = choice == SECOND ? true : false;
+                } else {
+                    if (choice == FIRST) {
+                        is_a_surely_selected = false;
+                    } else {
+                        int choice_a_1 = choice_of(a, !SURELY_SELECTED, I);
+                        is_a_surely_selected = choice == SECOND ? true : false;
+                    }
+                }
+            }
+            // Vertex `a` is not selected if W(a, 0) = W(p, 0).
+            else {
+                is_a_surely_selected = false;
+                if (!current_path.empty()) {
+                    paths.emplace_back(current_path);
+                    current_path.clear();
+                }
+                if (state.skipped_regions != nullptr) {
+                    skipUnprofitableRegion(state);
+                }
+            }
+            a = getPredecessorVertex(eds_segments, a);
+        }
+        // J vertex.
+        // Handle the full bubble, `a` is the start vertex of the bubble after
+        // this code part.
+        else if (isJVertex(a, eds_segments)) {
+            vertex_t j = a;
+            int num_preds = eds_segments[a.segment - 1].size();
+            // W(a, 1) = w(a) + max{group_1, group_2, group_3}.
+            // W(a, 0) = max{
+            //      W(p1, 0, I) + W(p2, 0, E) +...+ W(pb, 0, E),
+            //                         ...
+            //      W(p1, 0, E) + W(p2, 0, E) +...+ W(pb, 0, I),
+            //      W(a, 1)
+            // where b is the number of layers in the current bubble.
+
+            int choice = choice_of(
+                j, is_a_surely_selected ? SURELY_SELECTED : !SURELY_SELECTED,
+                I);
+
+            // Select J vertex if W(a, 1) or W(a, 0) = W(a, 1).
+            if (is_a_surely_selected || choice == num_preds) {
+                current_path.emplace_back(a);
+            } else {
+                if (!current_path.empty()) {
+                    paths.emplace_back(current_path);
+                    current_path.clear();
+                }
+            }
 
             // From the saved choice, we can determine which predecessor is
             // surely selected, if any.
@@ -725,7 +2058,7 @@ vector<vector<Vertex>> getPaths(const eds_matrix &eds_segments,
 
             // If W(a, 0) = W(a, 1).
             if (choice >= num_preds) {
-                choice = getChoice(choices, j, SURELY_SELECTED);
+                choice = choice_of(j, SURELY_SELECTED, I);
             }
 
             // Based on the rule group (every `num_preds` lines), we can get
@@ -744,19 +2077,20 @@ vector<vector<Vertex>> getPaths(const eds_matrix &eds_segments,
                 }
             }
 
-            vector<Vertex> after_bubble_current_path;
+            after_bubble_current_path.clear();
             // Iterate through the layers and store the paths on each layer,
             // handle the first layer last. Continue current path with one of
             // the predecessors.
             for (int layer = num_preds - 1; layer >= 0; layer--) {
-                vector<Vertex> layer_path;
+                layer_path.clear();
                 int path_cont_layer = rule_line == layer ? I : E;
                 is_a_surely_selected = layer == surely_selected_j_p_layer;
+                vertex_t j_pred = getPredecessorVertex(eds_segments, j, layer);
 
                 // Handle the full layer.
-                a = j_preds[layer];
+                a = j_pred;
                 while (isLayerVertex(a, eds_segments)) {
-                    choice = getChoice(choices, a, is_a_surely_selected,
+                    choice = choice_of(a, is_a_surely_selected,
                                        path_cont_layer);
 
                     // 1_first vertex: this is the last and vertex to be
@@ -773,7 +2107,7 @@ vector<vector<Vertex>> getPaths(const eds_matrix &eds_segments,
                                 layer_path.emplace_back(a);
                                 if (!mergeLayerPathIntoCurrentPath(
                                         current_path, layer_path, j,
-                                        j_preds[layer],
+                                        j_pred,
                                         surely_selected_j_p_layer)) {
                                     if (!current_path.empty()) {
                                         paths.emplace_back(current_path);
@@ -786,7 +2120,7 @@ vector<vector<Vertex>> getPaths(const eds_matrix &eds_segments,
                             else {
                                 if (mergeLayerPathIntoCurrentPath(
                                         current_path, layer_path, j,
-                                        j_preds[layer],
+                                        j_pred,
                                         surely_selected_j_p_layer)) {
                                     paths.emplace_back(current_path);
                                 } else {
@@ -806,7 +2140,7 @@ vector<vector<Vertex>> getPaths(const eds_matrix &eds_segments,
                         // Path continues on different layer.
                         else {
                             if (mergeLayerPathIntoCurrentPath(
-                                    current_path, layer_path, j, j_preds[layer],
+                                    current_path, layer_path, j, j_pred,
                                     surely_selected_j_p_layer)) {
                                 paths.emplace_back(current_path);
                             } else {
@@ -829,7 +2163,7 @@ vector<vector<Vertex>> getPaths(const eds_matrix &eds_segments,
                             // Vertex `a` is surely selected.
                             layer_path.emplace_back(a);
                             if (mergeLayerPathIntoCurrentPath(
-                                    current_path, layer_path, j, j_preds[layer],
+                                    current_path, layer_path, j, j_pred,
                                     surely_selected_j_p_layer)) {
                                 after_bubble_current_path = current_path;
                                 current_path.clear();
@@ -842,7 +2176,7 @@ vector<vector<Vertex>> getPaths(const eds_matrix &eds_segments,
                                 layer_path.emplace_back(a);
                             }
                             if (mergeLayerPathIntoCurrentPath(
-                                    current_path, layer_path, j, j_preds[layer],
+                                    current_path, layer_path, j, j_pred,
                                     surely_selected_j_p_layer)) {
                                 paths.emplace_back(current_path);
                                 current_path.clear();
@@ -867,7 +2201,7 @@ vector<vector<Vertex>> getPaths(const eds_matrix &eds_segments,
                                     is_a_surely_selected = false;
                                 } else {
                                     int choice_a_1 =
-                                        getChoice(choices, a, !SURELY_SELECTED);
+                                        choice_of(a, !SURELY_SELECTED, I);
                                     is_a_surely_selected =
                                         choice == SECOND ? true : false;
                                 }
@@ -878,7 +2212,7 @@ vector<vector<Vertex>> getPaths(const eds_matrix &eds_segments,
                         else {
                             is_a_surely_selected = false;
                             if (mergeLayerPathIntoCurrentPath(
-                                    current_path, layer_path, j, j_preds[layer],
+                                    current_path, layer_path, j, j_pred,
                                     surely_selected_j_p_layer)) {
                                 paths.emplace_back(current_path);
                                 current_path.clear();
@@ -895,41 +2229,1708 @@ vector<vector<Vertex>> getPaths(const eds_matrix &eds_segments,
             assert(false);
         }
     }
-    if (!current_path.empty()) {
-        paths.emplace_back(current_path);
+}
+
+// The smallest part of the graph worth a thread of the traceback.
+const int64_t TRACEBACK_CHUNK_VERTICES = 1 << 16;
+
+// Returns whether the traceback left no path open at `state.a`, the last vertex
+// of a deterministic segment. From there on, it is the same as the traceback
+// from the end of the graph.
+template <typename paths_t>
+bool isTracebackClosed(const eds_matrix &eds_segments,
+                       const TracebackState<paths_t> &state) {
+    return state.a.index + 1 ==
+               (int64_t)eds_segments[state.a.segment][0].size() &&
+           !state.is_a_surely_selected && state.current_path.empty();
+}
+
+// A chunk of the parallel traceback, traced back from its last vertex. The
+// paths are allocated from the heap, the resource of the paths of the
+// traceback may not be thread-safe.
+template <typename vertex_t>
+struct TracebackChunk {
+    typedef vector<vector<vertex_t>> paths_t;
+
+    TracebackChunk(const eds_matrix &eds_segments, int64_t first_segment)
+        : first_segment(first_segment), state(eds_segments, found) {}
+
+    // A bubble, or 0 for the first chunk.
+    int64_t first_segment;
+    // The paths in the order of the traceback.
+    paths_t found;
+    // The deterministic segments at whose last vertex the traceback left no
+    // path open, with the number of paths found before, in the order of the
+    // traceback.
+    vector<pair<int64_t, size_t>> closed;
+    TracebackState<paths_t> state;
+};
+
+// Traces back the chunk from `chunk.state` to the last vertex before it.
+template <typename choice_lookup_t, typename vertex_t>
+void traceBackChunk(const eds_matrix &eds_segments, choice_lookup_t choice_of,
+                    TracebackChunk<vertex_t> &chunk) {
+    auto &state = chunk.state;
+    // Between the calls of `traceBack()`, `state.a` is the last vertex of a
+    // deterministic segment, or the first vertex of the graph.
+    while (state.a.segment >= chunk.first_segment) {
+        if (isTracebackClosed(eds_segments, state)) {
+            chunk.closed.emplace_back(state.a.segment, chunk.found.size());
+        }
+        if (!hasPredecessorVertex(state.a)) {
+            break;
+        }
+        traceBack(eds_segments, choice_of, state, chunk.found,
+                  state.a.segment);
     }
+}
 
-    // Reverse the paths.
-    for (auto &path : paths) {
-        reverse(path.begin(), path.end());
+// Parallel traceback of `getPathsInParallel()`, the same paths as
+// `tracePaths()`.
+template <typename choice_lookup_t, typename paths_t>
+void tracePathsInParallel(const eds_matrix &eds_segments,
+                          choice_lookup_t choice_of, paths_t &paths,
+                          int num_threads) {
+    typedef typename TracebackState<paths_t>::vertex_t vertex_t;
+    int64_t num_vertices = linearizedGraphLength(eds_segments);
+    vector<int64_t> first_segments = checkpointBlocks(
+        eds_segments, max(TRACEBACK_CHUNK_VERTICES,
+                          num_vertices / max(num_threads, 1) + 1));
+    if (first_segments.size() == 1) {
+        tracePaths(eds_segments, choice_of, paths);
+        return;
     }
 
-    return paths;
+    // Every chunk starts from the last vertex of the deterministic segment
+    // before the next chunk, the last chunk from the end of the graph.
+    vector<TracebackChunk<vertex_t>> chunks;
+    chunks.reserve(first_segments.size());
+    for (size_t chunk = 0; chunk < first_segments.size(); chunk++) {
+        chunks.emplace_back(eds_segments, first_segments[chunk]);
+        if (chunk + 1 < first_segments.size()) {
+            int64_t last_segment = first_segments[chunk + 1] - 1;
+            chunks.back().state.a = vertex_t(
+                last_segment, 0, eds_segments[last_segment][0].size() - 1);
+        }
+    }
+    vector<thread> threads;
+    for (size_t chunk = 1; chunk < chunks.size(); chunk++) {
+        threads.emplace_back([&, chunk] {
+            traceBackChunk(eds_segments, choice_of, chunks[chunk]);
+        });
+    }
+    traceBackChunk(eds_segments, choice_of, chunks[0]);
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    // The traceback from the end of the graph, through the chunks from the
+    // last one on.
+    TracebackState<paths_t> state(eds_segments, paths);
+    for (auto chunk = chunks.rbegin(); chunk != chunks.rend(); chunk++) {
+        auto closed = chunk->closed.begin();
+        while (true) {
+            if (isTracebackClosed(eds_segments, state)) {
+                while (closed != chunk->closed.end() &&
+                       closed->first > state.a.segment) {
+                    closed++;
+                }
+                if (closed != chunk->closed.end() &&
+                    closed->first == state.a.segment) {
+                    // The traceback of the chunk from here on.
+                    for (auto path = chunk->found.begin() + closed->second;
+                         path != chunk->found.end(); path++) {
+                        paths.emplace_back(path->begin(), path->end());
+                    }
+                    state.a = chunk->state.a;
+                    state.is_a_surely_selected =
+                        chunk->state.is_a_surely_selected;
+                    state.current_path.assign(
+                        chunk->state.current_path.begin(),
+                        chunk->state.current_path.end());
+                    break;
+                }
+            }
+            if (!hasPredecessorVertex(state.a) ||
+                state.a.segment < chunk->first_segment) {
+                break;
+            }
+            traceBack(eds_segments, choice_of, state, paths, state.a.segment);
+        }
+        chunk->found = {};
+    }
+    finishTraceback(state, paths);
+}
+
+// The scores are not needed by the traceback, they are a parameter like in
+// `getPaths()`.
+template <typename score_t, typename paths_t>
+void getPathsInParallel(const eds_matrix &eds_segments,
+                        basic_score_matrix<score_t> & /* scores */,
+                        basic_score_matrix<score_t> &choices, paths_t &paths,
+                        int num_threads) {
+    tracePathsInParallel(
+        eds_segments,
+        [&choices](auto v, bool surely_selected, path_continuation path_goes) {
+            return getChoice(choices, v, surely_selected, path_goes);
+        },
+        paths, num_threads);
+}
+
+template <typename score_t, typename paths_t>
+void getPathsInParallel(const eds_matrix &eds_segments,
+                        const weight_matrix &weights,
+                        const RunLengthTables<score_t> &tables,
+                        paths_t &paths, int num_threads) {
+    tracePathsInParallel(eds_segments,
+                         RunLengthChoices<score_t>(weights, tables), paths,
+                         num_threads);
+}
+
+// The cells of the segments of one block of `checkpointBlocks()`, stored flat
+// so that the next blocks reuse the memory.
+template <typename score_t>
+struct BlockTables {
+    explicit BlockTables(pmr::memory_resource *resource)
+        : scores(resource),
+          choices(resource),
+          layer_starts(resource),
+          segment_starts(resource) {}
+
+    // Lays out the cells of segments `first_segment`..`end_segment` - 1.
+    void reset(const eds_matrix &eds_segments, int64_t first_segment,
+               int64_t end_segment) {
+        this->first_segment = first_segment;
+        layer_starts.clear();
+        segment_starts.clear();
+        int64_t num_cells = 0;
+        for (int64_t segment = first_segment; segment < end_segment;
+             segment++) {
+            segment_starts.push_back(layer_starts.size());
+            for (const auto &layer : eds_segments[segment]) {
+                layer_starts.push_back(num_cells);
+                num_cells += layer.size();
+            }
+        }
+        scores.resize(num_cells);
+        choices.resize(num_cells);
+    }
+
+    int64_t cellIndex(int64_t segment, int64_t layer, int64_t index) const {
+        return layer_starts[segment_starts[segment - first_segment] + layer] +
+               index;
+    }
+
+    int64_t first_segment = 0;
+    pmr::vector<score_cell<score_t>> scores;
+    pmr::vector<score_cell<score_t>> choices;
+    // `layer_starts[segment_starts[segment - first_segment] + layer]` is the
+    // index of the cell of the first vertex of the layer.
+    pmr::vector<int64_t> layer_starts;
+    pmr::vector<int64_t> segment_starts;
+};
+
+template <typename score_t, typename paths_t>
+score_t findMaxScoringPathsCheckpointed(const eds_matrix &eds_segments,
+                                        const weight_matrix &weights,
+                                        int penalty, int64_t block_vertices,
+                                        paths_t &paths,
+                                        pmr::memory_resource *resource) {
+    typedef typename TracebackState<paths_t>::index_t index_t;
+    checkTypeWidths<score_t, index_t>(eds_segments, weights, penalty);
+    vector<int64_t> first_segments =
+        checkpointBlocks(eds_segments, block_vertices);
+    int64_t num_segments = eds_segments.size();
+
+    // Forward pass, saves the cell of the start vertex of the first bubble of
+    // every block.
+    SegmentWindow<score_t> window(eds_segments);
+    pmr::vector<score_cell<score_t>> checkpoints(first_segments.size(),
+                                                 resource);
+    size_t block = 0;
+    int64_t max_block_cells = 0;
+    for (index_t segment = 0; segment < num_segments; segment++) {
+        if (block < first_segments.size() &&
+            segment == first_segments[block]) {
+            checkpoints[block++] = window.last_cells[0];
+        }
+        window.fill(eds_segments, weights, penalty, segment);
+    }
+    score_t score = window.score();
+
+    // Backward pass, recomputes the tables of the blocks from the last one and
+    // traces them back.
+    BlockTables<score_t> tables(resource);
+    for (size_t i = 0; i < first_segments.size(); i++) {
+        int64_t end_segment =
+            i + 1 < first_segments.size() ? first_segments[i + 1]
+                                          : num_segments;
+        int64_t cells = 0;
+        for (int64_t segment = first_segments[i]; segment < end_segment;
+             segment++) {
+            for (const auto &layer : eds_segments[segment]) {
+                cells += layer.size();
+            }
+        }
+        max_block_cells = max(max_block_cells, cells);
+    }
+    tables.scores.reserve(max_block_cells);
+    tables.choices.reserve(max_block_cells);
+
+    TracebackState<paths_t> state(eds_segments, paths);
+    auto choice_of = [&tables](auto v, bool surely_selected,
+                               path_continuation path_goes) {
+        return tables.choices[tables.cellIndex(v.segment, v.layer, v.index)]
+                             [surely_selected][path_goes];
+    };
+    JPredecessorScores<score_t> j_preds;
+    for (size_t i = first_segments.size(); i-- > 0;) {
+        int64_t first_segment = first_segments[i];
+        int64_t end_segment =
+            i + 1 < first_segments.size() ? first_segments[i + 1]
+                                          : num_segments;
+        tables.reset(eds_segments, first_segment, end_segment);
+        for (index_t segment = first_segment; segment < end_segment;
+             segment++) {
+            fillSegment<score_t>(
+                eds_segments, weights, penalty, segment,
+                [&](int layer) -> const score_cell<score_t> & {
+                    if (segment == first_segment) {
+                        return checkpoints[i];
+                    }
+                    int64_t last = eds_segments[segment - 1][layer].size() - 1;
+                    return tables.scores[tables.cellIndex(segment - 1, layer,
+                                                          last)];
+                },
+                [&](index_t layer, index_t index) -> score_cell<score_t> & {
+                    return tables.scores[tables.cellIndex(segment, layer,
+                                                          index)];
+                },
+                [&](index_t layer, index_t index) -> score_cell<score_t> & {
+                    return tables.choices[tables.cellIndex(segment, layer,
+                                                           index)];
+                },
+                j_preds);
+        }
+        traceBack(eds_segments, choice_of, state, paths, first_segment);
+    }
+    finishTraceback(state, paths);
+    return score;
+}
+
+template <typename score_t>
+PackedTables<score_t> initPackedTables(const eds_matrix &eds_segments,
+                                       pmr::memory_resource *resource) {
+    PackedTables<score_t> tables(resource);
+    int64_t num_layers = 0;
+    for (const auto &segment : eds_segments) {
+        num_layers += segment.size();
+    }
+    tables.layer_starts.reserve(num_layers + 1);
+    tables.segment_first_layers.reserve(eds_segments.size() + 1);
+    tables.layer_starts.push_back(0);
+    for (const auto &segment : eds_segments) {
+        tables.segment_first_layers.push_back(tables.layer_starts.size() - 1);
+        for (const auto &layer : segment) {
+            tables.layer_starts.push_back(tables.layer_starts.back() +
+                                          layer.size());
+        }
+    }
+    tables.segment_first_layers.push_back(tables.layer_starts.size() - 1);
+    tables.choice_bits.resize((tables.layer_starts.back() + 1) / 2);
+    tables.j_choices.resize(eds_segments.size());
+    return tables;
+}
+
+template <typename score_t, typename index_t>
+score_t findMaxScoringPaths(const eds_matrix &eds_segments,
+                            const weight_matrix &weights,
+                            PackedTables<score_t> &tables, int penalty) {
+    typedef BasicVertex<index_t> vertex_t;
+    checkTypeWidths<score_t, index_t>(eds_segments, weights, penalty);
+    fill(tables.choice_bits.begin(), tables.choice_bits.end(), 0);
+
+    // The rules fill the choices of a vertex in `pending`, they are packed
+    // when the DP moves on to the next vertex.
+    score_cell<score_t> pending = {};
+    int64_t pending_position = -1;
+    auto pack = [&] {
+        if (pending_position >= 0) {
+            int bits = pending[!SURELY_SELECTED][I] |
+                       pending[!SURELY_SELECTED][E] << 1 |
+                       pending[SURELY_SELECTED][I] << 2 |
+                       pending[SURELY_SELECTED][E] << 3;
+            tables.choice_bits[pending_position >> 1] |=
+                bits << (4 * (pending_position & 1));
+        }
+    };
+    SegmentWindow<score_t> window(eds_segments);
+    for (index_t segment = 0; segment < eds_segments.size(); segment++) {
+        int64_t first_layer = tables.segment_first_layers[segment];
+        window.fill(
+            eds_segments, weights, penalty, segment,
+            [&](index_t layer, index_t index) -> score_cell<score_t> & {
+                if (isJVertex(vertex_t{segment, layer, index},
+                              eds_segments)) {
+                    return tables.j_choices[segment];
+                }
+                pack();
+                pending = {};
+                pending_position =
+                    tables.layer_starts[first_layer + layer] + index;
+                return pending;
+            });
+    }
+    pack();
+    return window.score();
+}
+
+template <typename score_t, typename paths_t>
+void getPaths(const eds_matrix &eds_segments,
+              const PackedTables<score_t> &tables, paths_t &paths) {
+    tracePaths(
+        eds_segments,
+        [&tables](auto v, bool surely_selected, path_continuation path_goes) {
+            return tables.choice(v, surely_selected, path_goes);
+        },
+        paths);
+}
+
+template <typename score_t, typename paths_t>
+void getPathsInParallel(const eds_matrix &eds_segments,
+                        const PackedTables<score_t> &tables, paths_t &paths,
+                        int num_threads) {
+    tracePathsInParallel(
+        eds_segments,
+        [&tables](auto v, bool surely_selected, path_continuation path_goes) {
+            return tables.choice(v, surely_selected, path_goes);
+        },
+        paths, num_threads);
+}
+
+template <typename score_t, typename index_t>
+AppendableMaxScorePaths<score_t, index_t>::AppendableMaxScorePaths(
+    int match, int non_match, int penalty, pmr::memory_resource *resource)
+    : match_(match),
+      non_match_(non_match),
+      penalty_(penalty),
+      eds_segments_(1, vector<string>{string(2, EMPTY_STR)}),
+      weights_(resource),
+      scores_(resource),
+      choices_(resource),
+      num_vertices_(2),
+      max_coordinate_(2) {
+    update(vertex_t{0, 0, 0}, 0);
+}
+
+template <typename score_t, typename index_t>
+score_t AppendableMaxScorePaths<score_t, index_t>::append(const string &EDS) {
+    eds_matrix added = EDSToMatrix(EDS + EMPTY_STR);
+    // The last segment is deterministic and ends with the closing
+    // `EMPTY_STR`. If it is only that, it follows a bubble.
+    int64_t last = eds_segments_.size() - 1;
+    const string &tail = eds_segments_[last][0];
+    bool ends_with_bubble = last > 0 && tail.size() == 1;
+    bool starts_with_bubble = added[0].size() > 1;
+
+    // Check the types for the new graph before changing it.
+    int64_t num_vertices = num_vertices_ - 1;
+    int64_t max_abs_weight = max_abs_weight_;
+    int64_t max_bubble_width = max_bubble_width_;
+    int64_t max_coordinate =
+        max(max_coordinate_, (int64_t)(last + added.size()));
+    for (const auto &segment : added) {
+        max_bubble_width = max(max_bubble_width, (int64_t)segment.size());
+        for (const auto &layer : segment) {
+            num_vertices += layer.size();
+            max_coordinate = max(max_coordinate, (int64_t)layer.size());
+            for (char c : layer) {
+                max_abs_weight =
+                    max(max_abs_weight,
+                        abs((int64_t)gcContentWeight(c, match_, non_match_)));
+            }
+        }
+    }
+    if (ends_with_bubble && starts_with_bubble) {
+        // The separator stays.
+        num_vertices++;
+    }
+    if (!ends_with_bubble && !starts_with_bubble) {
+        max_coordinate = max(max_coordinate,
+                             (int64_t)(tail.size() - 1 + added[0][0].size()));
+    }
+    if (!fitsScoreType<score_t>(
+            scoreBound(num_vertices, max_abs_weight, penalty_),
+            max(max_bubble_width, max_bubble_width_))) {
+        throw overflow_error("Score type is too narrow for the graph, use " +
+                             string("selectScoreWidth()."));
+    }
+    if (sizeof(index_t) < sizeof(int64_t) &&
+        max_coordinate > numeric_limits<int32_t>::max()) {
+        throw overflow_error("Index type is too narrow for the graph, use " +
+                             string("selectIndexWidth()."));
+    }
+    num_vertices_ = num_vertices;
+    max_abs_weight_ = max_abs_weight;
+    max_bubble_width_ = max_bubble_width;
+    max_coordinate_ = max_coordinate;
+
+    // The first vertex whose cell changes, and the first segment with a
+    // changed last vertex.
+    vertex_t first;
+    int64_t first_changed_segment = last;
+    size_t first_added = 0;
+    if (ends_with_bubble && starts_with_bubble) {
+        // The separator of the bubbles and its cell stay.
+        first = {index_t(last + 1), 0, 0};
+        first_changed_segment = last + 1;
+    } else if (ends_with_bubble) {
+        eds_segments_.pop_back();
+        first = {index_t(last), 0, 0};
+    } else {
+        string &text = eds_segments_[last][0];
+        text.pop_back();
+        if (starts_with_bubble) {
+            first = {index_t(last + 1), 0, 0};
+        } else {
+            first = {index_t(last), 0, index_t(text.size())};
+            text += added[0][0];
+            first_added = 1;
+        }
+    }
+    for (size_t segment = first_added; segment < added.size(); segment++) {
+        eds_segments_.push_back(move(added[segment]));
+    }
+    update(first, first_changed_segment);
+    return score_;
+}
+
+template <typename score_t, typename index_t>
+void AppendableMaxScorePaths<score_t, index_t>::update(
+    vertex_t first, int64_t first_changed_segment) {
+    int64_t num_segments = eds_segments_.size();
+    weights_.resize(num_segments);
+    scores_.resize(num_segments);
+    choices_.resize(num_segments);
+    filled_vertices_ = 0;
+    for (int64_t segment = first_changed_segment; segment < num_segments;
+         segment++) {
+        const auto &layers = eds_segments_[segment];
+        weights_[segment].resize(layers.size());
+        scores_[segment].resize(layers.size());
+        choices_[segment].resize(layers.size());
+        for (size_t layer = 0; layer < layers.size(); layer++) {
+            const string &str = layers[layer];
+            // The vertices of the layer before `first` keep their cells.
+            size_t kept = str.size();
+            if (segment > first.segment ||
+                (segment == first.segment && layer > first.layer)) {
+                kept = 0;
+            } else if (segment == first.segment && layer == first.layer) {
+                kept = first.index;
+            }
+            auto &layer_weights = weights_[segment][layer];
+            layer_weights.resize(kept);
+            for (size_t index = kept; index < str.size(); index++) {
+                layer_weights.push_back(
+                    gcContentWeight(str[index], match_, non_match_));
+            }
+            // The cells from `first` on start from zero, see `fillTables()`.
+            scores_[segment][layer].resize(kept);
+            scores_[segment][layer].resize(str.size());
+            choices_[segment][layer].resize(kept);
+            choices_[segment][layer].resize(str.size());
+            filled_vertices_ += str.size() - kept;
+        }
+    }
+    fillTables(eds_segments_, weights_, scores_, choices_, penalty_, first);
+
+    const auto &last_cell = scores_.back()[0].back();
+    score_ =
+        max(last_cell[!SURELY_SELECTED][I], last_cell[!SURELY_SELECTED][E]);
+    traceBackPaths(first_changed_segment);
+}
+
+template <typename score_t, typename index_t>
+void AppendableMaxScorePaths<score_t, index_t>::traceBackPaths(
+    int64_t first_changed_segment) {
+    auto choice_of = [this](vertex_t v, bool surely_selected,
+                            path_continuation path_goes) {
+        return getChoice(choices_, v, surely_selected, path_goes);
+    };
+    paths_before_.resize(first_changed_segment);
+    paths_before_.resize(eds_segments_.size(), -1);
+
+    // The paths from the end of the graph, in the order of the traceback.
+    vector<vector<vertex_t>> found;
+    TracebackState<vector<vector<vertex_t>>> state(eds_segments_, found);
+    // The segments where no path is open, with the number of paths found
+    // before reaching their last vertex.
+    vector<pair<int64_t, int64_t>> closed;
+    int64_t kept_paths = 0;
+    // Between the calls of `traceBack()`, `state.a` is the last vertex of a
+    // deterministic segment, or the first vertex of the graph.
+    while (true) {
+        const vertex_t &a = state.a;
+        if (a.index + 1 == (int64_t)eds_segments_[a.segment][0].size()) {
+            bool is_closed =
+                !state.is_a_surely_selected && state.current_path.empty();
+            if (is_closed && a.segment < first_changed_segment &&
+                paths_before_[a.segment] >= 0) {
+                // From here on the traceback is the previous one.
+                kept_paths = paths_before_[a.segment];
+                break;
+            }
+            paths_before_[a.segment] = -1;
+            if (is_closed) {
+                closed.emplace_back(a.segment, found.size());
+            }
+        }
+        if (!hasPredecessorVertex(a)) {
+            break;
+        }
+        traceBack(eds_segments_, choice_of, state, found, a.segment);
+    }
+    finishTraceback(state, found);
+
+    paths_.resize(kept_paths);
+    changed_paths_ = found.size();
+    for (auto path = found.rbegin(); path != found.rend(); path++) {
+        paths_.push_back(move(*path));
+    }
+    for (const auto &[segment, found_before] : closed) {
+        paths_before_[segment] = paths_.size() - found_before;
+    }
+}
+
+// Traces back `state` to the last vertex of `final_segment`, or to the first
+// vertex of the graph if it is -1, see `traceBackChunk()`. The deterministic
+// segments whose last vertex the traceback reaches not surely selected are
+// added to `reached`, from the last one on.
+template <typename choice_lookup_t, typename paths_t>
+void traceBackToSegment(const eds_matrix &eds_segments,
+                        choice_lookup_t &choice_of,
+                        TracebackState<paths_t> &state, paths_t &found,
+                        int64_t final_segment, vector<int64_t> &reached) {
+    while (state.a.segment > final_segment && hasPredecessorVertex(state.a)) {
+        traceBack(eds_segments, choice_of, state, found, state.a.segment);
+        if (state.a.segment > final_segment && !state.is_a_surely_selected &&
+            state.a.index + 1 ==
+                (int64_t)eds_segments[state.a.segment][0].size()) {
+            reached.push_back(state.a.segment);
+        }
+    }
+}
+
+// Stands for the path open where the online traceback starts. The choices of
+// the traceback do not depend on its vertices, only the paths it is in.
+template <typename vertex_t>
+vertex_t openPathMark() {
+    return vertex_t(-1, -1, -1);
+}
+
+template <typename score_t, typename index_t>
+OnlineMaxScorePaths<score_t, index_t>::OnlineMaxScorePaths(int penalty,
+                                                           int64_t interval)
+    : penalty_(penalty),
+      interval_(interval),
+      last_cells_(1),
+      cells_(1),
+      // At the first vertex of the graph, the traceback of `getPaths()` ends
+      // the open path.
+      waiting_paths_(1, {openPathMark<vertex_t>()}) {}
+
+template <typename score_t, typename index_t>
+void OnlineMaxScorePaths<score_t, index_t>::extend(
+    const eds_matrix &eds_segments, const weight_matrix &weights,
+    paths_t &paths) {
+    JPredecessorScores<score_t> j_preds;
+    for (index_t segment = filled_segments_; segment < eds_segments.size();
+         segment++) {
+        const auto &layers = eds_segments[segment];
+        if (last_cells_.size() < layers.size()) {
+            last_cells_.resize(layers.size());
+            cells_.resize(layers.size());
+        }
+        auto &segment_choices = choices_.emplace_back();
+        int64_t num_vertices = 0;
+        for (const auto &layer : layers) {
+            segment_choices.emplace_back(layer.size());
+            num_vertices += layer.size();
+        }
+        fillSegment<score_t>(
+            eds_segments, weights, penalty_, segment,
+            [this](int layer) -> const score_cell<score_t> & {
+                return last_cells_[layer];
+            },
+            [this](index_t layer, index_t) -> score_cell<score_t> & {
+                return cells_[layer];
+            },
+            [&segment_choices](index_t layer,
+                               index_t index) -> score_cell<score_t> & {
+                return segment_choices[layer][index];
+            },
+            j_preds);
+        swap(last_cells_, cells_);
+        filled_segments_ = segment + 1;
+        kept_vertices_ += num_vertices;
+        max_kept_vertices_ = max(max_kept_vertices_, kept_vertices_);
+        filled_since_traceback_ += num_vertices;
+
+        // The next traceback waits for at least as many vertices as it left
+        // kept, so the tracebacks take linear time in total.
+        if (layers.size() == 1 &&
+            filled_since_traceback_ >=
+                max(interval_, kept_after_traceback_)) {
+            filled_since_traceback_ = 0;
+            traceBackCourses(eds_segments, segment, paths);
+            kept_after_traceback_ = kept_vertices_;
+        }
+    }
+}
+
+template <typename score_t, typename index_t>
+void OnlineMaxScorePaths<score_t, index_t>::traceBackCourses(
+    const eds_matrix &eds_segments, int64_t segment, paths_t &paths) {
+    auto choice_of = [this](vertex_t v, bool surely_selected,
+                            path_continuation path_goes) {
+        return choiceOf(v, surely_selected, path_goes);
+    };
+    // The courses with the last vertex of `segment` not selected and selected.
+    array<vector<int64_t>, 2> reached;
+    for (bool surely_selected : {false, true}) {
+        paths_t found;
+        TracebackState<paths_t> state(eds_segments, found);
+        state.a = vertex_t(segment, 0, eds_segments[segment][0].size() - 1);
+        state.is_a_surely_selected = surely_selected;
+        traceBackToSegment(eds_segments, choice_of, state, found,
+                           final_segment_, reached[surely_selected]);
+    }
+
+    // The last segment both courses reach not surely selected.
+    size_t i = 0;
+    size_t j = 0;
+    while (i < reached[0].size() && j < reached[1].size() &&
+           reached[0][i] != reached[1][j]) {
+        if (reached[0][i] > reached[1][j]) {
+            i++;
+        } else {
+            j++;
+        }
+    }
+    if (i == reached[0].size() || j == reached[1].size()) {
+        return;
+    }
+    traceBackFrom(eds_segments, reached[0][i], paths);
+    final_segment_ = reached[0][i];
+    dropChoicesBefore(final_segment_);
+}
+
+template <typename score_t, typename index_t>
+void OnlineMaxScorePaths<score_t, index_t>::traceBackFrom(
+    const eds_matrix &eds_segments, int64_t segment, paths_t &paths) {
+    auto choice_of = [this](vertex_t v, bool surely_selected,
+                            path_continuation path_goes) {
+        return choiceOf(v, surely_selected, path_goes);
+    };
+    const vertex_t mark = openPathMark<vertex_t>();
+    paths_t found;
+    TracebackState<paths_t> state(eds_segments, found);
+    if (segment != -1) {
+        state.a = vertex_t(segment, 0, eds_segments[segment][0].size() - 1);
+        state.current_path.push_back(mark);
+    }
+    vector<int64_t> reached;
+    traceBackToSegment(eds_segments, choice_of, state, found, final_segment_,
+                       reached);
+
+    // The waiting paths follow, with the path open at the last vertex of
+    // `final_segment_`, and do not count if they are empty then.
+    for (auto &path : waiting_paths_) {
+        auto open = find(path.begin(), path.end(), mark);
+        if (open != path.end()) {
+            open = path.erase(open);
+            path.insert(open, state.current_path.begin(),
+                        state.current_path.end());
+        }
+        if (!path.empty()) {
+            found.push_back(move(path));
+        }
+    }
+    size_t num_waiting = 0;
+    for (size_t path = 0; path < found.size(); path++) {
+        if (find(found[path].begin(), found[path].end(), mark) !=
+            found[path].end()) {
+            num_waiting = path + 1;
+        }
+    }
+    for (size_t path = found.size(); path-- > num_waiting;) {
+        reverse(found[path].begin(), found[path].end());
+        paths.push_back(move(found[path]));
+    }
+    found.resize(num_waiting);
+    waiting_paths_ = move(found);
+}
+
+template <typename score_t, typename index_t>
+void OnlineMaxScorePaths<score_t, index_t>::dropChoicesBefore(
+    int64_t segment) {
+    while (first_kept_segment_ < segment) {
+        for (const auto &layer : choices_.front()) {
+            kept_vertices_ -= layer.size();
+        }
+        choices_.pop_front();
+        first_kept_segment_++;
+    }
+}
+
+template <typename score_t, typename index_t>
+score_t OnlineMaxScorePaths<score_t, index_t>::finish(
+    const eds_matrix &eds_segments, paths_t &paths) {
+    traceBackFrom(eds_segments, -1, paths);
+    dropChoicesBefore(filled_segments_);
+
+    // The last vertex of the graph is an N or a J vertex.
+    const auto &last_cell = last_cells_[0];
+    return max(last_cell[!SURELY_SELECTED][I], last_cell[!SURELY_SELECTED][E]);
+}
+
+ComparativeMaxScores::ComparativeMaxScores(int match, int non_match,
+                                           int penalty)
+    : match_(match), non_match_(non_match), penalty_(penalty) {}
+
+int64_t ComparativeMaxScores::score(const eds_matrix &eds_segments) {
+    selectScoreWidth(
+        scoreBound(linearizedGraphLength(eds_segments),
+                   max(abs((int64_t)match_), abs((int64_t)non_match_)),
+                   penalty_),
+        maxBubbleWidth(eds_segments));
+    GCContentWeights weights(eds_segments, match_, non_match_);
+    SegmentWindow<int64_t> window(eds_segments);
+    // W(p, 0) and d of the last vertex p of the last unit.
+    int64_t score_0 = 0;
+    int64_t d = 0;
+    size_t first_segment = 0;
+    // The layers of the unit so far, each followed by a ',' and the last one
+    // of a segment by a '}', characters that the layers do not contain.
+    string unit_content;
+    uint64_t bubble_hash = 0;
+    for (size_t segment = 0; segment < eds_segments.size(); segment++) {
+        size_t segment_start = unit_content.size();
+        for (const auto &layer : eds_segments[segment]) {
+            unit_content += layer;
+            unit_content += ',';
+        }
+        unit_content.back() = '}';
+        bool is_bubble = eds_segments[segment].size() > 1;
+        if (is_bubble) {
+            bubble_hash = hash<string_view>()(
+                string_view(unit_content).substr(segment_start));
+        }
+        // The units end at the same bubbles in every graph, wherever the
+        // bubbles are, unless the graph ends first. The first segment is a
+        // unit on its own, it has no start vertex.
+        bool unit_ends = segment == 0 || segment + 1 == eds_segments.size() ||
+                         (!is_bubble && eds_segments[segment - 1].size() > 1 &&
+                          bubble_hash % UNIT_BUBBLES == 0);
+        if (!unit_ends) {
+            continue;
+        }
+
+        auto &transfers = units_[unit_content];
+        auto known = find_if(
+            transfers.begin(), transfers.end(),
+            [d](const Transfer &transfer) { return transfer.d == d; });
+        if (known != transfers.end()) {
+            reused_units_++;
+        } else {
+            // The start vertex p has W(p, 0) = 0.
+            computed_units_++;
+            window.last_cells[0] = {};
+            window.last_cells[0][SURELY_SELECTED][I] = d;
+            for (size_t unit_segment = first_segment; unit_segment <= segment;
+                 unit_segment++) {
+                window.fill(eds_segments, weights, penalty_,
+                            (int64_t)unit_segment);
+            }
+            const auto &end_cell = window.last_cells[0];
+            transfers.push_back(
+                {d,
+                 end_cell[SURELY_SELECTED][I] - end_cell[!SURELY_SELECTED][I],
+                 end_cell[!SURELY_SELECTED][I]});
+            known = transfers.end() - 1;
+        }
+        score_0 += known->offset;
+        d = known->end_d;
+        first_segment = segment + 1;
+        unit_content.clear();
+    }
+    // The last vertex is an `EMPTY_STR` with the E continuation at 0, as in
+    // `SegmentWindow::score()`.
+    return max<int64_t>(score_0, 0);
+}
+
+// Sharded DP, see `computeShardTransfer()` and `traceBackShard()`.
+
+// The cells of p that stand for a missing cell in `computeShardTransfer()` are
+// this many times the bound of the scores of the shard below 0.
+const int64_t SHARD_MISSING_CELL_FACTOR = 4;
+
+eds_matrix shardSegments(const eds_matrix &eds_segments, int64_t first_segment,
+                         int64_t end_segment) {
+    eds_matrix shard;
+    if (first_segment > 0) {
+        shard.push_back({string(1, EMPTY_STR)});
+    }
+    shard.insert(shard.end(), eds_segments.begin() + first_segment,
+                 eds_segments.begin() + end_segment);
+    return shard;
+}
+
+// Returns the bound of the scores of the shard relative to p. Throws
+// `overflow_error` if the DP of `computeShardTransfer()` does not fit into 64
+// bits: its missing cells are far below the scores, and the J vertex kernel
+// adds up to four scores, see `SCORE_BOUND_MARGIN`.
+int64_t shardScoreBound(const eds_matrix &shard, int match, int non_match,
+                        int penalty) {
+    int64_t bound = scoreBound(
+        linearizedGraphLength(shard),
+        max(abs((int64_t)match), abs((int64_t)non_match)), penalty);
+    if (bound > INT64_MAX / (2 * SHARD_MISSING_CELL_FACTOR *
+                             SCORE_BOUND_MARGIN)) {
+        throw overflow_error("Scores of the shard do not fit into 64 bits.");
+    }
+    return bound;
+}
+
+// Fills the segments of `shard` after p from the cells `p` of p into `window`,
+// and the choices of the vertices into `choices` if it is not null.
+template <typename weights_t>
+void fillShard(const eds_matrix &shard, const weights_t &weights,
+               bool is_first, const boundary_cells &p, int penalty,
+               SegmentWindow<int64_t> &window,
+               basic_score_matrix<int64_t> *choices) {
+    // N and J vertices keep the E continuation at 0.
+    window.last_cells[0] = {};
+    window.last_cells[0][!SURELY_SELECTED][I] = p[0];
+    window.last_cells[0][SURELY_SELECTED][I] = p[1];
+    for (int64_t segment = is_first ? 0 : 1; segment < (int64_t)shard.size();
+         segment++) {
+        if (choices == nullptr) {
+            window.fill(shard, weights, penalty, segment);
+            continue;
+        }
+        window.fill(shard, weights, penalty, segment,
+                    [&](int64_t layer, int64_t index)
+                        -> score_cell<int64_t> & {
+                        return (*choices)[segment][layer][index];
+                    });
+    }
+}
+
+shard_transfer computeShardTransfer(const eds_matrix &shard, bool is_first,
+                                    int match, int non_match, int penalty) {
+    int64_t bound = shardScoreBound(shard, match, non_match, penalty);
+    GCContentWeights weights(shard, match, non_match);
+    SegmentWindow<int64_t> window(shard);
+    shard_transfer transfer;
+    for (int t = 0; t < 2; t++) {
+        // W(q, s) = max{T[s][t], T[s][!t] - missing}, where T[s][!t] -
+        // missing is below -2 * bound and T[s][t] is not.
+        boundary_cells p;
+        p[t] = 0;
+        p[!t] = -SHARD_MISSING_CELL_FACTOR * bound - 1;
+        fillShard(shard, weights, is_first, p, penalty, window, nullptr);
+        for (int s = 0; s < 2; s++) {
+            int64_t score = window.last_cells[0][s][I];
+            transfer[s][t] = score < -2 * bound ? NO_SCORE : score;
+        }
+    }
+    return transfer;
+}
+
+boundary_cells applyShardTransfer(const shard_transfer &transfer,
+                                  const boundary_cells &p) {
+    boundary_cells q = {NO_SCORE, NO_SCORE};
+    for (int s = 0; s < 2; s++) {
+        for (int t = 0; t < 2; t++) {
+            if (transfer[s][t] != NO_SCORE && p[t] != NO_SCORE) {
+                q[s] = max(q[s], p[t] + transfer[s][t]);
+            }
+        }
+    }
+    return q;
+}
+
+array<ShardTraceback, NUM_SHARD_EXITS> traceBackShard(const eds_matrix &shard,
+                                                      bool is_first,
+                                                      const boundary_cells &p,
+                                                      int match, int non_match,
+                                                      int penalty) {
+    typedef vector<vector<Vertex64>> paths_t;
+    shardScoreBound(shard, match, non_match, penalty);
+    weight_matrix weights = getGCContentWeights(shard, match, non_match);
+    basic_score_matrix<int64_t> choices = initScoreMatrix<int64_t>(weights);
+    SegmentWindow<int64_t> window(shard);
+    fillShard(shard, weights, is_first, p, penalty, window, &choices);
+    auto choice_of = [&choices](auto v, bool surely_selected,
+                                path_continuation path_goes) {
+        return getChoice(choices, v, surely_selected, path_goes);
+    };
+
+    // Stands for the vertices of the path open at q, which are in the next
+    // shard. The traceback only appends to a path, so it stays the first
+    // vertex of the path that continues it.
+    const Vertex64 next_shard_vertex(-1, -1, -1);
+    array<ShardTraceback, NUM_SHARD_EXITS> tracebacks;
+    for (int exit = EXIT_CLOSED; exit < NUM_SHARD_EXITS; exit++) {
+        ShardTraceback &traceback = tracebacks[exit];
+        TracebackState<paths_t> state(shard, traceback.paths);
+        state.is_a_surely_selected = exit == EXIT_SELECTED;
+        if (exit != EXIT_CLOSED) {
+            state.current_path.push_back(next_shard_vertex);
+        }
+        traceBack(shard, choice_of, state, traceback.paths, is_first ? 0 : 1);
+        if (state.is_a_surely_selected && state.current_path.empty()) {
+            throw logic_error("Traceback selects p without an open path.");
+        }
+        traceback.p_exit = state.is_a_surely_selected ? EXIT_SELECTED
+                           : state.current_path.empty() ? EXIT_CLOSED
+                                                        : EXIT_OPEN;
+        traceback.open_path = move(state.current_path);
+
+        // The traceback may copy the open path before it ends it, so more
+        // than one path can continue it.
+        auto complete = [&](vector<Vertex64> &path) {
+            reverse(path.begin(), path.end());
+            if (!path.empty() && path.back() == next_shard_vertex) {
+                path.pop_back();
+                return true;
+            }
+            return false;
+        };
+        for (size_t path = 0; path < traceback.paths.size(); path++) {
+            if (complete(traceback.paths[path])) {
+                traceback.continued_paths.push_back(path);
+            }
+        }
+        traceback.open_path_continues = complete(traceback.open_path);
+        if ((traceback.continued_paths.empty() &&
+             !traceback.open_path_continues) != (exit == EXIT_CLOSED)) {
+            throw logic_error("Traceback lost the path open at q.");
+        }
+    }
+    return tracebacks;
+}
+
+// Forced scores, see `findBackwardScores()`.
+
+// Raises the cell B `target` to `backward` + `term` for a cell B `backward`
+// that a solution goes through. Cells that no solution goes through stay at
+// `NO_SCORE`.
+inline void raiseScore(int64_t &target, int64_t backward, int64_t term) {
+    if (backward != NO_SCORE) {
+        target = max(target, backward + term);
+    }
+}
+
+// The three largest values of a sequence with their positions, for the
+// maxima of the J vertex rules without one or two of the predecessors.
+struct TopThree {
+    void push(int64_t value, int64_t pos) {
+        for (int rank = 0; rank < 3; rank++) {
+            if (value > values[rank]) {
+                swap(value, values[rank]);
+                swap(pos, positions[rank]);
+            }
+        }
+    }
+
+    // The largest value at a position other than `skip_1` and `skip_2`, with
+    // the position -1 if there is none.
+    pair<int64_t, int64_t> bestExcept(int64_t skip_1,
+                                      int64_t skip_2 = -1) const {
+        for (int rank = 0; rank < 3; rank++) {
+            if (positions[rank] != -1 && positions[rank] != skip_1 &&
+                positions[rank] != skip_2) {
+                return {values[rank], positions[rank]};
+            }
+        }
+        return {NO_SCORE, -1};
+    }
+
+    int64_t values[3] = {NO_SCORE, NO_SCORE, NO_SCORE};
+    int64_t positions[3] = {-1, -1, -1};
+};
+
+// The backward rules, the rules of the DP above in reverse: `a` is the cell B
+// of the vertex and `p` the one of its predecessor.
+
+// W(a, 0, _) = max{..., W(a, 1, _)} in the rules of all but J vertices.
+void raiseSelectedCells(score_cell<int64_t> &a) {
+    raiseScore(a[SURELY_SELECTED][I], a[!SURELY_SELECTED][I], 0);
+    raiseScore(a[SURELY_SELECTED][E], a[!SURELY_SELECTED][E], 0);
+}
+
+// Same as `laterVertexRule()`.
+void laterVertexBackwardRule(const score_cell<int64_t> &a, int weight_a,
+                             int penalty, path_continuation layer,
+                             score_cell<int64_t> &p) {
+    raiseScore(p[!SURELY_SELECTED][layer], a[!SURELY_SELECTED][layer], 0);
+    raiseScore(p[!SURELY_SELECTED][layer], a[SURELY_SELECTED][layer],
+               weight_a - penalty);
+    raiseScore(p[SURELY_SELECTED][layer], a[SURELY_SELECTED][layer], weight_a);
+}
+
+// Same as `firstLayerFirstVertexRule()`.
+void firstLayerFirstVertexBackwardRule(const score_cell<int64_t> &a,
+                                       int weight_a, int penalty,
+                                       score_cell<int64_t> &p) {
+    laterVertexBackwardRule(a, weight_a, penalty, I, p);
+    raiseScore(p[SURELY_SELECTED][I], a[!SURELY_SELECTED][E], 0);
+    raiseScore(p[SURELY_SELECTED][I], a[SURELY_SELECTED][E],
+               weight_a - penalty);
+}
+
+// Same as `jVertexRule()`, `pred_cell(i)` returns the cell W and
+// `pred_backward(i)` the cell B of the predecessor on layer i. A cell of a
+// predecessor in a sum of the groups gets B(a, _) and the other terms of the
+// sum, the best of them are found from the largest differences of the J vertex
+// kernel. W(a, 0) takes the groups of W(a, 1) without w(a), see
+// `combineJVertexGroups()`, so B(a, 1) of the J vertex only has the solutions
+// that use W(a, 1) itself.
+template <typename pred_cell_t, typename pred_backward_t>
+void jVertexBackwardRule(const pred_cell_t &pred_cell,
+                         const pred_backward_t &pred_backward, int num_preds,
+                         const score_cell<int64_t> &a, int weight_a,
+                         int penalty, JPredecessorScores<int64_t> &j_preds) {
+    gatherJPredecessorScores(pred_cell, num_preds, j_preds);
+    TopThree top_0_I, top_1_I, top_1_E;
+    for (int i = 0; i < num_preds; i++) {
+        top_0_I.push(j_preds.diff_0_I[i], i);
+        top_1_I.push(j_preds.diff_1_I[i], i);
+        top_1_E.push(j_preds.diff_1_E[i], i);
+    }
+    // B of group_0, and of group_1, ..., group_3.
+    int64_t backward_0 = a[!SURELY_SELECTED][I];
+    int64_t backward_1 = NO_SCORE;
+    raiseScore(backward_1, a[SURELY_SELECTED][I], weight_a);
+    raiseScore(backward_1, a[!SURELY_SELECTED][I], 0);
+    for (int i = 0; i < num_preds; i++) {
+        score_cell<int64_t> &p = pred_backward(i);
+        // The base score without the term of p_i.
+        int64_t others = j_preds.base_score - pred_cell(i)[!SURELY_SELECTED][E];
+        auto best_0_I = top_0_I.bestExcept(i);
+        auto best_1_I = top_1_I.bestExcept(i);
+        auto best_1_E = top_1_E.bestExcept(i);
+
+        // W(p_i, 0, I) in group_0 and group_1, and with p_k in group_3.
+        raiseScore(p[!SURELY_SELECTED][I], backward_0, others);
+        raiseScore(p[!SURELY_SELECTED][I], backward_1, others - penalty);
+        if (best_1_E.second != -1) {
+            raiseScore(p[!SURELY_SELECTED][I], backward_1,
+                       others + best_1_E.first);
+        }
+        // W(p_i, 1, I) in group_2.
+        raiseScore(p[SURELY_SELECTED][I], backward_1, others);
+        // W(p_i, 1, E) with p_k in group_3.
+        if (best_0_I.second != -1) {
+            raiseScore(p[SURELY_SELECTED][E], backward_1,
+                       others + best_0_I.first);
+        }
+
+        // W(p_i, 0, E) in every group where another predecessor exchanges
+        // its term.
+        if (best_0_I.second != -1) {
+            raiseScore(p[!SURELY_SELECTED][E], backward_0,
+                       others + best_0_I.first);
+            raiseScore(p[!SURELY_SELECTED][E], backward_1,
+                       others + best_0_I.first - penalty);
+        }
+        if (best_1_I.second != -1) {
+            raiseScore(p[!SURELY_SELECTED][E], backward_1,
+                       others + best_1_I.first);
+        }
+        // Group 3 of two other predecessors.
+        if (best_0_I.second == -1 || best_1_E.second == -1) {
+            continue;
+        }
+        if (best_0_I.second != best_1_E.second) {
+            raiseScore(p[!SURELY_SELECTED][E], backward_1,
+                       others + best_0_I.first + best_1_E.first);
+            continue;
+        }
+        auto second_1_E = top_1_E.bestExcept(i, best_0_I.second);
+        if (second_1_E.second != -1) {
+            raiseScore(p[!SURELY_SELECTED][E], backward_1,
+                       others + best_0_I.first + second_1_E.first);
+        }
+        auto second_0_I = top_0_I.bestExcept(i, best_1_E.second);
+        if (second_0_I.second != -1) {
+            raiseScore(p[!SURELY_SELECTED][E], backward_1,
+                       others + second_0_I.first + best_1_E.first);
+        }
+    }
+}
+
+template <typename score_t>
+score_cell<int64_t> widenCell(const score_cell<score_t> &cell) {
+    score_cell<int64_t> wide;
+    for (int selected = 0; selected < 2; selected++) {
+        for (int layer = 0; layer < 2; layer++) {
+            wide[selected][layer] = cell[selected][layer];
+        }
+    }
+    return wide;
 }
 
-void printPaths(vector<vector<Vertex>> paths) {
+template <typename score_t>
+basic_score_matrix<int64_t> findBackwardScores(
+    const eds_matrix &eds_segments, const weight_matrix &weights,
+    const basic_score_matrix<score_t> &scores, int penalty,
+    pmr::memory_resource *resource) {
+    basic_score_matrix<int64_t> backward =
+        initScoreMatrix<int64_t>(weights, resource);
+    for (auto &segment : backward) {
+        for (auto &layer : segment) {
+            for (auto &cell : layer) {
+                cell = {{{NO_SCORE, NO_SCORE}, {NO_SCORE, NO_SCORE}}};
+            }
+        }
+    }
+    // The score of the graph is W(last, 0), see `findMaxScoringPaths()`.
+    Vertex64 last = getLastVertex<int64_t>(eds_segments);
+    backward[last.segment][last.layer][last.index][!SURELY_SELECTED][I] = 0;
+
+    auto cell = [&](Vertex64 v) {
+        return widenCell(scores[v.segment][v.layer][v.index]);
+    };
+    auto backward_cell = [&](Vertex64 v) -> score_cell<int64_t> & {
+        return backward[v.segment][v.layer][v.index];
+    };
+    JPredecessorScores<int64_t> j_preds;
+    // Every vertex comes after the vertices whose rules use its cells.
+    for (int64_t segment = eds_segments.size() - 1; segment >= 0; segment--) {
+        for (int64_t layer = eds_segments[segment].size() - 1; layer >= 0;
+             layer--) {
+            for (int64_t index = eds_segments[segment][layer].size() - 1;
+                 index >= 0; index--) {
+                Vertex64 a{segment, layer, index};
+                int weight_a = getWeight(weights, a);
+                score_cell<int64_t> &a_backward = backward_cell(a);
+                // J vertex.
+                if (isJVertex(a, eds_segments)) {
+                    jVertexBackwardRule(
+                        [&](int i) {
+                            return cell(
+                                getPredecessorVertex(eds_segments, a, i));
+                        },
+                        [&](int i) -> score_cell<int64_t> & {
+                            return backward_cell(
+                                getPredecessorVertex(eds_segments, a, i));
+                        },
+                        eds_segments[segment - 1].size(), a_backward, weight_a,
+                        penalty, j_preds);
+                    continue;
+                }
+                raiseSelectedCells(a_backward);
+                // First vertex of the graph and L_first vertex.
+                if (!hasPredecessorVertex(a) ||
+                    (isVertexFirstOnLayer(a, eds_segments) && layer > 0)) {
+                    continue;
+                }
+                score_cell<int64_t> &p_backward =
+                    backward_cell(getPredecessorVertex(eds_segments, a));
+                // N vertex.
+                if (isNVertex(a, eds_segments)) {
+                    laterVertexBackwardRule(a_backward, weight_a, penalty, I,
+                                            p_backward);
+                }
+                // 1_first vertex.
+                else if (isVertexFirstOnLayer(a, eds_segments)) {
+                    firstLayerFirstVertexBackwardRule(a_backward, weight_a,
+                                                      penalty, p_backward);
+                }
+                // 1_later and L_later vertex.
+                else {
+                    laterVertexBackwardRule(a_backward, weight_a, penalty, I,
+                                            p_backward);
+                    laterVertexBackwardRule(a_backward, weight_a, penalty, E,
+                                            p_backward);
+                }
+            }
+        }
+    }
+    return backward;
+}
+
+template <typename score_t>
+vector<forced_scores> getForcedScores(
+    const eds_matrix &eds_segments, const basic_score_matrix<score_t> &scores,
+    const basic_score_matrix<int64_t> &backward) {
+    auto cell = [&](Vertex64 v) {
+        return widenCell(scores[v.segment][v.layer][v.index]);
+    };
+    vector<forced_scores> forced;
+    forced.reserve(linearizedGraphLength(eds_segments));
+    for (int64_t segment = 0; segment < eds_segments.size(); segment++) {
+        for (int64_t layer = 0; layer < eds_segments[segment].size();
+             layer++) {
+            for (int64_t index = 0;
+                 index < eds_segments[segment][layer].size(); index++) {
+                Vertex64 a{segment, layer, index};
+                score_cell<int64_t> a_scores = cell(a);
+                const score_cell<int64_t> &a_backward =
+                    backward[segment][layer][index];
+                // The term of W(a, 0, _) without a, for each continuation.
+                array<int64_t, 2> unselected = {NO_SCORE, NO_SCORE};
+                // First vertex of the graph.
+                if (!hasPredecessorVertex(a)) {
+                    unselected[I] = 0;
+                }
+                // J vertex, no group of W(a, 0) contains w(a).
+                else if (isJVertex(a, eds_segments)) {
+                    unselected[I] = a_scores[!SURELY_SELECTED][I];
+                }
+                // L_first vertex.
+                else if (isVertexFirstOnLayer(a, eds_segments) && layer > 0) {
+                    unselected[E] = 0;
+                } else {
+                    score_cell<int64_t> p =
+                        cell(getPredecessorVertex(eds_segments, a));
+                    unselected[I] = p[!SURELY_SELECTED][I];
+                    // 1_first vertex.
+                    if (isVertexFirstOnLayer(a, eds_segments)) {
+                        unselected[E] = p[SURELY_SELECTED][I];
+                    }
+                    // 1_later and L_later vertex.
+                    else if (isLayerVertex(a, eds_segments)) {
+                        unselected[E] = p[!SURELY_SELECTED][E];
+                    }
+                }
+
+                forced_scores a_forced = {NO_SCORE, NO_SCORE};
+                for (int path_goes : {I, E}) {
+                    raiseScore(a_forced[SURELY_SELECTED],
+                               a_backward[SURELY_SELECTED][path_goes],
+                               a_scores[SURELY_SELECTED][path_goes]);
+                    if (unselected[path_goes] != NO_SCORE) {
+                        raiseScore(a_forced[!SURELY_SELECTED],
+                                   a_backward[!SURELY_SELECTED][path_goes],
+                                   unselected[path_goes]);
+                    }
+                }
+                forced.push_back(a_forced);
+            }
+        }
+    }
+    return forced;
+}
+
+// Lane-batched DP, see `findMaxScoringPathsInLanes()`.
+
+// The cells of a vertex hold this many bytes of scores of every component, one
+// score per lane.
+const int DP_BATCH_LANE_BYTES = 32;
+
+// Returns the kinds of the segments of a graph, 1 for bubbles and 0 for
+// deterministic segments. Graphs whose kinds are prefixes of each other can
+// share lanes.
+string segmentKinds(const eds_matrix &eds_segments) {
+    string kinds(eds_segments.size(), 0);
+    for (size_t segment = 0; segment < eds_segments.size(); segment++) {
+        kinds[segment] = eds_segments[segment].size() > 1;
+    }
+    return kinds;
+}
+
+// The tables of a group of graphs, one per lane. Layer `layer` of segment
+// `segment` is the row `first_row[segment] + layer`, as long as its longest
+// version in the lanes. Component `c = 2 * selected + continuation` of the
+// cell of vertex `index` of row `row` in lane `lane` is at
+// `((row_offset[row] + index) * 4 + c) * lanes + lane`, the weights and the
+// masks of the vertices are at `(row_offset[row] + index) * lanes + lane`.
+template <typename score_t>
+struct LaneTables {
+    static constexpr int lanes = DP_BATCH_LANE_BYTES / sizeof(score_t);
+    // Of the graphs of the lanes.
+    vector<const eds_matrix *> graphs;
+    vector<const weight_matrix *> graph_weights;
+
+    vector<int64_t> first_row;
+    vector<int64_t> row_offset;
+    vector<int64_t> row_length;
+    vector<score_t> weights;
+    // All ones for the vertices of the lane's graph, 0 for the padding.
+    vector<score_t> masks;
+    vector<score_t> scores;
+    vector<score_t> choices;
+
+    int64_t cellIndex(int lane, int64_t row, int64_t index, int c) const {
+        return ((row_offset[row] + index) * 4 + c) * lanes + lane;
+    }
+
+    score_cell<score_t> cell(const vector<score_t> &table, int lane,
+                             int64_t row, int64_t index) const {
+        score_cell<score_t> cell;
+        for (int c = 0; c < 4; c++) {
+            cell[c / 2][c % 2] = table[cellIndex(lane, row, index, c)];
+        }
+        return cell;
+    }
+
+    void setCell(vector<score_t> &table, int lane, int64_t row, int64_t index,
+                 const score_cell<score_t> &cell) {
+        for (int c = 0; c < 4; c++) {
+            table[cellIndex(lane, row, index, c)] = cell[c / 2][c % 2];
+        }
+    }
+};
+
+// Lays out the tables of the graphs `graphs` in the lanes of `tables`, reusing
+// their memory. The graphs are padded to the longest of them. Only the weights
+// and the masks are initialized, the rules write every cell that is read.
+template <typename score_t>
+void loadLaneTables(const vector<const eds_matrix *> &graphs,
+                    const vector<const weight_matrix *> &weights,
+                    LaneTables<score_t> &tables) {
+    const int lanes = tables.lanes;
+    tables.graphs = graphs;
+    tables.graph_weights = weights;
+    int64_t num_segments = 0;
+    for (const eds_matrix *graph : graphs) {
+        num_segments = max(num_segments, (int64_t)graph->size());
+    }
+    tables.first_row.assign(1, 0);
+    tables.row_length.clear();
+    for (int64_t segment = 0; segment < num_segments; segment++) {
+        int64_t width = 0;
+        for (const eds_matrix *graph : graphs) {
+            if (segment < graph->size()) {
+                width = max(width, (int64_t)(*graph)[segment].size());
+            }
+        }
+        for (int64_t layer = 0; layer < width; layer++) {
+            int64_t length = 0;
+            for (const eds_matrix *graph : graphs) {
+                if (segment < graph->size() &&
+                    layer < (*graph)[segment].size()) {
+                    length = max(length,
+                                 (int64_t)(*graph)[segment][layer].size());
+                }
+            }
+            tables.row_length.push_back(length);
+        }
+        tables.first_row.push_back(tables.row_length.size());
+    }
+    int64_t num_rows = tables.row_length.size();
+    tables.row_offset.assign(num_rows + 1, 0);
+    for (int64_t row = 0; row < num_rows; row++) {
+        tables.row_offset[row + 1] =
+            tables.row_offset[row] + tables.row_length[row];
+    }
+    int64_t num_vertices = tables.row_offset[num_rows];
+    tables.weights.resize(num_vertices * lanes);
+    tables.masks.resize(num_vertices * lanes);
+    tables.scores.resize(num_vertices * 4 * lanes);
+    tables.choices.resize(num_vertices * 4 * lanes);
+
+    // The weights of the layer of every lane, null if the lane has none.
+    vector<const pmr::vector<int> *> lane_weights(lanes);
+    for (int64_t segment = 0; segment < num_segments; segment++) {
+        for (int64_t row = tables.first_row[segment];
+             row < tables.first_row[segment + 1]; row++) {
+            int64_t layer = row - tables.first_row[segment];
+            for (int lane = 0; lane < lanes; lane++) {
+                lane_weights[lane] = nullptr;
+                if (lane < graphs.size() && segment < graphs[lane]->size() &&
+                    layer < (*graphs[lane])[segment].size()) {
+                    lane_weights[lane] = &(*weights[lane])[segment][layer];
+                }
+            }
+            int64_t first = tables.row_offset[row] * lanes;
+            score_t *row_weights = &tables.weights[first];
+            score_t *row_masks = &tables.masks[first];
+            for (int64_t index = 0; index < tables.row_length[row]; index++) {
+                for (int lane = 0; lane < lanes; lane++) {
+                    bool has_vertex = lane_weights[lane] &&
+                                      index < lane_weights[lane]->size();
+                    *row_weights++ =
+                        has_vertex ? (*lane_weights[lane])[index] : 0;
+                    *row_masks++ = has_vertex ? -1 : 0;
+                }
+            }
+        }
+    }
+}
+
+// The later vertices of a row in all lanes at once: `laterVertexRule()` for
+// the continuations `I` to `num_continuations - 1`. The lanes are computed in
+// local arrays that the compiler keeps in vector registers. The scores of the
+// padding are computed from zeros, so they cannot overflow, and are never
+// read.
+template <typename score_t>
+void laterVerticesInLanes(LaneTables<score_t> &tables, int64_t row,
+                          int num_continuations, int penalty) {
+    const int lanes = LaneTables<score_t>::lanes;
+    const score_t x = penalty;
+    const int64_t first = tables.row_offset[row];
+    for (int layer_goes = I; layer_goes < 2; layer_goes++) {
+        const int c_0 = 2 * !SURELY_SELECTED + layer_goes;
+        const int c_1 = 2 * SURELY_SELECTED + layer_goes;
+        // N vertices keep the E continuation at 0, as in the tables of
+        // `initScoreMatrix()`.
+        if (layer_goes >= num_continuations) {
+            for (int64_t index = 1; index < tables.row_length[row]; index++) {
+                for (int c : {c_0, c_1}) {
+                    int64_t i = ((first + index) * 4 + c) * lanes;
+                    fill_n(&tables.scores[i], lanes, 0);
+                    fill_n(&tables.choices[i], lanes, 0);
+                }
+            }
+            continue;
+        }
+        score_t score_p_0[lanes], score_p_1[lanes];
+        copy_n(&tables.scores[(first * 4 + c_0) * lanes], lanes, score_p_0);
+        copy_n(&tables.scores[(first * 4 + c_1) * lanes], lanes, score_p_1);
+        for (int64_t index = 1; index < tables.row_length[row]; index++) {
+            score_t weights[lanes], masks[lanes];
+            copy_n(&tables.weights[(first + index) * lanes], lanes, weights);
+            copy_n(&tables.masks[(first + index) * lanes], lanes, masks);
+            score_t score_a_0[lanes], score_a_1[lanes];
+            score_t choice_a_0[lanes], choice_a_1[lanes];
+            for (int lane = 0; lane < lanes; lane++) {
+                score_t score_0 = score_p_0[lane] & masks[lane];
+                score_t score_1 = score_p_1[lane] & masks[lane];
+                // W(a, 1, _) = w(a) + max{W(p, 0, _) - x, W(p, 1, _)}
+                score_t first_score = weights[lane] + score_0 - x;
+                score_t second_score = weights[lane] + score_1;
+                bool is_first = first_score > second_score;
+                score_a_1[lane] = is_first ? first_score : second_score;
+                choice_a_1[lane] = is_first ? FIRST : SECOND;
+                // W(a, 0, _) = max{W(p, 0, _), W(a, 1, _)}
+                is_first = score_0 > score_a_1[lane];
+                score_a_0[lane] = is_first ? score_0 : score_a_1[lane];
+                choice_a_0[lane] = is_first ? FIRST : SECOND;
+            }
+            int64_t i = (first + index) * 4 * lanes;
+            copy_n(score_a_0, lanes, &tables.scores[i + c_0 * lanes]);
+            copy_n(score_a_1, lanes, &tables.scores[i + c_1 * lanes]);
+            copy_n(choice_a_0, lanes, &tables.choices[i + c_0 * lanes]);
+            copy_n(choice_a_1, lanes, &tables.choices[i + c_1 * lanes]);
+            copy_n(score_a_0, lanes, score_p_0);
+            copy_n(score_a_1, lanes, score_p_1);
+        }
+    }
+}
+
+// The first vertex of a row in lane `lane`, by the rules of `fillTables()`.
+template <typename score_t>
+void firstVertexInLane(LaneTables<score_t> &tables, int lane, int64_t segment,
+                       int64_t layer, int penalty,
+                       vector<score_cell<score_t>> &pred_cells,
+                       JPredecessorScores<score_t> &j_preds) {
+    typedef BasicVertex<int64_t> vertex_t;
+    const eds_matrix &graph = *tables.graphs[lane];
+    int64_t row = tables.first_row[segment] + layer;
+    vertex_t a{segment, layer, 0};
+    int weight_a = getWeight(*tables.graph_weights[lane], a);
+    score_cell<score_t> a_scores = {};
+    score_cell<score_t> a_choices = {};
+    auto pred_last_cell = [&](int64_t pred_layer) {
+        return tables.cell(tables.scores, lane,
+                           tables.first_row[segment - 1] + pred_layer,
+                           graph[segment - 1][pred_layer].size() - 1);
+    };
+    if (!hasPredecessorVertex(a)) {
+        firstVertexRule(weight_a, penalty, a_scores, a_choices);
+    } else if (isNVertex(a, graph)) {
+        laterVertexRule(pred_last_cell(0), weight_a, penalty, I, a_scores,
+                        a_choices);
+    } else if (isFirstLayerVertex(a, graph)) {
+        firstLayerFirstVertexRule(pred_last_cell(0), weight_a, penalty,
+                                  a_scores, a_choices);
+    } else if (isLayerVertex(a, graph)) {
+        layerFirstVertexRule(weight_a, penalty, a_scores, a_choices);
+    } else {
+        assert(isJVertex(a, graph));
+        int num_preds = graph[segment - 1].size();
+        pred_cells.resize(max<size_t>(pred_cells.size(), num_preds));
+        for (int i = 0; i < num_preds; i++) {
+            pred_cells[i] = pred_last_cell(i);
+        }
+        jVertexRule(
+            [&](int i) -> const score_cell<score_t> & {
+                return pred_cells[i];
+            },
+            num_preds, weight_a, penalty, j_preds, a_scores, a_choices);
+    }
+    tables.setCell(tables.scores, lane, row, 0, a_scores);
+    tables.setCell(tables.choices, lane, row, 0, a_choices);
+}
+
+// Fills the tables of all lanes and appends the result of every lane to
+// `results`.
+template <typename score_t, typename index_t>
+void fillLaneTables(LaneTables<score_t> &tables, int penalty,
+                    vector<BatchResult<index_t>> &results) {
+    // Reused by every J vertex.
+    vector<score_cell<score_t>> pred_cells;
+    JPredecessorScores<score_t> j_preds;
+    const int num_graphs = tables.graphs.size();
+    for (int64_t segment = 0; segment + 1 < tables.first_row.size();
+         segment++) {
+        // The kinds of the segments of the lanes agree.
+        bool is_bubble = false;
+        for (int64_t row = tables.first_row[segment];
+             row < tables.first_row[segment + 1]; row++) {
+            int64_t layer = row - tables.first_row[segment];
+            for (int lane = 0; lane < num_graphs; lane++) {
+                const eds_matrix &graph = *tables.graphs[lane];
+                if (segment < graph.size() && layer < graph[segment].size()) {
+                    is_bubble = graph[segment].size() > 1;
+                    firstVertexInLane(tables, lane, segment, layer, penalty,
+                                      pred_cells, j_preds);
+                }
+            }
+            // N vertices only have the I continuation.
+            laterVerticesInLanes(tables, row, is_bubble ? 2 : 1, penalty);
+        }
+    }
+
+    for (int lane = 0; lane < num_graphs; lane++) {
+        const eds_matrix &graph = *tables.graphs[lane];
+        BasicVertex<index_t> last = getLastVertex<index_t>(graph);
+        score_cell<score_t> last_cell = tables.cell(
+            tables.scores, lane, tables.first_row[last.segment], last.index);
+        BatchResult<index_t> &result = results.emplace_back();
+        result.score =
+            max(last_cell[!SURELY_SELECTED][I], last_cell[!SURELY_SELECTED][E]);
+        tracePaths(
+            graph,
+            [&](auto v, bool surely_selected, path_continuation path_goes) {
+                return (int)tables.choices[tables.cellIndex(
+                    lane, tables.first_row[v.segment] + v.layer, v.index,
+                    2 * surely_selected + path_goes)];
+            },
+            result.paths);
+    }
+}
+
+template <typename score_t, typename index_t>
+vector<BatchResult<index_t>> findMaxScoringPathsInLanes(
+    const vector<eds_matrix> &graphs, const vector<weight_matrix> &weights,
+    int penalty) {
+    if (graphs.size() != weights.size()) {
+        throw invalid_argument("Every graph needs its weights.");
+    }
+    vector<string> kinds(graphs.size());
+    vector<int64_t> num_vertices(graphs.size());
+    vector<size_t> order(graphs.size());
+    for (size_t i = 0; i < graphs.size(); i++) {
+        checkTypeWidths<score_t, index_t>(graphs[i], weights[i], penalty);
+        kinds[i] = segmentKinds(graphs[i]);
+        num_vertices[i] = linearizedGraphLength(graphs[i]);
+        order[i] = i;
+    }
+    // Graphs with the same segments next to each other, the ones with similar
+    // sizes in the same lanes. A prefix of kinds sorts before its extensions.
+    sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return tie(kinds[a], num_vertices[a]) < tie(kinds[b], num_vertices[b]);
+    });
+
+    LaneTables<score_t> tables;
+    vector<BatchResult<index_t>> sorted_results;
+    sorted_results.reserve(graphs.size());
+    vector<const eds_matrix *> group;
+    vector<const weight_matrix *> group_weights;
+    // The longest kinds of the group.
+    const string *group_kinds = nullptr;
+    auto fillGroup = [&] {
+        loadLaneTables(group, group_weights, tables);
+        fillLaneTables(tables, penalty, sorted_results);
+        group.clear();
+        group_weights.clear();
+    };
+    for (size_t i : order) {
+        bool extends_group =
+            group_kinds &&
+            equal(group_kinds->begin(),
+                  group_kinds->begin() +
+                      min(group_kinds->size(), kinds[i].size()),
+                  kinds[i].begin());
+        if (!group.empty() &&
+            (group.size() == tables.lanes || !extends_group)) {
+            fillGroup();
+        }
+        if (group.empty() || kinds[i].size() > group_kinds->size()) {
+            group_kinds = &kinds[i];
+        }
+        group.push_back(&graphs[i]);
+        group_weights.push_back(&weights[i]);
+    }
+    if (!group.empty()) {
+        fillGroup();
+    }
+
+    vector<BatchResult<index_t>> results(graphs.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        results[order[i]] = move(sorted_results[i]);
+    }
+    return results;
+}
+
+template <typename index_t>
+vector<BatchResult<index_t>> findMaxScoringPathsBatch(
+    const vector<eds_matrix> &graphs, int match, int non_match, int penalty) {
+    vector<weight_matrix> weights;
+    weights.reserve(graphs.size());
+    ScoreWidth score_width = ScoreWidth::INT16;
+    for (const eds_matrix &graph : graphs) {
+        weights.push_back(getGCContentWeights(graph, match, non_match));
+        score_width = max(score_width,
+                          selectScoreWidth(graph, weights.back(), penalty));
+    }
+    switch (score_width) {
+        case ScoreWidth::INT16:
+            return findMaxScoringPathsInLanes<int16_t, index_t>(
+                graphs, weights, penalty);
+        case ScoreWidth::INT32:
+            return findMaxScoringPathsInLanes<int32_t, index_t>(
+                graphs, weights, penalty);
+        case ScoreWidth::INT64:
+            break;
+    }
+    return findMaxScoringPathsInLanes<int64_t, index_t>(graphs, weights,
+                                                        penalty);
+}
+
+template <typename paths_t>
+void printPaths(const paths_t &paths) {
     for (const auto &path : paths) {
-        for (const Vertex &v : path) {
+        for (const auto &v : path) {
             cout << v;
         }
-        cout << endl;
+        cout << '\n';
     }
 }
 
-int lengthOfPaths(vector<vector<Vertex>> paths) {
-    int length = 0;
+template <typename paths_t>
+int64_t lengthOfPaths(const paths_t &paths) {
+    int64_t length = 0;
     for (const auto &path : paths) {
         length += path.size();
     }
     return length;
 }
 
-double pathsAverageLength(vector<vector<Vertex>> paths) {
+template <typename paths_t>
+double pathsAverageLength(const paths_t &paths) {
     return (double) lengthOfPaths(paths) / paths.size();
 }
 
-int linearizedGraphLength(const eds_matrix &eds_segments) {
-    int length = 0;
+int64_t linearizedGraphLength(const eds_matrix &eds_segments) {
+    int64_t length = 0;
     for (const auto &segment : eds_segments) {
         for (const auto &layer : segment) {
             length += layer.length();
@@ -938,9 +3939,156 @@ int linearizedGraphLength(const eds_matrix &eds_segments) {
     return length;
 }
 
+template <typename paths_t>
 double pathCoverPercentage(const eds_matrix &eds_segments,
-                           vector<vector<Vertex>> paths) {
-    int graph_len = linearizedGraphLength(eds_segments);
-    int paths_len = lengthOfPaths(paths);
+                           const paths_t &paths) {
+    int64_t graph_len = linearizedGraphLength(eds_segments);
+    int64_t paths_len = lengthOfPaths(paths);
     return (double)paths_len / graph_len * 100;
 }
+
+// Explicit instantiations of the DP for the supported score and index types.
+#define INSTANTIATE_PATHS_FUNCTIONS(paths_t)                                   \
+    template void printPaths(const paths_t &);                                 \
+    template int64_t lengthOfPaths(const paths_t &);                           \
+    template double pathsAverageLength(const paths_t &);                       \
+    template double pathCoverPercentage(const eds_matrix &, const paths_t &);
+
+#define INSTANTIATE_VERTEX_FUNCTIONS(index_t)                                  \
+    template bool operator==(const BasicVertex<index_t> &,                     \
+                             const BasicVertex<index_t> &);                    \
+    template bool operator!=(const BasicVertex<index_t> &,                     \
+                             const BasicVertex<index_t> &);                    \
+    template bool operator<(const BasicVertex<index_t> &,                      \
+                            const BasicVertex<index_t> &);                     \
+    template BasicVertex<index_t> getLastVertex(const eds_matrix &);           \
+    template bool isLayerVertex(BasicVertex<index_t>, const eds_matrix &);     \
+    template bool isFirstLayerVertex(BasicVertex<index_t>,                     \
+                                     const eds_matrix &);                      \
+    template bool isVertexFirstOnLayer(BasicVertex<index_t>,                   \
+                                       const eds_matrix &);                    \
+    template bool isJVertex(BasicVertex<index_t>, const eds_matrix &);         \
+    template bool isNVertex(BasicVertex<index_t>, const eds_matrix &);         \
+    template bool hasPredecessorVertex(BasicVertex<index_t>);                  \
+    template BasicVertex<index_t> getPredecessorVertex(                        \
+        const eds_matrix &, BasicVertex<index_t>, int64_t);                    \
+    template int getWeight(const weight_matrix &, BasicVertex<index_t>);       \
+    template vector<BatchResult<index_t>> findMaxScoringPathsBatch(            \
+        const vector<eds_matrix> &, int, int, int);                            \
+    INSTANTIATE_PATHS_FUNCTIONS(vector<vector<BasicVertex<index_t>>>)          \
+    INSTANTIATE_PATHS_FUNCTIONS(pmr_paths<index_t>)
+
+#define INSTANTIATE_SCORE_FUNCTIONS(score_t, index_t)                          \
+    template score_t getScore(basic_score_matrix<score_t> &,                   \
+                              BasicVertex<index_t>, bool, path_continuation);  \
+    template int getChoice(basic_score_matrix<score_t> &,                      \
+                           BasicVertex<index_t>, bool, path_continuation);     \
+    template void setScoreAndChoice(                                           \
+        basic_score_matrix<score_t> &, basic_score_matrix<score_t> &,          \
+        pair<int64_t, int>, BasicVertex<index_t>, bool, path_continuation);    \
+    template score_t findMaxScoringPaths<score_t, index_t>(                    \
+        const eds_matrix &, const weight_matrix &,                             \
+        basic_score_matrix<score_t> &, basic_score_matrix<score_t> &, int);    \
+    template vector<vector<BasicVertex<index_t>>> getPaths<score_t, index_t>(  \
+        const eds_matrix &, basic_score_matrix<score_t> &,                     \
+        basic_score_matrix<score_t> &);                                        \
+    template void getPaths(const eds_matrix &, basic_score_matrix<score_t> &,  \
+                           basic_score_matrix<score_t> &,                      \
+                           vector<vector<BasicVertex<index_t>>> &);            \
+    template void getPaths(const eds_matrix &, basic_score_matrix<score_t> &,  \
+                           basic_score_matrix<score_t> &,                      \
+                           pmr_paths<index_t> &);                              \
+    template score_t findMaxScoringPaths<score_t, index_t>(                    \
+        const eds_matrix &, const weight_matrix &,                             \
+        basic_score_matrix<score_t> &, basic_score_matrix<score_t> &, int,     \
+        const UnprofitableRegions &);                                          \
+    template void getPaths(                                                    \
+        const eds_matrix &, const weight_matrix &,                             \
+        basic_score_matrix<score_t> &, basic_score_matrix<score_t> &,          \
+        const UnprofitableRegions &, vector<vector<BasicVertex<index_t>>> &);  \
+    template void getPaths(                                                    \
+        const eds_matrix &, const weight_matrix &,                             \
+        basic_score_matrix<score_t> &, basic_score_matrix<score_t> &,          \
+        const UnprofitableRegions &, pmr_paths<index_t> &);                    \
+    template score_t findMaxScoringPaths<score_t, index_t>(                    \
+        const eds_matrix &, const weight_matrix &, RunLengthTables<score_t> &, \
+        int);                                                                  \
+    template void getPaths(const eds_matrix &, const weight_matrix &,          \
+                           const RunLengthTables<score_t> &,                   \
+                           vector<vector<BasicVertex<index_t>>> &);            \
+    template void getPaths(const eds_matrix &, const weight_matrix &,          \
+                           const RunLengthTables<score_t> &,                   \
+                           pmr_paths<index_t> &);                              \
+    template score_t findMaxScore<score_t, index_t>(                           \
+        const eds_matrix &, const weight_matrix &, int);                       \
+    template score_t findMaxScoringPaths<score_t, index_t>(                    \
+        const eds_matrix &, const WeightTrack &,                               \
+        basic_score_matrix<score_t> &, basic_score_matrix<score_t> &, int);    \
+    template score_t findMaxScore<score_t, index_t>(                           \
+        const eds_matrix &, const WeightTrack &, int);                         \
+    template score_t findMaxScoringPathsCheckpointed(                          \
+        const eds_matrix &, const weight_matrix &, int, int64_t,               \
+        vector<vector<BasicVertex<index_t>>> &, pmr::memory_resource *);       \
+    template score_t findMaxScoringPathsCheckpointed(                          \
+        const eds_matrix &, const weight_matrix &, int, int64_t,               \
+        pmr_paths<index_t> &, pmr::memory_resource *);                         \
+    template score_t findMaxScoringPaths<score_t, index_t>(                    \
+        const eds_matrix &, const weight_matrix &, PackedTables<score_t> &,    \
+        int);                                                                  \
+    template void getPaths(const eds_matrix &, const PackedTables<score_t> &,  \
+                           vector<vector<BasicVertex<index_t>>> &);            \
+    template void getPaths(const eds_matrix &, const PackedTables<score_t> &,  \
+                           pmr_paths<index_t> &);                              \
+    template void getPathsInParallel(                                          \
+        const eds_matrix &, basic_score_matrix<score_t> &,                     \
+        basic_score_matrix<score_t> &, vector<vector<BasicVertex<index_t>>> &, \
+        int);                                                                  \
+    template void getPathsInParallel(                                          \
+        const eds_matrix &, basic_score_matrix<score_t> &,                     \
+        basic_score_matrix<score_t> &, pmr_paths<index_t> &, int);             \
+    template void getPathsInParallel(                                          \
+        const eds_matrix &, const weight_matrix &,                             \
+        const RunLengthTables<score_t> &,                                      \
+        vector<vector<BasicVertex<index_t>>> &, int);                          \
+    template void getPathsInParallel(                                          \
+        const eds_matrix &, const weight_matrix &,                             \
+        const RunLengthTables<score_t> &, pmr_paths<index_t> &, int);          \
+    template void getPathsInParallel(                                          \
+        const eds_matrix &, const PackedTables<score_t> &,                     \
+        vector<vector<BasicVertex<index_t>>> &, int);                          \
+    template void getPathsInParallel(const eds_matrix &,                       \
+                                     const PackedTables<score_t> &,            \
+                                     pmr_paths<index_t> &, int);               \
+    template class AppendableMaxScorePaths<score_t, index_t>;                  \
+    template class OnlineMaxScorePaths<score_t, index_t>;                      \
+    template void fillTables(const eds_matrix &, const weight_matrix &,        \
+                             basic_score_matrix<score_t> &,                    \
+                             basic_score_matrix<score_t> &, int,               \
+                             BasicVertex<index_t>);                            \
+    template vector<BatchResult<index_t>>                                      \
+    findMaxScoringPathsInLanes<score_t, index_t>(                              \
+        const vector<eds_matrix> &, const vector<weight_matrix> &, int);
+
+#define INSTANTIATE_SCORE_TYPE(score_t)                                        \
+    template basic_score_matrix<score_t> initScoreMatrix(                      \
+        const weight_matrix &, pmr::memory_resource *);                        \
+    template basic_score_matrix<score_t> initScoreMatrix(                      \
+        const WeightTrack &, pmr::memory_resource *);                          \
+    template basic_score_matrix<int64_t> findBackwardScores(                   \
+        const eds_matrix &, const weight_matrix &,                             \
+        const basic_score_matrix<score_t> &, int, pmr::memory_resource *);    \
+    template vector<forced_scores> getForcedScores(                            \
+        const eds_matrix &, const basic_score_matrix<score_t> &,               \
+        const basic_score_matrix<int64_t> &);                                  \
+    template RunLengthTables<score_t> initRunLengthTables(                     \
+        const weight_matrix &, pmr::memory_resource *);                        \
+    template PackedTables<score_t> initPackedTables(const eds_matrix &,        \
+                                                    pmr::memory_resource *);   \
+    INSTANTIATE_SCORE_FUNCTIONS(score_t, int32_t)                              \
+    INSTANTIATE_SCORE_FUNCTIONS(score_t, int64_t)
+
+INSTANTIATE_VERTEX_FUNCTIONS(int32_t)
+INSTANTIATE_VERTEX_FUNCTIONS(int64_t)
+INSTANTIATE_SCORE_TYPE(int16_t)
+INSTANTIATE_SCORE_TYPE(int32_t)
+INSTANTIATE_SCORE_TYPE(int64_t)
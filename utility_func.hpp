@@ -1,7 +1,12 @@
 #ifndef MAXSCOREPATH_UTILITY_FUNC_HEADER
 #define MAXSCOREPATH_UTILITY_FUNC_HEADER
 
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <memory_resource>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 using namespace std;
@@ -36,8 +41,10 @@ using namespace std;
 // `segment` on layer `layer` on position `index`.
 typedef vector<vector<string>> eds_matrix;
 // Each character from the `eds_matrix` has a weight, given with the following
-// matrix.
-typedef vector<vector<vector<int>>> weight_matrix;
+// matrix. The weights and the DP tables are allocated from a
+// `pmr::memory_resource`, by default from the heap, see `MaxScorePathsEngine`
+// for reusing an arena across runs.
+typedef pmr::vector<pmr::vector<pmr::vector<int>>> weight_matrix;
 
 // Separation character between adjacent non-deterministic segments, start and
 // end of the EDS text, and for empty segment variants in non-deterministic
@@ -45,37 +52,59 @@ typedef vector<vector<vector<int>>> weight_matrix;
 #define EMPTY_STR '_'
 
 // Reads a line containing EDS text from `file_path` and returns it as a string.
+// gzip and zstd files are decompressed while they are read, see
+// `openDecompressed()`.
 string readEDSFile(const string &file_path);
 
-// Store the EDS text in an `eds_matrix`.
-eds_matrix EDSToMatrix(const string &EDS);
+// Store the EDS text in an `eds_matrix`. Large texts are parsed by up to
+// `num_threads` threads. Throws `invalid_argument` with the offset if the text
+// is malformed: unbalanced or nested braces, or a `,` outside of them.
+eds_matrix EDSToMatrix(const string &EDS, int num_threads = 1);
 
 // Return a `weight matrix` of weights to the given `eds_matrix` based on the GC
 // content. Assign scores:
 // - bases G and C get score `match`;
 // - bases A and T (or N) get score `non_match`;
 // - the separation character `EMPTY_STR` gets score 0.
-vector<vector<vector<int>>> getGCContentWeights(const eds_matrix &eds_segments,
-                                                int match = 1,
-                                                int non_match = -1);
-
-// Each character in the EDS text represents a vertex.
-struct Vertex {
-    Vertex() : segment(-1), layer(-1), index(-1) {}
-    Vertex(int segment, int layer, int index)
+weight_matrix getGCContentWeights(
+    const eds_matrix &eds_segments, int match = 1, int non_match = -1,
+    pmr::memory_resource *resource = pmr::get_default_resource());
+
+// Returns the weight of character `c` in `getGCContentWeights()`.
+inline int gcContentWeight(char c, int match, int non_match) {
+    // The `EMPTY_STR` has no biological significance.
+    if (c == EMPTY_STR) {
+        return 0;
+    }
+    return (c == 'G' || c == 'C') ? match : non_match;
+}
+
+// Each character in the EDS text represents a vertex. The coordinates have the
+// type `index_t`, 64-bit coordinates are needed for graphs with more than 2^31
+// segments, layers in a bubble or vertices on a layer.
+template <typename index_t>
+struct BasicVertex {
+    BasicVertex() : segment(-1), layer(-1), index(-1) {}
+    BasicVertex(index_t segment, index_t layer, index_t index)
         : segment(segment), layer(layer), index(index) {}
 
     explicit operator bool() {
         return !(segment == -1 && layer == -1 && index == -1);
     }
 
-    int segment;
-    int layer;
-    int index;
+    index_t segment;
+    index_t layer;
+    index_t index;
 };
-bool operator==(const Vertex &a, const Vertex &b);
-bool operator!=(const Vertex &a, const Vertex &b);
-bool operator<(const Vertex &a, const Vertex &b);
+typedef BasicVertex<int> Vertex;
+typedef BasicVertex<int64_t> Vertex64;
+
+template <typename index_t>
+bool operator==(const BasicVertex<index_t> &a, const BasicVertex<index_t> &b);
+template <typename index_t>
+bool operator!=(const BasicVertex<index_t> &a, const BasicVertex<index_t> &b);
+template <typename index_t>
+bool operator<(const BasicVertex<index_t> &a, const BasicVertex<index_t> &b);
 
 // DP score calculation.
 // For each vertex we consider the score when it is selected or not selected.
@@ -94,87 +123,790 @@ const int E = 1;
 // continue on it's layer (in case of layer vertices). Each dimension has the
 // following meaning:
 // score_matrix[segment][layer][index][(!)SURELY_SELECTED][path_continuation].
-typedef vector<vector<vector<vector<vector<int>>>>> score_matrix;
+//
+// The scores have the type `score_t`. The choices of the DP are stored in a
+// matrix of the same shape and type. The last two dimensions have a fixed size,
+// they are stored inline in one cell per vertex.
+template <typename score_t>
+using score_cell = array<array<score_t, 2>, 2>;
+template <typename score_t>
+using basic_score_matrix =
+    pmr::vector<pmr::vector<pmr::vector<score_cell<score_t>>>>;
+typedef basic_score_matrix<int> score_matrix;
+
+// Widths of the score type, `selectScoreWidth()` picks the narrowest one that
+// cannot overflow for a given graph.
+enum class ScoreWidth { INT16, INT32, INT64 };
+
+// Widths of the vertex coordinates.
+enum class IndexWidth { INT32, INT64 };
+
+// Returns an upper bound of the absolute value of any score computed by the DP:
+// every score is a sum of vertex weights minus at most one penalty per vertex.
+int64_t scoreBound(const eds_matrix &eds_segments, const weight_matrix &weights,
+                   int penalty);
+// Same as above, for a graph of `num_vertices` vertices with weights of at
+// most `max_abs_weight` in absolute value.
+int64_t scoreBound(int64_t num_vertices, int64_t max_abs_weight, int penalty);
+
+// Returns the narrowest score type that can hold all scores, their
+// intermediate sums in J vertices and the choice codes of the widest bubble.
+// Throws `overflow_error` if not even 64-bit scores are enough.
+ScoreWidth selectScoreWidth(const eds_matrix &eds_segments,
+                            const weight_matrix &weights, int penalty);
+// Same as above, from `scoreBound()` and the number of layers of the widest
+// bubble.
+ScoreWidth selectScoreWidth(int64_t score_bound, int64_t max_bubble_width);
+
+// Returns the narrowest coordinate type for the vertices of the graph.
+IndexWidth selectIndexWidth(const eds_matrix &eds_segments);
 
 // Helper functions for the `Vertex`.
 // Return the last vertex of the n-layered bubble graph.
-Vertex getLastVertex(const eds_matrix &eds_segments);
+template <typename index_t = int>
+BasicVertex<index_t> getLastVertex(const eds_matrix &eds_segments);
 
 // Return true if the vertex is on one of the layers.
-bool isLayerVertex(Vertex v, const eds_matrix &eds_segments);
+template <typename index_t>
+bool isLayerVertex(BasicVertex<index_t> v, const eds_matrix &eds_segments);
 
 // Returns true if the vertex is on the first layer.
-bool isFirstLayerVertex(Vertex v, const eds_matrix &eds_segments);
+template <typename index_t>
+bool isFirstLayerVertex(BasicVertex<index_t> v, const eds_matrix &eds_segments);
 
 // Returns true if the vertex is the first on any layer.
-bool isVertexFirstOnLayer(Vertex v, const eds_matrix &eds_segments);
+template <typename index_t>
+bool isVertexFirstOnLayer(BasicVertex<index_t> v,
+                          const eds_matrix &eds_segments);
 
 // Returns whether a vertex is a J vertex, i.e. end vertex of a bubble.
-bool isJVertex(Vertex v, const eds_matrix &eds_segments);
+template <typename index_t>
+bool isJVertex(BasicVertex<index_t> v, const eds_matrix &eds_segments);
 
 // Returns whether a vertex is a "normal" vertex, i.e. not J or layer vertex.
-bool isNVertex(Vertex v, const eds_matrix &eds_segments);
+template <typename index_t>
+bool isNVertex(BasicVertex<index_t> v, const eds_matrix &eds_segments);
 
 // Returns true if the vertex has at least one predecessor vertex.
-bool hasPredecessorVertex(Vertex v);
+template <typename index_t>
+bool hasPredecessorVertex(BasicVertex<index_t> v);
 
 // Returns the predecessor vertex of vertex `v`. For J vertices, the layer can
 // be specified in `predecessor_layer`.
-Vertex getPredecessorVertex(const eds_matrix &eds_segments, Vertex v,
-                            int predecessor_layer = 0);
+template <typename index_t>
+BasicVertex<index_t> getPredecessorVertex(const eds_matrix &eds_segments,
+                                          BasicVertex<index_t> v,
+                                          int64_t predecessor_layer = 0);
 
-int getScore(score_matrix &scores, Vertex v, bool surely_selected,
-             path_continuation path_goes = I);
+template <typename score_t, typename index_t>
+score_t getScore(basic_score_matrix<score_t> &scores, BasicVertex<index_t> v,
+                 bool surely_selected, path_continuation path_goes = I);
 
 // The majority of rules in the DP algorithm have only two choices for score
 // calculation.
 #define FIRST 0
 #define SECOND 1
 
-int getChoice(score_matrix &choices, Vertex v, bool surely_selected,
-              path_continuation path_goes = I);
+template <typename score_t, typename index_t>
+int getChoice(basic_score_matrix<score_t> &choices, BasicVertex<index_t> v,
+              bool surely_selected, path_continuation path_goes = I);
 
 // Returns a tuple containing the maximum score and wether this was the first or
-// second parameter.
-pair<int, int> max_score(int first_score, int second_score);
+// second parameter. The scores are compared in 64 bits, independently of the
+// score type of the DP.
+pair<int64_t, int> max_score(int64_t first_score, int64_t second_score);
 
-void setScoreAndChoice(score_matrix &scores, score_matrix &choices,
-                       pair<int, int> score_choice, Vertex v, bool selected,
-                       path_continuation layer);
+template <typename score_t, typename index_t>
+void setScoreAndChoice(basic_score_matrix<score_t> &scores,
+                       basic_score_matrix<score_t> &choices,
+                       pair<int64_t, int> score_choice, BasicVertex<index_t> v,
+                       bool selected, path_continuation layer = I);
 
-int getWeight(const weight_matrix &weights, Vertex v);
+template <typename index_t>
+int getWeight(const weight_matrix &weights, BasicVertex<index_t> v);
 
 // Initializes the score matrix to its known size.
-score_matrix initScoreMatrix(const weight_matrix &weights);
+template <typename score_t = int>
+basic_score_matrix<score_t> initScoreMatrix(
+    const weight_matrix &weights,
+    pmr::memory_resource *resource = pmr::get_default_resource());
 
 // Dynamic programming algorithm to maximize the score of selected disjoint
 // paths while each path incurs a penalty. Fills the `scores` score matrix and
 // returns the best score from the last vertex which is the maximal score of
 // selecting disjoint paths. Fills also the `choices` matrix which contains
 // which previous score was used when calculating the current score.
-int findMaxScoringPaths(const eds_matrix &eds_segments,
-                        const weight_matrix &weights, score_matrix &scores,
-                        score_matrix &choices, int penalty);
+// Throws `overflow_error` if `score_t` or `index_t` is too narrow for the
+// graph, see `selectScoreWidth()` and `selectIndexWidth()`.
+template <typename score_t, typename index_t = int>
+score_t findMaxScoringPaths(const eds_matrix &eds_segments,
+                            const weight_matrix &weights,
+                            basic_score_matrix<score_t> &scores,
+                            basic_score_matrix<score_t> &choices, int penalty);
+
+// Fills the cells of `first` and of all vertices after it, in the order of
+// `findMaxScoringPaths()`, for tables that grow with the graph. The cells
+// before `first` must be filled already, the cells from `first` on must be zero
+// as in the tables of `initScoreMatrix()`. The type widths are not checked.
+template <typename score_t, typename index_t>
+void fillTables(const eds_matrix &eds_segments, const weight_matrix &weights,
+                basic_score_matrix<score_t> &scores,
+                basic_score_matrix<score_t> &choices, int penalty,
+                BasicVertex<index_t> first);
 
 // Based on the `choices` that were filled by `findMaxScoringPaths()`, return
 // all the selected paths.
-vector<vector<Vertex>> getPaths(const eds_matrix &eds_segments,
-                                score_matrix &scores, score_matrix &choices);
+template <typename score_t, typename index_t = int>
+vector<vector<BasicVertex<index_t>>> getPaths(
+    const eds_matrix &eds_segments, basic_score_matrix<score_t> &scores,
+    basic_score_matrix<score_t> &choices);
+
+// Run-length DP.
+// Under GC content scoring the weights take two values, so long AT-rich or
+// GC-rich stretches are runs of equal weights. The rules of a run of vertices
+// with equal weight, not first on their layer, have a closed form. The
+// run-length tables keep the cells of only the first vertex of every layer and
+// of the last vertex of every run, the DP processes the graph run by run and
+// the traceback recomputes the choices inside the runs.
+template <typename score_t>
+struct RunLengthTables {
+    explicit RunLengthTables(
+        pmr::memory_resource *resource = pmr::get_default_resource())
+        : run_ends(resource),
+          scores(resource),
+          first_choices(resource),
+          bubble_classes(resource) {}
+
+    // `run_ends[segment][layer][column]` is the index of the last vertex of
+    // the column. Column 0 is the first vertex of the layer, the other columns
+    // are the runs of equal weights.
+    pmr::vector<pmr::vector<pmr::vector<int64_t>>> run_ends;
+    // `scores[segment][layer][column]`, the scores of the last vertex of each
+    // column.
+    basic_score_matrix<score_t> scores;
+    // `first_choices[segment][layer]`, the choices of the first vertex of each
+    // layer.
+    pmr::vector<pmr::vector<score_cell<score_t>>> first_choices;
+    // `bubble_classes[segment]` is equal for bubbles with equal weights on all
+    // layers, so the DP computes their transfer once. -1 for deterministic
+    // segments and for bubbles whose weights occur only once.
+    pmr::vector<int32_t> bubble_classes;
+    // The penalty of the DP that filled the tables.
+    int penalty = 0;
+};
+
+// Returns the number of columns of `RunLengthTables` for a layer with weights
+// `layer_weights`, any container with `size()` and `operator[]`.
+template <typename weights_t>
+int64_t countRunColumns(const weights_t &layer_weights) {
+    int64_t columns = 1;
+    for (size_t index = 1; index < layer_weights.size(); index++) {
+        columns += index + 1 == layer_weights.size() ||
+                   layer_weights[index + 1] != layer_weights[index];
+    }
+    return columns;
+}
+
+// Initializes the run-length tables for the runs of `weights`. The tables only
+// depend on the weights and can be filled again with a different penalty.
+template <typename score_t = int>
+RunLengthTables<score_t> initRunLengthTables(
+    const weight_matrix &weights,
+    pmr::memory_resource *resource = pmr::get_default_resource());
+
+// Same as `findMaxScoringPaths()` above, on the run-length tables. A bubble
+// that repeats an earlier bubble of its class, entered from a start vertex with
+// the same W(p, 1) - W(p, 0), copies the cells of the earlier bubble instead of
+// computing them. Throws `invalid_argument` if `penalty` is negative.
+template <typename score_t, typename index_t = int>
+score_t findMaxScoringPaths(const eds_matrix &eds_segments,
+                            const weight_matrix &weights,
+                            RunLengthTables<score_t> &tables, int penalty);
+
+// Same score as `findMaxScoringPaths()`, without tables: only the cells of the
+// last vertices of two segments are kept.
+template <typename score_t, typename index_t = int>
+score_t findMaxScore(const eds_matrix &eds_segments,
+                     const weight_matrix &weights, int penalty);
+
+// Unprofitable regions.
+// A path pays off only where it selects a window of positive weight, long
+// AT-rich stretches under GC content scoring never host a selected vertex. A
+// region of consecutive N vertices R = p+1..q of a deterministic segment with
+// sum S is unprofitable if every prefix and every suffix of R has a negative
+// sum, every window of R has a sum below x and S < -x: taking the vertices of
+// R out of a path, or a path out of R, raises the score, so no solution of
+// the DP needs a vertex of R. Then W(v, 0) = W(p, 0) for every v in R and
+// W(q, 1) = max{W(p, 1) + S, W(p, 0) - x + M} for the largest suffix sum M of
+// R, the DP fills only the cells of q and the traceback jumps from q to p.
+// The bounds are those of the maximal-scoring subsequences: one pass over the
+// weights tracks the prefix sum and the largest suffix sum as in Kadane's
+// algorithm. The regions stay within deterministic segments, the DP of the
+// bubbles needs the exact cells of their start vertices.
+
+// The regions of a graph, in the order of the graph.
+struct UnprofitableRegions {
+    struct Region {
+        int64_t segment;
+        // The first and the last vertex of R, on layer 0.
+        int64_t first_index;
+        int64_t last_index;
+        // S and M above.
+        int64_t sum;
+        int64_t max_suffix_sum;
+    };
+
+    vector<Region> regions;
+    // The penalty the regions were found for.
+    int penalty = 0;
+};
+
+// Returns the unprofitable regions of the graph for `penalty`, one linear pass
+// over `weights`. Throws `invalid_argument` if `penalty` is negative.
+UnprofitableRegions findUnprofitableRegions(const eds_matrix &eds_segments,
+                                            const weight_matrix &weights,
+                                            int penalty);
+
+// Same as `findMaxScoringPaths()` above, the cells of the vertices of
+// `regions` but their last ones are not filled. Throws `invalid_argument` if
+// `regions` were found for another penalty.
+template <typename score_t, typename index_t = int>
+score_t findMaxScoringPaths(const eds_matrix &eds_segments,
+                            const weight_matrix &weights,
+                            basic_score_matrix<score_t> &scores,
+                            basic_score_matrix<score_t> &choices, int penalty,
+                            const UnprofitableRegions &regions);
+
+// Weight tracks.
+// The DP also reads the weights from a `WeightTrack`, a memory-mapped track
+// file of precomputed weights, see weight_track.hpp. The functions below are
+// the ones above with the weights of `track` instead of a `weight_matrix`.
+class WeightTrack;
+
+int64_t scoreBound(const eds_matrix &eds_segments, const WeightTrack &track,
+                   int penalty);
+ScoreWidth selectScoreWidth(const eds_matrix &eds_segments,
+                            const WeightTrack &track, int penalty);
+
+template <typename score_t = int>
+basic_score_matrix<score_t> initScoreMatrix(
+    const WeightTrack &track,
+    pmr::memory_resource *resource = pmr::get_default_resource());
+
+template <typename score_t, typename index_t = int>
+score_t findMaxScoringPaths(const eds_matrix &eds_segments,
+                            const WeightTrack &track,
+                            basic_score_matrix<score_t> &scores,
+                            basic_score_matrix<score_t> &choices, int penalty);
+
+template <typename score_t, typename index_t = int>
+score_t findMaxScore(const eds_matrix &eds_segments, const WeightTrack &track,
+                     int penalty);
+
+// Splits the graph into blocks of at least `block_vertices` vertices for
+// `findMaxScoringPathsCheckpointed()`, returns the first segment of every
+// block. Every block but the first one starts with a bubble.
+vector<int64_t> checkpointBlocks(const eds_matrix &eds_segments,
+                                 int64_t block_vertices);
+
+// Default size of the blocks of `findMaxScoringPathsCheckpointed()`.
+const int64_t DEFAULT_BLOCK_VERTICES = 1 << 16;
+
+// Default interval of the traceback of `OnlineMaxScorePaths`.
+const int64_t DEFAULT_ONLINE_INTERVAL_VERTICES = 1 << 16;
+
+// Paths allocated from a `pmr::memory_resource`.
+template <typename index_t>
+using pmr_paths = pmr::vector<pmr::vector<BasicVertex<index_t>>>;
+
+// Same as above, but appends the paths to `paths`, which is either a `vector`
+// or a `pmr_paths`. The paths use the allocator of `paths`.
+template <typename score_t, typename paths_t>
+void getPaths(const eds_matrix &eds_segments,
+              basic_score_matrix<score_t> &scores,
+              basic_score_matrix<score_t> &choices, paths_t &paths);
+
+// Same as above, for the run-length tables filled by `findMaxScoringPaths()`.
+template <typename score_t, typename paths_t>
+void getPaths(const eds_matrix &eds_segments, const weight_matrix &weights,
+              const RunLengthTables<score_t> &tables, paths_t &paths);
+
+// Same as above, for the tables filled by `findMaxScoringPaths()` with
+// `regions`. The traceback jumps over the regions, the cells of a region are
+// filled when a path reaches it selected on a tie.
+template <typename score_t, typename paths_t>
+void getPaths(const eds_matrix &eds_segments, const weight_matrix &weights,
+              basic_score_matrix<score_t> &scores,
+              basic_score_matrix<score_t> &choices,
+              const UnprofitableRegions &regions, paths_t &paths);
+
+// Parallel traceback.
+// The traceback is a backward sweep, but where it leaves no path open at the
+// last vertex of a deterministic segment, its state is the same as at the end
+// of the graph, so the traceback of the graph before that vertex does not
+// depend on the graph after it. The parallel traceback splits the graph into
+// chunks, see `checkpointBlocks()`, and traces back every chunk from its last
+// vertex in its own thread as if no path were open there. The traceback from
+// the end of the graph then follows each chunk only up to the first such vertex
+// where the traceback of the chunk left no path open either, and takes the
+// paths of the chunk from there on. The paths are the ones of `getPaths()`,
+// the speedup depends on paths that end often.
+
+// Same as `getPaths()` above, with the traceback in `num_threads` threads.
+template <typename score_t, typename paths_t>
+void getPathsInParallel(const eds_matrix &eds_segments,
+                        basic_score_matrix<score_t> &scores,
+                        basic_score_matrix<score_t> &choices, paths_t &paths,
+                        int num_threads);
+
+// Same as above, for the run-length tables.
+template <typename score_t, typename paths_t>
+void getPathsInParallel(const eds_matrix &eds_segments,
+                        const weight_matrix &weights,
+                        const RunLengthTables<score_t> &tables,
+                        paths_t &paths, int num_threads);
+
+// Same score and paths as `findMaxScoringPaths()` and `getPaths()` on full
+// tables, appended to `paths`, but with the tables of one block of
+// `checkpointBlocks()` at a time. A forward pass computes the score and saves
+// the cell of the start vertex of every block's first bubble. Then the tables
+// of the blocks are recomputed from these checkpoints, from the last block to
+// the first one, and the traceback resumes in every block where it left the
+// next one. The tables are allocated from `resource`.
+template <typename score_t, typename paths_t>
+score_t findMaxScoringPathsCheckpointed(
+    const eds_matrix &eds_segments, const weight_matrix &weights, int penalty,
+    int64_t block_vertices, paths_t &paths,
+    pmr::memory_resource *resource = pmr::get_default_resource());
+
+// Packed tables.
+// The traceback reads the choices only, and every choice but those of the J
+// vertices is `FIRST` or `SECOND`. The packed tables keep the four choices of
+// a vertex in 4 bits, two vertices per byte, and the choice cells of the J
+// vertices in full. The scores are kept for the last vertices of two segments
+// only, as in `findMaxScore()`.
+template <typename score_t>
+struct PackedTables {
+    explicit PackedTables(
+        pmr::memory_resource *resource = pmr::get_default_resource())
+        : layer_starts(resource),
+          segment_first_layers(resource),
+          choice_bits(resource),
+          j_choices(resource) {}
+
+    // Returns the choice of the DP for vertex `v`.
+    template <typename index_t>
+    int choice(BasicVertex<index_t> v, bool selected,
+               path_continuation layer) const {
+        int64_t first_layer = segment_first_layers[v.segment];
+        // A J vertex is the first vertex of a deterministic segment after a
+        // bubble, see `isJVertex()`.
+        if (v.index == 0 && v.segment > 0 &&
+            segment_first_layers[v.segment + 1] - first_layer == 1 &&
+            first_layer - segment_first_layers[v.segment - 1] > 1) {
+            return j_choices[v.segment][selected][layer];
+        }
+        int64_t position = layer_starts[first_layer + v.layer] + v.index;
+        int bits = choice_bits[position >> 1] >> (4 * (position & 1));
+        return (bits >> (2 * selected + layer)) & 1;
+    }
+
+    // `layer_starts[segment_first_layers[segment] + layer]` is the position
+    // of the first vertex of the layer in the order of the graph. Both end
+    // with the number of vertices and of layers of the graph.
+    pmr::vector<int64_t> layer_starts;
+    pmr::vector<int64_t> segment_first_layers;
+    // Bit `2 * selected + layer` of the 4 bits of a vertex is its choice for
+    // `selected` and path continuation `layer`.
+    pmr::vector<uint8_t> choice_bits;
+    // `j_choices[segment]` are the choices of the J vertex of `segment`, if
+    // it has one.
+    pmr::vector<score_cell<score_t>> j_choices;
+};
+
+// Initializes the packed tables of `eds_segments`.
+template <typename score_t = int>
+PackedTables<score_t> initPackedTables(
+    const eds_matrix &eds_segments,
+    pmr::memory_resource *resource = pmr::get_default_resource());
+
+// Same as `findMaxScoringPaths()` above, on the packed tables.
+template <typename score_t, typename index_t = int>
+score_t findMaxScoringPaths(const eds_matrix &eds_segments,
+                            const weight_matrix &weights,
+                            PackedTables<score_t> &tables, int penalty);
+
+// Same as `getPaths()` above, for the packed tables filled by
+// `findMaxScoringPaths()`.
+template <typename score_t, typename paths_t>
+void getPaths(const eds_matrix &eds_segments,
+              const PackedTables<score_t> &tables, paths_t &paths);
+
+// Same as `getPathsInParallel()` above, for the packed tables.
+template <typename score_t, typename paths_t>
+void getPathsInParallel(const eds_matrix &eds_segments,
+                        const PackedTables<score_t> &tables, paths_t &paths,
+                        int num_threads);
+
+// Appendable DP.
+// The DP is a forward sweep, so appending segments to a graph does not change
+// the cells of its vertices. `AppendableMaxScorePaths` keeps the full tables of
+// a growing graph and fills only the cells of the appended vertices. The
+// traceback starts from the new last vertex and stops where it meets the
+// traceback of the previous graph in the same state, the paths before that
+// point are kept.
+template <typename score_t, typename index_t = int>
+class AppendableMaxScorePaths {
+   public:
+    typedef BasicVertex<index_t> vertex_t;
+
+    // Starts with the graph of empty EDS text. The weights are the GC content
+    // weights with `match` and `non_match`.
+    AppendableMaxScorePaths(
+        int match, int non_match, int penalty,
+        pmr::memory_resource *resource = pmr::get_default_resource());
+
+    // Appends `EDS` to the EDS text of the graph, the graph becomes the
+    // `EDSToMatrix()` of the whole text enclosed as by `readEDSFile()`. Returns
+    // the max score of the new graph. Throws `overflow_error` if `score_t` or
+    // `index_t` is too narrow for the new graph, the graph is unchanged then.
+    score_t append(const string &EDS);
+
+    const eds_matrix &graph() const { return eds_segments_; }
+    score_t score() const { return score_; }
+    // The paths of `getPaths()` in the order of the graph, i.e. reversed. The
+    // last `changedPaths()` paths were found by the last `append()`, the other
+    // ones were kept.
+    const vector<vector<vertex_t>> &paths() const { return paths_; }
+    size_t changedPaths() const { return changed_paths_; }
+    // The number of vertices whose cells the last `append()` filled.
+    int64_t filledVertices() const { return filled_vertices_; }
+
+   private:
+    // Fills the weights and the cells from `first` on and traces back the
+    // paths. The traceback of the previous graph is valid before segment
+    // `first_changed_segment`.
+    void update(vertex_t first, int64_t first_changed_segment);
+    void traceBackPaths(int64_t first_changed_segment);
+
+    int match_;
+    int non_match_;
+    int penalty_;
+    eds_matrix eds_segments_;
+    weight_matrix weights_;
+    basic_score_matrix<score_t> scores_;
+    basic_score_matrix<score_t> choices_;
+    score_t score_ = 0;
+    vector<vector<vertex_t>> paths_;
+    // `paths_before_[segment]` is the number of paths before the last vertex
+    // of the segment if the traceback left no path open there, otherwise -1.
+    vector<int64_t> paths_before_;
+    size_t changed_paths_ = 0;
+    int64_t filled_vertices_ = 0;
+
+    // Statistics of the graph for `checkTypeWidths()`.
+    int64_t num_vertices_ = 0;
+    int64_t max_abs_weight_ = 0;
+    int64_t max_bubble_width_ = 1;
+    int64_t max_coordinate_ = 0;
+};
+
+// Online traceback.
+// The traceback from the last vertex p of a deterministic segment takes one of
+// two courses, depending only on whether the traceback from the end of the
+// graph reaches p with p surely selected or not. Where both courses reach the
+// last vertex c of an earlier deterministic segment with c not surely
+// selected, they make the same choices from c on, like the survivor paths of
+// Viterbi decoding: the paths before c are final whatever follows p, except
+// for the path still open at c, which continues into the part after c.
+// `OnlineMaxScorePaths` fills the DP segment by segment as the graph grows,
+// traces back both courses from the last deterministic segment every so often
+// and hands out the paths before the latest c where they meet. Only the
+// choices of the vertices from c on are kept, so the memory and the delay of
+// the paths depend on how far back the courses meet instead of on the length
+// of the graph.
+template <typename score_t, typename index_t = int>
+class OnlineMaxScorePaths {
+   public:
+    typedef BasicVertex<index_t> vertex_t;
+    typedef vector<vector<vertex_t>> paths_t;
+
+    // The courses are traced back after every `interval` filled vertices, or
+    // after as many vertices as there are kept choices if that is more.
+    explicit OnlineMaxScorePaths(
+        int penalty, int64_t interval = DEFAULT_ONLINE_INTERVAL_VERTICES);
+
+    // Fills the segments of `eds_segments` after the ones filled by the
+    // previous calls and appends the paths that became final to `paths`, in
+    // the order of the graph. `eds_segments` and `weights` are the graph so
+    // far, its segments are complete: later calls only add segments. The
+    // caller selects `score_t`, see `selectScoreWidth()`.
+    void extend(const eds_matrix &eds_segments, const weight_matrix &weights,
+                paths_t &paths);
+
+    // Appends the remaining paths once `extend()` filled the whole graph
+    // `eds_segments` and returns its score. All paths appended to `paths` are
+    // then those of `getPaths()` in the order of the graph, i.e. reversed.
+    score_t finish(const eds_matrix &eds_segments, paths_t &paths);
+
+    // The number of vertices whose choices are kept, now and at most.
+    int64_t keptVertices() const { return kept_vertices_; }
+    int64_t maxKeptVertices() const { return max_kept_vertices_; }
+
+   private:
+    // Traces back both courses from the last vertex of `segment`, if they meet
+    // the paths before are appended to `paths`.
+    void traceBackCourses(const eds_matrix &eds_segments, int64_t segment,
+                          paths_t &paths);
+    // Traces back from the last vertex of `segment`, not surely selected, with
+    // a path open, or from the end of the graph if `segment` is -1, to the
+    // last vertex of `final_segment_`. The paths that do not depend on the
+    // path open at the last vertex of `segment` are appended to `paths`.
+    void traceBackFrom(const eds_matrix &eds_segments, int64_t segment,
+                       paths_t &paths);
+    // Drops the choices of the segments before `segment`.
+    void dropChoicesBefore(int64_t segment);
+    int choiceOf(vertex_t v, bool surely_selected,
+                 path_continuation path_goes) const {
+        return choices_[v.segment - first_kept_segment_][v.layer][v.index]
+                       [surely_selected][path_goes];
+    }
+
+    int penalty_;
+    int64_t interval_;
+    int64_t filled_segments_ = 0;
+    // The cells of the last vertices of the layers of the last filled
+    // segment, and a buffer for the next one.
+    vector<score_cell<score_t>> last_cells_;
+    vector<score_cell<score_t>> cells_;
+    // The choices of the segments from `first_kept_segment_` on.
+    deque<vector<vector<score_cell<score_t>>>> choices_;
+    int64_t first_kept_segment_ = 0;
+    // The deterministic segment at whose last vertex the paths before are
+    // final, or -1.
+    int64_t final_segment_ = -1;
+    // The paths that wait for the path open at the last vertex of
+    // `final_segment_`, in the order of the traceback: the ones up to the last
+    // one that continues it. The open path is a vertex outside of the graph in
+    // them, see `openPathMark()`.
+    paths_t waiting_paths_;
+    int64_t kept_vertices_ = 0;
+    int64_t max_kept_vertices_ = 0;
+    int64_t filled_since_traceback_ = 0;
+    int64_t kept_after_traceback_ = 0;
+};
+
+// Comparative DP.
+// Let p be the last vertex of a deterministic segment and d = W(p, 1) -
+// W(p, 0). The cells of the last vertex of the next deterministic segment are
+// W(p, 0) plus values that depend only on d and the bubble and the segment in
+// between, see `BubbleMemo`, and so for any run of bubbles. A graph is cut
+// into such runs, its units, at the bubbles whose content hash selects them,
+// so that the same content is cut the same way in every graph. Related
+// graphs, e.g. of nested sample sets of one reference, share most of their
+// units. `ComparativeMaxScores` computes the transfer of a unit, from d to the
+// d and W(., 0) at its end, once per content and d, and reuses it for every
+// later occurrence of the unit, in the same or in another graph of a series.
+class ComparativeMaxScores {
+   public:
+    // The weights are the GC content weights with `match` and `non_match`.
+    ComparativeMaxScores(int match, int non_match, int penalty);
+
+    // Returns the max score of `eds_segments`, the same as `findMaxScore()`.
+    // Throws `overflow_error` if the scores do not fit into 64 bits.
+    int64_t score(const eds_matrix &eds_segments);
+
+    // The units filled by the DP and the ones taken from earlier units by the
+    // calls of `score()` so far.
+    int64_t computedUnits() const { return computed_units_; }
+    int64_t reusedUnits() const { return reused_units_; }
+
+   private:
+    // On average, a unit ends after this many bubbles.
+    static const int UNIT_BUBBLES = 8;
+
+    // The state at the end of a unit for the d at its start, relative to
+    // W(p, 0) of its start vertex p.
+    struct Transfer {
+        int64_t d;
+        int64_t end_d;
+        int64_t offset;
+    };
+
+    int match_;
+    int non_match_;
+    int penalty_;
+    // The transfers of every unit by its content.
+    unordered_map<string, vector<Transfer>> units_;
+    int64_t computed_units_ = 0;
+    int64_t reused_units_ = 0;
+};
+
+// Sharded DP.
+// A graph is cut into shards before bubbles, as by `checkpointBlocks()`, so
+// that every shard can be filled on another machine. Let p be the last vertex
+// before a shard and q its last vertex. Every score of the shard is a maximum
+// of sums with exactly one cell of p, so W(q, s) = max{W(p, 0) + T[s][0],
+// W(p, 1) + T[s][1]} for a matrix T of the shard, its transfer. The transfers
+// are composed in the max-plus algebra into the exact cells of every p, then
+// every shard is filled again from its p and traced back. The traceback of a
+// shard depends on the state that the traceback of the next shard left at q,
+// one of `ShardExit`, so every shard is traced back from all of them and the
+// tracebacks are stitched together from the last shard on.
+//
+// A shard is a graph whose first segment is deterministic: the first shard
+// starts with the first segment of the graph, the other shards with the
+// segment `EMPTY_STR` that stands for p, see `shardSegments()`.
+
+// W(., 0) and W(., 1) of the last vertex of a deterministic segment.
+typedef array<int64_t, 2> boundary_cells;
+// `transfer[s][t]` is T[s][t] above.
+typedef array<array<int64_t, 2>, 2> shard_transfer;
+// A score of no path, e.g. T[s][t] if W(q, s) does not depend on W(p, t), or
+// W(p, 1) before the first shard. Sums with scores stay below any score.
+const int64_t NO_SCORE = INT64_MIN / 4;
+
+// Returns the shard of segments `first_segment`..`end_segment` - 1 of
+// `eds_segments`, `first_segment` is 0 or a bubble.
+eds_matrix shardSegments(const eds_matrix &eds_segments, int64_t first_segment,
+                         int64_t end_segment);
+
+// Returns the transfer of `shard` under the GC content weights with `match` and
+// `non_match`. The cells of the first shard do not depend on p. Throws
+// `overflow_error` if the scores of the shard do not fit into 64 bits.
+shard_transfer computeShardTransfer(const eds_matrix &shard, bool is_first,
+                                    int match, int non_match, int penalty);
+
+// Returns the cells of q for the cells `p` of p.
+boundary_cells applyShardTransfer(const shard_transfer &transfer,
+                                  const boundary_cells &p);
+
+// The state of the traceback at q when it enters a shard: no path open, a
+// path open through the successor of q, or such a path that selects q.
+enum ShardExit { EXIT_CLOSED, EXIT_OPEN, EXIT_SELECTED, NUM_SHARD_EXITS };
+
+// The traceback of a shard from one `ShardExit`. The paths are in the
+// coordinates of the shard, in the order of the traceback, and each from its
+// first vertex on, as in the paths of `getPaths()`.
+struct ShardTraceback {
+    // The paths that end in the shard.
+    vector<vector<Vertex64>> paths;
+    // The path that is open at p, empty if none.
+    vector<Vertex64> open_path;
+    // The paths of `paths` that continue the path open at q, the vertices of
+    // that path follow after theirs. The traceback of `getPaths()` may copy
+    // the path before it ends it, so there can be more than one.
+    vector<int64_t> continued_paths;
+    // Whether `open_path` continues the path open at q.
+    bool open_path_continues = false;
+    // The `ShardExit` of the traceback of the previous shard.
+    ShardExit p_exit = EXIT_CLOSED;
+};
+
+// Fills `shard` from the cells `p` of p and traces it back from every
+// `ShardExit`, indexed by it. Throws `overflow_error` as
+// `computeShardTransfer()`.
+array<ShardTraceback, NUM_SHARD_EXITS> traceBackShard(const eds_matrix &shard,
+                                                      bool is_first,
+                                                      const boundary_cells &p,
+                                                      int match, int non_match,
+                                                      int penalty);
+
+// Forced scores.
+// The backward DP mirrors `findMaxScoringPaths()`: it goes through the rules in
+// reverse order and computes for every cell the best score that the rest of
+// the graph adds to a solution that uses the score of the cell, B(a, _, _).
+// Every rule W(a, ...) = max{...} passes B(a, ...) on to the cells it sums up,
+// so W(a, s, _) + B(a, s, _) is the best score of the graph with a solution
+// that goes through the cell. The solutions with a selected are the ones
+// through W(a, 1, _), the others take the term of W(a, 0, _) without a, so the
+// best score of the graph with a vertex selected, or not selected, follows from
+// its cells for all vertices after one forward and one backward pass.
+//
+// A vertex is selected if the score of the solution contains its weight. The
+// W(a, 0) of a J vertex takes the groups of W(a, 1) without w(a), so a solution
+// through it does not select the J vertex, and B(a, 1) of the J vertex has only
+// the solutions that use W(a, 1) itself. The scores are the ones of the DP
+// with the weight of the vertex raised high enough to select it, or lowered
+// low enough not to select it.
+
+// `forced[SURELY_SELECTED]` is the best score of the graph with the vertex
+// selected, `NO_SCORE` if the DP has no such solution, e.g. for a J vertex at
+// the end of the graph. `forced[!SURELY_SELECTED]` is the best score with the
+// vertex not selected. The larger of them is the score of the graph.
+typedef array<int64_t, 2> forced_scores;
+
+// Returns the cells B of the graph with the cells `scores` of
+// `findMaxScoringPaths()` for `weights` and `penalty`, in the shape of
+// `scores`. Cells that no solution goes through, e.g. the E continuation of N
+// and J vertices, are `NO_SCORE`.
+template <typename score_t>
+basic_score_matrix<int64_t> findBackwardScores(
+    const eds_matrix &eds_segments, const weight_matrix &weights,
+    const basic_score_matrix<score_t> &scores, int penalty,
+    pmr::memory_resource *resource = pmr::get_default_resource());
+
+// Returns the forced scores of every vertex from the cells `scores` of
+// `findMaxScoringPaths()` and `backward` of `findBackwardScores()`, in the
+// vertex order of the graph: segment by segment, layer by layer, vertex by
+// vertex.
+template <typename score_t>
+vector<forced_scores> getForcedScores(
+    const eds_matrix &eds_segments, const basic_score_matrix<score_t> &scores,
+    const basic_score_matrix<int64_t> &backward);
+
+// Lane-batched DP.
+// On many small graphs, the per-graph overhead and the scalar loops dominate.
+// The lane-batched DP packs graphs with the same sequence of deterministic
+// segments and bubbles into the lanes of one set of tables, the cell of a
+// vertex holds the scores of all lanes side by side. Shorter layers, narrower
+// bubbles and fewer segments are padded, so the later vertices of a layer are
+// filled in all lanes at once by loops that the compiler vectorizes. The first
+// vertices of the layers and the J vertices are filled lane by lane.
+
+// The score and the paths of one graph.
+template <typename index_t>
+struct BatchResult {
+    int64_t score = 0;
+    // As found by `getPaths()`.
+    vector<vector<BasicVertex<index_t>>> paths;
+};
 
-// Prints out the paths that were found by `getPaths()`.
-void printPaths(vector<vector<Vertex>> paths);
+// Returns the same scores and paths as `findMaxScoringPaths()` and
+// `getPaths()` for the graphs `graphs` with the weights `weights`, in the order
+// of the graphs. Throws `overflow_error` if `score_t` or `index_t` is too
+// narrow for one of the graphs.
+template <typename score_t, typename index_t = int>
+vector<BatchResult<index_t>> findMaxScoringPathsInLanes(
+    const vector<eds_matrix> &graphs, const vector<weight_matrix> &weights,
+    int penalty);
+
+// Same as above, with the weights of `getGCContentWeights()` and the narrowest
+// score type for all graphs.
+template <typename index_t = int>
+vector<BatchResult<index_t>> findMaxScoringPathsBatch(
+    const vector<eds_matrix> &graphs, int match, int non_match, int penalty);
+
+// The following functions accept paths in a `vector` or in `pmr_paths`.
+// Prints out the paths that were found by `getPaths()`, for debugging. See
+// `PathWriter` for writing large numbers of paths.
+template <typename paths_t>
+void printPaths(const paths_t &paths);
 
 // Returns the sum length of all paths in `paths`.
-int lengthOfPaths(vector<vector<Vertex>> paths);
+template <typename paths_t>
+int64_t lengthOfPaths(const paths_t &paths);
 
 // Returns the average length of paths.
-double pathsAverageLength(vector<vector<Vertex>> paths);
+template <typename paths_t>
+double pathsAverageLength(const paths_t &paths);
 
 // Calculates the length of flattened `eds_matrix`.
-int linearizedGraphLength(const eds_matrix &eds_segments);
+int64_t linearizedGraphLength(const eds_matrix &eds_segments);
 
 // Calculates the ratio of the graph that is covered by paths.
+template <typename paths_t>
 double pathCoverPercentage(const eds_matrix &eds_segments,
-                           vector<vector<Vertex>> paths);
+                           const paths_t &paths);
 
 #endif
\ No newline at end of file
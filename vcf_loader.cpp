@@ -0,0 +1,239 @@
+#include "vcf_loader.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+void appendUpper(string &out, string_view bases) {
+    size_t start = out.size();
+    out.append(bases);
+    for (size_t i = start; i < out.size(); i++) {
+        out[i] = toupper((unsigned char)out[i]);
+    }
+}
+
+// Reads the bases of the sequences of a FASTA file line by line.
+class FastaReader {
+   public:
+    explicit FastaReader(istream &input) : input_(input) {}
+
+    // Skips the rest of the current sequence and moves to the next one, sets
+    // `name` to the first word of its header. Returns false at the end of the
+    // file.
+    bool nextSequence(string &name) {
+        while (!at_header_) {
+            if (!getline(input_, line_)) {
+                return false;
+            }
+            at_header_ = !line_.empty() && line_[0] == '>';
+        }
+        at_header_ = false;
+        size_t end = line_.find_first_of(" \t\r", 1);
+        name = line_.substr(1, end == string::npos ? end : end - 1);
+        line_.clear();
+        offset_ = 0;
+        return true;
+    }
+
+    // Appends up to `count` next bases of the current sequence to `out`.
+    // Returns the number of appended bases, less than `count` at the end of
+    // the sequence.
+    int64_t read(int64_t count, string &out) {
+        int64_t appended = 0;
+        while (appended < count) {
+            if (offset_ == line_.size()) {
+                if (at_header_ || !getline(input_, line_)) {
+                    break;
+                }
+                offset_ = 0;
+                if (!line_.empty() && line_[0] == '>') {
+                    at_header_ = true;
+                    offset_ = line_.size();
+                    break;
+                }
+                if (!line_.empty() && line_.back() == '\r') {
+                    line_.pop_back();
+                }
+                continue;
+            }
+            size_t bases = min<int64_t>(count - appended,
+                                        line_.size() - offset_);
+            appendUpper(out, string_view(line_).substr(offset_, bases));
+            offset_ += bases;
+            appended += bases;
+        }
+        return appended;
+    }
+
+   private:
+    istream &input_;
+    string line_;
+    // Next base of `line_`.
+    size_t offset_ = 0;
+    // `line_` is the header of the next sequence.
+    bool at_header_ = false;
+};
+
+struct VCFRecord {
+    string chromosome;
+    int64_t position;
+    string ref;
+    // The alleles of the ALT column that are sequences.
+    vector<string> alts;
+};
+
+// An allele is a sequence if it consists of bases only.
+bool isSequence(string_view allele) {
+    return !allele.empty() &&
+           all_of(allele.begin(), allele.end(),
+                  [](char c) { return isalpha((unsigned char)c); });
+}
+
+// Reads the next record from `vcf` into `record`, skipping the header. Returns
+// false at the end of the file.
+bool readRecord(istream &vcf, string &line, VCFRecord &record) {
+    while (getline(vcf, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        // CHROM, POS, ID, REF and ALT.
+        string_view fields[5];
+        size_t start = 0;
+        for (int i = 0; i < 5; i++) {
+            size_t end = line.find('\t', start);
+            if (end == string::npos) {
+                if (i < 4) {
+                    throw runtime_error("malformed VCF record '" + line + "'");
+                }
+                end = line.size();
+            }
+            fields[i] = string_view(line).substr(start, end - start);
+            start = end + 1;
+        }
+        const char *pos_end = fields[1].data() + fields[1].size();
+        auto parsed = from_chars(fields[1].data(), pos_end, record.position);
+        if (parsed.ec != errc() || parsed.ptr != pos_end ||
+            record.position < 1 || !isSequence(fields[3])) {
+            throw runtime_error("malformed VCF record '" + line + "'");
+        }
+        record.chromosome.assign(fields[0]);
+        record.ref.clear();
+        appendUpper(record.ref, fields[3]);
+        record.alts.clear();
+        string_view alts = fields[4];
+        while (true) {
+            size_t comma = alts.find(',');
+            string_view allele = alts.substr(0, comma);
+            if (isSequence(allele)) {
+                appendUpper(record.alts.emplace_back(), allele);
+            }
+            if (comma == string_view::npos) {
+                break;
+            }
+            alts.remove_prefix(comma + 1);
+        }
+        return true;
+    }
+    return false;
+}
+
+}  // namespace
+
+eds_matrix VCFToMatrix(istream &fasta, istream &vcf,
+                       VCFLoadStatistics *statistics) {
+    VCFLoadStatistics counts;
+    FastaReader reference(fasta);
+    eds_matrix eds_segments;
+    // The deterministic segment being read, empty right after a
+    // non-deterministic segment.
+    string current(1, EMPTY_STR);
+
+    string line;
+    VCFRecord record;
+    bool has_record = readRecord(vcf, line, record);
+    string name;
+    while (reference.nextSequence(name)) {
+        // Of the next base of the sequence, 1-based as in the VCF.
+        int64_t position = 1;
+        for (; has_record && record.chromosome == name;
+             has_record = readRecord(vcf, line, record)) {
+            counts.records++;
+            if (record.position < position) {
+                counts.skipped_overlapping++;
+                continue;
+            }
+            int64_t gap = record.position - position;
+            string ref;
+            if (reference.read(gap, current) != gap ||
+                reference.read(record.ref.size(), ref) !=
+                    (int64_t)record.ref.size()) {
+                throw runtime_error("VCF record at " + name + ":" +
+                                    to_string(record.position) +
+                                    " is past the end of the sequence");
+            }
+            if (ref != record.ref) {
+                throw runtime_error("REF of the VCF record at " + name + ":" +
+                                    to_string(record.position) +
+                                    " differs from the reference");
+            }
+            position = record.position + ref.size();
+
+            vector<string> layers = {move(ref)};
+            for (auto &alt : record.alts) {
+                if (find(layers.begin(), layers.end(), alt) == layers.end()) {
+                    layers.push_back(move(alt));
+                }
+            }
+            if (layers.size() == 1) {
+                current += layers[0];
+                continue;
+            }
+            // Adjacent non-deterministic segments are separated, see
+            // `EDSToMatrix()`.
+            if (current.empty()) {
+                current += EMPTY_STR;
+            }
+            eds_segments.emplace_back(vector<string>{move(current)});
+            current.clear();
+            eds_segments.push_back(move(layers));
+            counts.variants++;
+        }
+        reference.read(INT64_MAX, current);
+    }
+    if (has_record) {
+        throw runtime_error("chromosome " + record.chromosome +
+                            " of the VCF is not in the reference after the "
+                            "previous records");
+    }
+    current += EMPTY_STR;
+    eds_segments.emplace_back(vector<string>{move(current)});
+
+    if (statistics) {
+        *statistics = counts;
+    }
+    return eds_segments;
+}
+
+eds_matrix readVCFFiles(const string &fasta_path, const string &vcf_path,
+                        VCFLoadStatistics *statistics) {
+    ifstream fasta(fasta_path);
+    if (!fasta) {
+        throw runtime_error("cannot read file '" + fasta_path + "'");
+    }
+    ifstream vcf(vcf_path);
+    if (!vcf) {
+        throw runtime_error("cannot read file '" + vcf_path + "'");
+    }
+    return VCFToMatrix(fasta, vcf, statistics);
+}
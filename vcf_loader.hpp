@@ -0,0 +1,49 @@
+#ifndef MAXSCOREPATH_VCF_LOADER_HEADER
+#define MAXSCOREPATH_VCF_LOADER_HEADER
+
+#include <cstdint>
+#include <istream>
+#include <string>
+
+#include "utility_func.hpp"
+
+using namespace std;
+
+// This file contains a loader of the graph from a reference FASTA and a VCF of
+// its variants, without writing and parsing the EDS text in between. Both
+// inputs are read once, line by line, so only the graph is kept in memory.
+//
+// The graph is the one `EDSToMatrix()` builds from the EDS text of the
+// reference in which every variant is replaced by the non-deterministic
+// segment `{REF,ALT1,ALT2...}`, with the text enclosed in `EMPTY_STR` as by
+// `readEDSFile()`:
+// - the sequences of the FASTA are concatenated in the order of the file and
+//   the bases are upper-cased;
+// - the records of a chromosome follow the order of the FASTA, sorted by
+//   position, as written by freebayes;
+// - symbolic (`<DEL>`), breakend, missing (`.`) and overlapping (`*`) alleles
+//   and repeated alleles are left out, a record without another allele keeps
+//   the reference;
+// - a record overlapping the previous record of its chromosome is skipped.
+
+// Statistics of the variants of a load.
+struct VCFLoadStatistics {
+    int64_t records = 0;
+    // Records that became non-deterministic segments.
+    int64_t variants = 0;
+    // Records overlapping the previous record.
+    int64_t skipped_overlapping = 0;
+};
+
+// Builds the graph from `fasta` and `vcf`. Throws `runtime_error` if a record
+// is malformed, its REF differs from the reference, or its chromosome is not in
+// the FASTA after the chromosome of the previous record.
+eds_matrix VCFToMatrix(istream &fasta, istream &vcf,
+                       VCFLoadStatistics *statistics = nullptr);
+
+// Reads the files `fasta_path` and `vcf_path`, see above. Throws
+// `runtime_error` if a file cannot be read.
+eds_matrix readVCFFiles(const string &fasta_path, const string &vcf_path,
+                        VCFLoadStatistics *statistics = nullptr);
+
+#endif
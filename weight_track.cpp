@@ -0,0 +1,95 @@
+#include "weight_track.hpp"
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+
+#include "result_cache.hpp"
+
+using namespace std;
+
+void writeWeightTrack(const string &file_path, const eds_matrix &eds_segments,
+                      const weight_matrix &weights) {
+    bool same_shape = weights.size() == eds_segments.size();
+    for (size_t segment = 0; same_shape && segment < weights.size();
+         segment++) {
+        same_shape = weights[segment].size() == eds_segments[segment].size();
+        for (size_t layer = 0; same_shape && layer < weights[segment].size();
+             layer++) {
+            same_shape = weights[segment][layer].size() ==
+                         eds_segments[segment][layer].size();
+        }
+    }
+    if (!same_shape) {
+        throw invalid_argument("The weights do not match the graph.");
+    }
+
+    ofstream output(file_path, ios::binary | ios::trunc);
+    if (!output) {
+        throw runtime_error("cannot write file '" + file_path + "'");
+    }
+    writeValue(output, WEIGHT_TRACK_MAGIC);
+    writeValue(output, WEIGHT_TRACK_VERSION);
+    writeValue(output, graphFingerprint(eds_segments));
+    writeValue(output, uint64_t(linearizedGraphLength(eds_segments)));
+    vector<int32_t> layer_weights;
+    for (const auto &segment : weights) {
+        for (const auto &layer : segment) {
+            layer_weights.assign(layer.begin(), layer.end());
+            output.write(reinterpret_cast<const char *>(layer_weights.data()),
+                         layer_weights.size() * sizeof(int32_t));
+        }
+    }
+    if (!output.flush()) {
+        throw runtime_error("cannot write file '" + file_path + "'");
+    }
+}
+
+VertexOrder::VertexOrder(const eds_matrix &eds_segments) {
+    segment_first_layers_.reserve(eds_segments.size() + 1);
+    layer_starts_.push_back(0);
+    for (const auto &segment : eds_segments) {
+        segment_first_layers_.push_back(layer_starts_.size() - 1);
+        for (const auto &layer : segment) {
+            layer_starts_.push_back(layer_starts_.back() + layer.size());
+        }
+    }
+    segment_first_layers_.push_back(layer_starts_.size() - 1);
+}
+
+int64_t VertexOrder::position(int64_t segment, int64_t layer,
+                              int64_t index) const {
+    if (segment < 0 || segment >= numSegments() || layer < 0 ||
+        layer >= numLayers(segment) || index < 0 ||
+        index >= layerSize(segment, layer)) {
+        throw out_of_range("The vertex is not in the graph.");
+    }
+    return layerStarts(segment)[layer] + index;
+}
+
+WeightTrack::WeightTrack(const string &file_path,
+                         const eds_matrix &eds_segments)
+    : order_(eds_segments),
+      file_(file_path, "weight track", WEIGHT_TRACK_MAGIC,
+            WEIGHT_TRACK_VERSION, WEIGHT_TRACK_HEADER_BYTES, sizeof(int32_t),
+            eds_segments, order_.numVertices()),
+      weights_(reinterpret_cast<const int32_t *>(file_.values())) {
+    // The DP reads the weights in the order of the file.
+    file_.advise(MADV_SEQUENTIAL);
+    const int32_t *weight = weights_;
+    for (const auto &segment : eds_segments) {
+        for (const auto &layer : segment) {
+            for (char c : layer) {
+                if (c == EMPTY_STR && *weight != 0) {
+                    throw invalid_argument(
+                        "'" + file_path +
+                        "' has a weight for a separator vertex.");
+                }
+                max_abs_weight_ = max(max_abs_weight_, abs((int64_t)*weight++));
+            }
+        }
+    }
+}
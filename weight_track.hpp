@@ -0,0 +1,132 @@
+#ifndef MAXSCOREPATH_WEIGHT_TRACK_HEADER
+#define MAXSCOREPATH_WEIGHT_TRACK_HEADER
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "binary_file.hpp"
+#include "utility_func.hpp"
+
+using namespace std;
+
+// This file contains external weight tracks: precomputed per-vertex weights,
+// e.g. conservation or coverage scores, in a binary file that the DP reads
+// through a memory mapping instead of a `weight_matrix`.
+//
+// A track file is a header followed by the weights as 32-bit integers in the
+// vertex order of the graph: segment by segment, layer by layer, vertex by
+// vertex, including the `EMPTY_STR` vertices of `EDSToMatrix()`, which weigh 0.
+// The header is the one of `MappedGraphFile`, with the magic number
+// `WEIGHT_TRACK_MAGIC` and the version `WEIGHT_TRACK_VERSION`. All values are
+// in the byte order of the machine, the weights start at byte
+// `WEIGHT_TRACK_HEADER_BYTES`.
+
+const uint32_t WEIGHT_TRACK_MAGIC = 0x5754534d;  // "MSTW"
+const uint32_t WEIGHT_TRACK_VERSION = 1;
+const size_t WEIGHT_TRACK_HEADER_BYTES = GRAPH_FILE_HEADER_BYTES;
+
+// The vertex order of a track for one graph: the position of every vertex,
+// and the number of layers and vertices of the segments.
+class VertexOrder {
+   public:
+    explicit VertexOrder(const eds_matrix &eds_segments);
+
+    int64_t numSegments() const { return segment_first_layers_.size() - 1; }
+    int64_t numLayers(int64_t segment) const {
+        return segment_first_layers_[segment + 1] -
+               segment_first_layers_[segment];
+    }
+    int64_t layerSize(int64_t segment, int64_t layer) const {
+        const int64_t *starts = layerStarts(segment);
+        return starts[layer + 1] - starts[layer];
+    }
+    int64_t numVertices() const { return layer_starts_.back(); }
+
+    // The positions of the first vertices of the layers of `segment`, and the
+    // one after its last vertex.
+    const int64_t *layerStarts(int64_t segment) const {
+        return &layer_starts_[segment_first_layers_[segment]];
+    }
+    // Returns the position of vertex `index` of `layer` of `segment`. Throws
+    // `out_of_range` if it is not a vertex of the graph.
+    int64_t position(int64_t segment, int64_t layer, int64_t index) const;
+
+   private:
+    // The position of the first vertex of every layer of the graph, in the
+    // order of the layers, and the number of vertices at the end.
+    vector<int64_t> layer_starts_;
+    // The position of the first layer of every segment in `layer_starts_`, and
+    // the number of layers at the end.
+    vector<int64_t> segment_first_layers_;
+};
+
+// Writes `weights` of `eds_segments` as a track to `file_path`. Throws
+// `invalid_argument` if their shapes differ, and `runtime_error` if the file
+// cannot be written.
+void writeWeightTrack(const string &file_path, const eds_matrix &eds_segments,
+                      const weight_matrix &weights);
+
+// A track file mapped into memory for one graph. The weights are indexed as in
+// a `weight_matrix`, `track[segment][layer][index]`. They are checked once when
+// the file is mapped, the DP then reads them from the mapped pages.
+class WeightTrack {
+   public:
+    // The weights of a layer.
+    class Layer {
+       public:
+        Layer(const int32_t *weights, size_t size)
+            : weights_(weights), size_(size) {}
+
+        size_t size() const { return size_; }
+        int operator[](size_t index) const { return weights_[index]; }
+
+       private:
+        const int32_t *weights_;
+        size_t size_;
+    };
+
+    // The layers of a segment.
+    class Segment {
+       public:
+        Segment(const int32_t *weights, const int64_t *layer_starts,
+                size_t size)
+            : weights_(weights), layer_starts_(layer_starts), size_(size) {}
+
+        size_t size() const { return size_; }
+        Layer operator[](size_t layer) const {
+            return Layer(weights_ + layer_starts_[layer],
+                         layer_starts_[layer + 1] - layer_starts_[layer]);
+        }
+
+       private:
+        const int32_t *weights_;
+        const int64_t *layer_starts_;
+        size_t size_;
+    };
+
+    // Maps the track of `eds_segments` from `file_path`. Throws
+    // `runtime_error` if the file cannot be mapped, and `invalid_argument` if
+    // it is not a track of this graph: a different header, fingerprint or
+    // length, or an `EMPTY_STR` vertex with a weight.
+    WeightTrack(const string &file_path, const eds_matrix &eds_segments);
+
+    // The number of segments.
+    size_t size() const { return order_.numSegments(); }
+    Segment operator[](size_t segment) const {
+        return Segment(weights_, order_.layerStarts(segment),
+                       order_.numLayers(segment));
+    }
+
+    int64_t numVertices() const { return order_.numVertices(); }
+    // The largest absolute value of the weights, for `scoreBound()`.
+    int64_t maxAbsWeight() const { return max_abs_weight_; }
+
+   private:
+    VertexOrder order_;
+    MappedGraphFile file_;
+    const int32_t *weights_;
+    int64_t max_abs_weight_ = 0;
+};
+
+#endif